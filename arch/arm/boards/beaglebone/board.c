@@ -100,6 +100,7 @@ static void beaglebone_eth_init(void)
 static int beaglebone_devices_init(void)
 {
 	am33xx_add_mmc0(NULL);
+	am33xx_add_edma();
 
 	am33xx_enable_i2c0_pin_mux();
 	beaglebone_eth_init();
@@ -28,7 +28,7 @@ static int of_arm_init(void)
 	if (root)
 		return 0;
 
-	root = of_unflatten_dtb(NULL, __dtb_start);
+	root = of_unflatten_dtb_const(NULL, __dtb_start);
 	if (root) {
 		pr_debug("using internal DTB\n");
 		of_set_root_node(root);
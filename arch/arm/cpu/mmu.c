@@ -29,6 +29,8 @@
 #include <asm/system.h>
 #include <asm/cache.h>
 #include <memory.h>
+#include <linux/list.h>
+#include <linux/bitops.h>
 #include <asm/system_info.h>
 
 #include "mmu.h"
@@ -114,36 +116,106 @@ static u32 *arm_create_pte(unsigned long virt)
 	return table;
 }
 
+/*
+ * Replace the 1MiB section mapping at virt with a second level table
+ * describing the same memory with the same cache attributes, so that
+ * parts of it can be remapped.
+ */
+static u32 *arm_split_section(unsigned long virt)
+{
+	u32 pmd = ttb[virt >> 20];
+	unsigned long phys = pmd & ~(SZ_1M - 1);
+	uint32_t flags;
+	u32 *table;
+	int i;
+
+	if (pmd & PMD_SECT_CACHEABLE)
+		flags = pte_flags_cached;
+	else
+		flags = pte_flags_uncached;
+
+	table = xmemalign(0x400, 0x400);
+
+	for (i = 0; i < 256; i++)
+		table[i] = (phys + i * PAGE_SIZE) | PTE_TYPE_SMALL | flags;
+
+	dma_flush_range((unsigned long)table, (unsigned long)table + 0x400);
+
+	ttb[virt >> 20] = (unsigned long)table | PMD_TYPE_TABLE;
+
+	return table;
+}
+
 static u32 *find_pte(unsigned long adr)
 {
 	u32 *table;
 
-	if ((ttb[adr >> 20] & PMD_TYPE_MASK) != PMD_TYPE_TABLE)
+	switch (ttb[adr >> 20] & PMD_TYPE_MASK) {
+	case PMD_TYPE_TABLE:
+		/* find the coarse page table base address */
+		table = (u32 *)(ttb[adr >> 20] & ~0x3ff);
+		break;
+	case PMD_TYPE_SECT:
+		table = arm_split_section(adr);
+		break;
+	default:
 		BUG();
-
-	/* find the coarse page table base address */
-	table = (u32 *)(ttb[adr >> 20] & ~0x3ff);
+	}
 
 	/* find second level descriptor */
 	return &table[(adr >> PAGE_SHIFT) & 0xff];
 }
 
+/*
+ * Section flags equivalent to the given page flags. Only the cached and
+ * uncached flags used in this file are known here.
+ */
+static uint32_t pte_flags_to_pmd(uint32_t flags)
+{
+	if (flags == pte_flags_cached)
+		return PMD_SECT_DEF_CACHED;
+
+	return PMD_SECT_DEF_UNCACHED;
+}
+
+/*
+ * Change the cache attributes of a page aligned range. Whole 1MiB
+ * sections that are still mapped as sections are changed in place,
+ * only sections partially covered by the range are split into pages.
+ */
 void remap_range(void *_start, size_t size, uint32_t flags)
 {
 	unsigned long start = (unsigned long)_start;
+	unsigned long end = start + size, next;
+	unsigned long *pmd = &ttb[start >> 20];
 	u32 *p;
 	int numentries, i;
 
-	numentries = size >> PAGE_SHIFT;
-	p = find_pte(start);
+	while (start < end) {
+		next = min(ALIGN(start + 1, SZ_1M), end);
+
+		if ((ttb[start >> 20] & PMD_TYPE_MASK) == PMD_TYPE_SECT &&
+				!(start & (SZ_1M - 1)) && next - start == SZ_1M) {
+			ttb[start >> 20] = (ttb[start >> 20] & ~(SZ_1M - 1)) |
+				pte_flags_to_pmd(flags);
+		} else {
+			numentries = (next - start) >> PAGE_SHIFT;
+			p = find_pte(start);
+
+			for (i = 0; i < numentries; i++) {
+				p[i] &= ~PTE_MASK;
+				p[i] |= flags | PTE_TYPE_SMALL;
+			}
 
-	for (i = 0; i < numentries; i++) {
-		p[i] &= ~PTE_MASK;
-		p[i] |= flags | PTE_TYPE_SMALL;
+			dma_flush_range((unsigned long)p,
+					(unsigned long)p + numentries * sizeof(u32));
+		}
+
+		start = next;
 	}
 
-	dma_flush_range((unsigned long)p,
-			(unsigned long)p + numentries * sizeof(u32));
+	dma_flush_range((unsigned long)pmd,
+			(unsigned long)&ttb[(end - 1) >> 20] + sizeof(u32));
 
 	tlb_invalidate();
 }
@@ -160,54 +232,6 @@ void *map_io_sections(unsigned long phys, void *_start, size_t size)
 	return _start;
 }
 
-/*
- * remap the memory bank described by mem cachable and
- * bufferable
- */
-static int arm_mmu_remap_sdram(struct memory_bank *bank)
-{
-	unsigned long phys = (unsigned long)bank->start;
-	unsigned long ttb_start = phys >> 20;
-	unsigned long ttb_end = (phys + bank->size) >> 20;
-	unsigned long num_ptes = bank->size >> 10;
-	int i, pte;
-	u32 *ptes;
-
-	pr_debug("remapping SDRAM from 0x%08lx (size 0x%08lx)\n",
-			phys, bank->size);
-
-	/*
-	 * We replace each 1MiB section in this range with second level page
-	 * tables, therefore we must have 1Mib aligment here.
-	 */
-	if ((phys & (SZ_1M - 1)) || (bank->size & (SZ_1M - 1)))
-		return -EINVAL;
-
-	ptes = xmemalign(PAGE_SIZE, num_ptes * sizeof(u32));
-
-	pr_debug("ptes: 0x%p ttb_start: 0x%08lx ttb_end: 0x%08lx\n",
-			ptes, ttb_start, ttb_end);
-
-	for (i = 0; i < num_ptes; i++) {
-		ptes[i] = (phys + i * 4096) | PTE_TYPE_SMALL |
-			pte_flags_cached;
-	}
-
-	pte = 0;
-
-	for (i = ttb_start; i < ttb_end; i++) {
-		ttb[i] = (unsigned long)(&ptes[pte]) | PMD_TYPE_TABLE |
-			(0 << 4);
-		pte += 256;
-	}
-
-	dma_flush_range((unsigned long)ttb, (unsigned long)ttb + 0x4000);
-	dma_flush_range((unsigned long)ptes, num_ptes * sizeof(u32));
-
-	tlb_invalidate();
-
-	return 0;
-}
 /*
  * We have 8 exception vectors and the table consists of absolute
  * jumps, so we need 8 * 4 bytes for the instructions and another
@@ -306,9 +330,9 @@ static int mmu_init(void)
 	vectors_init();
 
 	/*
-	 * First remap sdram cached using sections.
-	 * This is to speed up the generation of 2nd level page tables
-	 * below
+	 * Map sdram cached using sections. Sections are only split into
+	 * pages by remap_range() when a part of them needs different
+	 * attributes, coherent DMA memory gets whole sections of its own.
 	 */
 	for_each_memory_bank(bank)
 		create_sections(bank->start, bank->start, bank->size >> 20,
@@ -316,29 +340,88 @@ static int mmu_init(void)
 
 	__mmu_cache_on();
 
-	/*
-	 * Now that we have the MMU and caches on remap sdram again using
-	 * page tables
-	 */
-	for_each_memory_bank(bank)
-		arm_mmu_remap_sdram(bank);
-
 	return 0;
 }
 mmu_initcall(mmu_init);
 
+/*
+ * Coherent DMA memory is allocated page wise from pools of 1MiB
+ * sections which are mapped uncached as a whole. This keeps the
+ * remaining SDRAM mapped with cached sections instead of splitting
+ * it into pages for each allocation.
+ */
+struct dma_coherent_pool {
+	void *base;
+	int num_pages;
+	unsigned long *used;
+	struct list_head list;
+};
+
+static LIST_HEAD(dma_coherent_pools);
+
+static struct dma_coherent_pool *dma_coherent_pool_create(size_t size)
+{
+	struct dma_coherent_pool *pool;
+
+	size = ALIGN(size, SZ_1M);
+
+	pool = xzalloc(sizeof(*pool));
+	pool->base = xmemalign(SZ_1M, size);
+	pool->num_pages = size >> PAGE_SHIFT;
+	pool->used = xzalloc(BITS_TO_LONGS(pool->num_pages) * sizeof(long));
+
+	/* no dirty cache lines must be left for the uncached pool */
+	dma_flush_range((unsigned long)pool->base,
+			(unsigned long)pool->base + size);
+
+	remap_range(pool->base, size, pte_flags_uncached);
+
+	list_add_tail(&pool->list, &dma_coherent_pools);
+
+	pr_debug("dma coherent pool at 0x%p, size 0x%08zx\n", pool->base, size);
+
+	return pool;
+}
+
+static void *dma_coherent_pool_alloc(struct dma_coherent_pool *pool,
+		int num_pages)
+{
+	int i, start = 0;
+
+	for (i = 0; i < pool->num_pages; i++) {
+		if (test_bit(i, pool->used)) {
+			start = i + 1;
+			continue;
+		}
+
+		if (i - start + 1 == num_pages) {
+			for (i = start; i < start + num_pages; i++)
+				set_bit(i, pool->used);
+			return pool->base + (start << PAGE_SHIFT);
+		}
+	}
+
+	return NULL;
+}
+
 void *dma_alloc_coherent(size_t size)
 {
+	struct dma_coherent_pool *pool;
+	int num_pages;
 	void *ret;
 
 	size = PAGE_ALIGN(size);
-	ret = xmemalign(4096, size);
+	num_pages = size >> PAGE_SHIFT;
 
-	dma_inv_range((unsigned long)ret, (unsigned long)ret + size);
+	list_for_each_entry(pool, &dma_coherent_pools, list) {
+		ret = dma_coherent_pool_alloc(pool, num_pages);
+		if (ret)
+			return ret;
+	}
 
-	remap_range(ret, size, pte_flags_uncached);
+	pool = dma_coherent_pool_create(size);
 
-	return ret;
+	return dma_coherent_pool_alloc(pool, num_pages);
 }
 
 unsigned long virt_to_phys(void *virt)
@@ -353,9 +436,23 @@ void *phys_to_virt(unsigned long phys)
 
 void dma_free_coherent(void *mem, size_t size)
 {
-	remap_range(mem, size, pte_flags_cached);
+	struct dma_coherent_pool *pool;
+	int i, first;
+
+	list_for_each_entry(pool, &dma_coherent_pools, list) {
+		if (mem < pool->base ||
+				mem >= pool->base + (pool->num_pages << PAGE_SHIFT))
+			continue;
+
+		first = (mem - pool->base) >> PAGE_SHIFT;
+
+		for (i = first; i < first + (PAGE_ALIGN(size) >> PAGE_SHIFT); i++)
+			clear_bit(i, pool->used);
+
+		return;
+	}
 
-	free(mem);
+	pr_err("%s: 0x%p is not coherent DMA memory\n", __func__, mem);
 }
 
 void dma_clean_range(unsigned long start, unsigned long end)
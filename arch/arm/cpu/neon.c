@@ -0,0 +1,61 @@
+/*
+ * neon.c - enable VFP/NEON for use by memcpy
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <asm/system_info.h>
+#include <asm/neon.h>
+
+#define CPACR_CP10_CP11		(0xf << 20)
+#define CPACR_ASEDIS		(1 << 31)
+#define FPEXC_EN		(1 << 30)
+#define MVFR1_SIMD_LDST		(0xf << 8)
+
+/*
+ * Read by memcpy before the binary is relocated and before bss
+ * is cleared, so keep it in .data.
+ */
+int arm_neon_enabled __section(.data);
+
+/*
+ * Grant access to the VFP/NEON coprocessors and enable the unit. The
+ * coprocessor access bits read back as zero when there is no VFP, and
+ * MVFR1 tells whether the Advanced SIMD load/store instructions exist
+ * (Cortex-A9 without NEON has a VFP but no Advanced SIMD).
+ */
+void arm_neon_enable(void)
+{
+	u32 cpacr, mvfr1;
+
+	if (cpu_architecture() < CPU_ARCH_ARMv7)
+		return;
+
+	asm volatile("mrc p15, 0, %0, c1, c0, 2" : "=r" (cpacr));
+	cpacr |= CPACR_CP10_CP11;
+	cpacr &= ~CPACR_ASEDIS;
+	asm volatile("mcr p15, 0, %0, c1, c0, 2" : : "r" (cpacr));
+	isb();
+
+	asm volatile("mrc p15, 0, %0, c1, c0, 2" : "=r" (cpacr));
+	if ((cpacr & CPACR_CP10_CP11) != CPACR_CP10_CP11)
+		return;
+
+	/* fmxr fpexc / fmrx mvfr1, spelled out to not need -mfpu */
+	asm volatile("mcr p10, 7, %0, cr8, cr0, 0" : : "r" (FPEXC_EN));
+	asm volatile("mrc p10, 7, %0, cr6, cr0, 0" : "=r" (mvfr1));
+
+	if (!(mvfr1 & MVFR1_SIMD_LDST))
+		return;
+
+	arm_neon_enabled = 1;
+}
@@ -26,6 +26,7 @@
 #include <asm/sections.h>
 #include <asm/cache.h>
 #include <memory.h>
+#include <asm/neon.h>
 
 #include "mmu-early.h"
 
@@ -53,6 +54,8 @@ static noinline __noreturn void __start(uint32_t membase, uint32_t memsize,
 
 	setup_c();
 
+	arm_neon_enable();
+
 	barebox_boarddata = boarddata;
 	arm_stack_top = endmem;
 	endmem -= STACK_SIZE; /* Stack */
@@ -0,0 +1,20 @@
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+/* memcpy uses NEON for copies of at least this size */
+#define MEMCPY_NEON_MIN		256
+
+#ifndef __ASSEMBLY__
+
+#ifdef CONFIG_ARM_NEON_MEMCPY
+extern int arm_neon_enabled;
+void arm_neon_enable(void);
+#else
+static inline void arm_neon_enable(void)
+{
+}
+#endif
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_ARM_NEON_H */
@@ -140,6 +140,8 @@ void mxs_dma_desc_free(struct mxs_dma_desc *);
 int mxs_dma_desc_append(int channel, struct mxs_dma_desc *pdesc);
 
 int mxs_dma_go(int chan);
+int mxs_dma_go_timeout(int chan, uint32_t timeout);
 int mxs_dma_init(void);
+int mxs_dma_request_chan(int channel);
 
 #endif	/* __DMA_H__ */
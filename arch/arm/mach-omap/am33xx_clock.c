@@ -134,6 +134,12 @@ static void per_clocks_enable(void)
 
 	__raw_writel(PRCM_MOD_EN, CM_PER_SPI1_CLKCTRL);
 	while (__raw_readl(CM_PER_SPI1_CLKCTRL) != PRCM_MOD_EN);
+
+	/* EDMA channel controller and transfer controller 0 */
+	__raw_writel(PRCM_MOD_EN, CM_PER_TPCC_CLKCTRL);
+	while ((__raw_readl(CM_PER_TPCC_CLKCTRL) & 0x30000) != 0x0);
+	__raw_writel(PRCM_MOD_EN, CM_PER_TPTC0_CLKCTRL);
+	while ((__raw_readl(CM_PER_TPTC0_CLKCTRL) & 0x30000) != 0x0);
 }
 
 static void mpu_pll_config(int mpupll_M)
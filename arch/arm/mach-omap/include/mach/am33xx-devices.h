@@ -37,4 +37,10 @@ static inline struct device_d *am33xx_add_cpsw(struct cpsw_platform_data *cpsw_d
 			AM335X_CPSW_BASE, SZ_32K, IORESOURCE_MEM, cpsw_data);
 }
 
+static inline struct device_d *am33xx_add_edma(void)
+{
+	return add_generic_device("ti-edma", 0, NULL,
+			AM33XX_EDMA3CC_BASE, SZ_32K, IORESOURCE_MEM, NULL);
+}
+
 #endif /* __MACH_OMAP3_DEVICES_H */
@@ -66,6 +66,9 @@
 #define AM335X_CPSW_BASE		0x4A100000
 #define AM335X_CPSW_MDIO_BASE		0x4A101000
 
+/* EDMA3 channel controller */
+#define AM33XX_EDMA3CC_BASE		0x49000000
+
 /*DMM & EMIF4 MMR Declaration*/
 #define AM33XX_DMM_LISA_MAP__0		(AM33XX_DMM_BASE + 0x40)
 #define AM33XX_DMM_LISA_MAP__1		(AM33XX_DMM_BASE + 0x44)
@@ -127,6 +127,7 @@
 
 #define ZYNQ_TTC0_BASE_ADDR		0xF8001000
 #define ZYNQ_TTC1_BASE_ADDR		0xF8002000
+#define ZYNQ_DMAC_S_BASE_ADDR		0xF8003000
 
 #define ZYNQ_DDRC_BASE			0xF8006000
 
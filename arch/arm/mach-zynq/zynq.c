@@ -40,6 +40,8 @@ static int zynq_init(void)
 	add_generic_device("zynq-clock", 0, NULL, ZYNQ_SLCR_BASE, 0x4000, IORESOURCE_MEM, NULL);
 	add_generic_device("smp_twd", 0, NULL, CORTEXA9_SCU_TIMER_BASE_ADDR,
 				0x4000, IORESOURCE_MEM, NULL);
+	add_generic_device("pl330", 0, NULL, ZYNQ_DMAC_S_BASE_ADDR, 0x1000,
+				IORESOURCE_MEM, NULL);
 	return 0;
 }
 postcore_initcall(zynq_init);
@@ -25,32 +25,72 @@
 #include <errno.h>
 #include <mach/hostfile.h>
 #include <xfuncs.h>
+#include <fs.h>
+#include <block.h>
+#include <disks.h>
 
 struct hf_priv {
 	struct cdev cdev;
+	struct block_device blk;
 	struct hf_platform_data *pdata;
 };
 
-static ssize_t hf_read(struct cdev *cdev, void *buf, size_t count, loff_t offset, ulong flags)
+/*
+ * The files are mapped by the host side when possible, then accesses are
+ * plain memory copies. Otherwise each access is a pread/pwrite.
+ */
+static ssize_t hf_pread(struct hf_platform_data *hf, void *buf, size_t count,
+		loff_t offset)
 {
-	struct hf_platform_data *hf = cdev->priv;
-	int fd = hf->fd;
+	if (hf->base) {
+		memcpy(buf, (void *)hf->base + offset, count);
+		return count;
+	}
 
-	if (linux_lseek(fd, offset) != offset)
-		return -EINVAL;
+	if (linux_pread(hf->fd, buf, count, offset) != count)
+		return -EIO;
+
+	return count;
+}
 
-	return linux_read(fd, buf, count);
+static ssize_t hf_pwrite(struct hf_platform_data *hf, const void *buf,
+		size_t count, loff_t offset)
+{
+	if (hf->readonly)
+		return -EROFS;
+
+	if (hf->base) {
+		memcpy((void *)hf->base + offset, buf, count);
+		return count;
+	}
+
+	if (linux_pwrite(hf->fd, buf, count, offset) != count)
+		return -EIO;
+
+	return count;
+}
+
+static ssize_t hf_read(struct cdev *cdev, void *buf, size_t count, loff_t offset, ulong flags)
+{
+	return hf_pread(cdev->priv, buf, count, offset);
 }
 
 static ssize_t hf_write(struct cdev *cdev, const void *buf, size_t count, loff_t offset, ulong flags)
+{
+	return hf_pwrite(cdev->priv, buf, count, offset);
+}
+
+static int hf_memmap(struct cdev *cdev, void **map, int flags)
 {
 	struct hf_platform_data *hf = cdev->priv;
-	int fd = hf->fd;
 
-	if (linux_lseek(fd, offset) != offset)
+	if (!hf->base)
 		return -EINVAL;
+	if (hf->readonly && (flags & PROT_WRITE))
+		return -EACCES;
 
-	return linux_write(fd, buf, count);
+	*map = (void *)hf->base;
+	return 0;
 }
 
 static void hf_info(struct device_d *dev)
@@ -64,8 +104,68 @@ static struct file_operations hf_fops = {
 	.read  = hf_read,
 	.write = hf_write,
 	.lseek = dev_lseek_default,
+	.memmap = hf_memmap,
 };
 
+#ifdef CONFIG_SANDBOX_HOSTFILE_BLOCK
+static int hf_blk_read(struct block_device *blk, void *buf, int block,
+		int num_blocks)
+{
+	struct hf_priv *priv = container_of(blk, struct hf_priv, blk);
+	size_t count = (size_t)num_blocks << blk->blockbits;
+	ssize_t ret;
+
+	ret = hf_pread(priv->pdata, buf, count, (loff_t)block << blk->blockbits);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int hf_blk_write(struct block_device *blk, const void *buf, int block,
+		int num_blocks)
+{
+	struct hf_priv *priv = container_of(blk, struct hf_priv, blk);
+	size_t count = (size_t)num_blocks << blk->blockbits;
+	ssize_t ret;
+
+	ret = hf_pwrite(priv->pdata, buf, count, (loff_t)block << blk->blockbits);
+
+	return ret < 0 ? ret : 0;
+}
+
+static struct block_device_ops hf_blk_ops = {
+	.read = hf_blk_read,
+	.write = hf_blk_write,
+};
+
+static int hf_register_blockdevice(struct device_d *dev, struct hf_priv *priv)
+{
+	struct hf_platform_data *hf = priv->pdata;
+	int ret;
+
+	priv->blk.dev = dev;
+	priv->blk.ops = &hf_blk_ops;
+	priv->blk.blockbits = hf->blockbits;
+	priv->blk.num_blocks = hf->size >> hf->blockbits;
+	priv->blk.cdev.name = hf->name;
+
+	ret = blockdevice_register(&priv->blk);
+	if (ret)
+		return ret;
+
+	ret = parse_partition_table(&priv->blk);
+	if (ret)
+		dev_dbg(dev, "No partition table found\n");
+
+	return 0;
+}
+#else
+static int hf_register_blockdevice(struct device_d *dev, struct hf_priv *priv)
+{
+	dev_err(dev, "block device support is not enabled\n");
+	return -ENOSYS;
+}
+#endif
+
 static int hf_probe(struct device_d *dev)
 {
 	struct hf_platform_data *hf = dev->platform_data;
@@ -73,6 +173,9 @@ static int hf_probe(struct device_d *dev)
 
 	priv->pdata = hf;
 
+	if (hf->blockbits)
+		return hf_register_blockdevice(dev, priv);
+
 	priv->cdev.name = hf->name;
 	priv->cdev.size = hf->size;
 	priv->cdev.ops = &hf_fops;
@@ -112,3 +215,15 @@ int barebox_register_filedev(struct hf_platform_data *hf)
 	return sandbox_add_device(dev);
 }
 
+
+int barebox_register_hostdev(const char *drvname, struct hf_platform_data *hf)
+{
+	struct device_d *dev;
+
+	dev = xzalloc(sizeof(*dev));
+	strcpy(dev->name, drvname);
+	dev->id = DEVICE_ID_DYNAMIC;
+	dev->platform_data = hf;
+
+	return sandbox_add_device(dev);
+}
@@ -56,9 +56,9 @@ typedef unsigned long long u64;
 
 #define BITS_PER_LONG 32
 
-/* Dma addresses are 32-bits wide.  */
+/* DMA addresses are host pointers */
 
-typedef u32 dma_addr_t;
+typedef unsigned long dma_addr_t;
 
 #endif /* __KERNEL__ */
 
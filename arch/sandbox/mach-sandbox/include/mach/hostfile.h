@@ -7,9 +7,13 @@ struct hf_platform_data {
 	unsigned long base;
 	char *filename;
 	char *name;
+	char *args;
+	int readonly;
+	int blockbits;		/* register as block device if set */
 };
 
 int barebox_register_filedev(struct hf_platform_data *hf);
+int barebox_register_hostdev(const char *drvname, struct hf_platform_data *hf);
 
 #endif /* __ASM_ARCH_HOSTFILE_H */
 
@@ -14,6 +14,9 @@ int linux_read(int fd, void *buf, size_t count);
 int linux_read_nonblock(int fd, void *buf, size_t count);
 ssize_t linux_write(int fd, const void *buf, size_t count);
 off_t linux_lseek(int fildes, off_t offset);
+ssize_t linux_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t linux_pwrite(int fd, const void *buf, size_t count, off_t offset);
+void *linux_mmap(int fd, size_t size);
 int linux_tstc(int fd);
 
 int linux_execve(const char * filename, char *const argv[], char *const envp[]);
@@ -37,6 +37,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <strings.h>
 #include <libgen.h>
 #include <sys/mman.h>
 #include <errno.h>
@@ -186,6 +187,27 @@ off_t linux_lseek(int fd, off_t offset)
 	return lseek(fd, offset, SEEK_SET);
 }
 
+ssize_t linux_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	return pread(fd, buf, count, offset);
+}
+
+ssize_t linux_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	return pwrite(fd, buf, count, offset);
+}
+
+void *linux_mmap(int fd, size_t size)
+{
+	void *addr;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	return addr;
+}
+
 int linux_execve(const char * filename, char *const argv[], char *const envp[])
 {
 	pid_t pid, tpid;
@@ -214,10 +236,11 @@ static int add_image(char *str, char *name)
 {
 	char *file;
 	int readonly = 0, map = 1;
+	unsigned long blksize = 0;
 	struct stat s;
 	char *opt;
-	int fd, ret;
-	struct hf_platform_data *hf = malloc(sizeof(struct hf_platform_data));
+	int fd = -1, ret;
+	struct hf_platform_data *hf = calloc(1, sizeof(struct hf_platform_data));
 
 	if (!hf)
 		return -1;
@@ -228,6 +251,19 @@ static int add_image(char *str, char *name)
 			readonly = 1;
 		if (!strcmp(opt, "map"))
 			map = 1;
+		if (!strcmp(opt, "nomap"))
+			map = 0;
+		if (!strncmp(opt, "blksize=", 8))
+			blksize = strtoul(opt + 8, NULL, 0);
+	}
+
+	if (blksize) {
+		if (blksize < 512 || blksize > 65536 ||
+				(blksize & (blksize - 1))) {
+			printf("%s: invalid block size %lu\n", file, blksize);
+			goto err_out;
+		}
+		hf->blockbits = ffs(blksize) - 1;
 	}
 
 	printf("add file %s(%s)\n", file, readonly ? "ro" : "");
@@ -235,6 +271,7 @@ static int add_image(char *str, char *name)
 	fd = open(file, readonly ? O_RDONLY : O_RDWR);
 	hf->fd = fd;
 	hf->filename = file;
+	hf->readonly = readonly;
 
 	if (fd < 0) {
 		perror("open");
@@ -253,8 +290,10 @@ static int add_image(char *str, char *name)
 		hf->base = (unsigned long)mmap(NULL, hf->size,
 				PROT_READ | (readonly ? 0 : PROT_WRITE),
 				MAP_SHARED, fd, 0);
-		if ((void *)hf->base == MAP_FAILED)
+		if ((void *)hf->base == MAP_FAILED) {
 			printf("warning: mmapping %s failed\n", file);
+			hf->base = 0;
+		}
 	}
 
 	ret = barebox_register_filedev(hf);
@@ -269,6 +308,52 @@ err_out:
 	return -1;
 }
 
+/*
+ * Simulated flash devices get the file and the options following it, the
+ * options are parsed by the barebox driver.
+ */
+static int add_flashsim(char *str, const char *drvname)
+{
+	char *file;
+	struct stat s;
+	int fd;
+	struct hf_platform_data *hf = calloc(1, sizeof(struct hf_platform_data));
+
+	if (!hf)
+		return -1;
+
+	file = strtok(str, ",");
+	hf->args = strtok(NULL, "");
+
+	fd = open(file, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		perror("open");
+		goto err_out;
+	}
+
+	if (fstat(fd, &s)) {
+		perror("fstat");
+		goto err_out;
+	}
+
+	hf->fd = fd;
+	hf->size = s.st_size;
+	hf->filename = file;
+
+	printf("add %s %s\n", drvname, file);
+
+	if (barebox_register_hostdev(drvname, hf))
+		goto err_out;
+
+	return 0;
+
+err_out:
+	if (fd > 0)
+		close(fd);
+	free(hf);
+	return -1;
+}
+
 static void print_usage(const char*);
 
 static struct option long_options[] = {
@@ -280,10 +365,12 @@ static struct option long_options[] = {
 	{"stdin",  1, 0, 'I'},
 	{"xres",  1, 0, 'x'},
 	{"yres",  1, 0, 'y'},
+	{"nand",   1, 0, 'N'},
+	{"spinor", 1, 0, 'S'},
 	{0, 0, 0, 0},
 };
 
-static const char optstring[] = "hm:i:e:O:I:x:y:";
+static const char optstring[] = "hm:i:e:O:I:x:y:N:S:";
 
 int main(int argc, char *argv[])
 {
@@ -312,6 +399,10 @@ int main(int argc, char *argv[])
 			break;
 		case 'e':
 			break;
+		case 'N':
+			break;
+		case 'S':
+			break;
 		case 'O':
 			fd = open(optarg, O_WRONLY);
 			if (fd < 0) {
@@ -378,6 +469,14 @@ int main(int argc, char *argv[])
 				exit(1);
 			envno++;
 			break;
+		case 'N':
+			if (add_flashsim(optarg, "sandbox-nand"))
+				exit(1);
+			break;
+		case 'S':
+			if (add_flashsim(optarg, "sandbox-spinor"))
+				exit(1);
+			break;
 		default:
 			break;
 		}
@@ -406,7 +505,10 @@ static void print_usage(const char *prgname)
 "  -m, --malloc=<size>	Start sandbox with a specified malloc-space size in bytes.\n"
 "  -i, --image=<file>   Map an image file to barebox. This option can be given\n"
 "                       multiple times. The files will show up as\n"
-"                       /dev/fd0 ... /dev/fdx under barebox.\n"
+"                       /dev/fd0 ... /dev/fdx under barebox. Options can be\n"
+"                       appended with commas: ro, nomap (use read/write\n"
+"                       instead of mapping the file) and blksize=<n> (make\n"
+"                       it a block device with <n> byte blocks).\n"
 "  -e, --env=<file>     Map a file with an environment to barebox. With this \n"
 "                       option, files are mapped as /dev/env0 ... /dev/envx\n"
 "                       and thus are used as the default environment.\n"
@@ -417,7 +519,16 @@ static void print_usage(const char *prgname)
 "  -I, --stdin=<file>   Register a file as a console capable of doing stdin.\n"
 "                       <file> can be a regular file or a FIFO.\n"
 "  -x, --xres=<res>     SDL width.\n"
-"  -y, --yres=<res>     SDL height.\n",
+"  -y, --yres=<res>     SDL height.\n"
+"  -N, --nand=<file>[,<opt>=<val>...]\n"
+"                       Simulate a NAND chip backed by <file>. Options are\n"
+"                       pagesize, oobsize, pages (per block), blocks,\n"
+"                       bad and fail (lists of blocks separated by ':'),\n"
+"                       tr, tprog, tbers (us) and tc (ns per byte).\n"
+"  -S, --spinor=<file>[,<opt>=<val>...]\n"
+"                       Simulate a SPI NOR flash backed by <file>. Options\n"
+"                       are size, sectorsize, pagesize, hz, tpp, tse4k,\n"
+"                       tse (us) and map.\n",
 	prgname
 	);
 }
@@ -469,6 +580,21 @@ static void print_usage(const char *prgname)
  *
  * Specify SDL height
  *
+ * -N, --nand \<file\>[,\<opt\>=\<val\>...]
+ *
+ * Simulate a NAND chip with the contents of \<file\>, which holds each page
+ * followed by its OOB. The file is created and filled with 0xff if it is
+ * too small for the geometry. Options are pagesize, oobsize, pages (per
+ * block) and blocks for the geometry, bad and fail for lists of factory
+ * bad blocks and blocks failing to program or erase, and tr, tprog, tbers
+ * (us) and tc (ns per byte transferred) for the timing.
+ *
+ * -S, --spinor \<file\>[,\<opt\>=\<val\>...]
+ *
+ * Simulate a SPI NOR flash with the contents of \<file\>. Options are size,
+ * sectorsize and pagesize for the geometry, hz for the SPI clock, tpp, tse4k
+ * and tse (us) for the timing and map to allow mapped reads.
+ *
  * @section simu_dbg How to debug barebox simulator
  *
  */
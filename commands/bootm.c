@@ -45,6 +45,8 @@
 #include <globalvar.h>
 #include <magicvar.h>
 #include <asm-generic/memory_layout.h>
+#include <linux/err.h>
+#include <stringlist.h>
 
 static LIST_HEAD(handler_list);
 
@@ -133,11 +135,38 @@ static int bootm_open_initrd_uimage(struct image_data *data)
 	return 0;
 }
 
+static char *bootm_image_name_and_no(const char *name, int *no)
+{
+	char *at, *ret;
+
+	if (!name || !*name)
+		return NULL;
+
+	*no = 0;
+
+	ret = xstrdup(name);
+	at = strchr(ret, '@');
+	if (!at)
+		return ret;
+
+	*at++ = 0;
+
+	*no = simple_strtoul(at, NULL, 10);
+
+	return ret;
+}
+
 #ifdef CONFIG_OFTREE
-static int bootm_open_oftree(struct image_data *data, const char *oftree, int num)
+/*
+ * Read and unflatten the tree in @oftree. The tree refers to the blob,
+ * which is returned in @blob.
+ */
+static struct device_node *bootm_load_oftree(struct image_data *data,
+		const char *oftree, int num, void **blob)
 {
 	enum filetype ft;
 	struct fdt_header *fdt;
+	struct device_node *root;
 	size_t size;
 
 	printf("Loading devicetree from '%s'\n", oftree);
@@ -145,7 +174,7 @@ static int bootm_open_oftree(struct image_data *data, const char *oftree, int nu
 	ft = file_name_detect_type(oftree);
 	if ((int)ft < 0) {
 		printf("failed to open %s: %s\n", oftree, strerror(-(int)ft));
-		return ft;
+		return ERR_PTR(ft);
 	}
 
 	if (ft == filetype_uimage) {
@@ -160,7 +189,7 @@ static int bootm_open_oftree(struct image_data *data, const char *oftree, int nu
 		} else {
 			of_handle = uimage_open(oftree);
 			if (!of_handle)
-				return -ENODEV;
+				return ERR_PTR(-ENODEV);
 			uimage_print_contents(of_handle);
 			release = 1;
 		}
@@ -170,13 +199,13 @@ static int bootm_open_oftree(struct image_data *data, const char *oftree, int nu
 		if (release)
 			uimage_close(of_handle);
 #else
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 #endif
 	} else {
 		fdt = read_file(oftree, &size);
 		if (!fdt) {
 			perror("open");
-			return -ENODEV;
+			return ERR_PTR(-ENODEV);
 		}
 	}
 
@@ -186,13 +215,118 @@ static int bootm_open_oftree(struct image_data *data, const char *oftree, int nu
 				file_type_to_string(ft));
 	}
 
-	data->of_root_node = of_unflatten_dtb(NULL, fdt);
-	if (!data->of_root_node) {
+	/*
+	 * The tree is only used to create the fixed up tree for the
+	 * kernel, so let it refer to the blob instead of copying it.
+	 */
+	root = of_unflatten_dtb_const(NULL, fdt);
+	if (IS_ERR(root)) {
 		pr_err("unable to unflatten devicetree\n");
+		free(fdt);
+		return ERR_PTR(-EINVAL);
+	}
+
+	*blob = fdt;
+
+	return root;
+}
+
+/*
+ * Overlays given without a devicetree apply to global.bootm.oftree or,
+ * without it, to a copy of the internal tree. The internal tree itself
+ * must stay as it is when bootm fails or returns.
+ */
+static int bootm_open_base_oftree(struct image_data *data, const char *overlay)
+{
+	const char *base = getenv("global.bootm.oftree");
+	struct device_node *root;
+	void *fdt;
+
+	if (base && *base) {
+		char *name;
+		int num;
+
+		name = bootm_image_name_and_no(base, &num);
+
+		/* without -o the overlay may be global.bootm.oftree itself */
+		if (strcmp(name, overlay)) {
+			root = bootm_load_oftree(data, name, num, &fdt);
+			free(name);
+			if (IS_ERR(root))
+				return PTR_ERR(root);
+
+			if (of_overlay_is_overlay(root)) {
+				printf("%s: overlay given as base devicetree\n",
+						base);
+				of_free(root);
+				free(fdt);
+				return -EINVAL;
+			}
+
+			goto out;
+		}
+
+		free(name);
+	}
+
+	root = of_get_root_node();
+	if (!root)
+		return -ENOENT;
+
+	fdt = of_flatten_dtb(root);
+	if (!fdt)
+		return -ENOMEM;
+
+	root = of_unflatten_dtb_const(NULL, fdt);
+	if (IS_ERR(root)) {
+		free(fdt);
+		return PTR_ERR(root);
+	}
+out:
+	data->of_root_node = root;
+	data->of_root_blob = fdt;
+
+	return 0;
+}
+
+static int bootm_open_oftree(struct image_data *data, const char *oftree, int num)
+{
+	struct device_node *root;
+	void *fdt;
+	int ret = 0;
+
+	root = bootm_load_oftree(data, oftree, num, &fdt);
+	if (IS_ERR(root))
+		return PTR_ERR(root);
+
+	if (of_overlay_is_overlay(root)) {
+		/* overlays apply to the previous tree or a base tree */
+		if (!data->of_root_node)
+			ret = bootm_open_base_oftree(data, oftree);
+
+		if (!ret)
+			ret = of_overlay_apply_tree(data->of_root_node, root);
+
+		if (ret)
+			printf("applying overlay %s failed: %s\n", oftree,
+					strerror(-ret));
+
+		of_free(root);
+		free(fdt);
+
+		return ret;
+	}
+
+	if (data->of_root_node) {
+		printf("%s: only one devicetree allowed, others must be overlays\n",
+				oftree);
+		of_free(root);
+		free(fdt);
 		return -EINVAL;
 	}
 
-	free(fdt);
+	data->of_root_node = root;
+	data->of_root_blob = fdt;
 
 	return 0;
 }
@@ -215,26 +349,31 @@ static struct image_handler *bootm_find_handler(enum filetype filetype,
 	return NULL;
 }
 
-static char *bootm_image_name_and_no(const char *name, int *no)
+#ifdef CONFIG_OFTREE
+static int bootm_open_oftrees(struct image_data *data,
+		struct string_list *oftrees)
 {
-	char *at, *ret;
+	struct string_list *entry;
+	int ret;
 
-	if (!name || !*name)
-		return NULL;
+	list_for_each_entry(entry, &oftrees->list, list) {
+		char *name;
+		int num;
 
-	*no = 0;
+		if (!*entry->str)
+			continue;
 
-	ret = xstrdup(name);
-	at = strchr(ret, '@');
-	if (!at)
-		return ret;
-
-	*at++ = 0;
+		name = bootm_image_name_and_no(entry->str, &num);
 
-	*no = simple_strtoul(at, NULL, 10);
+		ret = bootm_open_oftree(data, name, num);
+		free(name);
+		if (ret)
+			return ret;
+	}
 
-	return ret;
+	return 0;
 }
+#endif
 
 #define BOOTM_OPTS_COMMON "ca:e:vo:f"
 
@@ -252,9 +391,11 @@ static int do_bootm(int argc, char *argv[])
 	int ret = 1;
 	enum filetype os_type, initrd_type = filetype_unknown;
 	const char *oftree = NULL, *initrd_file = NULL, *os_file = NULL;
+	struct string_list oftrees;
 	int fallback = 0;
 
 	memset(&data, 0, sizeof(struct image_data));
+	string_list_init(&oftrees);
 
 	data.initrd_address = UIMAGE_SOME_ADDRESS;
 	data.os_address = UIMAGE_SOME_ADDRESS;
@@ -289,7 +430,7 @@ static int do_bootm(int argc, char *argv[])
 			data.verbose++;
 			break;
 		case 'o':
-			oftree = optarg;
+			string_list_add(&oftrees, optarg);
 			break;
 		case 'f':
 			fallback = 1;
@@ -310,8 +451,8 @@ static int do_bootm(int argc, char *argv[])
 	if (initrd_file && !*initrd_file)
 		initrd_file = NULL;
 
-	if (oftree && !*oftree)
-		oftree = NULL;
+	if (list_empty(&oftrees.list) && oftree)
+		string_list_add(&oftrees, (char *)oftree);
 
 	data.os_file = bootm_image_name_and_no(os_file, &data.os_num);
 
@@ -388,15 +529,11 @@ static int do_bootm(int argc, char *argv[])
 	}
 
 #ifdef CONFIG_OFTREE
-	if (oftree) {
-		int oftree_num;
-
-		oftree = bootm_image_name_and_no(oftree, &oftree_num);
+	ret = bootm_open_oftrees(&data, &oftrees);
+	if (ret)
+		goto err_out;
 
-		ret = bootm_open_oftree(&data, oftree, oftree_num);
-		if (ret)
-			goto err_out;
-	} else {
+	if (!data.of_root_node) {
 		data.of_root_node = of_get_root_node();
 		if (bootm_verbose(&data) && data.of_root_node)
 			printf("using internal devicetree\n");
@@ -428,6 +565,12 @@ static int do_bootm(int argc, char *argv[])
 	printf("handler failed with %s\n", strerror(-ret));
 
 err_out:
+	string_list_free(&oftrees);
+#ifdef CONFIG_OFTREE
+	if (data.of_root_node && data.of_root_node != of_get_root_node())
+		of_free(data.of_root_node);
+	free(data.of_root_blob);
+#endif
 	free(data.initrd_file);
 	free(data.os_file);
 	if (data.os_res)
@@ -466,6 +609,11 @@ BAREBOX_CMD_HELP_OPT  ("-e <ofs>","entry point to the image relative to start (0
 #ifdef CONFIG_OFTREE
 BAREBOX_CMD_HELP_OPT  ("-o <oftree>","specify oftree\n")
 #endif
+#ifdef CONFIG_OF_OVERLAY
+BAREBOX_CMD_HELP_OPT  ("-o <overlay>","apply overlay, may be given multiple times. Without "
+"an oftree, overlays apply to global.bootm.oftree or to a copy of the internal "
+"devicetree\n")
+#endif
 #ifdef CONFIG_CMD_BOOTM_VERBOSE
 BAREBOX_CMD_HELP_OPT  ("-v","verbose\n")
 #endif
@@ -0,0 +1,135 @@
+/*
+ * boottrace.c - show the boot time trace
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <command.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <errno.h>
+#include <qsort.h>
+#include <kallsyms.h>
+#include <boottrace.h>
+#include <asm-generic/div64.h>
+
+static uint64_t boottrace_duration(struct boottrace_event *ev)
+{
+	return ev->end ? ev->end - ev->start : 0;
+}
+
+/* longest first */
+static int boottrace_compare(const void *a, const void *b)
+{
+	uint64_t da = boottrace_duration(*(struct boottrace_event **)a);
+	uint64_t db = boottrace_duration(*(struct boottrace_event **)b);
+
+	if (da == db)
+		return 0;
+
+	return da < db ? 1 : -1;
+}
+
+static unsigned long long to_us(uint64_t ns)
+{
+	do_div(ns, USECOND);
+
+	return ns;
+}
+
+static void boottrace_print(struct boottrace_event *ev, int indent)
+{
+	char name[KSYM_NAME_LEN];
+
+	boottrace_event_name(ev, name, sizeof(name));
+
+	printf("%10llu ", to_us(ev->start));
+	if (ev->end)
+		printf("%10llu ", to_us(boottrace_duration(ev)));
+	else
+		printf("%10s ", "-");
+	printf("%-8s %*s%s\n", boottrace_type_name(ev), indent ? ev->depth * 2 : 0,
+			"", name);
+}
+
+static int do_boottrace(int argc, char *argv[])
+{
+	struct boottrace_event **events;
+	unsigned int i, num, max = ~0;
+	int opt, chronological = 0;
+
+	while ((opt = getopt(argc, argv, "tn:ce")) > 0) {
+		switch (opt) {
+		case 't':
+			chronological = 1;
+			break;
+		case 'n':
+			max = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			boottrace_clear();
+			return 0;
+		case 'e':
+			return boottrace_export_oftree();
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	num = boottrace_num_events();
+	events = xmalloc(num * sizeof(*events));
+
+	for (i = 0; i < num; i++)
+		events[i] = boottrace_get(i);
+
+	if (!chronological)
+		qsort(events, num, sizeof(*events), boottrace_compare);
+
+	if (boottrace_num_lost())
+		printf("%u older events lost\n", boottrace_num_lost());
+
+	printf("  start/us    time/us type     name\n");
+
+	for (i = 0; i < num && i < max; i++)
+		boottrace_print(events[i], chronological);
+
+	free(events);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(boottrace)
+BAREBOX_CMD_HELP_USAGE("boottrace [OPTIONS]\n")
+BAREBOX_CMD_HELP_SHORT("Show the boot time trace, longest events first.\n")
+BAREBOX_CMD_HELP_OPT  ("-t",       "show events in chronological order, nested events indented\n")
+BAREBOX_CMD_HELP_OPT  ("-n <num>", "show only the first <num> events\n")
+BAREBOX_CMD_HELP_OPT  ("-c",       "clear the trace\n")
+BAREBOX_CMD_HELP_OPT  ("-e",       "pass the trace to the kernel in /chosen/barebox-boottrace\n")
+BAREBOX_CMD_HELP_END
+
+/**
+ * @page boottrace_command
+
+The trace records initcalls, driver probes, environment loading, sourced
+scripts and commands. Times are in microseconds. Events which have not
+finished yet, like the script currently running, show no duration.
+
+With -e the completed events are added to the devicetree passed to the
+kernel. The names property of the /chosen/barebox-boottrace node holds
+the event names, the times property a start time and a duration per
+event.
+ */
+
+BAREBOX_CMD_START(boottrace)
+	.cmd		= do_boottrace,
+	.usage		= "show boot time trace",
+	BAREBOX_CMD_HELP(cmd_boottrace_help)
+BAREBOX_CMD_END
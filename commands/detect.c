@@ -0,0 +1,93 @@
+/*
+ * detect.c - probe lazy devices and detect what is behind them
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <command.h>
+#include <driver.h>
+#include <getopt.h>
+#include <errno.h>
+#include <complete.h>
+
+static int do_detect(int argc, char *argv[])
+{
+	struct device_d *dev;
+	int opt, i, ret = 0, background = 0;
+
+	while ((opt = getopt(argc, argv, "lab")) > 0) {
+		switch (opt) {
+		case 'l':
+			for_each_device(dev) {
+				if (!dev->detect && !dev->probe_deferred)
+					continue;
+				printf("%-16s %s\n", dev_name(dev),
+					dev->probe_deferred ? "not probed" :
+					dev->detected ? "detected" : "");
+			}
+			return 0;
+		case 'a':
+			device_detect_all();
+			return 0;
+		case 'b':
+			background = 1;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind == argc)
+		return COMMAND_ERROR_USAGE;
+
+	for (i = optind; i < argc; i++) {
+		dev = get_device_by_name(argv[i]);
+		if (!dev) {
+			printf("no such device: %s\n", argv[i]);
+			ret = -ENODEV;
+			continue;
+		}
+
+		if (background)
+			ret = device_detect_async(dev);
+		else
+			ret = device_detect(dev);
+
+		if (ret)
+			printf("detecting %s failed: %s\n", argv[i],
+					strerror(-ret));
+	}
+
+	return ret ? 1 : 0;
+}
+
+BAREBOX_CMD_HELP_START(detect)
+BAREBOX_CMD_HELP_USAGE("detect [OPTIONS] [devices]\n")
+BAREBOX_CMD_HELP_SHORT("Probe devices of lazy drivers and detect what is connected to them.\n")
+BAREBOX_CMD_HELP_OPT  ("-l",  "list devices which can be detected\n")
+BAREBOX_CMD_HELP_OPT  ("-a",  "detect all devices\n")
+BAREBOX_CMD_HELP_OPT  ("-b",  "detect in the background while barebox waits for other things\n")
+BAREBOX_CMD_HELP_END
+
+/**
+ * @page detect_command
+
+Devices bound to lazy drivers are only probed when needed: when a
+parameter of the device is accessed, when a device file named after the
+device is not found or with this command. Detection also looks for cards
+or disks behind a device, for example on MCI and ATA ports.
+ */
+
+BAREBOX_CMD_START(detect)
+	.cmd		= do_detect,
+	.usage		= "detect devices",
+	BAREBOX_CMD_HELP(cmd_detect_help)
+	BAREBOX_CMD_COMPLETE(device_complete)
+BAREBOX_CMD_END
@@ -0,0 +1,245 @@
+/*
+ * flashbench.c - measure the throughput of flash devices
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fs.h>
+#include <errno.h>
+#include <malloc.h>
+#include <getopt.h>
+#include <ioctl.h>
+#include <fcntl.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/mtd-abi.h>
+#include <mtd/ubi-user.h>
+
+static void flashbench_report(const char *what, u64 bytes, u64 ns)
+{
+	u64 us = ns, rate;
+
+	do_div(us, USECOND);
+	rate = (bytes >> 10) * 1000000;
+	do_div(rate, us ? us : 1);
+	do_div(us, 1000);
+
+	printf("%-6s %8llu KiB in %6llu ms, %8llu KiB/s\n", what, bytes >> 10,
+			us, rate);
+}
+
+static int flashbench_isbad(int fd, loff_t ofs)
+{
+	return ioctl(fd, MEMGETBADBLOCK, &ofs) > 0;
+}
+
+/* Blocks failing to erase or write are marked bad and skipped afterwards */
+static void flashbench_markbad(int fd, loff_t ofs, const char *what, int err)
+{
+	printf("%s at 0x%08llx failed: %s, marking bad\n", what, ofs,
+			strerror(-err));
+	ioctl(fd, MEMSETBADBLOCK, &ofs);
+}
+
+static int flashbench_erase(int fd, struct mtd_info_user *info, loff_t size)
+{
+	u64 start = get_time_ns();
+	loff_t ofs, bytes = 0;
+	int ret;
+
+	for (ofs = 0; ofs < size; ofs += info->erasesize) {
+		if (flashbench_isbad(fd, ofs))
+			continue;
+
+		ret = erase(fd, info->erasesize, ofs);
+		if (ret) {
+			flashbench_markbad(fd, ofs, "erase", ret);
+			continue;
+		}
+		bytes += info->erasesize;
+
+		if (ctrlc())
+			return -EINTR;
+	}
+
+	flashbench_report("erase", bytes, get_time_ns() - start);
+
+	return 0;
+}
+
+static int flashbench_write(int fd, struct mtd_info_user *info, loff_t size,
+		void *buf)
+{
+	u64 start = get_time_ns();
+	loff_t ofs, bytes = 0;
+	int ret, block = 0;
+
+	for (ofs = 0; ofs < size; ofs += info->erasesize, block++) {
+		if (flashbench_isbad(fd, ofs))
+			continue;
+
+		memset(buf, block, info->erasesize);
+
+		ret = pwrite(fd, buf, info->erasesize, ofs);
+		if (ret < 0) {
+			flashbench_markbad(fd, ofs, "write", ret);
+			continue;
+		}
+		bytes += info->erasesize;
+
+		if (ctrlc())
+			return -EINTR;
+	}
+
+	flashbench_report("write", bytes, get_time_ns() - start);
+
+	return 0;
+}
+
+static int flashbench_read(int fd, struct mtd_info_user *info, loff_t size,
+		void *buf)
+{
+	u64 start = get_time_ns();
+	loff_t ofs, bytes = 0;
+	int ret;
+
+	for (ofs = 0; ofs < size; ofs += info->erasesize) {
+		if (flashbench_isbad(fd, ofs))
+			continue;
+
+		ret = pread(fd, buf, info->erasesize, ofs);
+		if (ret < 0) {
+			printf("read at 0x%08llx failed: %s\n", ofs,
+					strerror(-ret));
+			return ret;
+		}
+		bytes += info->erasesize;
+
+		if (ctrlc())
+			return -EINTR;
+	}
+
+	flashbench_report("read", bytes, get_time_ns() - start);
+
+	return 0;
+}
+
+static int flashbench_ubi(struct mtd_info_user *info)
+{
+	u64 start, ms;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_UBI)) {
+		printf("UBI support is not enabled\n");
+		return -ENOSYS;
+	}
+
+	start = get_time_ns();
+	ret = ubi_attach_mtd_dev(info->mtd, UBI_DEV_NUM_AUTO, 0);
+	ms = get_time_ns() - start;
+	if (ret < 0) {
+		printf("UBI attach failed: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	do_div(ms, MSECOND);
+	printf("attach %8u PEBs in %6llu ms\n",
+			(unsigned)(info->size / info->erasesize), ms);
+
+	return ubi_detach_mtd_dev(info->mtd, 1);
+}
+
+static int do_flashbench(int argc, char *argv[])
+{
+	struct mtd_info_user info;
+	loff_t size = 0;
+	int opt, fd, ret, do_write = 0, do_ubi = 0;
+	void *buf;
+
+	while ((opt = getopt(argc, argv, "s:wu")) > 0) {
+		switch (opt) {
+		case 's':
+			size = strtoull_suffix(optarg, NULL, 0);
+			break;
+		case 'w':
+			do_write = 1;
+			break;
+		case 'u':
+			do_ubi = 1;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (optind >= argc)
+		return COMMAND_ERROR_USAGE;
+
+	fd = open(argv[optind], do_write ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	ret = ioctl(fd, MEMGETINFO, &info);
+	if (ret < 0) {
+		perror("MEMGETINFO");
+		goto out;
+	}
+
+	if (!size || size > info.size)
+		size = info.size;
+	size = ALIGN(size, info.erasesize);
+
+	printf("%s: %llu KiB, %u KiB erase blocks, %u byte pages\n",
+			argv[optind], size >> 10, info.erasesize >> 10,
+			info.writesize);
+
+	/* Attach UBI first, it needs the contents */
+	if (do_ubi) {
+		ret = flashbench_ubi(&info);
+		if (ret)
+			goto out;
+	}
+
+	buf = xmalloc(info.erasesize);
+
+	if (do_write) {
+		ret = flashbench_erase(fd, &info, size);
+		if (!ret)
+			ret = flashbench_write(fd, &info, size, buf);
+	}
+
+	if (!ret)
+		ret = flashbench_read(fd, &info, size, buf);
+
+	free(buf);
+out:
+	close(fd);
+
+	return ret ? 1 : 0;
+}
+
+BAREBOX_CMD_HELP_START(flashbench)
+BAREBOX_CMD_HELP_USAGE("flashbench [OPTIONS] <device>\n")
+BAREBOX_CMD_HELP_SHORT("Measure the read, erase and write throughput of a flash device.\n")
+BAREBOX_CMD_HELP_OPT  ("-s <size>", "only use the first <size> bytes\n")
+BAREBOX_CMD_HELP_OPT  ("-w",  "erase and write, this destroys the contents\n")
+BAREBOX_CMD_HELP_OPT  ("-u",  "measure the time to attach UBI, then detach again\n")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(flashbench)
+	.cmd		= do_flashbench,
+	.usage		= "measure flash throughput",
+	BAREBOX_CMD_HELP(cmd_flashbench_help)
+BAREBOX_CMD_END
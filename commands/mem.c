@@ -32,6 +32,9 @@
 #include <getopt.h>
 #include <linux/stat.h>
 #include <xfuncs.h>
+#include <dmaengine.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
 
 #ifdef	CMD_MEM_DEBUG
 #define	PRINTF(fmt,args...)	printf (fmt ,##args)
@@ -62,7 +65,8 @@ int memory_display(char *addr, loff_t offs, ulong nbytes, int size, int swab)
 	 * once, and all accesses are with the specified bus width.
 	 */
 	do {
-		char	linebuf[DISP_LINE_LEN];
+		u64	linebuf[DISP_LINE_LEN / 8];
+		u64	*uqp = linebuf;
 		uint	*uip = (uint   *)linebuf;
 		ushort	*usp = (ushort *)linebuf;
 		u_char	*ucp = (u_char *)linebuf;
@@ -72,7 +76,13 @@ int memory_display(char *addr, loff_t offs, ulong nbytes, int size, int swab)
 		linebytes = (nbytes > DISP_LINE_LEN) ? DISP_LINE_LEN : nbytes;
 
 		for (i = 0; i < linebytes; i += size) {
-			if (size == 4) {
+			if (size == 8) {
+				u64 res;
+				res = (*uqp++ = *((u64 *)addr));
+				if (swab)
+					res = __swab64(res);
+				count -= printf(" %016llx", res);
+			} else if (size == 4) {
 				u32 res;
 				res = (*uip++ = *((uint *)addr));
 				if (swab)
@@ -151,6 +161,9 @@ static int mem_parse_options(int argc, char *argv[], char *optstr, int *mode,
 		case 'l':
 			*mode = O_RWSIZE_4;
 			break;
+		case 'q':
+			*mode = O_RWSIZE_8;
+			break;
 		case 's':
 			*sourcefile = optarg;
 			break;
@@ -181,7 +194,7 @@ static int do_mem_md(int argc, char *argv[])
 	if (argc < 2)
 		return COMMAND_ERROR_USAGE;
 
-	if (mem_parse_options(argc, argv, "bwls:x", &mode, &filename, NULL,
+	if (mem_parse_options(argc, argv, "bwlqs:x", &mode, &filename, NULL,
 			&swab) < 0)
 		return 1;
 
@@ -209,7 +222,7 @@ static int do_mem_md(int argc, char *argv[])
 			goto out;
 
 		if ((ret = memory_display(rw_buf, start, r,
-				mode >> O_RWSIZE_SHIFT, swab)))
+				O_RWSIZE_BYTES(mode), swab)))
 			goto out;
 
 		start += r;
@@ -230,6 +243,7 @@ static const __maybe_unused char cmd_md_help[] =
 "  -b          output in bytes\n"
 "  -w          output in halfwords (16bit)\n"
 "  -l          output in words (32bit)\n"
+"  -q          output in quad words (64bit)\n"
 "  -x          swap bytes at output\n"
 "\n"
 "Memory regions:\n"
@@ -257,7 +271,7 @@ static int do_mem_mw(int argc, char *argv[])
 	loff_t adr;
 	int swab = 0;
 
-	if (mem_parse_options(argc, argv, "bwld:x", &mode, NULL, &filename,
+	if (mem_parse_options(argc, argv, "bwlqd:x", &mode, NULL, &filename,
 			&swab) < 0)
 		return 1;
 
@@ -274,6 +288,7 @@ static int do_mem_mw(int argc, char *argv[])
 		u8 val8;
 		u16 val16;
 		u32 val32;
+		u64 val64;
 		switch (mode) {
 		case O_RWSIZE_1:
 			val8 = simple_strtoul(argv[optind], NULL, 0);
@@ -291,6 +306,12 @@ static int do_mem_mw(int argc, char *argv[])
 				val32 = __swab32(val32);
 			ret = write(fd, &val32, 4);
 			break;
+		case O_RWSIZE_8:
+			val64 = simple_strtoull(argv[optind], NULL, 0);
+			if (swab)
+				val64 = __swab64(val64);
+			ret = write(fd, &val64, 8);
+			break;
 		}
 		if (ret < 0) {
 			perror("write");
@@ -310,6 +331,7 @@ static const __maybe_unused char cmd_mw_help[] =
 "Write value(s) to the specifies region.\n"
 "options:\n"
 "  -b, -w, -l	use byte, halfword, or word accesses\n"
+"  -q		use quad word (64bit) accesses\n"
 "  -d <file>	write file (default /dev/mem)\n";
 
 BAREBOX_CMD_START(mw)
@@ -318,19 +340,67 @@ BAREBOX_CMD_START(mw)
 	BAREBOX_CMD_HELP(cmd_mw_help)
 BAREBOX_CMD_END
 
+/*
+ * Map @count bytes at @offset of @filename to *map. Fails if the file
+ * cannot be mapped or is too short, otherwise *fd must be closed when done.
+ */
+static int mem_map(const char *filename, int prot, loff_t offset,
+		loff_t count, int *fd, void **map)
+{
+	struct stat statbuf;
+	void *m;
+
+	if (stat(filename, &statbuf))
+		return -errno;
+
+	/* /dev/mem is ~0 bytes, which may be negative as loff_t */
+	if ((u64)offset + count > (u64)statbuf.st_size)
+		return -EINVAL;
+
+	*fd = open(filename, prot & PROT_WRITE ? O_RDWR : O_RDONLY);
+	if (*fd < 0)
+		return -errno;
+
+	m = memmap(*fd, prot);
+	if (m == (void *)-1) {
+		close(*fd);
+		return -ENOSYS;
+	}
+
+	*map = m + offset;
+
+	return 0;
+}
+
+static void mem_report(const char *what, loff_t bytes, u64 start)
+{
+	u64 us = get_time_ns() - start, rate;
+
+	do_div(us, USECOND);
+	rate = bytes * 1000000;
+	do_div(rate, us ? us : 1);
+	rate >>= 10;
+
+	printf("%s %lld bytes in %llu us, %llu KiB/s\n", what, bytes, us, rate);
+}
+
 static int do_mem_cmp(int argc, char *argv[])
 {
 	loff_t	addr1, addr2, count = ~0;
-	int	mode  = O_RWSIZE_1;
+	int	mode  = 0;
 	char   *sourcefile = DEVMEM;
 	char   *destfile = DEVMEM;
 	int     sourcefd, destfd;
 	char   *rw_buf1;
 	int     ret = 1;
-	int     offset = 0;
+	loff_t  offset = 0;
 	struct  stat statbuf;
+	void   *map1, *map2;
+	int	mapped1, mapped2 = 0;
+	ulong	ofs;
+	u64	start;
 
-	if (mem_parse_options(argc, argv, "bwls:d:", &mode, &sourcefile,
+	if (mem_parse_options(argc, argv, "bwlqs:d:", &mode, &sourcefile,
 			&destfile, NULL) < 0)
 		return 1;
 
@@ -354,6 +424,33 @@ static int do_mem_cmp(int argc, char *argv[])
 		count = strtoull_suffix(argv[optind + 2], NULL, 0);
 	}
 
+	start = get_time_ns();
+
+	/* compare in place if both sides can be mapped */
+	mapped1 = !mem_map(sourcefile, PROT_READ, addr1, count, &sourcefd,
+			&map1);
+	if (mapped1)
+		mapped2 = !mem_map(destfile, PROT_READ, addr2, count, &destfd,
+				&map2);
+
+	if (mapped2) {
+		ofs = memcmp_sz(map1, map2, count, mode);
+		close(sourcefd);
+		close(destfd);
+
+		if (ofs != count) {
+			printf("files differ at offset %lu\n", ofs);
+			return 1;
+		}
+
+		printf("OK\n");
+		mem_report("compared", count, start);
+		return 0;
+	}
+
+	if (mapped1)
+		close(sourcefd);
+
 	sourcefd = open_and_lseek(sourcefile, mode | O_RDONLY, addr1);
 	if (sourcefd < 0)
 		return 1;
@@ -367,7 +464,7 @@ static int do_mem_cmp(int argc, char *argv[])
 	rw_buf1 = xmalloc(RW_BUF_SIZE);
 
 	while (count > 0) {
-		int now, r1, r2, i;
+		int now, r1, r2;
 
 		now = min((loff_t)RW_BUF_SIZE, count);
 
@@ -388,18 +485,18 @@ static int do_mem_cmp(int argc, char *argv[])
 			goto out;
 		}
 
-		for (i = 0; i < now; i++) {
-			if (rw_buf[i] != rw_buf1[i]) {
-				printf("files differ at offset %d\n", offset);
-				goto out;
-			}
-			offset++;
+		ofs = memcmp_sz(rw_buf, rw_buf1, now, 0);
+		if (ofs != now) {
+			printf("files differ at offset %lld\n", offset + ofs);
+			goto out;
 		}
 
+		offset += now;
 		count -= now;
 	}
 
 	printf("OK\n");
+	mem_report("compared", offset, start);
 	ret = 0;
 out:
 	close(sourcefd);
@@ -413,14 +510,15 @@ static const __maybe_unused char cmd_memcmp_help[] =
 "Usage: memcmp [OPTIONS] <addr1> <addr2> <count>\n"
 "\n"
 "options:\n"
-"  -b, -w, -l	use byte, halfword, or word accesses\n"
+"  -b, -w, -l   use byte, halfword, or word accesses\n"
+"  -q           use quad word (64bit) accesses\n"
 "  -s <file>    source file (default /dev/mem)\n"
 "  -d <file>    destination file (default /dev/mem)\n"
 "\n"
 "Compare memory regions specified with addr1 and addr2\n"
 "of size <count> bytes. If source is a file count can\n"
 "be left unspecified in which case the whole file is\n"
-"compared\n";
+"compared. Without an access width the fastest one is used.\n";
 
 BAREBOX_CMD_START(memcmp)
 	.cmd		= do_mem_cmp,
@@ -437,8 +535,12 @@ static int do_mem_cp(int argc, char *argv[])
 	int mode = 0;
 	struct stat statbuf;
 	int ret = 0;
+	void *srcmap, *dstmap;
+	int srcmapped, dstmapped = 0;
+	loff_t total;
+	u64 start;
 
-	if (mem_parse_options(argc, argv, "bwls:d:", &mode, &sourcefile,
+	if (mem_parse_options(argc, argv, "bwlqs:d:", &mode, &sourcefile,
 			&destfile, NULL) < 0)
 		return 1;
 
@@ -462,6 +564,36 @@ static int do_mem_cp(int argc, char *argv[])
 		count = strtoull_suffix(argv[optind + 2], NULL, 0);
 	}
 
+	start = get_time_ns();
+
+	/*
+	 * Copy in one piece if both sides can be mapped, without an access
+	 * width through a DMA engine if there is one.
+	 */
+	srcmapped = !mem_map(sourcefile, PROT_READ, src, count, &sourcefd,
+			&srcmap);
+	if (srcmapped)
+		dstmapped = !mem_map(destfile, PROT_WRITE, dest, count, &destfd,
+				&dstmap);
+
+	if (dstmapped) {
+		if (mode)
+			memcpy_sz(dstmap, srcmap, count, mode);
+		else
+			dma_memcpy(dstmap, srcmap, count);
+
+		close(sourcefd);
+		close(destfd);
+
+		mem_report("copied", count, start);
+		return 0;
+	}
+
+	if (srcmapped)
+		close(sourcefd);
+
+	total = count;
+
 	sourcefd = open_and_lseek(sourcefile, mode | O_RDONLY, src);
 	if (sourcefd < 0)
 		return 1;
@@ -510,6 +642,8 @@ static int do_mem_cp(int argc, char *argv[])
 	if (count) {
 		printf("ran out of data\n");
 		ret = 1;
+	} else {
+		mem_report("copied", total, start);
 	}
 
 out:
@@ -524,10 +658,13 @@ static const __maybe_unused char cmd_memcpy_help[] =
 "\n"
 "options:\n"
 "  -b, -w, -l   use byte, halfword, or word accesses\n"
+"  -q           use quad word (64bit) accesses\n"
 "  -s <file>    source file (default /dev/mem)\n"
 "  -d <file>    destination file (default /dev/mem)\n"
 "\n"
-"Copy memory at <src> of <count> bytes to <dst>\n";
+"Copy memory at <src> of <count> bytes to <dst>\n"
+"If both files can be mapped the copy is done in place. The throughput\n"
+"is printed at the end.\n";
 
 BAREBOX_CMD_START(memcpy)
 	.cmd		= do_mem_cp,
@@ -544,7 +681,7 @@ static int do_memset(int argc, char *argv[])
 	int     ret = 1;
 	char	*file = DEVMEM;
 
-	if (mem_parse_options(argc, argv, "bwld:", &mode, NULL, &file,
+	if (mem_parse_options(argc, argv, "bwlqd:", &mode, NULL, &file,
 			NULL) < 0)
 		return 1;
 
@@ -590,6 +727,7 @@ static const __maybe_unused char cmd_memset_help[] =
 "\n"
 "options:\n"
 "  -b, -w, -l   use byte, halfword, or word accesses\n"
+"  -q           use quad word (64bit) accesses\n"
 "  -d <file>    destination file (default /dev/mem)\n"
 "\n"
 "Fill the first <n> bytes at offset <addr> with byte <c>\n";
@@ -19,17 +19,43 @@
 #include <common.h>
 #include <command.h>
 #include <complete.h>
+#include <getopt.h>
 #include <malloc.h>
+#include <slab.h>
 
 static int do_meminfo(int argc, char *argv[])
 {
+	int opt;
+
+	while ((opt = getopt(argc, argv, "a")) > 0) {
+		switch (opt) {
+		case 'a':
+			if (!IS_ENABLED(CONFIG_MALLOC_TRACE)) {
+				printf("allocation tracing is not enabled\n");
+				return 1;
+			}
+			malloc_trace_stats();
+			return 0;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
 	malloc_stats();
+	slab_stats();
 
 	return 0;
 }
 
+BAREBOX_CMD_HELP_START(meminfo)
+BAREBOX_CMD_HELP_USAGE("meminfo [OPTIONS]\n")
+BAREBOX_CMD_HELP_SHORT("Print heap usage.\n")
+BAREBOX_CMD_HELP_OPT  ("-a", "show live and peak bytes per call site (needs MALLOC_TRACE)\n")
+BAREBOX_CMD_HELP_END
+
 BAREBOX_CMD_START(meminfo)
 	.cmd		= do_meminfo,
 	.usage		= "print info about memory usage",
+	BAREBOX_CMD_HELP(cmd_meminfo_help)
 	BAREBOX_CMD_COMPLETE(empty_complete)
 BAREBOX_CMD_END
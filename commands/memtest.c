@@ -22,6 +22,20 @@
 #include <common.h>
 #include <command.h>
 #include <types.h>
+#include <errno.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <memory.h>
+#include <linux/ioport.h>
+#include <asm-generic/div64.h>
+#ifdef CONFIG_ARM
+#include <asm/mmu.h>
+#else
+static inline void dma_flush_range(unsigned long s, unsigned long e)
+{
+}
+#endif
 
 /*
  * Perform a memory test. A more complete alternative test can be
@@ -318,18 +332,351 @@ static int mem_test(ulong _start, ulong _end, ulong pattern)
 }
 #endif
 
+/*
+ * Fast mode: march tests over all of SDRAM which barebox does not use.
+ *
+ * The memory stays mapped cached. Each march element walks the range
+ * one cache line at a time, so that the DRAM only sees line fills and
+ * write backs, i.e. bursts. Between the elements the range is cleaned
+ * and invalidated, so that the next element reads what actually made
+ * it to the DRAM.
+ */
+#define MTEST_LINE_WORDS	(64 / sizeof(ulong))
+#define MTEST_LINE_SIZE		(MTEST_LINE_WORDS * sizeof(ulong))
+#define MTEST_MAX_RANGES	32
+#define MTEST_MAX_REPORT	16
+
+#define M_NONE	-1
+
+/* one march element: direction, then read and/or write of 0 or 1 */
+struct march_element {
+	int down;
+	int read;
+	int write;
+};
+
+struct march_test {
+	const char *name;
+	const struct march_element *elements;
+	int num_elements;
+};
+
+/* MATS+: {(w0); up(r0,w1); down(r1,w0)} */
+static const struct march_element march_mats_plus[] = {
+	{ 0, M_NONE, 0 }, { 0, 0, 1 }, { 1, 1, 0 },
+};
+
+/* March C-: {(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); (r0)} */
+static const struct march_element march_c_minus[] = {
+	{ 0, M_NONE, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 1, 0, 1 }, { 1, 1, 0 },
+	{ 0, 0, M_NONE },
+};
+
+static const struct march_test march_tests[] = {
+	{ "MATS+", march_mats_plus, ARRAY_SIZE(march_mats_plus) },
+	{ "March C-", march_c_minus, ARRAY_SIZE(march_c_minus) },
+};
+
+struct mtest_range {
+	ulong start;
+	ulong end;	/* exclusive */
+};
+
+struct mtest {
+	struct mtest_range ranges[MTEST_MAX_RANGES];
+	int num_ranges;
+
+	unsigned long errors;
+	unsigned long single_bit;
+	ulong bits;		/* all bits found flipped */
+	ulong first, last;	/* lowest and highest failing address */
+};
+
+static int mtest_add_range(struct mtest *mt, ulong start, ulong end)
+{
+	start = ALIGN(start, MTEST_LINE_SIZE);
+	end &= ~(MTEST_LINE_SIZE - 1);
+
+	if (end <= start)
+		return 0;
+
+	if (mt->num_ranges == MTEST_MAX_RANGES) {
+		printf("too many ranges\n");
+		return -ENOSPC;
+	}
+
+	mt->ranges[mt->num_ranges].start = start;
+	mt->ranges[mt->num_ranges].end = end;
+	mt->num_ranges++;
+
+	return 0;
+}
+
+/* Cut [start, end] out of all ranges */
+static int mtest_exclude(struct mtest *mt, ulong start, ulong end)
+{
+	struct mtest_range *r;
+	ulong rend;
+	int i, ret;
+
+	for (i = 0; i < mt->num_ranges; i++) {
+		r = &mt->ranges[i];
+
+		if (start >= r->end || end < r->start)
+			continue;
+
+		rend = r->end;
+		r->end = start & ~(MTEST_LINE_SIZE - 1);
+
+		if (r->end <= r->start) {
+			/* remove the range, the last one takes its place */
+			*r = mt->ranges[--mt->num_ranges];
+			i--;
+		}
+
+		if (end + 1 < rend) {
+			ret = mtest_add_range(mt, end + 1, rend);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Without an explicit range test all memory banks. Everything barebox
+ * requested with request_sdram_region() is left out.
+ */
+static int mtest_partition(struct mtest *mt, ulong start, ulong end, int all)
+{
+	struct memory_bank *bank;
+	struct resource *res;
+	int ret;
+
+	if (all) {
+		for_each_memory_bank(bank) {
+			ret = mtest_add_range(mt, bank->start,
+					bank->start + bank->size);
+			if (ret)
+				return ret;
+		}
+	} else {
+		ret = mtest_add_range(mt, start, end + 1);
+		if (ret)
+			return ret;
+	}
+
+	for_each_memory_bank(bank) {
+		list_for_each_entry(res, &bank->res->children, sibling) {
+			ret = mtest_exclude(mt, res->start, res->end);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static void mtest_report(struct mtest *mt, ulong *line, ulong expect)
+{
+	ulong diff, addr;
+	int i;
+
+	for (i = 0; i < MTEST_LINE_WORDS; i++) {
+		diff = line[i] ^ expect;
+		if (!diff)
+			continue;
+
+		addr = (ulong)&line[i];
+
+		if (!mt->errors || addr < mt->first)
+			mt->first = addr;
+		if (!mt->errors || addr > mt->last)
+			mt->last = addr;
+
+		mt->bits |= diff;
+		if (!(diff & (diff - 1)))
+			mt->single_bit++;
+
+		if (mt->errors++ < MTEST_MAX_REPORT)
+			printf("\nerror at 0x%08lx: expected 0x%0*lx, found 0x%0*lx%s",
+					addr, (int)sizeof(ulong) * 2, expect,
+					(int)sizeof(ulong) * 2, line[i],
+					diff & (diff - 1) ? "" : " (single bit)");
+	}
+}
+
+static int mtest_element(struct mtest *mt, const struct march_element *e,
+		struct mtest_range *r, ulong pattern)
+{
+	ulong rd = e->read ? ~pattern : pattern;
+	ulong wr = e->write ? ~pattern : pattern;
+	long step = e->down ? -MTEST_LINE_WORDS : MTEST_LINE_WORDS;
+	ulong *line, diff;
+	ulong n;
+	int i;
+
+	line = (ulong *)(e->down ? r->end - MTEST_LINE_SIZE : r->start);
+
+	for (n = (r->end - r->start) / MTEST_LINE_SIZE; n; n--, line += step) {
+		if (e->read != M_NONE) {
+			diff = 0;
+			for (i = 0; i < MTEST_LINE_WORDS; i++)
+				diff |= line[i] ^ rd;
+			if (diff)
+				mtest_report(mt, line, rd);
+		}
+
+		if (e->write != M_NONE)
+			for (i = 0; i < MTEST_LINE_WORDS; i++)
+				line[i] = wr;
+
+		if (!(n & 0xffff) && ctrlc())
+			return -EINTR;
+	}
+
+	dma_flush_range(r->start, r->end);
+
+	return 0;
+}
+
+static int mtest_march(struct mtest *mt, const struct march_test *test,
+		ulong pattern, int pass)
+{
+	const struct march_element *e;
+	unsigned long before = mt->errors;
+	u64 start, bytes = 0, us, ms, rate;
+	int i, j, ret;
+
+	start = get_time_ns();
+
+	for (i = 0; i < test->num_elements; i++) {
+		e = &test->elements[i];
+
+		for (j = 0; j < mt->num_ranges; j++) {
+			struct mtest_range *r = &mt->ranges[j];
+
+			ret = mtest_element(mt, e, r, pattern);
+			if (ret)
+				return ret;
+
+			if (e->read != M_NONE)
+				bytes += r->end - r->start;
+			if (e->write != M_NONE)
+				bytes += r->end - r->start;
+		}
+	}
+
+	us = get_time_ns() - start;
+	do_div(us, USECOND);
+	ms = us;
+	do_div(ms, 1000);
+	rate = (bytes >> 10) * 1000000;
+	do_div(rate, us ? us : 1);
+
+	printf("%spass %d: %llu ms, %llu MiB/s, %lu errors\n",
+			mt->errors != before ? "\n" : "", pass, ms,
+			rate >> 10, mt->errors - before);
+
+	return 0;
+}
+
+static int mtest_fast(ulong start, ulong end, int all,
+		const struct march_test *test, ulong pattern, int iterations)
+{
+	struct mtest *mt;
+	u64 size = 0;
+	int i, ret, pass;
+
+	mt = xzalloc(sizeof(*mt));
+
+	ret = mtest_partition(mt, start, end, all);
+	if (ret)
+		goto out;
+
+	if (!mt->num_ranges) {
+		printf("nothing to test\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < mt->num_ranges; i++) {
+		printf("0x%08lx ... 0x%08lx\n", mt->ranges[i].start,
+				mt->ranges[i].end - 1);
+		size += mt->ranges[i].end - mt->ranges[i].start;
+	}
+
+	printf("%s, pattern 0x%0*lx, %llu KiB in %d ranges\n", test->name,
+			(int)sizeof(ulong) * 2, pattern, size >> 10,
+			mt->num_ranges);
+
+	for (pass = 1; !iterations || pass <= iterations; pass++) {
+		ret = mtest_march(mt, test, pattern, pass);
+		if (ret)
+			break;
+	}
+
+	if (ret == -EINTR)
+		printf("\ninterrupted\n");
+
+	if (mt->errors) {
+		printf("%lu errors, %lu of them single bit\n", mt->errors,
+				mt->single_bit);
+		printf("failing bits 0x%0*lx, between 0x%08lx and 0x%08lx\n",
+				(int)sizeof(ulong) * 2, mt->bits, mt->first,
+				mt->last);
+		ret = -EIO;
+	}
+out:
+	free(mt);
+
+	return ret;
+}
+
 static int do_mem_mtest(int argc, char *argv[])
 {
-	ulong start, end, pattern = 0;
+	ulong start = 0, end = 0, pattern = 0;
+	const struct march_test *test = &march_tests[1];
+	int opt, fast = 0, iterations = 1;
+
+	while ((opt = getopt(argc, argv, "fm:i:")) > 0) {
+		switch (opt) {
+		case 'f':
+			fast = 1;
+			break;
+		case 'm':
+			if (!strcmp(optarg, "mats"))
+				test = &march_tests[0];
+			else if (!strcmp(optarg, "marchc"))
+				test = &march_tests[1];
+			else
+				return COMMAND_ERROR_USAGE;
+			break;
+		case 'i':
+			iterations = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
 
-	if (argc < 3)
+	if (argc >= 2) {
+		start = simple_strtoul(argv[0], NULL, 0);
+		end = simple_strtoul(argv[1], NULL, 0);
+	} else if (!fast || argc) {
 		return COMMAND_ERROR_USAGE;
+	}
 
-	start = simple_strtoul(argv[1], NULL, 0);
-	end = simple_strtoul(argv[2], NULL, 0);
+	if (argc > 2)
+		pattern = simple_strtoul(argv[2], NULL, 0);
 
-	if (argc > 3)
-		pattern = simple_strtoul(argv[3], NULL, 0);
+	if (fast)
+		return mtest_fast(start, end, argc < 2, test, pattern,
+				iterations) ? 1 : 0;
 
 	printf ("Testing 0x%08x ... 0x%08x:\n", (uint)start, (uint)end);
 	
@@ -337,15 +684,20 @@ static int do_mem_mtest(int argc, char *argv[])
 }
 
 static const __maybe_unused char cmd_mtest_help[] =
-"Usage: <start> <end> "
+"Usage: mtest [OPTIONS] <start> <end> "
 #ifdef CONFIG_CMD_MTEST_ALTERNATIVE
 "[pattern]"
 #endif
-"\nsimple RAM read/write test\n";
+"\nsimple RAM read/write test\n"
+"Usage: mtest -f [OPTIONS] [<start> <end> [pattern]]\n"
+"fast march test, without a range on all SDRAM not used by barebox\n"
+"options:\n"
+" -f           fast march test\n"
+" -m <test>    march test to run, 'mats' (MATS+) or 'marchc' (March C-, default)\n"
+" -i <n>       number of passes in fast mode, 0 for endless (default 1)\n";
 
 BAREBOX_CMD_START(mtest)
 	.cmd		= do_mem_mtest,
 	.usage		= "simple RAM test",
 	BAREBOX_CMD_HELP(cmd_mtest_help)
 BAREBOX_CMD_END
-
@@ -252,25 +252,13 @@ static int do_of_property(int argc, char *argv[])
 			return ret;
 		}
 
-		if (pp) {
-			free(pp->value);
-
-			/* limit property data to the actual size */
-			if (len) {
-				pp->value = xrealloc(data, len);
-			} else {
-				pp->value = NULL;
-				free(data);
-			}
+		ret = of_set_property(node, propname, data, len, 1);
 
-			pp->length = len;
-		} else {
-			pp = of_new_property(node, propname, data, len);
-			if (!pp) {
-				printf("Cannot create property %s\n", propname);
-				free(data);
-				return 1;
-			}
+		free(data);
+
+		if (ret) {
+			printf("Cannot set property %s\n", propname);
+			return 1;
 		}
 	}
 
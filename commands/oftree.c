@@ -37,6 +37,16 @@
 #include <getopt.h>
 #include <init.h>
 #include <fcntl.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
+
+static void oftree_print_time(const char *what, uint64_t start)
+{
+	uint64_t us = get_time_ns() - start;
+
+	do_div(us, USECOND);
+	printf("%s: %llu us\n", what, us);
+}
 
 static int do_oftree(int argc, char *argv[])
 {
@@ -51,10 +61,12 @@ static int do_oftree(int argc, char *argv[])
 	int load = 0;
 	int save = 0;
 	int free_of = 0;
+	int timing = 0;
 	int ret;
+	uint64_t start;
 	struct device_node *n, *root;
 
-	while ((opt = getopt(argc, argv, "dpfn:ls")) > 0) {
+	while ((opt = getopt(argc, argv, "dpfn:lst")) > 0) {
 		switch (opt) {
 		case 'l':
 			load = 1;
@@ -79,6 +91,9 @@ static int do_oftree(int argc, char *argv[])
 		case 's':
 			save = 1;
 			break;
+		case 't':
+			timing = 1;
+			break;
 		}
 	}
 
@@ -138,12 +153,17 @@ static int do_oftree(int argc, char *argv[])
 
 		n = of_get_root_node();
 
+		start = get_time_ns();
+
 		root = of_unflatten_dtb(n, fdt);
 		if (IS_ERR(root))
 			ret = PTR_ERR(root);
 		else
 			ret = 0;
 
+		if (timing)
+			oftree_print_time("unflatten", start);
+
 		if (!n)
 			ret = of_set_root_node(root);
 
@@ -188,9 +208,14 @@ static int do_oftree(int argc, char *argv[])
 	}
 
 	if (probe) {
+		start = get_time_ns();
+
 		ret = of_probe();
 		if (ret)
 			goto out;
+
+		if (timing)
+			oftree_print_time("probe", start);
 	}
 
 	ret = 0;
@@ -207,6 +232,7 @@ BAREBOX_CMD_HELP_OPT  ("-p",  "probe devices from stored devicetree\n")
 BAREBOX_CMD_HELP_OPT  ("-d",  "dump oftree from [DTB] or the parsed tree if no dtb is given\n")
 BAREBOX_CMD_HELP_OPT  ("-f",  "free stored devicetree\n")
 BAREBOX_CMD_HELP_OPT  ("-n <node>",  "specify root devicenode to dump for -d\n")
+BAREBOX_CMD_HELP_OPT  ("-t",  "report time spent for -l and -p\n")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(oftree)
@@ -0,0 +1,291 @@
+/*
+ * strbench.c - measure the throughput of the memory and string functions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <getopt.h>
+#include <clock.h>
+#include <sizes.h>
+#include <asm-generic/div64.h>
+
+struct strbench {
+	char *src;
+	char *dst;
+	size_t size;
+	/* results end up here so that the calls cannot be optimized away */
+	volatile unsigned long sink;
+};
+
+/*
+ * Byte-at-a-time reference implementations. The speedup printed for
+ * each function is relative to these.
+ */
+static noinline void *ref_memcpy(void *dest, const void *src, size_t count)
+{
+	char *d = dest;
+	const char *s = src;
+
+	while (count--)
+		*d++ = *s++;
+
+	return dest;
+}
+
+static noinline void *ref_memset(void *s, int c, size_t count)
+{
+	char *xs = s;
+
+	while (count--)
+		*xs++ = c;
+
+	return s;
+}
+
+static noinline int ref_memcmp(const void *cs, const void *ct, size_t count)
+{
+	const unsigned char *su1 = cs, *su2 = ct;
+	int res = 0;
+
+	for (; count; su1++, su2++, count--)
+		if ((res = *su1 - *su2) != 0)
+			break;
+
+	return res;
+}
+
+static noinline size_t ref_strlen(const char *s)
+{
+	const char *sc;
+
+	for (sc = s; *sc; sc++)
+		;
+
+	return sc - s;
+}
+
+static noinline char *ref_strchr(const char *s, int c)
+{
+	for (; *s != (char)c; s++)
+		if (!*s)
+			return NULL;
+
+	return (char *)s;
+}
+
+static void bench_memcpy(struct strbench *sb, int ref)
+{
+	if (ref)
+		ref_memcpy(sb->dst, sb->src, sb->size);
+	else
+		memcpy(sb->dst, sb->src, sb->size);
+}
+
+static void bench_memcpy_unaligned(struct strbench *sb, int ref)
+{
+	if (ref)
+		ref_memcpy(sb->dst, sb->src + 1, sb->size - 1);
+	else
+		memcpy(sb->dst, sb->src + 1, sb->size - 1);
+}
+
+static void bench_memset(struct strbench *sb, int ref)
+{
+	if (ref)
+		ref_memset(sb->dst, 0x5a, sb->size);
+	else
+		memset(sb->dst, 0x5a, sb->size);
+}
+
+static void bench_memcmp(struct strbench *sb, int ref)
+{
+	if (ref)
+		sb->sink = ref_memcmp(sb->dst, sb->src, sb->size);
+	else
+		sb->sink = memcmp(sb->dst, sb->src, sb->size);
+}
+
+static void bench_strlen(struct strbench *sb, int ref)
+{
+	if (ref)
+		sb->sink = ref_strlen(sb->src);
+	else
+		sb->sink = strlen(sb->src);
+}
+
+static void bench_strchr(struct strbench *sb, int ref)
+{
+	if (ref)
+		sb->sink = (unsigned long)ref_strchr(sb->src, '!');
+	else
+		sb->sink = (unsigned long)strchr(sb->src, '!');
+}
+
+static struct {
+	const char *name;
+	void (*bench)(struct strbench *sb, int ref);
+	/* dst must be a copy of src */
+	int copy;
+} strbench_tests[] = {
+	{ "memcpy", bench_memcpy },
+	{ "memcpy+1", bench_memcpy_unaligned },
+	{ "memset", bench_memset },
+	{ "memcmp", bench_memcmp, 1 },
+	{ "strlen", bench_strlen },
+	{ "strchr", bench_strchr },
+};
+
+static u64 strbench_run(struct strbench *sb, int test, int ref, int loops)
+{
+	u64 start = get_time_ns();
+	int i;
+
+	for (i = 0; i < loops; i++)
+		strbench_tests[test].bench(sb, ref);
+
+	return get_time_ns() - start;
+}
+
+static u64 strbench_rate(u64 bytes, u64 ns)
+{
+	u64 us = ns;
+
+	do_div(us, USECOND);
+	bytes = (bytes >> 10) * 1000000;
+	do_div(bytes, us ? us : 1);
+
+	return bytes;
+}
+
+/*
+ * Copy with increasing block sizes, each with the same total amount of
+ * data. Shows where per-call overhead stops to matter and where the
+ * architecture switches to its bulk copy loop, if any.
+ */
+static void strbench_memcpy_sweep(struct strbench *sb, int loops)
+{
+	u64 bytes = (u64)sb->size * loops, start, ns;
+	size_t blk;
+	int i, n;
+
+	printf("%-10s %10s\n", "blocksize", "KiB/s");
+
+	for (blk = 16; blk <= sb->size; blk <<= 1) {
+		n = sb->size / blk * loops;
+
+		start = get_time_ns();
+		for (i = 0; i < n; i++)
+			memcpy(sb->dst, sb->src, blk);
+		ns = get_time_ns() - start;
+
+		printf("%-10zu %10llu\n", blk, strbench_rate(bytes, ns));
+
+		if (ctrlc())
+			break;
+	}
+}
+
+static int do_strbench(int argc, char *argv[])
+{
+	struct strbench sb;
+	size_t size = SZ_64K;
+	int opt, i, loops = 256, sweep = 0;
+	u64 lib, ref, bytes, speedup;
+	unsigned frac;
+
+	while ((opt = getopt(argc, argv, "s:l:m")) > 0) {
+		switch (opt) {
+		case 's':
+			size = strtoul_suffix(optarg, NULL, 0);
+			break;
+		case 'l':
+			loops = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			sweep = 1;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (size < 2 || loops < 1)
+		return COMMAND_ERROR_USAGE;
+
+	sb.size = size;
+	sb.src = malloc(size);
+	sb.dst = malloc(size);
+	if (!sb.src || !sb.dst) {
+		printf("cannot allocate %zu bytes\n", size * 2);
+		free(sb.src);
+		free(sb.dst);
+		return 1;
+	}
+
+	/* a nul terminated string without '!' for strlen and strchr */
+	for (i = 0; i < size - 1; i++)
+		sb.src[i] = 'a' + i % 26;
+	sb.src[size - 1] = 0;
+
+	bytes = (u64)size * loops;
+
+	printf("%zu bytes, %d loops\n", size, loops);
+
+	if (sweep) {
+		strbench_memcpy_sweep(&sb, loops);
+		goto out;
+	}
+
+	printf("%-10s %10s %10s %8s\n", "function", "KiB/s", "bytewise",
+			"speedup");
+
+	for (i = 0; i < ARRAY_SIZE(strbench_tests); i++) {
+		if (strbench_tests[i].copy)
+			memcpy(sb.dst, sb.src, size);
+
+		lib = strbench_run(&sb, i, 0, loops);
+		ref = strbench_run(&sb, i, 1, loops);
+
+		speedup = ref * 10;
+		do_div(speedup, lib ? lib : 1);
+		frac = do_div(speedup, 10);
+
+		printf("%-10s %10llu %10llu %5llu.%ux\n", strbench_tests[i].name,
+				strbench_rate(bytes, lib), strbench_rate(bytes, ref),
+				speedup, frac);
+
+		if (ctrlc())
+			break;
+	}
+out:
+	free(sb.src);
+	free(sb.dst);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(strbench)
+BAREBOX_CMD_HELP_USAGE("strbench [OPTIONS]\n")
+BAREBOX_CMD_HELP_SHORT("Measure the throughput of memcpy, memset, memcmp, strlen and strchr\n")
+BAREBOX_CMD_HELP_SHORT("and compare it to simple byte-at-a-time loops.\n")
+BAREBOX_CMD_HELP_OPT  ("-s <size>", "buffer size (default 64k)\n")
+BAREBOX_CMD_HELP_OPT  ("-l <loops>", "number of iterations per function (default 256)\n")
+BAREBOX_CMD_HELP_OPT  ("-m", "only measure memcpy, with block sizes from 16 bytes to <size>\n")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(strbench)
+	.cmd		= do_strbench,
+	.usage		= "measure memory and string function throughput",
+	BAREBOX_CMD_HELP(cmd_strbench_help)
+BAREBOX_CMD_END
@@ -24,23 +24,159 @@
 #include <fs.h>
 #include <net.h>
 #include <libbb.h>
+#include <clock.h>
+#include <errno.h>
+#include <asm-generic/div64.h>
 
 #define TFTP_MOUNT_PATH	"/.tftp_tmp_path"
 
+/*
+ * Chunk size used when fetching multiple files. TFTP is stop-and-wait, but
+ * the tftp fs acknowledges a block as soon as it is received, so each
+ * connection has its next block in flight while we read from the others.
+ * Reading little from each connection at a time keeps all of them busy.
+ */
+#define TFTP_MULTI_CHUNK	512
+
+struct tftp_multi_file {
+	char *source;
+	char *dest;
+	int srcfd;
+	int dstfd;
+	int done;
+};
+
+static int tftp_multi_open(struct tftp_multi_file *f, const char *arg)
+{
+	const char *sep;
+
+	sep = strchr(arg, ':');
+	if (sep) {
+		f->source = asprintf("%s/%.*s", TFTP_MOUNT_PATH,
+				(int)(sep - arg), arg);
+		f->dest = xstrdup(sep + 1);
+	} else {
+		f->source = asprintf("%s/%s", TFTP_MOUNT_PATH, arg);
+		f->dest = xstrdup(basename((char *)arg));
+	}
+
+	f->srcfd = open(f->source, O_RDONLY);
+	if (f->srcfd < 0) {
+		printf("could not open %s: %s\n", f->source, errno_str());
+		return f->srcfd;
+	}
+
+	f->dstfd = open(f->dest, O_WRONLY | O_CREAT);
+	if (f->dstfd < 0) {
+		printf("could not open %s: %s\n", f->dest, errno_str());
+		return f->dstfd;
+	}
+
+	return 0;
+}
+
+/*
+ * Fetch all files given on the command line through concurrent TFTP
+ * sessions. All sessions are driven from a single loop: each read only
+ * waits for one data packet of its connection, while the packets of
+ * the other connections are received into their fifos and acknowledged
+ * by the same net_poll().
+ */
+static int tftp_multi(int argc, char *argv[])
+{
+	struct tftp_multi_file *files;
+	int nfiles = argc - optind;
+	int active = 0, i, r, w, ret = 0;
+	uint64_t start;
+	unsigned long total = 0;
+	void *buf, *p;
+
+	files = xzalloc(sizeof(*files) * nfiles);
+	buf = xmalloc(TFTP_MULTI_CHUNK);
+
+	for (i = 0; i < nfiles; i++)
+		files[i].srcfd = files[i].dstfd = -1;
+
+	for (i = 0; i < nfiles; i++) {
+		ret = tftp_multi_open(&files[i], argv[optind + i]);
+		if (ret)
+			goto out;
+		active++;
+	}
+
+	start = get_time_ns();
+
+	while (active) {
+		for (i = 0; i < nfiles; i++) {
+			struct tftp_multi_file *f = &files[i];
+
+			if (f->done)
+				continue;
+
+			r = read(f->srcfd, buf, TFTP_MULTI_CHUNK);
+			if (r < 0) {
+				printf("%s: %s\n", f->source, errno_str());
+				ret = r;
+				goto out;
+			}
+
+			if (!r) {
+				f->done = 1;
+				active--;
+				continue;
+			}
+
+			p = buf;
+			while (r) {
+				w = write(f->dstfd, p, r);
+				if (w < 0) {
+					perror("write");
+					ret = w;
+					goto out;
+				}
+				p += w;
+				r -= w;
+				total += w;
+			}
+		}
+	}
+
+	start = get_time_ns() - start;
+	do_div(start, MSECOND);
+	printf("%lu bytes in %d files, %llu ms\n", total, nfiles, start);
+out:
+	for (i = 0; i < nfiles; i++) {
+		if (files[i].srcfd >= 0)
+			close(files[i].srcfd);
+		if (files[i].dstfd >= 0)
+			close(files[i].dstfd);
+		free(files[i].source);
+		free(files[i].dest);
+	}
+
+	free(buf);
+	free(files);
+
+	return ret;
+}
+
 static int do_tftpb(int argc, char *argv[])
 {
 	char *source, *dest, *freep;
 	int opt;
 	unsigned long flags;
-	int tftp_push = 0;
+	int tftp_push = 0, tftp_multiple = 0;
 	int ret;
 	IPaddr_t ip;
 
-	while ((opt = getopt(argc, argv, "p")) > 0) {
+	while ((opt = getopt(argc, argv, "pm")) > 0) {
 		switch(opt) {
 		case 'p':
 			tftp_push = 1;
 			break;
+		case 'm':
+			tftp_multiple = 1;
+			break;
 		default:
 			return COMMAND_ERROR_USAGE;
 		}
@@ -49,6 +185,26 @@ static int do_tftpb(int argc, char *argv[])
 	if (argc <= optind)
 		return COMMAND_ERROR_USAGE;
 
+	if (tftp_multiple) {
+		if (tftp_push)
+			return COMMAND_ERROR_USAGE;
+
+		ret = make_directory(TFTP_MOUNT_PATH);
+		if (ret)
+			return ret;
+
+		ip = net_get_serverip();
+		ret = mount(ip_to_string(ip), "tftp", TFTP_MOUNT_PATH);
+		if (!ret) {
+			ret = tftp_multi(argc, argv);
+			umount(TFTP_MOUNT_PATH);
+		}
+
+		rmdir(TFTP_MOUNT_PATH);
+
+		return ret;
+	}
+
 	source = argv[optind++];
 
 	if (argc == optind)
@@ -93,7 +249,10 @@ err_free:
 
 BAREBOX_CMD_HELP_START(tftp)
 BAREBOX_CMD_HELP_USAGE("tftp [-p] <source> [dest]\n")
+BAREBOX_CMD_HELP_USAGE("tftp -m <source>[:dest] [<source>[:dest]...]\n")
 BAREBOX_CMD_HELP_SHORT("Load a file from or upload to TFTP server.\n")
+BAREBOX_CMD_HELP_OPT  ("-p",  "push to TFTP server\n")
+BAREBOX_CMD_HELP_OPT  ("-m",  "load multiple files using concurrent TFTP sessions\n")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(tftp)
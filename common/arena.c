@@ -0,0 +1,107 @@
+/*
+ * arena.c - allocate lots of small objects and free them all at once
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <xfuncs.h>
+#include <arena.h>
+
+#define ARENA_ALIGN		sizeof(unsigned long long)
+#define ARENA_DEFAULT_CHUNK	4096
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	unsigned long long data[0];
+};
+
+void arena_init(struct arena *arena, size_t chunk_size)
+{
+	arena->chunks = NULL;
+	arena->cur = NULL;
+	arena->left = 0;
+	arena->chunk_size = chunk_size;
+}
+
+/*
+ * Like xmalloc the arena functions never return NULL. Objects bigger
+ * than a quarter chunk get a chunk of their own so that the space left
+ * in the current chunk is not wasted.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t chunk_size = arena->chunk_size;
+	void *mem;
+
+	if (!chunk_size)
+		chunk_size = ARENA_DEFAULT_CHUNK;
+
+	size = ALIGN(size, ARENA_ALIGN);
+
+	if (size > arena->left) {
+		if (size > chunk_size / 4) {
+			chunk = xmalloc(sizeof(*chunk) + size);
+			if (arena->chunks) {
+				chunk->next = arena->chunks->next;
+				arena->chunks->next = chunk;
+			} else {
+				chunk->next = NULL;
+				arena->chunks = chunk;
+			}
+			return chunk->data;
+		}
+
+		chunk = xmalloc(sizeof(*chunk) + chunk_size);
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->cur = (char *)chunk->data;
+		arena->left = chunk_size;
+	}
+
+	mem = arena->cur;
+	arena->cur += size;
+	arena->left -= size;
+
+	return mem;
+}
+
+void *arena_zalloc(struct arena *arena, size_t size)
+{
+	void *mem = arena_alloc(arena, size);
+
+	memset(mem, 0, size);
+
+	return mem;
+}
+
+char *arena_strndup(struct arena *arena, const char *s, size_t len)
+{
+	char *str = arena_alloc(arena, len + 1);
+
+	memcpy(str, s, len);
+	str[len] = 0;
+
+	return str;
+}
+
+void arena_free_all(struct arena *arena)
+{
+	struct arena_chunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	arena_init(arena, arena->chunk_size);
+}
@@ -0,0 +1,207 @@
+/*
+ * boottrace.c - record where the boot time goes
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <boottrace.h>
+#include <clock.h>
+#include <malloc.h>
+#include <of.h>
+#include <kallsyms.h>
+#include <asm-generic/div64.h>
+
+/*
+ * The events live in a statically allocated ring buffer, so tracing does
+ * not depend on malloc and does not allocate anything while running.
+ * When the buffer is full the oldest events are overwritten. An event is
+ * identified by its sequence number, so that ending an event whose slot
+ * has been reused in the meantime is detected and ignored.
+ */
+#define BOOTTRACE_ENTRIES	CONFIG_BOOTTRACE_ENTRIES
+
+static struct boottrace_event boottrace_ring[BOOTTRACE_ENTRIES];
+static unsigned int boottrace_seq = 1;
+static unsigned int boottrace_first = 1;
+static unsigned int boottrace_depth;
+
+static const char * const boottrace_type_names[] = {
+	[BOOTTRACE_INITCALL] = "initcall",
+	[BOOTTRACE_ENV] = "env",
+	[BOOTTRACE_SCRIPT] = "script",
+	[BOOTTRACE_COMMAND] = "command",
+	[BOOTTRACE_PROBE] = "probe",
+};
+
+/**
+ * boottrace_begin - start recording an event
+ * @type: the kind of event
+ * @name: name of the event, copied into the trace
+ * @fn: for initcalls the function, its symbol is used as name
+ *
+ * Returns a handle to be passed to boottrace_end().
+ */
+unsigned int boottrace_begin(enum boottrace_type type, const char *name,
+		const void *fn)
+{
+	unsigned int seq = boottrace_seq++;
+	struct boottrace_event *ev = &boottrace_ring[seq % BOOTTRACE_ENTRIES];
+
+	ev->seq = seq;
+	ev->type = type;
+	ev->depth = boottrace_depth++;
+	ev->fn = fn;
+	ev->end = 0;
+
+	if (name)
+		strlcpy(ev->name, name, BOOTTRACE_NAME_LEN);
+	else
+		ev->name[0] = 0;
+
+	ev->start = get_time_ns();
+
+	return seq;
+}
+
+void boottrace_end(unsigned int handle)
+{
+	struct boottrace_event *ev = &boottrace_ring[handle % BOOTTRACE_ENTRIES];
+	uint64_t now = get_time_ns();
+
+	if (boottrace_depth)
+		boottrace_depth--;
+
+	if (ev->seq != handle)
+		return;
+
+	/* keep events before the first clocksource distinguishable */
+	ev->end = now ? now : 1;
+}
+
+/**
+ * boottrace_get - get an event from the trace
+ * @i: index of the event, 0 is the oldest
+ */
+struct boottrace_event *boottrace_get(unsigned int i)
+{
+	if (i >= boottrace_num_events())
+		return NULL;
+
+	i += boottrace_seq - boottrace_num_events();
+
+	return &boottrace_ring[i % BOOTTRACE_ENTRIES];
+}
+
+unsigned int boottrace_num_events(void)
+{
+	return min_t(unsigned int, boottrace_seq - boottrace_first,
+			BOOTTRACE_ENTRIES);
+}
+
+/* number of events overwritten because the ring buffer was full */
+unsigned int boottrace_num_lost(void)
+{
+	return boottrace_seq - boottrace_first - boottrace_num_events();
+}
+
+void boottrace_clear(void)
+{
+	boottrace_first = boottrace_seq;
+}
+
+const char *boottrace_type_name(struct boottrace_event *ev)
+{
+	return boottrace_type_names[ev->type];
+}
+
+void boottrace_event_name(struct boottrace_event *ev, char *buf, size_t len)
+{
+	if (ev->name[0])
+		strlcpy(buf, ev->name, len);
+	else
+		snprintf(buf, len, "%pS", ev->fn);
+}
+
+static uint32_t boottrace_ns_to_us(uint64_t ns)
+{
+	do_div(ns, USECOND);
+
+	return ns;
+}
+
+/*
+ * Add the completed events to /chosen/barebox-boottrace. The names
+ * property holds the names of the events as a string list, the times
+ * property holds a start time and a duration in microseconds per event.
+ */
+static int boottrace_of_fixup(struct device_node *root)
+{
+	struct device_node *node;
+	struct boottrace_event *ev;
+	char name[KSYM_NAME_LEN];
+	unsigned int i, n = 0;
+	char *names, *p;
+	__be32 *times;
+	int ret;
+
+	node = of_create_node(root, "/chosen/barebox-boottrace");
+	if (!node)
+		return -ENOMEM;
+
+	names = p = xmalloc(boottrace_num_events() * KSYM_NAME_LEN);
+	times = xmalloc(boottrace_num_events() * 2 * sizeof(__be32));
+
+	for (i = 0; i < boottrace_num_events(); i++) {
+		ev = boottrace_get(i);
+		if (!ev->end)
+			continue;
+
+		boottrace_event_name(ev, name, sizeof(name));
+		p += sprintf(p, "%s", name) + 1;
+
+		times[n * 2] = cpu_to_be32(boottrace_ns_to_us(ev->start));
+		times[n * 2 + 1] =
+			cpu_to_be32(boottrace_ns_to_us(ev->end - ev->start));
+		n++;
+	}
+
+	ret = of_set_property(node, "names", names, p - names, 1);
+	if (!ret)
+		ret = of_set_property(node, "times", times,
+				n * 2 * sizeof(__be32), 1);
+
+	free(names);
+	free(times);
+
+	return ret;
+}
+
+/**
+ * boottrace_export_oftree - export the trace to the devicetree
+ *
+ * Registers a fixup which adds the trace to the devicetree passed
+ * to the kernel.
+ */
+int boottrace_export_oftree(void)
+{
+	static int registered;
+
+	if (!IS_ENABLED(CONFIG_OFTREE))
+		return -ENOSYS;
+
+	if (registered)
+		return 0;
+
+	registered = 1;
+
+	return of_register_fixup(boottrace_of_fixup);
+}
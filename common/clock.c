@@ -38,6 +38,10 @@ uint64_t get_time_ns(void)
         uint64_t cycle_now, cycle_delta;
         uint64_t ns_offset;
 
+	/* devices may be probed before the first clocksource */
+	if (!cs)
+		return time_ns;
+
         /* read clocksource: */
 	cycle_now = cs->read() & cs->mask;
 
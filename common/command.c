@@ -30,6 +30,7 @@
 #include <init.h>
 #include <complete.h>
 #include <getopt.h>
+#include <boottrace.h>
 
 LIST_HEAD(command_list);
 EXPORT_SYMBOL(command_list);
@@ -67,6 +68,7 @@ int execute_command(int argc, char **argv)
 {
 	struct command *cmdtp;
 	int ret;
+	unsigned int trace;
 	struct getopt_context gc;
 
 	getopt_context_store(&gc);
@@ -74,7 +76,9 @@ int execute_command(int argc, char **argv)
 	/* Look up command in command table */
 	if ((cmdtp = find_cmd(argv[0]))) {
 		/* OK - call function to do the command */
+		trace = boottrace_begin(BOOTTRACE_COMMAND, argv[0], NULL);
 		ret = cmdtp->cmd(argc, argv);
+		boottrace_end(trace);
 		if (ret == COMMAND_ERROR_USAGE) {
 			barebox_cmd_usage(cmdtp);
 			ret = COMMAND_ERROR;
@@ -3,6 +3,8 @@
 #include <malloc.h>
 #include <string.h>
 #include <memory.h>
+#include <slab.h>
+#include "malloc_trace.h"
 
 #include <stdio.h>
 #include <module.h>
@@ -1141,7 +1143,7 @@ static void malloc_extend_top(INTERNAL_SIZE_T nb)
       chunk borders either a previously allocated and still in-use chunk,
       or the base of its memory arena.)
 */
-void *malloc(size_t bytes)
+static void *heap_malloc(size_t bytes)
 {
 	mchunkptr victim;	/* inspected/selected chunk */
 	INTERNAL_SIZE_T victim_size;	/* its size */
@@ -1342,6 +1344,18 @@ void *malloc(size_t bytes)
 	  placed in corresponding bins. (This includes the case of
 	  consolidating with the current `last_remainder').
 */
+void *malloc(size_t bytes)
+{
+	if (bytes <= SLAB_MAX_SIZE) {
+		void *mem = slab_alloc(bytes);
+
+		if (mem)
+			return mem;
+	}
+
+	return heap_malloc(bytes);
+}
+
 void free(void *mem)
 {
 	mchunkptr p;		/* chunk corresponding to mem */
@@ -1358,6 +1372,11 @@ void free(void *mem)
 	if (!mem)		/* free(0) has no effect */
 		return;
 
+	if (slab_owns(mem)) {
+		slab_free(mem);
+		return;
+	}
+
 	p = mem2chunk(mem);
 	hd = p->size;
 
@@ -1485,6 +1504,9 @@ void *realloc(void *oldmem, size_t bytes)
 	if (!oldmem)
 		return malloc(bytes);
 
+	if (slab_owns(oldmem))
+		return slab_realloc(oldmem, bytes);
+
 	newp = oldp = mem2chunk(oldmem);
 	newsize = oldsize = chunksize(oldp);
 
@@ -1578,9 +1600,9 @@ void *realloc(void *oldmem, size_t bytes)
 			}
 		}
 
-		/* Must allocate */
+		/* Must allocate, from the heap as the chunk is looked at below */
 
-		newmem = malloc(bytes);
+		newmem = heap_malloc(bytes);
 
 		if (!newmem)	/* propagate failure */
 			return NULL;
@@ -1658,10 +1680,13 @@ void *memalign(size_t alignment, size_t bytes)
 	if (alignment < MINSIZE)
 		alignment = MINSIZE;
 
-	/* Call malloc with worst case padding to hit alignment. */
+	/*
+	 * Call malloc with worst case padding to hit alignment. The chunk
+	 * headers are edited below, so this must not be a slab object.
+	 */
 
 	nb = request2size(bytes);
-	m = (char*)(malloc (nb + alignment + MINSIZE));
+	m = (char*)(heap_malloc(nb + alignment + MINSIZE));
 
 	if (!m)
 		return NULL;	/* propagate failure */
@@ -1757,7 +1782,10 @@ void *calloc(size_t n, size_t elem_size)
 
 	if (!mem)
 		return NULL;
-	else {
+	else if (slab_owns(mem)) {
+		memset(mem, 0, sz);
+		return mem;
+	} else {
 		p = mem2chunk(mem);
 
 		/* Two optional cases in which clearing not necessary */
@@ -1868,6 +1896,8 @@ size_t malloc_usable_size(void *mem)
 
 	if (!mem)
 		return 0;
+	else if (slab_owns(mem))
+		return slab_usable_size(mem);
 	else {
 		p = mem2chunk(mem);
 		if (!chunk_is_mmapped(p)) {
@@ -49,6 +49,7 @@ static const struct filetype_str filetype_str[] = {
 	[filetype_png] = { "PNG image", "png" },
 	[filetype_ext] = { "ext filesystem", "ext" },
 	[filetype_gpt] = { "GUID Partition Table", "gpt" },
+	[filetype_ubifs] = { "UBIFS image", "ubifs" },
 };
 
 const char *file_type_to_string(enum filetype f)
@@ -201,6 +202,8 @@ enum filetype file_detect_type(const void *_buf, size_t bufsize)
 		return filetype_ubi;
 	if (buf[0] == 0x20031985)
 		return filetype_jffs2;
+	if (buf[0] == le32_to_cpu(0x06101831) && buf8[20] == 6)
+		return filetype_ubifs;
 	if (buf8[0] == 0x1f && buf8[1] == 0x8b && buf8[2] == 0x08)
 		return filetype_gzip;
 	if (buf8[0] == 'B' && buf8[1] == 'Z' && buf8[2] == 'h' &&
@@ -123,6 +123,7 @@
 #include <linux/list.h>
 #include <binfmt.h>
 #include <init.h>
+#include <boottrace.h>
 
 /*cmd_boot.c*/
 extern int do_bootd(int flag, int argc, char *argv[]);      /* do_bootd */
@@ -1821,14 +1822,18 @@ static int source_script(const char *path, int argc, char *argv[])
 {
 	struct p_context ctx;
 	char *script;
+	unsigned int trace;
 	int ret;
 
+	trace = boottrace_begin(BOOTTRACE_SCRIPT, path, NULL);
+
 	ctx.global_argc = argc;
 	ctx.global_argv = argv;
 
 	script = read_file(path, NULL);
 	if (!script) {
 		perror("sh");
+		boottrace_end(trace);
 		return 1;
 	}
 
@@ -1839,6 +1844,8 @@ static int source_script(const char *path, int argc, char *argv[])
 	release_context(&ctx);
 	free(script);
 
+	boottrace_end(trace);
+
 	return ret;
 }
 
@@ -0,0 +1,338 @@
+/*
+ * malloc_trace.c - record the call site of each live allocation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Every live allocation is kept in an open addressing hash table keyed
+ * by its address, together with its size and the call site which made
+ * it. The call sites have their own small table with live and peak
+ * bytes and allocation counters, this is what 'meminfo -a' shows.
+ *
+ * Both tables are static so that tracing does not allocate itself.
+ * When one of them is full, further allocations are counted as
+ * untracked only.
+ */
+#include <common.h>
+#include <malloc.h>
+#include <module.h>
+#include <clock.h>
+#include <qsort.h>
+#include <asm-generic/div64.h>
+
+#define MALLOC_TRACE_WRAPPERS
+#include "malloc_trace.h"
+
+#define TRACE_ENTRIES	CONFIG_MALLOC_TRACE_ENTRIES
+#define TRACE_SITES	512
+
+struct trace_entry {
+	void *mem;
+	unsigned int size;
+	unsigned short site;
+};
+
+struct trace_site {
+	void *caller;
+	unsigned long live;
+	unsigned long count;
+	unsigned long peak;
+	unsigned long allocs;
+};
+
+static struct trace_entry trace_entries[TRACE_ENTRIES];
+static struct trace_site trace_sites[TRACE_SITES];
+static unsigned int trace_num_entries, trace_num_sites;
+
+static unsigned long trace_live, trace_peak;
+static unsigned long trace_allocs, trace_frees, trace_untracked;
+
+/* for the rate since the last report */
+static unsigned long trace_last_allocs, trace_last_bytes, trace_bytes;
+static u64 trace_last_time;
+
+/* set while inside the allocator so that its internal calls are ignored */
+static int trace_busy;
+
+void *malloc_trace_caller;
+
+static inline unsigned int trace_hash(void *ptr, unsigned int size)
+{
+	return ((unsigned long)ptr >> 3) * 2654435761u % size;
+}
+
+static struct trace_site *trace_site_get(void *caller)
+{
+	unsigned int i = trace_hash(caller, TRACE_SITES);
+	struct trace_site *site;
+
+	while (1) {
+		site = &trace_sites[i];
+
+		if (site->caller == caller)
+			return site;
+
+		if (!site->caller) {
+			/* keep one slot free so that lookups terminate */
+			if (trace_num_sites == TRACE_SITES - 1)
+				return NULL;
+			trace_num_sites++;
+			site->caller = caller;
+			return site;
+		}
+
+		i = (i + 1) % TRACE_SITES;
+	}
+}
+
+static struct trace_entry *trace_entry_find(void *mem)
+{
+	unsigned int i = trace_hash(mem, TRACE_ENTRIES);
+
+	while (trace_entries[i].mem) {
+		if (trace_entries[i].mem == mem)
+			return &trace_entries[i];
+		i = (i + 1) % TRACE_ENTRIES;
+	}
+
+	return NULL;
+}
+
+static void trace_untrack(void *mem)
+{
+	struct trace_entry *e;
+	struct trace_site *site;
+	unsigned int i, j, home;
+
+	if (!mem)
+		return;
+
+	e = trace_entry_find(mem);
+	if (!e)
+		return;
+
+	site = &trace_sites[e->site];
+	site->live -= e->size;
+	site->count--;
+	trace_live -= e->size;
+	trace_frees++;
+	trace_num_entries--;
+
+	/*
+	 * Move following entries of the same probe sequence back into the
+	 * hole, the table has no tombstones.
+	 */
+	i = e - trace_entries;
+	j = i;
+	while (1) {
+		trace_entries[i].mem = NULL;
+
+		do {
+			j = (j + 1) % TRACE_ENTRIES;
+			if (!trace_entries[j].mem)
+				return;
+			home = trace_hash(trace_entries[j].mem, TRACE_ENTRIES);
+		} while (i <= j ? (i < home && home <= j) :
+				(i < home || home <= j));
+
+		trace_entries[i] = trace_entries[j];
+		i = j;
+	}
+}
+
+static void trace_track(void *mem, size_t size, void *caller)
+{
+	struct trace_site *site;
+	struct trace_entry *e;
+	unsigned int i;
+
+	if (malloc_trace_caller) {
+		caller = malloc_trace_caller;
+		malloc_trace_caller = NULL;
+	}
+
+	if (!mem)
+		return;
+
+	trace_allocs++;
+	trace_bytes += size;
+
+	/* keep one slot free so that lookups terminate */
+	if (trace_num_entries == TRACE_ENTRIES - 1) {
+		trace_untracked++;
+		return;
+	}
+
+	site = trace_site_get(caller);
+	if (!site) {
+		trace_untracked++;
+		return;
+	}
+
+	i = trace_hash(mem, TRACE_ENTRIES);
+	while (trace_entries[i].mem)
+		i = (i + 1) % TRACE_ENTRIES;
+
+	e = &trace_entries[i];
+	e->mem = mem;
+	e->size = size;
+	e->site = site - trace_sites;
+	trace_num_entries++;
+
+	site->allocs++;
+	site->count++;
+	site->live += size;
+	if (site->live > site->peak)
+		site->peak = site->live;
+
+	trace_live += size;
+	if (trace_live > trace_peak)
+		trace_peak = trace_live;
+}
+
+void *malloc(size_t bytes)
+{
+	void *mem;
+
+	if (trace_busy)
+		return __malloc(bytes);
+
+	trace_busy = 1;
+	mem = __malloc(bytes);
+	trace_track(mem, bytes, __builtin_return_address(0));
+	trace_busy = 0;
+
+	return mem;
+}
+EXPORT_SYMBOL(malloc);
+
+void free(void *mem)
+{
+	if (!trace_busy)
+		trace_untrack(mem);
+
+	__free(mem);
+}
+EXPORT_SYMBOL(free);
+
+void *realloc(void *oldmem, size_t bytes)
+{
+	void *mem;
+
+	if (trace_busy)
+		return __realloc(oldmem, bytes);
+
+	trace_busy = 1;
+	mem = __realloc(oldmem, bytes);
+	if (mem)
+		trace_untrack(oldmem);
+	trace_track(mem, bytes, __builtin_return_address(0));
+	trace_busy = 0;
+
+	return mem;
+}
+EXPORT_SYMBOL(realloc);
+
+void *memalign(size_t alignment, size_t bytes)
+{
+	void *mem;
+
+	if (trace_busy)
+		return __memalign(alignment, bytes);
+
+	trace_busy = 1;
+	mem = __memalign(alignment, bytes);
+	trace_track(mem, bytes, __builtin_return_address(0));
+	trace_busy = 0;
+
+	return mem;
+}
+EXPORT_SYMBOL(memalign);
+
+void *calloc(size_t n, size_t elem_size)
+{
+	void *mem;
+
+	if (trace_busy)
+		return __calloc(n, elem_size);
+
+	trace_busy = 1;
+	mem = __calloc(n, elem_size);
+	trace_track(mem, n * elem_size, __builtin_return_address(0));
+	trace_busy = 0;
+
+	return mem;
+}
+EXPORT_SYMBOL(calloc);
+
+static int trace_site_cmp(const void *a, const void *b)
+{
+	const struct trace_site *sa = *(const struct trace_site **)a;
+	const struct trace_site *sb = *(const struct trace_site **)b;
+
+	if (sa->live != sb->live)
+		return sa->live < sb->live ? 1 : -1;
+
+	return sa->peak < sb->peak ? 1 : sa->peak > sb->peak ? -1 : 0;
+}
+
+static unsigned long trace_per_second(unsigned long n, u64 ns)
+{
+	u64 rate = (u64)n * 1000;
+
+	do_div(ns, MSECOND);
+	do_div(rate, ns ? ns : 1);
+
+	return rate;
+}
+
+void malloc_trace_stats(void)
+{
+	static struct trace_site *sorted[TRACE_SITES];
+	struct trace_site *site;
+	unsigned int i, n = 0;
+	u64 now = get_time_ns(), ns = now - trace_last_time;
+	unsigned long allocs, bytes;
+
+	for (i = 0; i < TRACE_SITES; i++) {
+		site = &trace_sites[i];
+		if (site->caller && (site->live || site->peak))
+			sorted[n++] = site;
+	}
+
+	qsort(sorted, n, sizeof(*sorted), trace_site_cmp);
+
+	printf("live: %lu bytes in %u allocations, peak %lu bytes\n",
+			trace_live, trace_num_entries, trace_peak);
+
+	allocs = trace_allocs - trace_last_allocs;
+	bytes = trace_bytes - trace_last_bytes;
+	printf("allocs: %lu, frees: %lu, untracked: %lu\n", trace_allocs,
+			trace_frees, trace_untracked);
+	printf("since last call: %lu allocs (%lu/s), %lu bytes (%lu/s)\n",
+			allocs, trace_per_second(allocs, ns),
+			bytes, trace_per_second(bytes, ns));
+
+	trace_last_allocs = trace_allocs;
+	trace_last_bytes = trace_bytes;
+	trace_last_time = now;
+
+	printf("%10s %7s %10s %8s  %s\n", "live", "count", "peak", "allocs",
+			"caller");
+
+	for (i = 0; i < n; i++) {
+		site = sorted[i];
+		printf("%10lu %7lu %10lu %8lu  %pS\n", site->live, site->count,
+				site->peak, site->allocs, site->caller);
+		if (ctrlc())
+			break;
+	}
+}
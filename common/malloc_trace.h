@@ -0,0 +1,32 @@
+#ifndef __MALLOC_TRACE_H
+#define __MALLOC_TRACE_H
+
+/*
+ * With CONFIG_MALLOC_TRACE the allocators provide their entry points
+ * under these names and common/malloc_trace.c wraps them. Include this
+ * after <malloc.h> so that the prototypes stay the public ones. Calls
+ * the allocators make internally go to the unwrapped functions.
+ */
+#ifdef CONFIG_MALLOC_TRACE
+void *__malloc(size_t bytes);
+void __free(void *mem);
+void *__realloc(void *oldmem, size_t bytes);
+void *__memalign(size_t alignment, size_t bytes);
+void *__calloc(size_t n, size_t elem_size);
+
+#ifndef MALLOC_TRACE_WRAPPERS
+#undef malloc
+#undef free
+#undef realloc
+#undef memalign
+#undef calloc
+
+#define malloc		__malloc
+#define free		__free
+#define realloc		__realloc
+#define memalign	__memalign
+#define calloc		__calloc
+#endif
+#endif
+
+#endif /* __MALLOC_TRACE_H */
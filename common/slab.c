@@ -0,0 +1,239 @@
+/*
+ * slab.c - size class allocator for small objects
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * malloc() hands allocations of up to SLAB_MAX_SIZE bytes to this
+ * allocator first. Objects are carved from pages of a single region
+ * which is taken from the heap on first use, so that free() can tell
+ * slab objects from heap chunks with an address range check. Each page
+ * holds objects of one size class only and keeps its own free list,
+ * pages which become empty go back to the region.
+ *
+ * When the region is exhausted the allocation falls back to the heap.
+ */
+#include <common.h>
+#include <malloc.h>
+#include <slab.h>
+#include <linux/list.h>
+
+#define SLAB_PAGE_SIZE	4096
+
+struct slab_class;
+
+struct slab_page {
+	struct list_head list;
+	struct slab_class *class;
+	void *free;		/* list of freed objects */
+	char *unused;		/* objects behind this were never handed out */
+	unsigned int inuse;
+} __attribute__((aligned(16)));
+
+struct slab_class {
+	unsigned int size;
+	struct list_head partial;	/* pages with free objects */
+	unsigned int pages;
+	unsigned long inuse;
+	unsigned long peak;
+	unsigned long allocs;
+	unsigned long fallbacks;
+};
+
+static struct slab_class slab_classes[] = {
+	{ .size = 16 }, { .size = 32 }, { .size = 48 }, { .size = 64 },
+	{ .size = 96 }, { .size = 128 }, { .size = 192 }, { .size = 256 },
+};
+
+/* size class index for each multiple of 16 bytes up to SLAB_MAX_SIZE */
+static const unsigned char slab_index[SLAB_MAX_SIZE / 16] = {
+	0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+static char *slab_start, *slab_end, *slab_next;
+static LIST_HEAD(slab_free_pages);
+static int slab_disabled;
+
+static void slab_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(slab_classes); i++)
+		INIT_LIST_HEAD(&slab_classes[i].partial);
+
+	slab_start = memalign(SLAB_PAGE_SIZE, CONFIG_MALLOC_SLAB_SIZE);
+	if (!slab_start) {
+		slab_disabled = 1;
+		return;
+	}
+
+	slab_next = slab_start;
+	slab_end = slab_start + CONFIG_MALLOC_SLAB_SIZE;
+}
+
+static struct slab_page *slab_new_page(struct slab_class *class)
+{
+	struct slab_page *page;
+
+	if (!list_empty(&slab_free_pages)) {
+		page = list_first_entry(&slab_free_pages, struct slab_page, list);
+		list_del(&page->list);
+	} else if (slab_next < slab_end) {
+		page = (struct slab_page *)slab_next;
+		slab_next += SLAB_PAGE_SIZE;
+	} else {
+		return NULL;
+	}
+
+	page->class = class;
+	page->free = NULL;
+	page->unused = (char *)page + sizeof(*page);
+	page->inuse = 0;
+	list_add(&page->list, &class->partial);
+	class->pages++;
+
+	return page;
+}
+
+static inline int slab_page_full(struct slab_page *page)
+{
+	return !page->free && page->unused + page->class->size >
+		(char *)page + SLAB_PAGE_SIZE;
+}
+
+void *slab_alloc(size_t size)
+{
+	struct slab_class *class;
+	struct slab_page *page;
+	void *obj;
+
+	if (size > SLAB_MAX_SIZE || slab_disabled)
+		return NULL;
+
+	if (!slab_start) {
+		slab_init();
+		if (slab_disabled)
+			return NULL;
+	}
+
+	class = &slab_classes[slab_index[size ? (size - 1) >> 4 : 0]];
+
+	if (list_empty(&class->partial)) {
+		page = slab_new_page(class);
+		if (!page) {
+			class->fallbacks++;
+			return NULL;
+		}
+	} else {
+		page = list_first_entry(&class->partial, struct slab_page, list);
+	}
+
+	if (page->free) {
+		obj = page->free;
+		page->free = *(void **)obj;
+	} else {
+		obj = page->unused;
+		page->unused += class->size;
+	}
+
+	page->inuse++;
+
+	/* full pages are on no list, slab_free puts them back */
+	if (slab_page_full(page))
+		list_del_init(&page->list);
+
+	class->allocs++;
+	if (++class->inuse > class->peak)
+		class->peak = class->inuse;
+
+	return obj;
+}
+
+static inline struct slab_page *slab_page_of(void *mem)
+{
+	return (struct slab_page *)((unsigned long)mem & ~(SLAB_PAGE_SIZE - 1));
+}
+
+int slab_owns(void *mem)
+{
+	return (char *)mem >= slab_start && (char *)mem < slab_end;
+}
+
+size_t slab_usable_size(void *mem)
+{
+	return slab_page_of(mem)->class->size;
+}
+
+void slab_free(void *mem)
+{
+	struct slab_page *page = slab_page_of(mem);
+	struct slab_class *class = page->class;
+
+	if (slab_page_full(page))
+		list_add(&page->list, &class->partial);
+
+	*(void **)mem = page->free;
+	page->free = mem;
+	page->inuse--;
+	class->inuse--;
+
+	if (!page->inuse) {
+		list_move(&page->list, &slab_free_pages);
+		class->pages--;
+	}
+}
+
+void *slab_realloc(void *mem, size_t size)
+{
+	size_t oldsize = slab_usable_size(mem);
+	void *new;
+
+	if (size <= oldsize)
+		return mem;
+
+	new = malloc(size);
+	if (!new)
+		return NULL;
+
+	memcpy(new, mem, oldsize);
+	slab_free(mem);
+
+	return new;
+}
+
+void slab_stats(void)
+{
+	struct slab_class *class;
+	unsigned int i, free_pages = 0;
+	struct list_head *l;
+
+	if (!slab_start) {
+		printf("slab: not in use\n");
+		return;
+	}
+
+	list_for_each(l, &slab_free_pages)
+		free_pages++;
+
+	printf("slab: %u KiB at 0x%p, %u pages free\n",
+			CONFIG_MALLOC_SLAB_SIZE >> 10, slab_start,
+			free_pages + (unsigned int)(slab_end - slab_next) /
+			SLAB_PAGE_SIZE);
+	printf("%6s %6s %8s %8s %10s %9s\n", "size", "pages", "in use",
+			"peak", "allocs", "fallback");
+
+	for (i = 0; i < ARRAY_SIZE(slab_classes); i++) {
+		class = &slab_classes[i];
+		printf("%6u %6u %8lu %8lu %10lu %9lu\n", class->size,
+				class->pages, class->inuse, class->peak,
+				class->allocs, class->fallbacks);
+	}
+}
@@ -35,6 +35,7 @@
 #include <envfs.h>
 #include <asm/sections.h>
 #include <uncompress.h>
+#include <boottrace.h>
 
 extern initcall_t __barebox_initcalls_start[], __barebox_early_initcalls_end[],
 		  __barebox_initcalls_end[];
@@ -98,6 +99,7 @@ void __noreturn start_barebox(void)
 {
 	initcall_t *initcall;
 	int result;
+	unsigned int trace;
 	struct stat s;
 
 	if (!IS_ENABLED(CONFIG_SHELL_NONE))
@@ -106,7 +108,9 @@ void __noreturn start_barebox(void)
 	for (initcall = __barebox_initcalls_start;
 			initcall < __barebox_initcalls_end; initcall++) {
 		pr_debug("initcall-> %pS\n", *initcall);
+		trace = boottrace_begin(BOOTTRACE_INITCALL, NULL, *initcall);
 		result = (*initcall)();
+		boottrace_end(trace);
 		if (result)
 			pr_err("initcall %pS failed: %s\n", *initcall,
 					strerror(-result));
@@ -117,13 +121,19 @@ void __noreturn start_barebox(void)
 	if (IS_ENABLED(CONFIG_ENV_HANDLING)) {
 		int ret;
 
+		trace = boottrace_begin(BOOTTRACE_ENV,
+				default_environment_path, NULL);
 		ret = envfs_load(default_environment_path, "/env", 0);
+		boottrace_end(trace);
 
 		if (ret && IS_ENABLED(CONFIG_DEFAULT_ENVIRONMENT)) {
 			pr_err("no valid environment found on %s. "
 				"Using default environment\n",
 				default_environment_path);
+			trace = boottrace_begin(BOOTTRACE_ENV,
+					"/dev/defaultenv", NULL);
 			envfs_load("/dev/defaultenv", "/env", 0);
+			boottrace_end(trace);
 		}
 	}
 
@@ -23,11 +23,21 @@
 #include <stdio.h>
 #include <module.h>
 #include <tlsf.h>
+#include <slab.h>
+#include "malloc_trace.h"
 
 extern tlsf_pool tlsf_mem_pool;
 
 void *malloc(size_t bytes)
 {
+	void *mem;
+
+	if (bytes <= SLAB_MAX_SIZE) {
+		mem = slab_alloc(bytes);
+		if (mem)
+			return mem;
+	}
+
 	/*
 	 * tlsf_malloc returns NULL for zero bytes, we instead want
 	 * to have a valid pointer.
@@ -57,12 +67,20 @@ EXPORT_SYMBOL(calloc);
 
 void free(void *mem)
 {
+	if (slab_owns(mem)) {
+		slab_free(mem);
+		return;
+	}
+
 	tlsf_free(tlsf_mem_pool, mem);
 }
 EXPORT_SYMBOL(free);
 
 void *realloc(void *oldmem, size_t bytes)
 {
+	if (oldmem && slab_owns(oldmem))
+		return slab_realloc(oldmem, bytes);
+
 	return tlsf_realloc(tlsf_mem_pool, oldmem, bytes);
 }
 EXPORT_SYMBOL(realloc);
@@ -130,6 +130,9 @@ again:
 	handle = xzalloc(sizeof(struct uimage_handle));
 	header = &handle->header;
 
+	if (!stat(filename, &s))
+		handle->size = s.st_size;
+
 	if (read(fd, header, sizeof(*header)) < 0) {
 		printf("could not read: %s\n", errno_str());
 		goto err_out;
@@ -237,7 +240,7 @@ static int uimage_fill(void *buf, unsigned int len)
 	return read_full(uimage_fd, buf, len);
 }
 
-static int uncompress_copy(unsigned char *inbuf_unused, int len,
+static int uncompress_copy(unsigned char *inbuf, int len,
 		int(*fill)(void*, unsigned int),
 		int(*flush)(void*, unsigned int),
 		unsigned char *outbuf_unused,
@@ -245,13 +248,24 @@ static int uncompress_copy(unsigned char *inbuf_unused, int len,
 		void(*error_fn)(char *x))
 {
 	int ret;
-	void *buf = xmalloc(PAGE_SIZE);
+	void *buf;
+
+	if (inbuf) {
+		ret = flush(inbuf, len);
+		return ret < 0 ? ret : 0;
+	}
+
+	buf = xmalloc(PAGE_SIZE);
 
 	while (len) {
 		int now = min(len, PAGE_SIZE);
 		ret = fill(buf, now);
 		if (ret < 0)
 			goto err;
+		if (ret < now) {
+			ret = -EINVAL;
+			goto err;
+		}
 		ret = flush(buf, now);
 		if (ret < 0)
 			goto err;
@@ -264,6 +278,26 @@ err:
 	return ret;
 }
 
+/*
+ * Map @len bytes at @offset of the uImage. Returns NULL if the file cannot
+ * be mapped or is shorter than the header says, it is read then.
+ */
+static void *uimage_map(struct uimage_handle *handle, size_t offset,
+		size_t len)
+{
+	void *map;
+
+	/* /dev/mem is ~0 bytes, which may be negative as loff_t */
+	if ((u64)offset + len > (u64)handle->size)
+		return NULL;
+
+	map = memmap(handle->fd, PROT_READ);
+	if (map == (void *)-1)
+		return NULL;
+
+	return map + offset;
+}
+
 /*
  * Verify the data crc of an uImage
  */
@@ -273,20 +307,32 @@ int uimage_verify(struct uimage_handle *handle)
 	int len, ret;
 	void *buf;
 
-	ret = lseek(handle->fd, sizeof(struct image_header), SEEK_SET);
-	if (ret < 0)
-		return ret;
+	buf = uimage_map(handle, sizeof(struct image_header),
+			handle->header.ih_size);
+	if (buf) {
+		crc = crc32(0, buf, handle->header.ih_size);
+		buf = NULL;
+	} else {
+		ret = lseek(handle->fd, sizeof(struct image_header), SEEK_SET);
+		if (ret < 0)
+			return ret;
 
-	buf = xmalloc(PAGE_SIZE);
+		buf = xmalloc(PAGE_SIZE);
 
-	len = handle->header.ih_size;
-	while (len) {
-		int now = min(len, PAGE_SIZE);
-		ret = read(handle->fd, buf, now);
-		if (ret < 0)
-			goto err;
-		crc = crc32(crc, buf, now);
-		len -= ret;
+		len = handle->header.ih_size;
+		while (len) {
+			int now = min(len, PAGE_SIZE);
+			ret = read(handle->fd, buf, now);
+			if (ret < 0)
+				goto err;
+			if (!ret) {
+				printf("uImage is shorter than its header says\n");
+				ret = -EINVAL;
+				goto err;
+			}
+			crc = crc32(crc, buf, ret);
+			len -= ret;
+		}
 	}
 
 	if (crc != handle->header.ih_dcrc) {
@@ -312,6 +358,7 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 {
 	image_header_t *hdr = &handle->header;
 	struct uimage_handle_data *iha;
+	unsigned char *map;
 	int ret;
 	int (*uncompress_fn)(unsigned char *inbuf, int len,
 		    int(*fill)(void*, unsigned int),
@@ -325,17 +372,23 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 
 	iha = &handle->ihd[image_no];
 
-	ret = lseek(handle->fd, iha->offset + handle->data_offset,
-			SEEK_SET);
-	if (ret < 0)
-		return ret;
-
 	/* if ramdisk U-Boot expect to ignore the compression type */
 	if (hdr->ih_comp == IH_COMP_NONE || hdr->ih_type == IH_TYPE_RAMDISK)
 		uncompress_fn = uncompress_copy;
 	else
 		uncompress_fn = uncompress;
 
+	/* images on mapped devices are uncompressed or copied in place */
+	map = uimage_map(handle, iha->offset + handle->data_offset, iha->len);
+	if (map)
+		return uncompress_fn(map, iha->len, NULL, flush, NULL, NULL,
+				uncompress_err_stdout);
+
+	ret = lseek(handle->fd, iha->offset + handle->data_offset,
+			SEEK_SET);
+	if (ret < 0)
+		return ret;
+
 	uimage_fd = handle->fd;
 
 	ret = uncompress_fn(NULL, iha->len, uimage_fill, flush,
@@ -275,14 +275,18 @@ static int ahci_write(struct ata_port *ata, const void *buf, unsigned int block,
 	return ahci_rw(ata, NULL, buf, block, num_blocks);
 }
 
-static int ahci_init_port(struct ahci_port *ahci_port)
+static void ahci_port_free(struct ahci_port *ahci_port)
+{
+	dma_free_coherent(ahci_port->cmd_tbl, AHCI_CMD_TBL_SZ);
+	dma_free_coherent((void *)ahci_port->rx_fis, AHCI_RX_FIS_SZ);
+	dma_free_coherent(ahci_port->cmd_slot, AHCI_CMD_SLOT_SZ * 32);
+}
+
+static int ahci_init_port_start(struct ahci_port *ahci_port)
 {
-	void __iomem *port_mmio;
 	u32 val, cmd;
 	int ret;
 
-	port_mmio = ahci_port->port_mmio;
-
 	/* make sure port is not active */
 	val = ahci_port_read(ahci_port, PORT_CMD);
 	if (val & (PORT_CMD_LIST_ON | PORT_CMD_FIS_ON | PORT_CMD_FIS_RX | PORT_CMD_START)) {
@@ -356,42 +360,23 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	cmd |= PORT_CMD_START;
 	ahci_port_write_f(ahci_port, PORT_CMD, cmd);
 
-	/*
-	 * Bring up SATA link.
-	 * SATA link bringup time is usually less than 1 ms; only very
-	 * rarely has it taken between 1-2 ms. Never seen it above 2 ms.
-	 */
-	ret = wait_on_timeout(WAIT_LINKUP,
-			(ahci_port_read(ahci_port, PORT_SCR_STAT) & 0xf) == 0x3);
-	if (ret) {
-		ahci_port_info(ahci_port, "SATA link timeout\n");;
-		ret = -ETIMEDOUT;
-		goto err_init;
-	}
-
-	ahci_port_info(ahci_port, "SATA link ok\n");
-
-	/* Clear error status */
-	val = ahci_port_read(ahci_port, PORT_SCR_ERR);
-	if (val)
-		ahci_port_write(ahci_port, PORT_SCR_ERR, val);
+	return 0;
 
-	ahci_port_info(ahci_port, "Spinning up device...\n");
+err_alloc2:
+	dma_free_coherent((void *)ahci_port->rx_fis, AHCI_RX_FIS_SZ);
+err_alloc1:
+	dma_free_coherent(ahci_port->cmd_slot, AHCI_CMD_SLOT_SZ * 32);
+err_alloc:
+	return ret;
+}
 
-	ret = wait_on_timeout(WAIT_SPINUP,
-			((readl(port_mmio + PORT_TFDATA) &
-			 (ATA_STATUS_BUSY | ATA_STATUS_DRQ)) == 0)
-			|| ((readl(port_mmio + PORT_SCR_STAT) & 0xf) == 1));
-	if (ret) {
-		ahci_port_info(ahci_port, "timeout.\n");
-		ret = -ENODEV;
-		goto err_init;
-	}
+static int ahci_init_port_finish(struct ahci_port *ahci_port)
+{
+	u32 val;
 
-	if ((readl(port_mmio + PORT_SCR_STAT) & 0xf) == 1) {
+	if ((ahci_port_read(ahci_port, PORT_SCR_STAT) & 0xf) == 1) {
 		ahci_port_info(ahci_port, "down.\n");
-		ret = -ENODEV;
-		goto err_init;
+		return -ENODEV;
 	}
 
 	ahci_port_info(ahci_port, "ok.\n");
@@ -418,15 +403,87 @@ static int ahci_init_port(struct ahci_port *ahci_port)
 	if ((val & 0xf) == 0x03)
 		return 0;
 
-	ret = -ENODEV;
+	return -ENODEV;
+}
+
+/*
+ * Bring up a port. The waits for the SATA link and for the device to spin
+ * up do not block: -EAGAIN is returned until the port is ready, call again
+ * then.
+ */
+static int ahci_init_port(struct ahci_port *ahci_port)
+{
+	void __iomem *port_mmio = ahci_port->port_mmio;
+	u32 val;
+	int ret;
+
+	switch (ahci_port->state) {
+	case AHCI_PORT_IDLE:
+		ret = ahci_init_port_start(ahci_port);
+		if (ret)
+			return ret;
+
+		ahci_port->state = AHCI_PORT_LINKUP;
+		ahci_port->wait_start = get_time_ns();
+
+		return -EAGAIN;
+
+	case AHCI_PORT_LINKUP:
+		/*
+		 * Bring up SATA link.
+		 * SATA link bringup time is usually less than 1 ms; only very
+		 * rarely has it taken between 1-2 ms. Never seen it above 2 ms.
+		 */
+		if ((ahci_port_read(ahci_port, PORT_SCR_STAT) & 0xf) != 0x3) {
+			if (!is_timeout(ahci_port->wait_start, WAIT_LINKUP))
+				return -EAGAIN;
+
+			ahci_port_info(ahci_port, "SATA link timeout\n");
+			ret = -ETIMEDOUT;
+			goto err_init;
+		}
+
+		ahci_port_info(ahci_port, "SATA link ok\n");
+
+		/* Clear error status */
+		val = ahci_port_read(ahci_port, PORT_SCR_ERR);
+		if (val)
+			ahci_port_write(ahci_port, PORT_SCR_ERR, val);
+
+		ahci_port_info(ahci_port, "Spinning up device...\n");
+
+		ahci_port->state = AHCI_PORT_SPINUP;
+		ahci_port->wait_start = get_time_ns();
+
+		return -EAGAIN;
+
+	case AHCI_PORT_SPINUP:
+		if ((readl(port_mmio + PORT_TFDATA) &
+				(ATA_STATUS_BUSY | ATA_STATUS_DRQ)) &&
+		    (readl(port_mmio + PORT_SCR_STAT) & 0xf) != 1) {
+			if (!is_timeout(ahci_port->wait_start, WAIT_SPINUP))
+				return -EAGAIN;
+
+			ahci_port_info(ahci_port, "timeout.\n");
+			ret = -ENODEV;
+			goto err_init;
+		}
+
+		ret = ahci_init_port_finish(ahci_port);
+		if (ret)
+			goto err_init;
+
+		ahci_port->state = AHCI_PORT_IDLE;
+
+		return 0;
+	}
+
+	return -EINVAL;
 
 err_init:
-	dma_free_coherent(ahci_port->cmd_tbl, AHCI_CMD_TBL_SZ);
-err_alloc2:
-	dma_free_coherent((void *)ahci_port->rx_fis, AHCI_RX_FIS_SZ);
-err_alloc1:
-	dma_free_coherent(ahci_port->cmd_slot, AHCI_CMD_SLOT_SZ * 32);
-err_alloc:
+	ahci_port_free(ahci_port);
+	ahci_port->state = AHCI_PORT_IDLE;
+
 	return ret;
 }
 
@@ -160,8 +160,14 @@ struct ahci_port {
 	struct ahci_sg		*cmd_tbl_sg;
 	void			*cmd_tbl;
 	u32			rx_fis;
+	int			state;		/* AHCI_PORT_*, bringing up the port */
+	uint64_t		wait_start;
 };
 
+#define AHCI_PORT_IDLE		0
+#define AHCI_PORT_LINKUP	1
+#define AHCI_PORT_SPINUP	2
+
 struct ahci_device {
 	struct device_d		*dev;
 	struct ahci_port	ports[AHCI_MAX_PORTS];
@@ -329,7 +329,7 @@ static int ata_set_probe(struct device_d *class_dev, struct param_d *param,
 				const char *val)
 {
 	struct ata_port *port = container_of(class_dev, struct ata_port, class_dev);
-	int ret, probe;
+	int probe;
 
 	if (port->initialized) {
 		dev_info(class_dev, "already initialized\n");
@@ -340,13 +340,29 @@ static int ata_set_probe(struct device_d *class_dev, struct param_d *param,
 	if (!probe)
 		return 0;
 
+	return device_detect(class_dev);
+}
+
+/*
+ * Detect callback of the port, does one step of the port initialization.
+ * Returns -EAGAIN while the port is still waiting for the drive.
+ */
+static int ata_detect(struct device_d *class_dev)
+{
+	struct ata_port *port = container_of(class_dev, struct ata_port, class_dev);
+	int ret;
+
+	if (port->initialized)
+		return 0;
+
 	ret = ata_port_init(port);
 	if (ret)
 		return ret;
 
 	port->initialized = 1;
 
-	return dev_param_set_generic(class_dev, param, "1");
+	return dev_param_set_generic(class_dev,
+			get_param_by_name(class_dev, "probe"), "1");
 }
 
 /**
@@ -362,6 +378,7 @@ int ata_port_register(struct ata_port *port)
 	port->class_dev.id = DEVICE_ID_DYNAMIC;
 	strcpy(port->class_dev.name, "ata");
 	port->class_dev.parent = port->dev;
+	port->class_dev.detect = ata_detect;
 
 	ret = register_device(&port->class_dev);
 	if (ret)
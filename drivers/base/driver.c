@@ -31,6 +31,10 @@
 #include <fs.h>
 #include <linux/list.h>
 #include <complete.h>
+#include <clock.h>
+#include <asm-generic/div64.h>
+#include <boottrace.h>
+#include <poller.h>
 
 LIST_HEAD(device_list);
 EXPORT_SYMBOL(device_list);
@@ -77,9 +81,21 @@ int get_free_deviceid(const char *name_template)
 
 int device_probe(struct device_d *dev)
 {
+	unsigned int trace;
+	uint64_t start;
 	int ret;
 
+	trace = boottrace_begin(BOOTTRACE_PROBE, dev_name(dev), NULL);
+	start = get_time_ns();
 	ret = dev->bus->probe(dev);
+	dev->probe_time = get_time_ns() - start;
+	boottrace_end(trace);
+
+	if (dev->driver) {
+		dev->driver->probe_time += dev->probe_time;
+		dev->driver->probe_count++;
+	}
+
 	if (ret) {
 		dev_err(dev, "probe failed: %s\n", strerror(-ret));
 		return ret;
@@ -101,6 +117,12 @@ static int match(struct driver_d *drv, struct device_d *dev)
 
 	if (dev->bus->match(dev, drv))
 		goto err_out;
+
+	if (drv->lazy) {
+		dev->probe_deferred = 1;
+		return 0;
+	}
+
 	ret = device_probe(dev);
 	if (ret)
 		goto err_out;
@@ -111,10 +133,184 @@ err_out:
 	return -1;
 }
 
-int register_device(struct device_d *new_device)
+/*
+ * The compatible index. On buses with of_match_only set a device with a
+ * device node can only be bound to a driver with an of_compatible table
+ * when they share a compatible string. Both are hashed by their
+ * compatible strings here, so that registering a device or a driver only
+ * tries the candidates instead of calling match() for every device/driver
+ * combination of the bus.
+ */
+#define OF_COMPAT_HASH_SIZE	256
+
+struct of_compat_entry {
+	struct hlist_node hash;
+	struct list_head list;	/* device_d::of_compatibles */
+	struct driver_d *drv;
+	struct device_d *dev;
+	char compatible[0];
+};
+
+static struct hlist_head of_compat_drivers[OF_COMPAT_HASH_SIZE];
+static struct hlist_head of_compat_devices[OF_COMPAT_HASH_SIZE];
+
+static unsigned int of_compat_hash(const char *compatible)
+{
+	unsigned int hash = 0;
+
+	while (*compatible)
+		hash = hash * 31 + *compatible++;
+
+	return hash % OF_COMPAT_HASH_SIZE;
+}
+
+static struct of_compat_entry *of_compat_alloc(const char *compatible)
+{
+	struct of_compat_entry *e;
+
+	e = xzalloc(sizeof(*e) + strlen(compatible) + 1);
+	strcpy(e->compatible, compatible);
+
+	return e;
+}
+
+static int driver_is_indexed(struct driver_d *drv)
+{
+	return IS_ENABLED(CONFIG_OFDEVICE) && drv->bus->of_match_only &&
+		drv->of_compatible;
+}
+
+/*
+ * A device is indexed when it had a device node at registration time.
+ * Devices which get their node attached later are matched the slow way.
+ */
+static int device_is_indexed(struct device_d *dev)
+{
+	return !list_empty(&dev->of_compatibles);
+}
+
+static void driver_index_compatibles(struct driver_d *drv)
+{
+	struct of_device_id *id;
+	struct of_compat_entry *e;
+
+	if (!driver_is_indexed(drv))
+		return;
+
+	for (id = drv->of_compatible; id->compatible; id++) {
+		e = of_compat_alloc(id->compatible);
+		e->drv = drv;
+		hlist_add_head(&e->hash,
+			&of_compat_drivers[of_compat_hash(id->compatible)]);
+	}
+}
+
+static void device_index_compatibles(struct device_d *dev)
+{
+	struct of_compat_entry *e;
+	const char *cp;
+	int cplen, l;
+
+	if (!IS_ENABLED(CONFIG_OFDEVICE) || !dev->bus->of_match_only ||
+			!dev->device_node)
+		return;
+
+	cp = of_get_property(dev->device_node, "compatible", &cplen);
+	if (!cp)
+		return;
+
+	while (cplen > 0) {
+		e = of_compat_alloc(cp);
+		e->dev = dev;
+		hlist_add_head(&e->hash, &of_compat_devices[of_compat_hash(cp)]);
+		list_add_tail(&e->list, &dev->of_compatibles);
+
+		l = strlen(cp) + 1;
+		cp += l;
+		cplen -= l;
+	}
+}
+
+static void device_unindex_compatibles(struct device_d *dev)
+{
+	struct of_compat_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &dev->of_compatibles, list) {
+		hlist_del(&e->hash);
+		list_del(&e->list);
+		free(e);
+	}
+}
+
+/*
+ * Try the drivers sharing a compatible with @dev, in the order of the
+ * compatible property of its node, i.e. most specific first.
+ */
+static int device_match_indexed(struct device_d *dev)
+{
+	struct of_compat_entry *d, *e;
+	struct hlist_node *n;
+
+	list_for_each_entry(d, &dev->of_compatibles, list) {
+		hlist_for_each_entry(e, n,
+			&of_compat_drivers[of_compat_hash(d->compatible)], hash) {
+			if (e->drv->bus != dev->bus ||
+					strcmp(e->compatible, d->compatible))
+				continue;
+			if (!match(e->drv, dev))
+				return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static void device_match_driver(struct device_d *dev)
 {
 	struct driver_d *drv;
+	int indexed = device_is_indexed(dev);
+
+	if (indexed && !device_match_indexed(dev))
+		return;
+
+	bus_for_each_driver(dev->bus, drv) {
+		if (indexed && driver_is_indexed(drv))
+			continue;
+		if (!match(drv, dev))
+			break;
+	}
+}
+
+static void driver_match_devices(struct driver_d *drv)
+{
+	struct of_device_id *id;
+	struct of_compat_entry *e;
+	struct hlist_node *n;
+	struct device_d *dev;
+
+	if (!driver_is_indexed(drv)) {
+		bus_for_each_device(drv->bus, dev)
+			match(drv, dev);
+		return;
+	}
+
+	for (id = drv->of_compatible; id->compatible; id++) {
+		hlist_for_each_entry(e, n,
+			&of_compat_devices[of_compat_hash(id->compatible)], hash) {
+			if (e->dev->bus != drv->bus ||
+					strcmp(e->compatible, id->compatible))
+				continue;
+			match(drv, e->dev);
+		}
+	}
 
+	bus_for_each_device(drv->bus, dev)
+		if (!device_is_indexed(dev))
+			match(drv, dev);
+}
+
+int register_device(struct device_d *new_device)
+{
 	if (new_device->id == DEVICE_ID_DYNAMIC) {
 		new_device->id = get_free_deviceid(new_device->name);
 	} else {
@@ -132,6 +328,8 @@ int register_device(struct device_d *new_device)
 	INIT_LIST_HEAD(&new_device->cdevs);
 	INIT_LIST_HEAD(&new_device->parameters);
 	INIT_LIST_HEAD(&new_device->active);
+	INIT_LIST_HEAD(&new_device->of_compatibles);
+	INIT_LIST_HEAD(&new_device->detect_list);
 
 	if (new_device->bus) {
 		if (!new_device->parent)
@@ -139,10 +337,8 @@ int register_device(struct device_d *new_device)
 
 		list_add_tail(&new_device->bus_list, &new_device->bus->device_list);
 
-		bus_for_each_driver(new_device->bus, drv) {
-			if (!match(drv, new_device))
-				break;
-		}
+		device_index_compatibles(new_device);
+		device_match_driver(new_device);
 	}
 
 	if (new_device->parent)
@@ -159,7 +355,7 @@ int unregister_device(struct device_d *old_dev)
 
 	dev_dbg(old_dev, "unregister\n");
 
-	if (old_dev->driver)
+	if (old_dev->driver && !old_dev->probe_deferred)
 		old_dev->bus->remove(old_dev);
 
 	list_for_each_entry_safe(child, dt, &old_dev->children, sibling) {
@@ -177,6 +373,8 @@ int unregister_device(struct device_d *old_dev)
 	list_del(&old_dev->list);
 	list_del(&old_dev->bus_list);
 	list_del(&old_dev->active);
+	list_del(&old_dev->detect_list);
+	device_unindex_compatibles(old_dev);
 
 	/* remove device from parents child list */
 	if (old_dev->parent)
@@ -186,6 +384,169 @@ int unregister_device(struct device_d *old_dev)
 }
 EXPORT_SYMBOL(unregister_device);
 
+int device_probe_deferred(struct device_d *dev)
+{
+	int ret;
+
+	if (!dev->probe_deferred)
+		return 0;
+
+	dev->probe_deferred = 0;
+
+	ret = device_probe(dev);
+	if (ret)
+		dev->driver = NULL;
+
+	return ret;
+}
+EXPORT_SYMBOL(device_probe_deferred);
+
+/**
+ * device_detect - make a device usable
+ * @dev: the device
+ *
+ * Probes the device if it is bound to a lazy driver and runs its detect
+ * callback, e.g. to look for a card in a slot. A callback returning
+ * -EAGAIN is called again, with the pollers running meanwhile.
+ */
+int device_detect(struct device_d *dev)
+{
+	int ret;
+
+	ret = device_probe_deferred(dev);
+	if (ret)
+		return ret;
+
+	if (!dev->detect)
+		return 0;
+
+	list_del_init(&dev->detect_list);
+
+	while ((ret = dev->detect(dev)) == -EAGAIN)
+		poller_call();
+
+	dev->detected = 1;
+
+	return ret;
+}
+EXPORT_SYMBOL(device_detect);
+
+int device_detect_by_name(const char *devname)
+{
+	struct device_d *dev;
+
+	dev = get_device_by_name(devname);
+	if (!dev)
+		return -ENODEV;
+
+	return device_detect(dev);
+}
+EXPORT_SYMBOL(device_detect_by_name);
+
+void device_detect_all(void)
+{
+	struct device_d *dev;
+
+	for_each_device(dev)
+		device_detect(dev);
+}
+EXPORT_SYMBOL(device_detect_all);
+
+static int device_needs_detect(struct device_d *dev)
+{
+	return dev->probe_deferred || (dev->detect && !dev->detected);
+}
+
+/**
+ * device_detect_file - detect the device a device file belongs to
+ * @name: the name of the device file, without /dev/
+ *
+ * Called when a device file is not found, it may belong to a device
+ * which has not been probed or detected yet. A device owns the file
+ * if the file is named after it, like ata0 or the partition ata0.0.
+ * Returns 1 if such a device has been detected, 0 otherwise.
+ */
+int device_detect_file(const char *name)
+{
+	struct device_d *dev;
+	const char *devname;
+	int len;
+
+	for_each_device(dev) {
+		if (!device_needs_detect(dev))
+			continue;
+
+		devname = dev_name(dev);
+		len = strlen(devname);
+
+		if (strncmp(name, devname, len) ||
+				(name[len] != '\0' && name[len] != '.'))
+			continue;
+
+		device_detect(dev);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_POLLER
+static LIST_HEAD(detect_async_list);
+static int detect_poller_registered;
+
+static void device_detect_poll(struct poller_struct *poller)
+{
+	struct device_d *dev, *tmp;
+
+	list_for_each_entry_safe(dev, tmp, &detect_async_list, detect_list) {
+		if (device_probe_deferred(dev) || !dev->detect) {
+			list_del_init(&dev->detect_list);
+			continue;
+		}
+
+		if (dev->detect(dev) == -EAGAIN)
+			continue;
+
+		dev->detected = 1;
+		list_del_init(&dev->detect_list);
+	}
+}
+
+static struct poller_struct detect_poller = {
+	.func = device_detect_poll,
+};
+
+/**
+ * device_detect_async - detect a device in the background
+ * @dev: the device
+ *
+ * The device is probed and detected from the poller, so that a detect
+ * callback returning -EAGAIN while waiting for the hardware makes
+ * progress whenever barebox waits for something else.
+ */
+int device_detect_async(struct device_d *dev)
+{
+	if (!device_needs_detect(dev) || !list_empty(&dev->detect_list))
+		return 0;
+
+	if (!detect_poller_registered) {
+		poller_register(&detect_poller);
+		detect_poller_registered = 1;
+	}
+
+	list_add_tail(&dev->detect_list, &detect_async_list);
+
+	return 0;
+}
+#else
+int device_detect_async(struct device_d *dev)
+{
+	return device_detect(dev);
+}
+#endif
+EXPORT_SYMBOL(device_detect_async);
+
 struct driver_d *get_driver_by_name(const char *name)
 {
 	struct driver_d *drv;
@@ -209,8 +570,6 @@ static void noshortinfo(struct device_d *dev)
 
 int register_driver(struct driver_d *drv)
 {
-	struct device_d *dev = NULL;
-
 	debug("register_driver: %s\n", drv->name);
 
 	BUG_ON(!drv->bus);
@@ -223,8 +582,8 @@ int register_driver(struct driver_d *drv)
 	if (!drv->shortinfo)
 		drv->shortinfo = noshortinfo;
 
-	bus_for_each_device(drv->bus, dev)
-		match(drv, dev);
+	driver_index_compatibles(drv);
+	driver_match_devices(drv);
 
 	return 0;
 }
@@ -449,6 +808,7 @@ static int do_devinfo(int argc, char *argv[])
 	struct param_d *param;
 	int i;
 	struct resource *res;
+	uint64_t time;
 
 	if (argc == 1) {
 		printf("devices:\n");
@@ -459,8 +819,16 @@ static int do_devinfo(int argc, char *argv[])
 		}
 
 		printf("\ndrivers:\n");
-		for_each_driver(drv)
-			printf("%s\n",drv->name);
+		for_each_driver(drv) {
+			if (drv->probe_count) {
+				time = drv->probe_time;
+				do_div(time, USECOND);
+				printf("%-24s %3u probes %8llu us\n", drv->name,
+					drv->probe_count, time);
+			} else {
+				printf("%s\n", drv->name);
+			}
+		}
 	} else {
 		dev = get_device_by_name(argv[1]);
 
@@ -480,13 +848,20 @@ static int do_devinfo(int argc, char *argv[])
 			       res->start, resource_size(res));
 		}
 
-		printf("driver: %s\n", dev->driver ?
-				dev->driver->name : "none");
+		printf("driver: %s%s\n", dev->driver ?
+				dev->driver->name : "none",
+				dev->probe_deferred ? " (not probed yet)" : "");
+
+		if (dev->driver) {
+			time = dev->probe_time;
+			do_div(time, USECOND);
+			printf("probe time: %llu us\n", time);
+		}
 
 		printf("bus: %s\n\n", dev->bus ?
 				dev->bus->name : "none");
 
-		if (dev->driver)
+		if (dev->driver && !dev->probe_deferred)
 			dev->driver->info(dev);
 
 		printf("%s\n", list_empty(&dev->parameters) ?
@@ -74,6 +74,7 @@ struct bus_type platform_bus = {
 	.match = platform_match,
 	.probe = platform_probe,
 	.remove = platform_remove,
+	.of_match_only = 1,
 };
 
 static int platform_init(void)
@@ -20,6 +20,7 @@
 #include <common.h>
 #include <malloc.h>
 #include <errno.h>
+#include <dmaengine.h>
 #include <asm/mmu.h>
 #include <asm/io.h>
 #include <mach/clock.h>
@@ -48,7 +49,15 @@
 #define	BP_APBHX_CHn_SEMA_PHORE			16
 
 static struct mxs_dma_chan mxs_dma_channels[MXS_MAX_DMA_CHANNELS];
+static struct dma_chan apbh_dma_chans[MXS_MAX_DMA_CHANNELS];
 static bool apbh_is_old;
+static bool mxs_dma_initialized;
+
+struct apbh_dma_tx {
+	struct dma_async_tx_descriptor tx;
+	int num_desc;
+	struct mxs_dma_desc *desc[];
+};
 
 /*
  * Test is the DMA channel is valid channel
@@ -362,7 +371,7 @@ void mxs_dma_desc_free(struct mxs_dma_desc *pdesc)
 	if (pdesc == NULL)
 		return;
 
-	free(pdesc);
+	dma_free_coherent(pdesc, sizeof(struct mxs_dma_desc));
 }
 
 /*
@@ -491,12 +500,21 @@ static int mxs_dma_finish(int channel, struct list_head *head)
 	return 0;
 }
 
+/*
+ * Test if the DMA channel has completed its command chain
+ */
+static int mxs_dma_done(int chan)
+{
+	void __iomem *apbh_regs = (void *)MXS_APBH_BASE;
+
+	return readl(apbh_regs + HW_APBHX_CTRL1) & (1 << chan);
+}
+
 /*
  * Wait for DMA channel to complete
  */
 static int mxs_dma_wait_complete(uint32_t timeout, unsigned int chan)
 {
-	void __iomem *apbh_regs = (void *)MXS_APBH_BASE;
 	int ret;
 
 	ret = mxs_dma_validate_chan(chan);
@@ -504,7 +522,7 @@ static int mxs_dma_wait_complete(uint32_t timeout, unsigned int chan)
 		return ret;
 
 	while (--timeout) {
-		if (readl(apbh_regs + HW_APBHX_CTRL1) & (1 << chan))
+		if (mxs_dma_done(chan))
 			break;
 		udelay(1);
 	}
@@ -518,33 +536,195 @@ static int mxs_dma_wait_complete(uint32_t timeout, unsigned int chan)
 }
 
 /*
- * Execute the DMA channel
+ * Start the descriptors appended to the channel
  */
-int mxs_dma_go(int chan)
+static void mxs_dma_start(int chan)
 {
-	uint32_t timeout = 10000;
-	int ret;
-
-	LIST_HEAD(tmp_desc_list);
-
 	mxs_dma_enable_irq(chan, 1);
 	mxs_dma_enable(chan);
+}
 
-	/* Wait for DMA to finish. */
-	ret = mxs_dma_wait_complete(timeout, chan);
+/*
+ * Shut the channel down after its command chain completed or timed out
+ */
+static void mxs_dma_stop(int chan)
+{
+	LIST_HEAD(tmp_desc_list);
 
 	/* Clear out the descriptors we just ran. */
 	mxs_dma_finish(chan, &tmp_desc_list);
 
-	/* Shut the DMA channel down. */
 	mxs_dma_ack_irq(chan);
 	mxs_dma_reset(chan);
 	mxs_dma_enable_irq(chan, 0);
 	mxs_dma_disable(chan);
+}
+
+/*
+ * Execute the DMA channel, waiting up to @timeout microseconds
+ */
+int mxs_dma_go_timeout(int chan, uint32_t timeout)
+{
+	int ret;
+
+	mxs_dma_start(chan);
+
+	/* Wait for DMA to finish. */
+	ret = mxs_dma_wait_complete(timeout, chan);
+
+	mxs_dma_stop(chan);
 
 	return ret;
 }
 
+/*
+ * Execute the DMA channel
+ */
+int mxs_dma_go(int chan)
+{
+	return mxs_dma_go_timeout(chan, 10000);
+}
+
+/*
+ * DMA engine interface. Each channel runs one transaction at a time, further
+ * submitted transactions are started from the poll function when the
+ * previous one has completed.
+ */
+static inline struct apbh_dma_tx *to_apbh_tx(struct dma_async_tx_descriptor *tx)
+{
+	return container_of(tx, struct apbh_dma_tx, tx);
+}
+
+static void apbh_dma_free_desc(struct dma_async_tx_descriptor *tx)
+{
+	struct apbh_dma_tx *atx = to_apbh_tx(tx);
+	int i;
+
+	for (i = 0; i < atx->num_desc; i++)
+		mxs_dma_desc_free(atx->desc[i]);
+
+	free(atx);
+}
+
+static struct dma_async_tx_descriptor *apbh_dma_prep_slave_sg(
+		struct dma_chan *chan, struct dma_sg *sg, int sg_len,
+		enum dma_transfer_direction dir)
+{
+	struct apbh_dma_tx *atx;
+	struct mxs_dma_desc *d;
+	unsigned long cmd;
+	int i;
+
+	/* memory is read for transfers to the device */
+	if (dir == DMA_MEM_TO_DEV)
+		cmd = MXS_DMA_DESC_COMMAND_DMA_READ;
+	else if (dir == DMA_DEV_TO_MEM)
+		cmd = MXS_DMA_DESC_COMMAND_DMA_WRITE;
+	else
+		return NULL;
+
+	atx = xzalloc(sizeof(*atx) + sg_len * sizeof(atx->desc[0]));
+	atx->tx.chan = chan;
+
+	for (i = 0; i < sg_len; i++) {
+		if (sg[i].len > 0xffff)
+			goto err;
+
+		d = mxs_dma_desc_alloc();
+		if (!d)
+			goto err;
+
+		atx->desc[atx->num_desc++] = d;
+
+		d->cmd.data = cmd | MXS_DMA_DESC_DEC_SEM |
+			(sg[i].len << MXS_DMA_DESC_BYTES_OFFSET);
+		if (i == sg_len - 1)
+			d->cmd.data |= MXS_DMA_DESC_IRQ | MXS_DMA_DESC_WAIT4END;
+		d->cmd.address = sg[i].addr;
+	}
+
+	return &atx->tx;
+err:
+	apbh_dma_free_desc(&atx->tx);
+	return NULL;
+}
+
+static void apbh_dma_start(struct dma_async_tx_descriptor *tx)
+{
+	struct apbh_dma_tx *atx = to_apbh_tx(tx);
+	int i;
+
+	for (i = 0; i < atx->num_desc; i++)
+		mxs_dma_desc_append(tx->chan->chan_id, atx->desc[i]);
+
+	mxs_dma_start(tx->chan->chan_id);
+}
+
+static int apbh_dma_submit(struct dma_async_tx_descriptor *tx)
+{
+	/* the core has queued @tx already, start it if it is the only one */
+	if (list_is_singular(&tx->chan->active))
+		apbh_dma_start(tx);
+
+	return 0;
+}
+
+static void apbh_dma_poll(struct dma_chan *chan)
+{
+	struct dma_async_tx_descriptor *tx;
+
+	tx = list_first_entry(&chan->active, struct dma_async_tx_descriptor,
+			node);
+
+	if (!mxs_dma_done(chan->chan_id))
+		return;
+
+	mxs_dma_stop(chan->chan_id);
+	dma_cookie_complete(chan, tx->cookie, DMA_COMPLETE);
+
+	if (!list_is_last(&tx->node, &chan->active))
+		apbh_dma_start(list_entry(tx->node.next,
+				struct dma_async_tx_descriptor, node));
+}
+
+static void apbh_dma_terminate_all(struct dma_chan *chan)
+{
+	mxs_dma_reset(chan->chan_id);
+	mxs_dma_stop(chan->chan_id);
+}
+
+static struct dma_device apbh_dma = {
+	.name = "apbh-dma",
+	.chans = apbh_dma_chans,
+	.num_chans = MXS_MAX_DMA_CHANNELS,
+	.caps = 1 << DMA_SLAVE,
+	.prep_slave_sg = apbh_dma_prep_slave_sg,
+	.submit = apbh_dma_submit,
+	.poll = apbh_dma_poll,
+	.terminate_all = apbh_dma_terminate_all,
+	.free_desc = apbh_dma_free_desc,
+};
+
+static int mxs_dma_filter(struct dma_chan *chan, void *param)
+{
+	return chan->chan_id == *(int *)param;
+}
+
+/*
+ * Claim a channel for a driver which uses the mxs_dma_* functions directly
+ * so that the DMA engine does not hand it out to someone else.
+ */
+int mxs_dma_request_chan(int channel)
+{
+	if (!mxs_dma_initialized)
+		return -ENODEV;
+
+	if (!dma_request_channel(DMA_SLAVE, mxs_dma_filter, &channel))
+		return -EBUSY;
+
+	return 0;
+}
+
 /*
  * Initialize the DMA hardware
  */
@@ -555,6 +735,10 @@ int mxs_dma_init(void)
 	int ret, channel;
 	u32 val, reg;
 
+	/* shared by the NAND and SPI drivers */
+	if (mxs_dma_initialized)
+		return 0;
+
 	ret = mxs_reset_block(apbh_regs, 0);
 	if (ret)
 		return ret;
@@ -591,6 +775,12 @@ int mxs_dma_init(void)
 		mxs_dma_ack_irq(channel);
 	}
 
+	ret = dma_device_register(&apbh_dma);
+	if (ret)
+		goto err;
+
+	mxs_dma_initialized = true;
+
 	return 0;
 
 err:
@@ -0,0 +1,104 @@
+/*
+ * dma-soft.c - DMA engine which copies with the CPU
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Memory to memory transfers are done in slices from the poll function,
+ * so a transfer makes progress in the background like it would on a real
+ * engine. Useful to test the DMA engine users on boards without one.
+ */
+#include <common.h>
+#include <dmaengine.h>
+#include <malloc.h>
+#include <init.h>
+#include <sizes.h>
+
+#define DMA_SOFT_CHANNELS	2
+#define DMA_SOFT_SLICE		SZ_1M
+
+struct dma_soft_desc {
+	struct dma_async_tx_descriptor tx;
+	char *dst;
+	const char *src;
+	size_t len;
+	size_t done;
+};
+
+static struct dma_chan dma_soft_chans[DMA_SOFT_CHANNELS];
+
+static inline struct dma_soft_desc *to_soft_desc(
+		struct dma_async_tx_descriptor *tx)
+{
+	return container_of(tx, struct dma_soft_desc, tx);
+}
+
+static struct dma_async_tx_descriptor *dma_soft_prep_memcpy(
+		struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		size_t len)
+{
+	struct dma_soft_desc *desc = xzalloc(sizeof(*desc));
+
+	desc->tx.chan = chan;
+	desc->dst = (char *)dst;
+	desc->src = (const char *)src;
+	desc->len = len;
+
+	return &desc->tx;
+}
+
+static int dma_soft_submit(struct dma_async_tx_descriptor *tx)
+{
+	/* the copy starts with the next poll */
+	return 0;
+}
+
+static void dma_soft_poll(struct dma_chan *chan)
+{
+	struct dma_soft_desc *desc;
+	size_t now;
+
+	if (list_empty(&chan->active))
+		return;
+
+	desc = to_soft_desc(list_first_entry(&chan->active,
+			struct dma_async_tx_descriptor, node));
+
+	now = min_t(size_t, desc->len - desc->done, DMA_SOFT_SLICE);
+	memcpy(desc->dst + desc->done, desc->src + desc->done, now);
+	desc->done += now;
+
+	if (desc->done == desc->len)
+		dma_cookie_complete(chan, desc->tx.cookie, DMA_COMPLETE);
+}
+
+static void dma_soft_free_desc(struct dma_async_tx_descriptor *tx)
+{
+	free(to_soft_desc(tx));
+}
+
+static struct dma_device dma_soft = {
+	.name = "dma-soft",
+	.chans = dma_soft_chans,
+	.num_chans = DMA_SOFT_CHANNELS,
+	.caps = 1 << DMA_MEMCPY,
+	.prep_memcpy = dma_soft_prep_memcpy,
+	.submit = dma_soft_submit,
+	.poll = dma_soft_poll,
+	.free_desc = dma_soft_free_desc,
+};
+
+/* late, so that hardware engines are preferred by dma_request_channel() */
+static int dma_soft_init(void)
+{
+	return dma_device_register(&dma_soft);
+}
+late_initcall(dma_soft_init);
@@ -0,0 +1,373 @@
+/*
+ * dmaengine.c - DMA engine core
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Channels are handed out with dma_request_channel() and stay with their
+ * user until released. Submitted descriptors are kept on the channel's
+ * active list in submission order. The driver reports progress by moving
+ * the channel's completed cookie forward from its poll() function, the
+ * core then retires all descriptors up to that cookie, runs their
+ * callbacks and gives them back to the driver.
+ *
+ * Retiring happens when a user asks for the status of a transfer and from
+ * a poller, so callbacks of background transfers run while barebox waits
+ * for console input or in any other is_timeout() loop.
+ */
+#include <common.h>
+#include <dmaengine.h>
+#include <errno.h>
+#include <clock.h>
+#include <poller.h>
+#include <sizes.h>
+
+#ifdef CONFIG_ARM
+#include <asm/mmu.h>
+#else
+static inline void dma_clean_range(unsigned long s, unsigned long e)
+{
+}
+
+static inline void dma_flush_range(unsigned long s, unsigned long e)
+{
+}
+
+static inline void dma_inv_range(unsigned long s, unsigned long e)
+{
+}
+#endif
+
+/* below this size the setup costs more than the CPU needs for the copy */
+#define DMA_MEMCPY_MIN		SZ_4K
+
+static LIST_HEAD(dma_device_list);
+
+static inline int dma_cookie_done(struct dma_chan *chan, dma_cookie_t cookie)
+{
+	return cookie - chan->completed_cookie <= 0;
+}
+
+static void dma_chan_retire(struct dma_chan *chan)
+{
+	struct dma_device *dma = chan->device;
+	struct dma_async_tx_descriptor *tx, *tmp;
+	enum dma_status status;
+
+	if (list_empty(&chan->active))
+		return;
+
+	dma->poll(chan);
+
+	list_for_each_entry_safe(tx, tmp, &chan->active, node) {
+		if (!dma_cookie_done(chan, tx->cookie))
+			break;
+
+		status = tx->cookie == chan->completed_cookie ?
+			chan->status : DMA_COMPLETE;
+
+		list_del(&tx->node);
+
+		if (tx->callback)
+			tx->callback(tx->callback_param, status);
+
+		if (dma->free_desc)
+			dma->free_desc(tx);
+	}
+}
+
+static void dma_poll(struct poller_struct *poller)
+{
+	struct dma_device *dma;
+	int i;
+
+	list_for_each_entry(dma, &dma_device_list, list)
+		for (i = 0; i < dma->num_chans; i++)
+			dma_chan_retire(&dma->chans[i]);
+}
+
+static struct poller_struct dma_poller = {
+	.func = dma_poll,
+};
+
+int dma_device_register(struct dma_device *dma)
+{
+	static int poller_registered;
+	struct dma_chan *chan;
+	int i;
+
+	if (!dma->submit || !dma->poll || !dma->num_chans)
+		return -EINVAL;
+
+	for (i = 0; i < dma->num_chans; i++) {
+		chan = &dma->chans[i];
+		chan->device = dma;
+		chan->chan_id = i;
+		chan->in_use = 0;
+		chan->cookie = 0;
+		chan->completed_cookie = 0;
+		chan->status = DMA_COMPLETE;
+		INIT_LIST_HEAD(&chan->active);
+	}
+
+	list_add_tail(&dma->list, &dma_device_list);
+
+	if (!poller_registered) {
+		poller_register(&dma_poller);
+		poller_registered = 1;
+	}
+
+	pr_debug("%s: %d channels\n", dma->name, dma->num_chans);
+
+	return 0;
+}
+EXPORT_SYMBOL(dma_device_register);
+
+void dma_device_unregister(struct dma_device *dma)
+{
+	int i;
+
+	for (i = 0; i < dma->num_chans; i++)
+		dmaengine_terminate_all(&dma->chans[i]);
+
+	list_del(&dma->list);
+}
+EXPORT_SYMBOL(dma_device_unregister);
+
+/*
+ * Get a free channel of a device which can do @cap. @filter, if given,
+ * decides whether a channel is suitable, drivers with dedicated channels
+ * per peripheral use it to select one by number.
+ */
+struct dma_chan *dma_request_channel(enum dma_transaction_type cap,
+		dma_filter_fn filter, void *param)
+{
+	struct dma_device *dma;
+	struct dma_chan *chan;
+	int i;
+
+	list_for_each_entry(dma, &dma_device_list, list) {
+		if (!(dma->caps & (1 << cap)))
+			continue;
+
+		for (i = 0; i < dma->num_chans; i++) {
+			chan = &dma->chans[i];
+
+			if (chan->in_use)
+				continue;
+			if (filter && !filter(chan, param))
+				continue;
+
+			chan->in_use = 1;
+			return chan;
+		}
+	}
+
+	return NULL;
+}
+EXPORT_SYMBOL(dma_request_channel);
+
+void dma_release_channel(struct dma_chan *chan)
+{
+	dmaengine_terminate_all(chan);
+	chan->in_use = 0;
+}
+EXPORT_SYMBOL(dma_release_channel);
+
+struct dma_async_tx_descriptor *dmaengine_prep_dma_memcpy(
+		struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		size_t len)
+{
+	struct dma_device *dma = chan->device;
+
+	if (!dma->prep_memcpy)
+		return NULL;
+
+	return dma->prep_memcpy(chan, dst, src, len);
+}
+EXPORT_SYMBOL(dmaengine_prep_dma_memcpy);
+
+struct dma_async_tx_descriptor *dmaengine_prep_slave_sg(
+		struct dma_chan *chan, struct dma_sg *sg, int sg_len,
+		enum dma_transfer_direction dir)
+{
+	struct dma_device *dma = chan->device;
+
+	if (!dma->prep_slave_sg)
+		return NULL;
+
+	return dma->prep_slave_sg(chan, sg, sg_len, dir);
+}
+EXPORT_SYMBOL(dmaengine_prep_slave_sg);
+
+/*
+ * Queue @tx on its channel and start it if the channel is idle. Returns
+ * the cookie to wait for or a negative error code, in which case the
+ * descriptor still belongs to the caller.
+ */
+dma_cookie_t dmaengine_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct dma_chan *chan = tx->chan;
+	dma_cookie_t cookie;
+	int ret;
+
+	cookie = chan->cookie + 1;
+	if (cookie <= 0)
+		cookie = 1;
+
+	tx->cookie = cookie;
+	list_add_tail(&tx->node, &chan->active);
+
+	ret = chan->device->submit(tx);
+	if (ret) {
+		list_del(&tx->node);
+		return ret;
+	}
+
+	chan->cookie = cookie;
+
+	return cookie;
+}
+EXPORT_SYMBOL(dmaengine_submit);
+
+enum dma_status dma_async_is_tx_complete(struct dma_chan *chan,
+		dma_cookie_t cookie)
+{
+	dma_chan_retire(chan);
+
+	if (!dma_cookie_done(chan, cookie))
+		return DMA_IN_PROGRESS;
+
+	return cookie == chan->completed_cookie ? chan->status : DMA_COMPLETE;
+}
+EXPORT_SYMBOL(dma_async_is_tx_complete);
+
+/*
+ * Wait up to @timeout ns for @cookie to complete. On timeout all transfers
+ * on the channel are aborted.
+ */
+int dma_sync_wait(struct dma_chan *chan, dma_cookie_t cookie, u64 timeout)
+{
+	u64 start = get_time_ns();
+	enum dma_status status;
+
+	while (1) {
+		status = dma_async_is_tx_complete(chan, cookie);
+		if (status == DMA_COMPLETE)
+			return 0;
+		if (status == DMA_ERROR)
+			return -EIO;
+
+		if (is_timeout(start, timeout)) {
+			dmaengine_terminate_all(chan);
+			return -ETIMEDOUT;
+		}
+	}
+}
+EXPORT_SYMBOL(dma_sync_wait);
+
+/*
+ * Stop the channel and complete all its descriptors with DMA_ERROR.
+ */
+void dmaengine_terminate_all(struct dma_chan *chan)
+{
+	struct dma_device *dma = chan->device;
+	struct dma_async_tx_descriptor *tx, *tmp;
+
+	if (list_empty(&chan->active))
+		return;
+
+	if (dma->terminate_all)
+		dma->terminate_all(chan);
+
+	dma_cookie_complete(chan, chan->cookie, DMA_ERROR);
+
+	list_for_each_entry_safe(tx, tmp, &chan->active, node) {
+		list_del(&tx->node);
+
+		if (tx->callback)
+			tx->callback(tx->callback_param, DMA_ERROR);
+
+		if (dma->free_desc)
+			dma->free_desc(tx);
+	}
+}
+EXPORT_SYMBOL(dmaengine_terminate_all);
+
+static int dma_memcpy_offload(struct dma_chan *chan, void *dst,
+		const void *src, size_t len)
+{
+	struct dma_async_tx_descriptor *tx;
+	unsigned long d = (unsigned long)dst, s = (unsigned long)src;
+	dma_cookie_t cookie;
+	int ret;
+
+	dma_clean_range(s, s + len);
+	dma_flush_range(d, d + len);
+
+	tx = dmaengine_prep_dma_memcpy(chan, d, s, len);
+	if (!tx)
+		return -ENOMEM;
+
+	cookie = dmaengine_submit(tx);
+	if (cookie < 0) {
+		if (chan->device->free_desc)
+			chan->device->free_desc(tx);
+		return cookie;
+	}
+
+	/* allow for at least 16 MiB/s */
+	ret = dma_sync_wait(chan, cookie, SECOND * (1 + (len >> 24)));
+
+	dma_inv_range(d, d + len);
+
+	return ret;
+}
+
+/*
+ * memcpy() which hands the bulk of large copies to a DMA_MEMCPY channel,
+ * if there is one. Unaligned head and tail bytes, small copies and copies
+ * whose source and destination cannot be aligned to the engine's
+ * requirements at the same time are done by the CPU, as is everything if
+ * the transfer fails.
+ */
+void *dma_memcpy(void *dst, const void *src, size_t len)
+{
+	static struct dma_chan *chan;
+	size_t align, head, bulk;
+
+	if (len < DMA_MEMCPY_MIN)
+		return memcpy(dst, src, len);
+
+	if (!chan) {
+		chan = dma_request_channel(DMA_MEMCPY, NULL, NULL);
+		if (!chan)
+			return memcpy(dst, src, len);
+	}
+
+	align = chan->device->copy_align ? chan->device->copy_align : 1;
+	head = -(unsigned long)dst & (align - 1);
+
+	if (((unsigned long)src + head) & (align - 1))
+		return memcpy(dst, src, len);
+
+	bulk = (len - head) & ~(align - 1);
+
+	if (dma_memcpy_offload(chan, dst + head, src + head, bulk))
+		return memcpy(dst, src, len);
+
+	/* after the transfer, the invalidate must not discard these bytes */
+	memcpy(dst, src, head);
+	memcpy(dst + head + bulk, src + head + bulk, len - head - bulk);
+
+	return dst;
+}
+EXPORT_SYMBOL(dma_memcpy);
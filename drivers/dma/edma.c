@@ -0,0 +1,228 @@
+/*
+ * edma.c - TI EDMA3 channel controller, memory to memory transfers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * A copy is done in AB-synchronized steps of up to 65535 blocks of 16k,
+ * each started with a manual event. The transfer completion code of the
+ * channel is the channel number, the next step is programmed from the
+ * poll function when its bit shows up in the interrupt pending register.
+ * Only the first channels are used, they are triggered manually so the
+ * peripheral events they are tied to do not matter.
+ */
+#include <common.h>
+#include <driver.h>
+#include <init.h>
+#include <malloc.h>
+#include <errno.h>
+#include <io.h>
+#include <sizes.h>
+#include <dmaengine.h>
+
+#define EDMA_DCHMAP(n)		(0x100 + (n) * 4)
+#define EDMA_EMR		0x300
+#define EDMA_EMCR		0x308
+#define EDMA_SECR		0x1040
+#define EDMA_ESR		0x1010
+#define EDMA_IPR		0x1068
+#define EDMA_ICR		0x1070
+
+#define EDMA_PARAM(n)		(0x4000 + (n) * 0x20)
+#define PARAM_OPT		0x00
+#define PARAM_SRC		0x04
+#define PARAM_A_B_CNT		0x08
+#define PARAM_DST		0x0c
+#define PARAM_SRC_DST_BIDX	0x10
+#define PARAM_LINK_BCNTRLD	0x14
+#define PARAM_SRC_DST_CIDX	0x18
+#define PARAM_CCNT		0x1c
+
+#define OPT_SYNCDIM		(1 << 2)	/* AB-synchronized */
+#define OPT_STATIC		(1 << 3)
+#define OPT_TCC(x)		((x) << 12)
+#define OPT_TCINTEN		(1 << 20)
+
+#define EDMA_CHANNELS		4
+#define EDMA_ACNT		SZ_16K
+#define EDMA_BCNT_MAX		0xffff
+
+struct edma_desc {
+	struct dma_async_tx_descriptor tx;
+	dma_addr_t dst;
+	dma_addr_t src;
+	size_t len;
+	size_t done;
+	size_t step;		/* bytes in the running step */
+};
+
+struct edma {
+	void __iomem *base;
+	struct dma_chan chans[EDMA_CHANNELS];
+	struct dma_device dma;
+};
+
+static inline struct edma_desc *to_edma_desc(
+		struct dma_async_tx_descriptor *tx)
+{
+	return container_of(tx, struct edma_desc, tx);
+}
+
+static inline struct edma *to_edma(struct dma_chan *chan)
+{
+	return container_of(chan->device, struct edma, dma);
+}
+
+static struct dma_async_tx_descriptor *edma_prep_memcpy(
+		struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		size_t len)
+{
+	struct edma_desc *desc = xzalloc(sizeof(*desc));
+
+	desc->tx.chan = chan;
+	desc->dst = dst;
+	desc->src = src;
+	desc->len = len;
+
+	return &desc->tx;
+}
+
+static void edma_step(struct edma *edma, struct edma_desc *desc)
+{
+	int ch = desc->tx.chan->chan_id;
+	void __iomem *param = edma->base + EDMA_PARAM(ch);
+	size_t left = desc->len - desc->done;
+	unsigned int acnt, bcnt;
+
+	if (left >= EDMA_ACNT) {
+		acnt = EDMA_ACNT;
+		bcnt = min_t(size_t, left / EDMA_ACNT, EDMA_BCNT_MAX);
+	} else {
+		acnt = left;
+		bcnt = 1;
+	}
+
+	desc->step = acnt * bcnt;
+
+	writel(OPT_SYNCDIM | OPT_STATIC | OPT_TCC(ch) | OPT_TCINTEN,
+			param + PARAM_OPT);
+	writel(desc->src + desc->done, param + PARAM_SRC);
+	writel(acnt | bcnt << 16, param + PARAM_A_B_CNT);
+	writel(desc->dst + desc->done, param + PARAM_DST);
+	writel(acnt | acnt << 16, param + PARAM_SRC_DST_BIDX);
+	writel(0xffff, param + PARAM_LINK_BCNTRLD);
+	writel(0, param + PARAM_SRC_DST_CIDX);
+	writel(1, param + PARAM_CCNT);
+
+	writel(1 << ch, edma->base + EDMA_ICR);
+	writel(1 << ch, edma->base + EDMA_EMCR);
+	writel(1 << ch, edma->base + EDMA_SECR);
+	writel(1 << ch, edma->base + EDMA_ESR);
+}
+
+static int edma_submit(struct dma_async_tx_descriptor *tx)
+{
+	if (list_is_singular(&tx->chan->active))
+		edma_step(to_edma(tx->chan), to_edma_desc(tx));
+
+	return 0;
+}
+
+static void edma_poll(struct dma_chan *chan)
+{
+	struct edma *edma = to_edma(chan);
+	struct dma_async_tx_descriptor *tx;
+	struct edma_desc *desc;
+	u32 bit = 1 << chan->chan_id;
+
+	tx = list_first_entry(&chan->active, struct dma_async_tx_descriptor,
+			node);
+	desc = to_edma_desc(tx);
+
+	if (readl(edma->base + EDMA_EMR) & bit) {
+		dev_err(edma->dma.dev, "channel %d: missed event\n",
+				chan->chan_id);
+		writel(bit, edma->base + EDMA_EMCR);
+		dma_cookie_complete(chan, tx->cookie, DMA_ERROR);
+	} else if (readl(edma->base + EDMA_IPR) & bit) {
+		desc->done += desc->step;
+		if (desc->done < desc->len) {
+			edma_step(edma, desc);
+			return;
+		}
+		writel(bit, edma->base + EDMA_ICR);
+		dma_cookie_complete(chan, tx->cookie, DMA_COMPLETE);
+	} else {
+		return;
+	}
+
+	if (!list_is_last(&tx->node, &chan->active))
+		edma_step(edma, to_edma_desc(list_entry(tx->node.next,
+				struct dma_async_tx_descriptor, node)));
+}
+
+static void edma_terminate_all(struct dma_chan *chan)
+{
+	struct edma *edma = to_edma(chan);
+	u32 bit = 1 << chan->chan_id;
+
+	/* a running step cannot be stopped, but the next one is not started */
+	writel(bit, edma->base + EDMA_SECR);
+	writel(bit, edma->base + EDMA_EMCR);
+	writel(bit, edma->base + EDMA_ICR);
+}
+
+static void edma_free_desc(struct dma_async_tx_descriptor *tx)
+{
+	free(to_edma_desc(tx));
+}
+
+static int edma_probe(struct device_d *dev)
+{
+	struct edma *edma;
+	struct dma_device *dma;
+	int i, ret;
+
+	edma = xzalloc(sizeof(*edma));
+	edma->base = dev_request_mem_region(dev, 0);
+
+	/* use the PaRAM set with the channel's number */
+	for (i = 0; i < EDMA_CHANNELS; i++)
+		writel(EDMA_PARAM(i) - EDMA_PARAM(0),
+				edma->base + EDMA_DCHMAP(i));
+
+	dma = &edma->dma;
+	dma->name = dev_name(dev);
+	dma->dev = dev;
+	dma->chans = edma->chans;
+	dma->num_chans = EDMA_CHANNELS;
+	dma->caps = 1 << DMA_MEMCPY;
+	dma->copy_align = 4;
+	dma->prep_memcpy = edma_prep_memcpy;
+	dma->submit = edma_submit;
+	dma->poll = edma_poll;
+	dma->terminate_all = edma_terminate_all;
+	dma->free_desc = edma_free_desc;
+
+	ret = dma_device_register(dma);
+	if (ret) {
+		free(edma);
+		return ret;
+	}
+
+	return 0;
+}
+
+static struct driver_d edma_driver = {
+	.name	= "ti-edma",
+	.probe	= edma_probe,
+};
+device_platform_driver(edma_driver);
@@ -0,0 +1,327 @@
+/*
+ * pl330.c - ARM PL330 DMA controller, memory to memory transfers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The PL330 runs a small program per channel. For a copy we generate
+ * one which moves bursts of 16 beats of the AXI data width in nested
+ * loops, followed by single beats for the rest, and start it with DMAGO
+ * through the debug interface. Completion is found by polling the
+ * channel status, no events or interrupts are used.
+ */
+#include <common.h>
+#include <driver.h>
+#include <init.h>
+#include <malloc.h>
+#include <errno.h>
+#include <io.h>
+#include <dmaengine.h>
+#include <asm/mmu.h>
+
+#define PL330_FTC(n)		(0x040 + (n) * 4)
+#define PL330_CS(n)		(0x100 + (n) * 8)
+#define PL330_CS_STOPPED	0x0
+#define PL330_CS_FAULTING	0xf
+#define PL330_DBGSTATUS		0xd00
+#define PL330_DBGSTATUS_BUSY	(1 << 0)
+#define PL330_DBGCMD		0xd04
+#define PL330_DBGINST0		0xd08
+#define PL330_DBGINST1		0xd0c
+#define PL330_CR0		0xe00
+#define PL330_CRD		0xe14
+
+/* instructions */
+#define PL330_DMAEND		0x00
+#define PL330_DMAKILL		0x01
+#define PL330_DMALD		0x04
+#define PL330_DMAST		0x08
+#define PL330_DMAWMB		0x13
+#define PL330_DMALP		0x20
+#define PL330_DMALPEND		0x38
+#define PL330_DMAGO		0xa0
+#define PL330_DMAMOV		0xbc
+
+#define PL330_SAR		0
+#define PL330_CCR		1
+#define PL330_DAR		2
+
+#define CCR_SRC_INC		(1 << 0)
+#define CCR_SRC_BSIZE(x)	((x) << 1)
+#define CCR_SRC_BLEN(x)		(((x) - 1) << 4)
+#define CCR_DST_INC		(1 << 14)
+#define CCR_DST_BSIZE(x)	((x) << 15)
+#define CCR_DST_BLEN(x)		(((x) - 1) << 18)
+
+#define PL330_BURST_LEN		16
+/* the longest nested loop, 256 * 256 bursts, and its code size at most */
+#define PL330_LOOP_BURSTS	(256 * 256)
+#define PL330_LOOP_CODE		16
+
+struct pl330_desc {
+	struct dma_async_tx_descriptor tx;
+	u8 *code;
+	size_t code_size;
+};
+
+struct pl330 {
+	void __iomem *base;
+	unsigned int width_shift;	/* log2 of the AXI data width in bytes */
+	struct dma_device dma;
+};
+
+static inline struct pl330_desc *to_pl330_desc(
+		struct dma_async_tx_descriptor *tx)
+{
+	return container_of(tx, struct pl330_desc, tx);
+}
+
+static inline struct pl330 *to_pl330(struct dma_chan *chan)
+{
+	return container_of(chan->device, struct pl330, dma);
+}
+
+static u8 *pl330_mov(u8 *p, int reg, u32 val)
+{
+	*p++ = PL330_DMAMOV;
+	*p++ = reg;
+	*p++ = val;
+	*p++ = val >> 8;
+	*p++ = val >> 16;
+	*p++ = val >> 24;
+
+	return p;
+}
+
+static u8 *pl330_lp(u8 *p, int lc, unsigned int iter)
+{
+	*p++ = PL330_DMALP | (lc << 1);
+	*p++ = iter - 1;
+
+	return p;
+}
+
+static u8 *pl330_lpend(u8 *p, int lc, u8 *start)
+{
+	*p = PL330_DMALPEND | (lc << 2);
+	p[1] = p - start;
+
+	return p + 2;
+}
+
+/* @bursts times load and store, @bursts <= PL330_LOOP_BURSTS */
+static u8 *pl330_copy_loop(u8 *p, unsigned int bursts)
+{
+	u8 *outer, *inner;
+
+	if (bursts >= 256) {
+		p = pl330_lp(p, 0, bursts / 256);
+		outer = p;
+		p = pl330_lp(p, 1, 256);
+		inner = p;
+		*p++ = PL330_DMALD;
+		*p++ = PL330_DMAST;
+		p = pl330_lpend(p, 1, inner);
+		p = pl330_lpend(p, 0, outer);
+		bursts %= 256;
+	}
+
+	if (bursts) {
+		p = pl330_lp(p, 1, bursts);
+		inner = p;
+		*p++ = PL330_DMALD;
+		*p++ = PL330_DMAST;
+		p = pl330_lpend(p, 1, inner);
+	}
+
+	return p;
+}
+
+static struct dma_async_tx_descriptor *pl330_prep_memcpy(
+		struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		size_t len)
+{
+	struct pl330 *pl330 = to_pl330(chan);
+	unsigned int shift = pl330->width_shift;
+	size_t burst = PL330_BURST_LEN << shift;
+	size_t bursts = len / burst;
+	unsigned int beats = (len % burst) >> shift;
+	struct pl330_desc *desc;
+	u32 ccr;
+	u8 *p;
+
+	desc = xzalloc(sizeof(*desc));
+	desc->tx.chan = chan;
+
+	/*
+	 * 3 moves, the loops for the bursts, a move and a loop for the
+	 * single beats, wmb and end
+	 */
+	desc->code_size = 3 * 6 +
+		(bursts / PL330_LOOP_BURSTS + 1) * PL330_LOOP_CODE + 6 + 6 + 2;
+	desc->code = dma_alloc_coherent(desc->code_size);
+	if (!desc->code) {
+		free(desc);
+		return NULL;
+	}
+
+	ccr = CCR_SRC_INC | CCR_DST_INC | CCR_SRC_BSIZE(shift) |
+		CCR_DST_BSIZE(shift);
+
+	p = desc->code;
+	p = pl330_mov(p, PL330_SAR, src);
+	p = pl330_mov(p, PL330_DAR, dst);
+	p = pl330_mov(p, PL330_CCR, ccr | CCR_SRC_BLEN(PL330_BURST_LEN) |
+			CCR_DST_BLEN(PL330_BURST_LEN));
+
+	while (bursts) {
+		unsigned int now = min_t(size_t, bursts, PL330_LOOP_BURSTS);
+
+		p = pl330_copy_loop(p, now);
+		bursts -= now;
+	}
+
+	if (beats) {
+		p = pl330_mov(p, PL330_CCR, ccr | CCR_SRC_BLEN(1) |
+				CCR_DST_BLEN(1));
+		p = pl330_copy_loop(p, beats);
+	}
+
+	*p++ = PL330_DMAWMB;
+	*p++ = PL330_DMAEND;
+
+	return &desc->tx;
+}
+
+static int pl330_dbg_exec(struct pl330 *pl330, u32 inst0, u32 inst1)
+{
+	if (readl(pl330->base + PL330_DBGSTATUS) & PL330_DBGSTATUS_BUSY)
+		return -EBUSY;
+
+	writel(inst0, pl330->base + PL330_DBGINST0);
+	writel(inst1, pl330->base + PL330_DBGINST1);
+	writel(0, pl330->base + PL330_DBGCMD);
+
+	/* wait until executed, so that a started channel is not seen stopped */
+	while (readl(pl330->base + PL330_DBGSTATUS) & PL330_DBGSTATUS_BUSY)
+		;
+
+	return 0;
+}
+
+static int pl330_start(struct dma_async_tx_descriptor *tx)
+{
+	struct pl330_desc *desc = to_pl330_desc(tx);
+	int ch = tx->chan->chan_id;
+
+	/* DMAGO for channel ch, executed by the manager thread */
+	return pl330_dbg_exec(to_pl330(tx->chan),
+			(PL330_DMAGO << 16) | (ch << 24),
+			(u32)desc->code);
+}
+
+static int pl330_submit(struct dma_async_tx_descriptor *tx)
+{
+	if (!list_is_singular(&tx->chan->active))
+		return 0;
+
+	return pl330_start(tx);
+}
+
+static void pl330_terminate_all(struct dma_chan *chan)
+{
+	int ch = chan->chan_id;
+
+	/* DMAKILL, executed by the channel thread */
+	pl330_dbg_exec(to_pl330(chan), (PL330_DMAKILL << 16) | (ch << 8) | 1,
+			0);
+}
+
+static void pl330_poll(struct dma_chan *chan)
+{
+	struct pl330 *pl330 = to_pl330(chan);
+	struct dma_async_tx_descriptor *tx, *next;
+	u32 cs;
+
+	tx = list_first_entry(&chan->active, struct dma_async_tx_descriptor,
+			node);
+
+	cs = readl(pl330->base + PL330_CS(chan->chan_id)) & 0xf;
+
+	if (cs == PL330_CS_FAULTING) {
+		dev_err(pl330->dma.dev, "channel %d fault 0x%08x\n",
+				chan->chan_id,
+				readl(pl330->base + PL330_FTC(chan->chan_id)));
+		pl330_terminate_all(chan);
+		dma_cookie_complete(chan, tx->cookie, DMA_ERROR);
+	} else if (cs == PL330_CS_STOPPED) {
+		dma_cookie_complete(chan, tx->cookie, DMA_COMPLETE);
+	} else {
+		return;
+	}
+
+	if (list_is_last(&tx->node, &chan->active))
+		return;
+
+	next = list_entry(tx->node.next, struct dma_async_tx_descriptor, node);
+	if (pl330_start(next))
+		dma_cookie_complete(chan, next->cookie, DMA_ERROR);
+}
+
+static void pl330_free_desc(struct dma_async_tx_descriptor *tx)
+{
+	struct pl330_desc *desc = to_pl330_desc(tx);
+
+	dma_free_coherent(desc->code, desc->code_size);
+	free(desc);
+}
+
+static int pl330_probe(struct device_d *dev)
+{
+	struct pl330 *pl330;
+	struct dma_device *dma;
+	int ret;
+
+	pl330 = xzalloc(sizeof(*pl330));
+	pl330->base = dev_request_mem_region(dev, 0);
+	pl330->width_shift = readl(pl330->base + PL330_CRD) & 0x7;
+
+	dma = &pl330->dma;
+	dma->name = dev_name(dev);
+	dma->dev = dev;
+	dma->num_chans = ((readl(pl330->base + PL330_CR0) >> 4) & 0x7) + 1;
+	dma->chans = xzalloc(dma->num_chans * sizeof(*dma->chans));
+	dma->caps = 1 << DMA_MEMCPY;
+	dma->copy_align = 1 << pl330->width_shift;
+	dma->prep_memcpy = pl330_prep_memcpy;
+	dma->submit = pl330_submit;
+	dma->poll = pl330_poll;
+	dma->terminate_all = pl330_terminate_all;
+	dma->free_desc = pl330_free_desc;
+
+	ret = dma_device_register(dma);
+	if (ret) {
+		free(dma->chans);
+		free(pl330);
+		return ret;
+	}
+
+	dev_info(dev, "%d channels, %d bit\n", dma->num_chans,
+			8 << pl330->width_shift);
+
+	return 0;
+}
+
+static struct driver_d pl330_driver = {
+	.name	= "pl330",
+	.probe	= pl330_probe,
+};
+device_platform_driver(pl330_driver);
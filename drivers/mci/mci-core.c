@@ -1478,6 +1478,11 @@ static int mci_set_probe(struct device_d *mci_dev, struct param_d *param,
 	return dev_param_set_generic(mci_dev, param, val);
 }
 
+static int mci_detect(struct device_d *mci_dev)
+{
+	return dev_set_param(mci_dev, "probe", "1");
+}
+
 /**
  * Add parameter to the MCI device on demand
  * @param mci_dev MCI device instance
@@ -1514,6 +1519,7 @@ static int mci_probe(struct device_d *mci_dev)
 	mci_dev->priv = mci;
 	mci->mci_dev = mci_dev;
 	mci->host = mci_dev->platform_data;
+	mci_dev->detect = mci_detect;
 
 	dev_info(mci->host->hw_dev, "registered as %s\n", dev_name(mci_dev));
 
@@ -25,6 +25,7 @@
 #include <ioctl.h>
 #include <nand.h>
 #include <errno.h>
+#include <fs.h>
 
 #include "mtd.h"
 
@@ -82,6 +83,26 @@ static ssize_t mtd_op_read(struct cdev *cdev, void* buf, size_t count,
 	return retlen;
 }
 
+static int mtd_op_memmap(struct cdev *cdev, void **map, int flags)
+{
+	struct mtd_info *mtd = cdev->priv;
+	size_t retlen;
+	int ret;
+
+	if (flags & PROT_WRITE)
+		return -EACCES;
+
+	ret = mtd_point(mtd, 0, mtd->size, &retlen, map);
+	if (ret)
+		return ret;
+
+	/* only whole devices can be mapped */
+	if (retlen != mtd->size)
+		return -EINVAL;
+
+	return 0;
+}
+
 #define NOTALIGNED(x) (x & (mtd->writesize - 1)) != 0
 #define MTDPGALG(x) ((x) & ~(mtd->writesize - 1))
 
@@ -268,6 +289,19 @@ int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 	return mtd->write(mtd, to, len, retlen, buf);
 }
 
+int mtd_point(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
+		void **virt)
+{
+	*retlen = 0;
+
+	if (!mtd->point)
+		return -EOPNOTSUPP;
+	if (from < 0 || from > mtd->size || len > mtd->size - from)
+		return -EINVAL;
+
+	return mtd->point(mtd, from, len, retlen, virt);
+}
+
 int mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 {
 	return mtd->erase(mtd, instr);
@@ -282,6 +316,7 @@ static struct file_operations mtd_ops = {
 #endif
 	.ioctl  = mtd_ioctl,
 	.lseek  = dev_lseek_default,
+	.memmap = mtd_op_memmap,
 };
 
 int add_mtd_device(struct mtd_info *mtd, char *devname)
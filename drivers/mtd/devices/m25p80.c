@@ -34,12 +34,18 @@
 #define	OPCODE_WRSR		0x01	/* Write status register 1 byte */
 #define	OPCODE_NORM_READ	0x03	/* Read data bytes (low frequency) */
 #define	OPCODE_FAST_READ	0x0b	/* Read data bytes (high frequency) */
+#define	OPCODE_DUAL_READ	0x3b	/* Read data bytes on 2 wires */
+#define	OPCODE_QUAD_READ	0x6b	/* Read data bytes on 4 wires */
+#define	OPCODE_DUAL_IO_READ	0xbb	/* Read with address on 2 wires */
+#define	OPCODE_QUAD_IO_READ	0xeb	/* Read with address on 4 wires */
 #define	OPCODE_PP		0x02	/* Page program (up to 256 bytes) */
 #define	OPCODE_BE_4K		0x20	/* Erase 4KiB block */
 #define	OPCODE_BE_32K		0x52	/* Erase 32KiB block */
 #define	OPCODE_CHIP_ERASE	0xc7	/* Erase whole flash chip */
 #define	OPCODE_SE		0xd8	/* Sector erase (usually 64KiB) */
 #define	OPCODE_RDID		0x9f	/* Read JEDEC ID */
+#define	OPCODE_RDSFDP		0x5a	/* Read SFDP parameters */
+#define	OPCODE_RDCR		0x35	/* Read configuration register */
 
 /* Used for SST flashes only. */
 #define	OPCODE_BP		0x02	/* Byte program */
@@ -61,12 +67,18 @@
 #define	SR_BP1			8	/* Block protect 1 */
 #define	SR_BP2			0x10	/* Block protect 2 */
 #define	SR_SRWD			0x80	/* SR write protect */
+#define	SR_QUAD_EN_MX		0x40	/* Macronix quad enable */
+
+/* Configuration Register bits. */
+#define	CR_QUAD_EN_SPAN		0x02	/* Spansion/Winbond quad enable */
 
 /* Define max times to check status register before we give up. */
 #define	MAX_READY_WAIT		40	/* M25P16 specs 40s max chip erase */
-#define MAX_CMD_SIZE		6
+#define MAX_DUMMY_SIZE		8
+#define MAX_CMD_SIZE		(5 + MAX_DUMMY_SIZE)
 
 #define JEDEC_MFR(_jedec_id)	((_jedec_id) >> 16)
+#define JEDEC_MFR_WINBOND	0xef
 
 /****************************************************************************/
 
@@ -77,6 +89,18 @@ struct spi_device_id {
 	unsigned long driver_data;
 };
 
+/*
+ * How data is read: the opcode is always sent on one wire, the address
+ * and the dummy bytes on @addr_nbits wires, the data is received on
+ * @data_nbits wires.
+ */
+struct m25p_read_mode {
+	u8			opcode;
+	u8			dummy;
+	u8			addr_nbits;
+	u8			data_nbits;
+};
+
 struct m25p {
 	struct spi_device	*spi;
 	struct mtd_info		mtd;
@@ -85,7 +109,9 @@ struct m25p {
 	u16			addr_width;
 	u8			erase_opcode;
 	u8			erase_opcode_4k;
+	struct m25p_read_mode	read;
 	u8			*command;
+	void __iomem		*mem;
 };
 
 static inline struct m25p *mtd_to_m25p(struct mtd_info *mtd)
@@ -121,6 +147,27 @@ static int read_sr(struct m25p *flash)
 	return val;
 }
 
+/*
+ * Read the configuration register (status register 2 on Winbond).
+ * Returns negative if error occurred.
+ */
+static int read_cr(struct m25p *flash)
+{
+	ssize_t retval;
+	u8 code = OPCODE_RDCR;
+	u8 val;
+
+	retval = spi_write_then_read(flash->spi, &code, 1, &val, 1);
+
+	if (retval < 0) {
+		dev_err(&flash->spi->dev, "error %d reading CR\n",
+				(int) retval);
+		return retval;
+	}
+
+	return val;
+}
+
 /*
  * Write status register 1 byte
  * Returns negative if error occurred.
@@ -240,6 +287,11 @@ static int m25p_cmdsz(struct m25p *flash)
  */
 static int erase_sector(struct m25p *flash, u32 offset, u32 command)
 {
+	struct spi_transfer t[2];
+	struct spi_message wren, m;
+	u8 code = OPCODE_WREN;
+	LIST_HEAD(batch);
+
 	dev_dbg(&flash->spi->dev, "%s %dKiB at 0x%08x\n",
 		__func__, flash->mtd.erasesize / 1024, offset);
 
@@ -247,16 +299,27 @@ static int erase_sector(struct m25p *flash, u32 offset, u32 command)
 	if (wait_till_ready(flash))
 		return -ETIMEDOUT;
 
-	/* Send write enable, then erase commands. */
-	write_enable(flash);
-
 	/* Set up command buffer. */
 	flash->command[0] = command;
 	m25p_addr2cmd(flash, offset, flash->command);
 
-	spi_write(flash->spi, flash->command, m25p_cmdsz(flash));
+	spi_message_init(&wren);
+	spi_message_init(&m);
+	memset(t, 0, (sizeof t));
+
+	t[0].tx_buf = &code;
+	t[0].len = 1;
+	spi_message_add_tail(&t[0], &wren);
 
-	return 0;
+	t[1].tx_buf = flash->command;
+	t[1].len = m25p_cmdsz(flash);
+	spi_message_add_tail(&t[1], &m);
+
+	/* Send write enable, then erase commands. */
+	spi_batch_add_tail(&wren, &batch);
+	spi_batch_add_tail(&m, &batch);
+
+	return spi_sync_batch(flash->spi, &batch);
 }
 
 /****************************************************************************/
@@ -353,124 +416,161 @@ static int m25p80_read(struct mtd_info *mtd, loff_t from, size_t len,
 	size_t *retlen, u_char *buf)
 {
 	struct m25p *flash = mtd_to_m25p(mtd);
-	struct spi_transfer t[2];
+	struct m25p_read_mode *read = &flash->read;
+	struct spi_transfer t[3];
 	struct spi_message m;
-	int fast_read = 0;
+	int cmd_sz = m25p_cmdsz(flash) + read->dummy;
+	int ret;
+
+	if (flash->mem) {
+		if (wait_till_ready(flash))
+			return -ETIMEDOUT;
 
-	if (flash->spi->max_speed_hz >= 25000000)
-		fast_read = 1;
+		memcpy(buf, (void __force *)flash->mem + from, len);
+		*retlen = len;
+
+		return 0;
+	}
 
 	spi_message_init(&m);
 	memset(t, 0, (sizeof t));
 
-	/* NOTE:
-	 * OPCODE_FAST_READ (if available) is faster.
-	 * Should add 1 byte DUMMY_BYTE.
-	 */
-	t[0].tx_buf = flash->command;
-	t[0].len = m25p_cmdsz(flash) + fast_read;
-	spi_message_add_tail(&t[0], &m);
+	if (read->addr_nbits == SPI_NBITS_SINGLE) {
+		t[0].tx_buf = flash->command;
+		t[0].len = cmd_sz;
+		spi_message_add_tail(&t[0], &m);
+	} else {
+		/* The opcode is sent on one wire, the address on more */
+		t[0].tx_buf = flash->command;
+		t[0].len = 1;
+		spi_message_add_tail(&t[0], &m);
+
+		t[1].tx_buf = flash->command + 1;
+		t[1].len = cmd_sz - 1;
+		t[1].tx_nbits = read->addr_nbits;
+		spi_message_add_tail(&t[1], &m);
+	}
 
-	t[1].rx_buf = buf;
-	t[1].len = len;
-	spi_message_add_tail(&t[1], &m);
+	t[2].rx_buf = buf;
+	t[2].len = len;
+	t[2].rx_nbits = read->data_nbits;
+	spi_message_add_tail(&t[2], &m);
 
 	/* Wait till previous write/erase is done. */
 	if (wait_till_ready(flash))
 		return -ETIMEDOUT;
 
-	/* FIXME switch to OPCODE_FAST_READ.  It's required for higher
-	 * clocks; and at this writing, every chip this driver handles
-	 * supports that opcode.
-	 */
-
 	/* Set up the write data buffer. */
-	flash->command[0] = fast_read ? OPCODE_FAST_READ : OPCODE_NORM_READ;
+	flash->command[0] = read->opcode;
 	m25p_addr2cmd(flash, from, flash->command);
+	/* Also clears the mode bits, no continuous read mode */
+	memset(flash->command + m25p_cmdsz(flash), 0, read->dummy);
 
-	spi_sync(flash->spi, &m);
+	ret = spi_sync(flash->spi, &m);
+	if (ret)
+		return ret;
 
-	*retlen = m.actual_length - m25p_cmdsz(flash) - fast_read;
+	*retlen = m.actual_length - cmd_sz;
 
 	return 0;
 }
 
 /*
- * Write an address range to the flash chip.  Data must be written in
- * FLASH_PAGESIZE chunks.  The address range may be any size provided
- * it is within the physical boundaries.
+ * Return a pointer into the mapped flash, for flashes on controllers
+ * which can map them. The pointer can be used until the next write or
+ * erase.
  */
-static int m25p80_write(struct mtd_info *mtd, loff_t to, size_t len,
-	size_t *retlen, const u_char *buf)
+static int m25p80_point(struct mtd_info *mtd, loff_t from, size_t len,
+	size_t *retlen, void **virt)
 {
 	struct m25p *flash = mtd_to_m25p(mtd);
-	u32 page_offset, page_size;
-	struct spi_transfer t[2];
-	struct spi_message m;
 
-	dev_dbg(&flash->spi->dev, "m25p80_write %ld bytes at 0x%08llx\n",
-			(unsigned long)len, to);
+	if (wait_till_ready(flash))
+		return -ETIMEDOUT;
+
+	*virt = (void __force *)flash->mem + from;
+	*retlen = len;
+
+	return 0;
+}
 
+/*
+ * Program up to one page. Write enable and the program command are sent
+ * as one batch, so controllers which can chain messages do not return to
+ * the CPU in between.
+ */
+static int m25p_page_program(struct m25p *flash, u32 to, const u_char *buf,
+	size_t len, size_t *retlen)
+{
+	struct spi_transfer t[3];
+	struct spi_message wren, m;
+	u8 code = OPCODE_WREN;
+	LIST_HEAD(batch);
+	int ret;
+
+	spi_message_init(&wren);
 	spi_message_init(&m);
 	memset(t, 0, (sizeof t));
 
-	t[0].tx_buf = flash->command;
-	t[0].len = m25p_cmdsz(flash);
-	spi_message_add_tail(&t[0], &m);
+	t[0].tx_buf = &code;
+	t[0].len = 1;
+	spi_message_add_tail(&t[0], &wren);
 
-	t[1].tx_buf = buf;
+	t[1].tx_buf = flash->command;
+	t[1].len = m25p_cmdsz(flash);
 	spi_message_add_tail(&t[1], &m);
 
-	/* Wait until finished previous write command. */
-	if (wait_till_ready(flash))
-		return -ETIMEDOUT;
-
-	write_enable(flash);
+	t[2].tx_buf = buf;
+	t[2].len = len;
+	spi_message_add_tail(&t[2], &m);
 
-	/* Set up the opcode in the write buffer. */
 	flash->command[0] = OPCODE_PP;
 	m25p_addr2cmd(flash, to, flash->command);
 
-	page_offset = to & (flash->page_size - 1);
-
-	/* do all the bytes fit onto one page? */
-	if (page_offset + len <= flash->page_size) {
-		t[1].len = len;
-
-		spi_sync(flash->spi, &m);
-
-		*retlen = m.actual_length - m25p_cmdsz(flash);
-	} else {
-		u32 i;
-
-		/* the size of data remaining on the first page */
-		page_size = flash->page_size - page_offset;
+	spi_batch_add_tail(&wren, &batch);
+	spi_batch_add_tail(&m, &batch);
 
-		t[1].len = page_size;
-		spi_sync(flash->spi, &m);
+	ret = spi_sync_batch(flash->spi, &batch);
+	if (ret)
+		return ret;
 
-		*retlen = m.actual_length - m25p_cmdsz(flash);
+	*retlen += m.actual_length - m25p_cmdsz(flash);
 
-		/* write everything in flash->page_size chunks */
-		for (i = page_size; i < len; i += page_size) {
-			page_size = len - i;
-			if (page_size > flash->page_size)
-				page_size = flash->page_size;
+	return 0;
+}
 
-			/* write the next page to flash */
-			m25p_addr2cmd(flash, to + i, flash->command);
+/*
+ * Write an address range to the flash chip.  Data must be written in
+ * FLASH_PAGESIZE chunks.  The address range may be any size provided
+ * it is within the physical boundaries.
+ */
+static int m25p80_write(struct mtd_info *mtd, loff_t to, size_t len,
+	size_t *retlen, const u_char *buf)
+{
+	struct m25p *flash = mtd_to_m25p(mtd);
+	u32 page_offset;
+	size_t i, page_size;
+	int ret;
 
-			t[1].tx_buf = buf + i;
-			t[1].len = page_size;
+	dev_dbg(&flash->spi->dev, "m25p80_write %ld bytes at 0x%08llx\n",
+			(unsigned long)len, to);
 
-			wait_till_ready(flash);
+	*retlen = 0;
 
-			write_enable(flash);
+	for (i = 0; i < len; i += page_size) {
+		/* the first page may be written partially */
+		page_offset = (to + i) & (flash->page_size - 1);
+		page_size = min_t(size_t, len - i,
+				flash->page_size - page_offset);
 
-			spi_sync(flash->spi, &m);
+		/* Wait until finished previous write command. */
+		if (wait_till_ready(flash))
+			return -ETIMEDOUT;
 
-			*retlen += m.actual_length - m25p_cmdsz(flash);
-		}
+		ret = m25p_page_program(flash, to + i, buf + i, page_size,
+				retlen);
+		if (ret)
+			return ret;
 	}
 
 	return 0;
@@ -592,6 +692,7 @@ struct flash_info {
 	u16		flags;
 #define	SECT_4K		0x01		/* OPCODE_BE_4K works uniformly */
 #define	M25P_NO_ERASE	0x02		/* No erase command needed */
+#define	M25P_SFDP	0x04		/* Built from SFDP parameters */
 };
 
 #define INFO(_jedec_id, _ext_id, _sector_size, _n_sectors, _flags)	\
@@ -754,7 +855,356 @@ static const struct spi_device_id m25p_ids[] = {
 	{ },
 };
 
-static const struct spi_device_id *jedec_probe(struct spi_device *spi)
+/****************************************************************************/
+
+/*
+ * Serial Flash Discoverable Parameters (JESD216)
+ */
+
+#define SFDP_SIGNATURE		0x50444653	/* "SFDP" */
+#define SFDP_BFPT_DWORDS	16		/* Basic Flash Parameter Table */
+
+enum {
+	SFDP_READ_1_1_2,
+	SFDP_READ_1_2_2,
+	SFDP_READ_1_1_4,
+	SFDP_READ_1_4_4,
+	SFDP_READ_MAX,
+};
+
+/* How the quad enable bit is set */
+enum {
+	QE_UNKNOWN,
+	QE_NONE,
+	QE_SR_BIT6,
+	QE_CR_BIT1,
+	QE_UNSUPPORTED,
+};
+
+struct sfdp_header {
+	__le32	signature;
+	u8	minor;
+	u8	major;
+	u8	nph;		/* number of parameter headers - 1 */
+	u8	unused;
+};
+
+struct sfdp_param_header {
+	u8	id_lsb;
+	u8	minor;
+	u8	major;
+	u8	length;		/* in dwords */
+	u8	ptp[3];		/* parameter table pointer */
+	u8	id_msb;
+};
+
+struct m25p_sfdp {
+	u64			size;
+	unsigned		page_size;
+	unsigned		sector_size;
+	u8			sector_opcode;
+	u8			erase_opcode_4k;
+	int			addr4_only;
+	int			quad_enable;
+	struct m25p_read_mode	read[SFDP_READ_MAX];
+
+	/* describe a flash which is not in m25p_ids[] */
+	struct spi_device_id	id;
+	struct flash_info	info;
+};
+
+static int sfdp_read(struct spi_device *spi, u32 addr, void *buf, size_t len)
+{
+	u8 cmd[5];
+
+	/* Always 3 address bytes and 8 dummy cycles */
+	cmd[0] = OPCODE_RDSFDP;
+	cmd[1] = addr >> 16;
+	cmd[2] = addr >> 8;
+	cmd[3] = addr;
+	cmd[4] = 0;
+
+	return spi_write_then_read(spi, cmd, sizeof(cmd), buf, len);
+}
+
+/*
+ * Fast read modes are described by 5 bits of dummy clocks, 3 bits of mode
+ * clocks and the opcode, starting at @shift.
+ */
+static void sfdp_parse_read(struct m25p_read_mode *read, u32 dword, int shift,
+		u8 addr_nbits, u8 data_nbits)
+{
+	unsigned clocks, opcode;
+
+	clocks = ((dword >> shift) & 0x1f) + ((dword >> (shift + 5)) & 0x7);
+	opcode = (dword >> (shift + 8)) & 0xff;
+
+	/* The dummy clocks are sent as bytes on the address wires */
+	if (!opcode || (clocks * addr_nbits) % 8 ||
+	    clocks * addr_nbits / 8 > MAX_DUMMY_SIZE)
+		return;
+
+	read->opcode = opcode;
+	read->dummy = clocks * addr_nbits / 8;
+	read->addr_nbits = addr_nbits;
+	read->data_nbits = data_nbits;
+}
+
+static int m25p_sfdp_parse(struct spi_device *spi, struct m25p_sfdp *sfdp)
+{
+	struct sfdp_header hdr;
+	struct sfdp_param_header phdr;
+	__le32 table[SFDP_BFPT_DWORDS];
+	u32 dw[SFDP_BFPT_DWORDS + 1];
+	int i, ret, len;
+
+	ret = sfdp_read(spi, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+
+	if (le32_to_cpu(hdr.signature) != SFDP_SIGNATURE || hdr.major != 1)
+		return -ENODEV;
+
+	/* The first parameter header is the mandatory basic table */
+	ret = sfdp_read(spi, sizeof(hdr), &phdr, sizeof(phdr));
+	if (ret)
+		return ret;
+
+	if (phdr.id_lsb != 0 || phdr.major != 1 || phdr.length < 9)
+		return -ENODEV;
+
+	len = min_t(int, phdr.length, SFDP_BFPT_DWORDS);
+	memset(table, 0, sizeof(table));
+	ret = sfdp_read(spi, phdr.ptp[2] << 16 | phdr.ptp[1] << 8 | phdr.ptp[0],
+			table, len * 4);
+	if (ret)
+		return ret;
+
+	/* Count the dwords from 1 like JESD216 does */
+	for (i = 0; i < SFDP_BFPT_DWORDS; i++)
+		dw[i + 1] = le32_to_cpu(table[i]);
+
+	memset(sfdp, 0, sizeof(*sfdp));
+
+	/* Density in bits */
+	if (dw[2] & 0x80000000) {
+		i = dw[2] & 0x7fffffff;
+		if (i < 3 || i > 35)
+			return -EINVAL;
+		sfdp->size = 1ULL << (i - 3);
+	} else {
+		sfdp->size = ((u64)dw[2] + 1) >> 3;
+	}
+
+	/* Address bytes: 3 only, 3 or 4, 4 only */
+	if (((dw[1] >> 17) & 0x3) == 2)
+		sfdp->addr4_only = 1;
+
+	if ((dw[1] & 0x3) == 1)
+		sfdp->erase_opcode_4k = (dw[1] >> 8) & 0xff;
+
+	/* Use the largest of the four erase types for sectors */
+	for (i = 0; i < 4; i++) {
+		u32 type = dw[8 + i / 2] >> (16 * (i % 2));
+		unsigned shift = type & 0xff;
+
+		if (!shift || shift > 30)
+			continue;
+
+		if ((1 << shift) > sfdp->sector_size) {
+			sfdp->sector_size = 1 << shift;
+			sfdp->sector_opcode = (type >> 8) & 0xff;
+		}
+	}
+
+	if (!sfdp->sector_size || sfdp->size < sfdp->sector_size)
+		return -EINVAL;
+
+	if (dw[1] & (1 << 16))
+		sfdp_parse_read(&sfdp->read[SFDP_READ_1_1_2], dw[4], 0, 1, 2);
+	if (dw[1] & (1 << 20))
+		sfdp_parse_read(&sfdp->read[SFDP_READ_1_2_2], dw[4], 16, 2, 2);
+	if (dw[1] & (1 << 22))
+		sfdp_parse_read(&sfdp->read[SFDP_READ_1_1_4], dw[3], 16, 1, 4);
+	if (dw[1] & (1 << 21))
+		sfdp_parse_read(&sfdp->read[SFDP_READ_1_4_4], dw[3], 0, 4, 4);
+
+	/* JESD216A and later have the page size and quad enable method */
+	sfdp->page_size = 256;
+	if (len >= 11 && (dw[11] >> 4) & 0xf)
+		sfdp->page_size = 1 << ((dw[11] >> 4) & 0xf);
+
+	sfdp->quad_enable = QE_UNKNOWN;
+	if (len >= 15) {
+		switch ((dw[15] >> 20) & 0x7) {
+		case 0:
+			sfdp->quad_enable = QE_NONE;
+			break;
+		case 1:
+		case 4:
+		case 5:
+			sfdp->quad_enable = QE_CR_BIT1;
+			break;
+		case 2:
+			sfdp->quad_enable = QE_SR_BIT6;
+			break;
+		default:
+			sfdp->quad_enable = QE_UNSUPPORTED;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Set the quad enable bit, without it the chip uses the additional data
+ * lines as write protect and hold inputs.
+ */
+static int m25p_quad_enable(struct m25p *flash, int qe)
+{
+	int sr, cr;
+
+	switch (qe) {
+	case QE_NONE:
+		return 0;
+	case QE_SR_BIT6:
+		sr = read_sr(flash);
+		if (sr < 0)
+			return sr;
+		if (sr & SR_QUAD_EN_MX)
+			return 0;
+
+		write_enable(flash);
+		write_sr(flash, sr | SR_QUAD_EN_MX);
+		if (wait_till_ready(flash))
+			return -ETIMEDOUT;
+
+		sr = read_sr(flash);
+		return sr >= 0 && (sr & SR_QUAD_EN_MX) ? 0 : -EIO;
+	case QE_CR_BIT1:
+		sr = read_sr(flash);
+		if (sr < 0)
+			return sr;
+		cr = read_cr(flash);
+		if (cr < 0)
+			return cr;
+		if (cr & CR_QUAD_EN_SPAN)
+			return 0;
+
+		/* Both registers are written together */
+		write_enable(flash);
+		flash->command[0] = OPCODE_WRSR;
+		flash->command[1] = sr;
+		flash->command[2] = cr | CR_QUAD_EN_SPAN;
+		spi_write(flash->spi, flash->command, 3);
+		if (wait_till_ready(flash))
+			return -ETIMEDOUT;
+
+		cr = read_cr(flash);
+		return cr >= 0 && (cr & CR_QUAD_EN_SPAN) ? 0 : -EIO;
+	default:
+		return -ENOSYS;
+	}
+}
+
+/*
+ * Use the fastest read mode both the flash and the wiring to the
+ * controller support. Without SFDP only the single wire reads are known.
+ */
+static void m25p_set_read_mode(struct m25p *flash, struct m25p_sfdp *sfdp,
+		u32 jedec_id)
+{
+	u16 mode = flash->spi->mode;
+	struct m25p_read_mode *read = NULL;
+	int qe;
+
+	flash->read.addr_nbits = SPI_NBITS_SINGLE;
+	flash->read.data_nbits = SPI_NBITS_SINGLE;
+
+	/* Every flash with SFDP can do fast read, it's needed for high clocks */
+	if (sfdp || flash->spi->max_speed_hz >= 25000000) {
+		flash->read.opcode = OPCODE_FAST_READ;
+		flash->read.dummy = 1;
+	} else {
+		flash->read.opcode = OPCODE_NORM_READ;
+		flash->read.dummy = 0;
+	}
+
+	if (!sfdp)
+		return;
+
+	qe = sfdp->quad_enable;
+	if (qe == QE_UNKNOWN) {
+		switch (JEDEC_MFR(jedec_id)) {
+		case CFI_MFR_MACRONIX:
+			qe = QE_SR_BIT6;
+			break;
+		case CFI_MFR_AMD:
+		case JEDEC_MFR_WINBOND:
+			qe = QE_CR_BIT1;
+			break;
+		case CFI_MFR_ST:
+			qe = QE_NONE;
+			break;
+		default:
+			qe = QE_UNSUPPORTED;
+			break;
+		}
+	}
+
+	if ((mode & SPI_RX_QUAD) && qe != QE_UNSUPPORTED) {
+		if ((mode & SPI_TX_QUAD) && sfdp->read[SFDP_READ_1_4_4].opcode)
+			read = &sfdp->read[SFDP_READ_1_4_4];
+		else if (sfdp->read[SFDP_READ_1_1_4].opcode)
+			read = &sfdp->read[SFDP_READ_1_1_4];
+
+		if (read && m25p_quad_enable(flash, qe)) {
+			dev_warn(&flash->spi->dev, "cannot enable quad mode\n");
+			read = NULL;
+		}
+	}
+
+	if (!read && (mode & (SPI_RX_DUAL | SPI_RX_QUAD))) {
+		if ((mode & (SPI_TX_DUAL | SPI_TX_QUAD)) &&
+		    sfdp->read[SFDP_READ_1_2_2].opcode)
+			read = &sfdp->read[SFDP_READ_1_2_2];
+		else if (sfdp->read[SFDP_READ_1_1_2].opcode)
+			read = &sfdp->read[SFDP_READ_1_1_2];
+	}
+
+	if (read)
+		flash->read = *read;
+}
+
+/*
+ * Describe a flash which is not in m25p_ids[] from its SFDP parameters.
+ * The description is stored in @sfdp, so it is valid as long as @sfdp is.
+ */
+static const struct spi_device_id *sfdp_id(u32 jedec, struct m25p_sfdp *sfdp)
+{
+	struct spi_device_id *id = &sfdp->id;
+	struct flash_info *info = &sfdp->info;
+
+	memset(id, 0, sizeof(*id));
+	memset(info, 0, sizeof(*info));
+
+	snprintf(id->name, SPI_NAME_SIZE, "sfdp-%06x", jedec);
+	id->driver_data = (unsigned long)info;
+
+	info->jedec_id = jedec;
+	info->sector_size = sfdp->sector_size;
+	info->n_sectors = sfdp->size >> (ffs(sfdp->sector_size) - 1);
+	info->page_size = sfdp->page_size;
+	info->flags = M25P_SFDP;
+	if (sfdp->erase_opcode_4k)
+		info->flags |= SECT_4K;
+
+	return id;
+}
+
+static const struct spi_device_id *jedec_probe(struct spi_device *spi,
+		struct m25p_sfdp *sfdp)
 {
 	int			tmp;
 	u8			code = OPCODE_RDID;
@@ -789,15 +1239,19 @@ static const struct spi_device_id *jedec_probe(struct spi_device *spi)
 			return &m25p_ids[tmp];
 		}
 	}
+
+	if (sfdp)
+		return sfdp_id(jedec, sfdp);
+
 	dev_err(&spi->dev, "unrecognized JEDEC id %06x\n", jedec);
 	return ERR_PTR(-ENODEV);
 }
 
 
 /*
- * board specific setup should have ensured the SPI clock used here
- * matches what the READ command supports, at least until this driver
- * understands FAST_READ (for clocks over 25 MHz).
+ * Without SFDP, board specific setup should have ensured the SPI clock
+ * used here matches what the READ command supports; FAST_READ is only
+ * used for clocks over 25 MHz then.
  */
 static int m25p_probe(struct device_d *dev)
 {
@@ -806,8 +1260,11 @@ static int m25p_probe(struct device_d *dev)
 	struct flash_platform_data	*data;
 	struct m25p			*flash;
 	struct flash_info		*info = NULL;
+	struct m25p_sfdp		sfdp;
+	struct spi_flash_map		map;
 	unsigned			i;
 	unsigned			do_jdec_probe = 1;
+	int				has_sfdp = 0;
 
 	/* Platform data helps sort out which chip type we have, as
 	 * well as how this board partitions it.  If we don't have
@@ -839,7 +1296,9 @@ static int m25p_probe(struct device_d *dev)
 	if (do_jdec_probe) {
 		const struct spi_device_id *jid;
 
-		jid = jedec_probe(spi);
+		has_sfdp = !m25p_sfdp_parse(spi, &sfdp);
+
+		jid = jedec_probe(spi, has_sfdp ? &sfdp : NULL);
 		if (IS_ERR(jid)) {
 			return PTR_ERR(jid);
 		} else if (jid != id) {
@@ -904,6 +1363,12 @@ static int m25p_probe(struct device_d *dev)
 		flash->mtd.erasesize = info->sector_size;
 	}
 
+	if (info->flags & M25P_SFDP) {
+		flash->erase_opcode = sfdp.sector_opcode;
+		if (sfdp.erase_opcode_4k)
+			flash->erase_opcode_4k = sfdp.erase_opcode_4k;
+	}
+
 	if (info->flags & M25P_NO_ERASE)
 		flash->mtd.flags |= MTD_NO_ERASE;
 
@@ -917,13 +1382,29 @@ static int m25p_probe(struct device_d *dev)
 		/* enable 4-byte addressing if the device exceeds 16MiB */
 		if (flash->mtd.size > 0x1000000) {
 			flash->addr_width = 4;
-			set_4byte(flash, info->jedec_id, 1);
+			if (!has_sfdp || !sfdp.addr4_only)
+				set_4byte(flash, info->jedec_id, 1);
 		} else
 			flash->addr_width = 3;
 	}
 
-	dev_info(dev, "%s (%lld Kbytes)\n", id->name,
-			(long long)flash->mtd.size >> 10);
+	m25p_set_read_mode(flash, has_sfdp ? &sfdp : NULL, info->jedec_id);
+
+	map.opcode = flash->read.opcode;
+	map.addr_width = flash->addr_width;
+	map.dummy = flash->read.dummy;
+	map.addr_nbits = flash->read.addr_nbits;
+	map.data_nbits = flash->read.data_nbits;
+	map.size = flash->mtd.size;
+
+	flash->mem = spi_flash_map(spi, &map);
+	if (flash->mem)
+		flash->mtd.point = m25p80_point;
+
+	dev_info(dev, "%s (%lld Kbytes), read opcode 0x%02x (1-%d-%d)%s\n",
+			id->name, (long long)flash->mtd.size >> 10,
+			flash->read.opcode, flash->read.addr_nbits,
+			flash->read.data_nbits, flash->mem ? ", mapped" : "");
 
 	dev_dbg(dev, "mtd .name = %s, .size = 0x%llx (%lldMiB) "
 			".erasesize = 0x%.8x (%uKiB) .numeraseregions = %d\n",
@@ -25,6 +25,7 @@
 #include <init.h>
 #include <ioctl.h>
 #include <nand.h>
+#include <linux/mtd/mtd.h>
 #include <linux/mtd/mtd-abi.h>
 #include <fcntl.h>
 #include <libgen.h>
@@ -45,34 +46,100 @@ struct nand_bb {
 	unsigned long flags;
 	void *writebuf;
 
+	/*
+	 * Logical to physical eraseblock map. map[n] is the physical
+	 * block holding the n-th good block. It is rebuilt whenever the
+	 * bad block count of the underlying mtd device changes.
+	 */
+	uint32_t *map;
+	int num_blocks;
+	int erase_shift;
+	uint32_t badblocks;
+
 	struct cdev cdev;
 
 	struct list_head list;
 };
 
+static int nand_bb_build_map(struct nand_bb *bb)
+{
+	int block, num_raw = bb->raw_size >> bb->erase_shift;
+	loff_t pos;
+	int ret;
+
+	if (!bb->map)
+		bb->map = xmalloc(num_raw * sizeof(*bb->map));
+
+	bb->num_blocks = 0;
+
+	for (block = 0; block < num_raw; block++) {
+		pos = (loff_t)block << bb->erase_shift;
+		ret = cdev_ioctl(bb->cdev_parent, MEMGETBADBLOCK, &pos);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			bb->map[bb->num_blocks++] = block;
+	}
+
+	if (bb->info.mtd)
+		bb->badblocks = bb->info.mtd->ecc_stats.badblocks;
+
+	bb->cdev.size = (loff_t)bb->num_blocks << bb->erase_shift;
+
+	return 0;
+}
+
+static int nand_bb_update_map(struct nand_bb *bb)
+{
+	if (bb->info.mtd &&
+			bb->info.mtd->ecc_stats.badblocks != bb->badblocks)
+		return nand_bb_build_map(bb);
+
+	return 0;
+}
+
+/*
+ * Translate a logical offset into a physical offset on the parent
+ * device. Returns -ENOSPC when the offset is behind the last good block.
+ */
+static int nand_bb_phys(struct nand_bb *bb, loff_t offset, loff_t *phys)
+{
+	unsigned long block = offset >> bb->erase_shift;
+	int ret;
+
+	ret = nand_bb_update_map(bb);
+	if (ret)
+		return ret;
+
+	if (block >= bb->num_blocks)
+		return -ENOSPC;
+
+	*phys = ((loff_t)bb->map[block] << bb->erase_shift) +
+		(offset & (bb->info.erasesize - 1));
+
+	return 0;
+}
+
 static ssize_t nand_bb_read(struct cdev *cdev, void *buf, size_t count,
 	loff_t offset, ulong flags)
 {
 	struct nand_bb *bb = cdev->priv;
 	struct cdev *parent = bb->cdev_parent;
 	int ret, bytes = 0, now;
+	loff_t phys;
 
 	debug("%s 0x%08llx %d\n", __func__, offset, count);
 
 	while(count) {
-		ret = cdev_ioctl(parent, MEMGETBADBLOCK, &bb->offset);
-		if (ret < 0)
+		ret = nand_bb_phys(bb, bb->offset, &phys);
+		if (ret == -ENOSPC)
+			break;
+		if (ret)
 			return ret;
 
-		if (ret) {
-			printf("skipping bad block at 0x%08llx\n", bb->offset);
-			bb->offset += bb->info.erasesize;
-			continue;
-		}
-
 		now = min(count, (size_t)(bb->info.erasesize -
-				((size_t)bb->offset % bb->info.erasesize)));
-		ret = cdev_read(parent, buf, now, bb->offset, 0);
+				((size_t)phys & (bb->info.erasesize - 1))));
+		ret = cdev_read(parent, buf, now, phys, 0);
 		if (ret < 0)
 			return ret;
 		buf += now;
@@ -90,31 +157,16 @@ static ssize_t nand_bb_read(struct cdev *cdev, void *buf, size_t count,
 #ifdef CONFIG_MTD_WRITE
 static int nand_bb_write_buf(struct nand_bb *bb, size_t count)
 {
-	int ret, now;
-	struct cdev *parent = bb->cdev_parent;
-	void *buf = bb->writebuf;
-	loff_t cur_ofs = bb->offset & ~(BB_WRITEBUF_SIZE - 1);
-
-	while (count) {
-		ret = cdev_ioctl(parent, MEMGETBADBLOCK, &cur_ofs);
-		if (ret < 0)
-			return ret;
+	loff_t phys;
+	int ret;
 
-		if (ret) {
-			debug("skipping bad block at 0x%08llx\n", cur_ofs);
-			bb->offset += bb->info.erasesize;
-			cur_ofs += bb->info.erasesize;
-			continue;
-		}
+	ret = nand_bb_phys(bb, bb->offset & ~(BB_WRITEBUF_SIZE - 1), &phys);
+	if (ret)
+		return ret;
 
-		now = min(count, (size_t)(bb->info.erasesize));
-		ret = cdev_write(parent, buf, now, cur_ofs, 0);
-		if (ret < 0)
-			return ret;
-		buf += now;
-		count -= now;
-		cur_ofs += now;
-	};
+	ret = cdev_write(bb->cdev_parent, bb->writebuf, count, phys, 0);
+	if (ret < 0)
+		return ret;
 
 	return 0;
 }
@@ -165,10 +217,15 @@ static int nand_bb_erase(struct cdev *cdev, size_t count, loff_t offset)
 static int nand_bb_open(struct cdev *cdev, unsigned long flags)
 {
 	struct nand_bb *bb = cdev->priv;
+	int ret;
 
 	if (bb->open)
 		return -EBUSY;
 
+	ret = nand_bb_update_map(bb);
+	if (ret)
+		return ret;
+
 	bb->flags = flags;
 	bb->open = 1;
 	bb->offset = 0;
@@ -192,54 +249,19 @@ static int nand_bb_close(struct cdev *cdev)
 	return 0;
 }
 
-static int nand_bb_calc_size(struct nand_bb *bb)
-{
-	loff_t pos = 0;
-	int ret;
-
-	while (pos < bb->raw_size) {
-		ret = cdev_ioctl(bb->cdev_parent, MEMGETBADBLOCK, &pos);
-		if (ret < 0)
-			return ret;
-		if (!ret)
-			bb->cdev.size += bb->info.erasesize;
-
-		pos += bb->info.erasesize;
-	}
-
-	return 0;
-}
-
-static loff_t nand_bb_lseek(struct cdev *cdev, loff_t __offset)
+static loff_t nand_bb_lseek(struct cdev *cdev, loff_t offset)
 {
 	struct nand_bb *bb = cdev->priv;
-	loff_t raw_pos = 0;
-	uint32_t offset = __offset;
-	int ret;
 
 	/* lseek only in readonly mode */
 	if (bb->flags & O_ACCMODE)
 		return -ENOSYS;
-	while (raw_pos < bb->raw_size) {
-		off_t now = min(offset, bb->info.erasesize);
-
-		ret = cdev_ioctl(bb->cdev_parent, MEMGETBADBLOCK, &raw_pos);
-		if (ret < 0)
-			return ret;
-		if (!ret) {
-			offset -= now;
-			raw_pos += now;
-		} else {
-			raw_pos += bb->info.erasesize;
-		}
+	if (offset > bb->cdev.size)
+		return -EINVAL;
 
-		if (!offset) {
-			bb->offset = raw_pos;
-			return __offset;
-		}
-	}
+	bb->offset = offset;
 
-	return -EINVAL;
+	return offset;
 }
 
 static struct file_operations nand_bb_ops = {
@@ -287,7 +309,12 @@ int dev_add_bb_dev(char *path, const char *name)
 	if (ret)
 		goto out4;
 
-	nand_bb_calc_size(bb);
+	bb->erase_shift = ffs(bb->info.erasesize) - 1;
+
+	ret = nand_bb_build_map(bb);
+	if (ret)
+		goto out4;
+
 	bb->cdev.ops = &nand_bb_ops;
 	bb->cdev.priv = bb;
 
@@ -300,6 +327,7 @@ int dev_add_bb_dev(char *path, const char *name)
 	return 0;
 
 out4:
+	free(bb->map);
 	cdev_close(bb->cdev_parent);
 out1:
 	free(bb);
@@ -315,6 +343,7 @@ int dev_remove_bb_dev(const char *name)
 			devfs_remove(&bb->cdev);
 			cdev_close(bb->cdev_parent);
 			list_del_init(&bb->list);
+			free(bb->map);
 			free(bb);
 			return 0;
 		}
@@ -158,15 +158,14 @@ static void nand_select_chip(struct mtd_info *mtd, int chipnr)
  * @buf:	buffer to store date
  * @len:	number of bytes to read
  *
- * Default read function for 8bit buswith
+ * Default read function for 8bit buswith. The data register is read
+ * with the architecture's string accessor, which stores whole words.
  */
 static void nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
 {
-	int i;
 	struct nand_chip *chip = mtd->priv;
 
-	for (i = 0; i < len; i++)
-		buf[i] = readb(chip->IO_ADDR_R);
+	readsb(chip->IO_ADDR_R, buf, len);
 }
 
 /**
@@ -198,13 +197,9 @@ static int nand_verify_buf(struct mtd_info *mtd, const uint8_t *buf, int len)
  */
 static void nand_read_buf16(struct mtd_info *mtd, uint8_t *buf, int len)
 {
-	int i;
 	struct nand_chip *chip = mtd->priv;
-	u16 *p = (u16 *) buf;
-	len >>= 1;
 
-	for (i = 0; i < len; i++)
-		p[i] = readw(chip->IO_ADDR_R);
+	readsw(chip->IO_ADDR_R, buf, len >> 1);
 }
 
 /**
@@ -597,6 +592,40 @@ static int nand_read_page_raw(struct mtd_info *mtd, struct nand_chip *chip,
 	return 0;
 }
 
+/**
+ * nand_read_pages_cached - [DEFAULT] read consecutive pages with cache read
+ * @mtd:	mtd info structure
+ * @chip:	nand chip info structure
+ * @buf:	buffer to store read data
+ * @page:	first page to read
+ * @numpages:	number of pages to read, all within one block
+ *
+ * The chip loads the next page into its data register while the current
+ * one is transferred from the cache register, so only the first page has
+ * to wait for the full array read time.
+ */
+static int nand_read_pages_cached(struct mtd_info *mtd, struct nand_chip *chip,
+				  uint8_t *buf, int page, int numpages)
+{
+	int i, ret, err = 0;
+
+	chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+	for (i = 0; i < numpages; i++) {
+		/* The last page must end the cache read sequence */
+		chip->cmdfunc(mtd, i == numpages - 1 ? NAND_CMD_READCACHEEND :
+			      NAND_CMD_READCACHESEQ, -1, -1);
+
+		ret = chip->ecc.read_page(mtd, chip, buf);
+		if (ret < 0 && !err)
+			err = ret;
+
+		buf += mtd->writesize;
+	}
+
+	return err;
+}
+
 /**
  * nand_transfer_oob - [Internal] Transfer oob to client buffer
  * @chip:	nand chip structure
@@ -659,7 +688,7 @@ static uint8_t *nand_transfer_oob(struct nand_chip *chip, uint8_t *oob,
 static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			    struct mtd_oob_ops *ops)
 {
-	int chipnr, page, realpage, col, bytes, aligned;
+	int chipnr, page, realpage, col, bytes, aligned, numpages;
 	struct nand_chip *chip = mtd->priv;
 	struct mtd_ecc_stats stats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
@@ -686,8 +715,26 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
 
-		/* Is the current page in the buffer ? */
-		if (realpage != chip->pagebuf || oob) {
+		/*
+		 * Let the driver read runs of whole pages in one go, up to
+		 * the end of the block.
+		 */
+		numpages = 0;
+		if (chip->read_pages && sndcmd && aligned && !oob &&
+		    ops->mode != MTD_OOB_RAW)
+			numpages = min_t(int, readlen >> chip->page_shift,
+					 blkcheck + 1 - (page & blkcheck));
+
+		if (numpages > 1) {
+			ret = chip->read_pages(mtd, chip, buf, page, numpages);
+			if (ret < 0)
+				break;
+
+			bytes = numpages << chip->page_shift;
+			buf += bytes;
+			realpage += numpages - 1;
+		} else if (realpage != chip->pagebuf || oob) {
+			/* The current page is not in the buffer */
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
 			if (likely(sndcmd)) {
@@ -1062,16 +1109,15 @@ static u16 onfi_crc16(u16 crc, u8 const *p, size_t len)
 }
 
 /*
- * Check if the NAND chip is ONFI compliant, returns 1 if it is, 0 otherwise
+ * Read the ONFI parameter page into chip->onfi_params, returns 1 if a
+ * valid one was found, 0 otherwise
  */
-static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
-					int *busw)
+static int nand_flash_read_onfi_params(struct mtd_info *mtd,
+					struct nand_chip *chip)
 {
 	struct nand_onfi_params *p = &chip->onfi_params;
 	int i;
-	int val;
 
-	/* try ONFI for unknow chip or LP */
 	chip->cmdfunc(mtd, NAND_CMD_READID, 0x20, -1);
 	if (chip->read_byte(mtd) != 'O' || chip->read_byte(mtd) != 'N' ||
 		chip->read_byte(mtd) != 'F' || chip->read_byte(mtd) != 'I')
@@ -1084,14 +1130,27 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 		if (onfi_crc16(ONFI_CRC_BASE, (uint8_t *)p, 254) ==
 				le16_to_cpu(p->crc)) {
 			pr_info("ONFI param page %d valid\n", i);
-			break;
+			return 1;
 		}
 	}
 
-	if (i == 3) {
-		pr_info("no valid ONFI param page found\n");
+	pr_info("no valid ONFI param page found\n");
+
+	return 0;
+}
+
+/*
+ * Check if the NAND chip is ONFI compliant, returns 1 if it is, 0 otherwise
+ */
+static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
+					int *busw)
+{
+	struct nand_onfi_params *p = &chip->onfi_params;
+	int val;
+
+	/* try ONFI for unknow chip or LP */
+	if (!nand_flash_read_onfi_params(mtd, chip))
 		return 0;
-	}
 
 	/* check version */
 	val = le16_to_cpu(p->revision);
@@ -1128,6 +1187,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 	chip->options &= ~NAND_CHIPOPTIONS_MSK;
 	chip->options |= NAND_NO_READRDY & NAND_CHIPOPTIONS_MSK;
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHERD;
+
 	return 1;
 }
 
@@ -1297,6 +1359,15 @@ static struct nand_flash_dev *nand_get_flash_type(struct mtd_info *mtd,
 	if (*maf_id != NAND_MFR_SAMSUNG && !type->pagesize)
 		chip->options &= ~NAND_SAMSUNG_LP_OPTIONS;
 
+	/*
+	 * Large page chips found in the id table may be ONFI compliant
+	 * nonetheless. The table does not tell about the optional commands,
+	 * so ask the parameter page whether cache read is supported.
+	 */
+	if (mtd->writesize > 512 && nand_flash_read_onfi_params(mtd, chip) &&
+	    (le16_to_cpu(chip->onfi_params.opt_cmd) & ONFI_OPT_CMD_READ_CACHE))
+		chip->options |= NAND_CACHERD;
+
 ident_done:
 	/*
 	 * Set chip as a default. Board drivers can override it, if necessary
@@ -1463,6 +1534,14 @@ int nand_scan_tail(struct mtd_info *mtd)
 	/* Set the internal oob buffer location, just after the page data */
 	chip->oob_poi = chip->buffers->databuf + mtd->writesize;
 
+	/*
+	 * Use cache read for runs of pages if the chip has it and the
+	 * commands are sent by the default command function.
+	 */
+	if (!chip->read_pages && NAND_HAS_CACHERD(chip) &&
+	    chip->cmdfunc == nand_command_lp)
+		chip->read_pages = nand_read_pages_cached;
+
 	/*
 	 * If no default placement scheme is given, select an appropriate one
 	 */
@@ -1112,7 +1112,7 @@ int mxs_nand_alloc_buffers(struct mxs_nand_info *nand_info)
 	/* Command buffers */
 	nand_info->cmd_buf = dma_alloc_coherent(MXS_NAND_COMMAND_BUFFER_SIZE);
 	if (!nand_info->cmd_buf) {
-		free(buf);
+		dma_free_coherent(buf, size);
 		printf("MXS NAND: Error allocating command buffers\n");
 		return -ENOMEM;
 	}
@@ -1145,7 +1145,14 @@ int mxs_nand_hw_init(struct mxs_nand_info *info)
 	}
 
 	/* Init the DMA controller. */
-	mxs_dma_init();
+	ret = mxs_dma_init();
+	if (ret)
+		return ret;
+
+	/* the probe scans for a single chip only */
+	ret = mxs_dma_request_chan(MXS_DMA_CHANNEL_AHB_APBH_GPMI0);
+	if (ret)
+		return ret;
 
 	imx_enable_nandclk();
 
@@ -1254,8 +1261,9 @@ static int mxs_nand_probe(struct device_d *dev)
 
 	return add_mtd_nand_device(mtd, "nand");
 err2:
-	free(nand_info->data_buf);
-	free(nand_info->cmd_buf);
+	dma_free_coherent(nand_info->data_buf,
+			NAND_MAX_PAGESIZE + NAND_MAX_OOBSIZE);
+	dma_free_coherent(nand_info->cmd_buf, MXS_NAND_COMMAND_BUFFER_SIZE);
 err1:
 	free(nand_info);
 	return err;
@@ -0,0 +1,677 @@
+/*
+ * nand_sandbox.c - simulated NAND chip for the sandbox
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The chip is simulated at the level of the command, address and data
+ * cycles, so the generic NAND code runs unmodified on it, including the
+ * ONFI detection and cache reads. The contents are kept in a file on the
+ * host, each page followed by its OOB area.
+ *
+ * Operations take as long as the chip is configured to need: the ready
+ * line and the ready bit in the status are cleared for tR, tPROG or tBERS
+ * and each byte transferred over the bus takes tC.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <malloc.h>
+#include <init.h>
+#include <errno.h>
+#include <clock.h>
+#include <xfuncs.h>
+#include <linux/log2.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/nand.h>
+#include <mach/linux.h>
+#include <mach/hostfile.h>
+
+#define SIM_BLK_BAD	(1 << 0)	/* factory bad, marked in the OOB */
+#define SIM_BLK_FAIL	(1 << 1)	/* program and erase fail */
+
+struct sandbox_nand {
+	struct mtd_info		mtd;
+	struct nand_chip	nand;
+	struct device_d		*dev;
+	struct hf_platform_data	*hf;
+	char			*args;
+
+	/* geometry */
+	unsigned int		pagesize;
+	unsigned int		oobsize;
+	unsigned int		pages;		/* per block */
+	unsigned int		blocks;
+	unsigned int		rawsize;	/* page + oob in the file */
+	int			row_cycles;
+	u8			*blkstate;
+
+	/* timing in us, tc in ns per byte */
+	unsigned long		tr, tprog, tbers, tc;
+
+	struct nand_ecclayout	layout;
+
+	/* interface state */
+	int			cmd;
+	u8			addr[5];
+	int			naddr;
+	const u8		*out;
+	unsigned int		outlen;
+	unsigned int		pos;
+	u8			status;
+	uint64_t		busy_until;
+
+	u8			id[8];
+	u8			*param;		/* three copies */
+	u8			*reg;		/* data register */
+	u8			*cache;		/* cache register */
+	u8			*tmp;
+	int			reg_page;	/* page in the data register */
+	uint64_t		reg_ready;	/* when it has been read */
+	int			prog_page;
+};
+
+static inline struct sandbox_nand *mtd_to_sim(struct mtd_info *mtd)
+{
+	return container_of(mtd, struct sandbox_nand, mtd);
+}
+
+static inline loff_t sim_page_offset(struct sandbox_nand *sim, int page)
+{
+	return (loff_t)page * sim->rawsize;
+}
+
+static inline int sim_addr_column(struct sandbox_nand *sim)
+{
+	return sim->addr[0] | sim->addr[1] << 8;
+}
+
+static int sim_addr_page(struct sandbox_nand *sim, int first)
+{
+	int i, page = 0;
+
+	for (i = 0; i < sim->row_cycles; i++)
+		page |= sim->addr[first + i] << (8 * i);
+
+	return page & (sim->pages * sim->blocks - 1);
+}
+
+static void sim_busy(struct sandbox_nand *sim, uint64_t from, unsigned long us)
+{
+	sim->busy_until = from + us * USECOND;
+}
+
+static int sim_ready(struct sandbox_nand *sim)
+{
+	return get_time_ns() >= sim->busy_until;
+}
+
+static void sim_load_page(struct sandbox_nand *sim, int page)
+{
+	if (linux_pread(sim->hf->fd, sim->reg, sim->rawsize,
+			sim_page_offset(sim, page)) != sim->rawsize)
+		memset(sim->reg, 0xff, sim->rawsize);
+
+	if (sim->blkstate[page / sim->pages] & SIM_BLK_BAD) {
+		sim->reg[sim->pagesize] = 0x00;
+		sim->reg[sim->pagesize + 1] = 0x00;
+	}
+
+	sim->reg_page = page;
+}
+
+static void sim_output(struct sandbox_nand *sim, const u8 *buf,
+		unsigned int len, unsigned int pos)
+{
+	sim->out = buf;
+	sim->outlen = len;
+	sim->pos = pos;
+}
+
+static void sim_program(struct sandbox_nand *sim)
+{
+	int page = sim->prog_page;
+	int i;
+
+	sim_busy(sim, get_time_ns(), sim->tprog);
+
+	if (sim->blkstate[page / sim->pages]) {
+		sim->status |= NAND_STATUS_FAIL;
+		return;
+	}
+
+	/* Programming can only clear bits */
+	if (linux_pread(sim->hf->fd, sim->tmp, sim->rawsize,
+			sim_page_offset(sim, page)) != sim->rawsize)
+		memset(sim->tmp, 0xff, sim->rawsize);
+
+	for (i = 0; i < sim->rawsize; i++)
+		sim->tmp[i] &= sim->reg[i];
+
+	if (linux_pwrite(sim->hf->fd, sim->tmp, sim->rawsize,
+			sim_page_offset(sim, page)) != sim->rawsize)
+		sim->status |= NAND_STATUS_FAIL;
+}
+
+static void sim_erase(struct sandbox_nand *sim)
+{
+	int block = sim_addr_page(sim, 0) / sim->pages;
+	int i;
+
+	sim_busy(sim, get_time_ns(), sim->tbers);
+
+	if (sim->blkstate[block]) {
+		sim->status |= NAND_STATUS_FAIL;
+		return;
+	}
+
+	memset(sim->tmp, 0xff, sim->rawsize);
+
+	for (i = 0; i < sim->pages; i++) {
+		if (linux_pwrite(sim->hf->fd, sim->tmp, sim->rawsize,
+				sim_page_offset(sim, block * sim->pages + i)) !=
+				sim->rawsize) {
+			sim->status |= NAND_STATUS_FAIL;
+			return;
+		}
+	}
+}
+
+/*
+ * In a cache read the page in the data register moves to the cache
+ * register as soon as it has been read from the array, then reading the
+ * next page starts while the host transfers the cache register.
+ */
+static void sim_cache_read(struct sandbox_nand *sim, int last)
+{
+	uint64_t now = get_time_ns();
+	uint64_t start = max(now, sim->reg_ready);
+
+	memcpy(sim->cache, sim->reg, sim->rawsize);
+	sim_output(sim, sim->cache, sim->rawsize, 0);
+	sim->busy_until = start;
+
+	if (last)
+		return;
+
+	sim_load_page(sim, (sim->reg_page + 1) &
+			(sim->pages * sim->blocks - 1));
+	sim->reg_ready = start + sim->tr * USECOND;
+}
+
+static void sim_command(struct sandbox_nand *sim, int cmd)
+{
+	switch (cmd) {
+	case NAND_CMD_RESET:
+		sim->cmd = cmd;
+		sim->status = 0;
+		sim->busy_until = 0;
+		sim_output(sim, NULL, 0, 0);
+		return;
+	case NAND_CMD_STATUS:
+		sim->cmd = cmd;
+		return;
+	case NAND_CMD_READSTART:
+		if (sim->cmd != NAND_CMD_READ0)
+			break;
+		sim_load_page(sim, sim_addr_page(sim, 2));
+		sim->reg_ready = get_time_ns() + sim->tr * USECOND;
+		sim->busy_until = sim->reg_ready;
+		sim_output(sim, sim->reg, sim->rawsize, sim_addr_column(sim));
+		return;
+	case NAND_CMD_RNDOUTSTART:
+		if (sim->cmd != NAND_CMD_RNDOUT)
+			break;
+		sim->pos = sim_addr_column(sim);
+		return;
+	case NAND_CMD_READCACHESEQ:
+	case NAND_CMD_READCACHEEND:
+		sim_cache_read(sim, cmd == NAND_CMD_READCACHEEND);
+		return;
+	case NAND_CMD_PAGEPROG:
+		if (sim->cmd == NAND_CMD_SEQIN || sim->cmd == NAND_CMD_RNDIN)
+			sim_program(sim);
+		sim->cmd = cmd;
+		return;
+	case NAND_CMD_ERASE2:
+		if (sim->cmd == NAND_CMD_ERASE1)
+			sim_erase(sim);
+		sim->cmd = cmd;
+		return;
+	case NAND_CMD_SEQIN:
+	case NAND_CMD_ERASE1:
+		/* The status reports the result of the last program or erase */
+		sim->status = 0;
+		/* fall through */
+	case NAND_CMD_READID:
+	case NAND_CMD_PARAM:
+	case NAND_CMD_READ0:
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+		sim->cmd = cmd;
+		sim->naddr = 0;
+		return;
+	}
+
+	dev_dbg(sim->dev, "unsupported command 0x%02x after 0x%02x\n",
+			cmd, sim->cmd);
+}
+
+static void sim_address(struct sandbox_nand *sim, u8 byte)
+{
+	if (sim->naddr == ARRAY_SIZE(sim->addr))
+		return;
+
+	sim->addr[sim->naddr++] = byte;
+
+	switch (sim->cmd) {
+	case NAND_CMD_READID:
+		if (sim->naddr != 1)
+			break;
+		if (byte == 0x20)
+			sim_output(sim, (const u8 *)"ONFI", 4, 0);
+		else
+			sim_output(sim, sim->id, sizeof(sim->id), 0);
+		break;
+	case NAND_CMD_PARAM:
+		if (sim->naddr == 1)
+			sim_output(sim, sim->param,
+				3 * sizeof(struct nand_onfi_params), 0);
+		break;
+	case NAND_CMD_SEQIN:
+		if (sim->naddr != 2 + sim->row_cycles)
+			break;
+		sim->prog_page = sim_addr_page(sim, 2);
+		memset(sim->reg, 0xff, sim->rawsize);
+		sim->pos = sim_addr_column(sim);
+		break;
+	case NAND_CMD_RNDIN:
+		if (sim->naddr == 2)
+			sim->pos = sim_addr_column(sim);
+		break;
+	}
+}
+
+static void sandbox_nand_cmd_ctrl(struct mtd_info *mtd, int dat,
+		unsigned int ctrl)
+{
+	struct sandbox_nand *sim = mtd_to_sim(mtd);
+
+	if (dat == NAND_CMD_NONE)
+		return;
+
+	if (ctrl & NAND_CLE)
+		sim_command(sim, dat & 0xff);
+	else if (ctrl & NAND_ALE)
+		sim_address(sim, dat & 0xff);
+}
+
+static int sandbox_nand_dev_ready(struct mtd_info *mtd)
+{
+	return sim_ready(mtd_to_sim(mtd));
+}
+
+static void sim_bus_delay(struct sandbox_nand *sim, int len)
+{
+	if (sim->tc)
+		ndelay(len * sim->tc);
+}
+
+static uint8_t sandbox_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand *sim = mtd_to_sim(mtd);
+
+	sim_bus_delay(sim, 1);
+
+	if (sim->cmd == NAND_CMD_STATUS) {
+		if (sim_ready(sim))
+			return sim->status | NAND_STATUS_WP |
+				NAND_STATUS_READY | NAND_STATUS_TRUE_READY;
+		return sim->status | NAND_STATUS_WP;
+	}
+
+	if (!sim->out || sim->pos >= sim->outlen)
+		return 0xff;
+
+	return sim->out[sim->pos++];
+}
+
+static void sandbox_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	struct sandbox_nand *sim = mtd_to_sim(mtd);
+	int n = 0;
+
+	sim_bus_delay(sim, len);
+
+	if (sim->out && sim->pos < sim->outlen)
+		n = min_t(int, len, sim->outlen - sim->pos);
+
+	memcpy(buf, sim->out + sim->pos, n);
+	memset(buf + n, 0xff, len - n);
+	sim->pos += n;
+}
+
+static void sandbox_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+		int len)
+{
+	struct sandbox_nand *sim = mtd_to_sim(mtd);
+	int n;
+
+	sim_bus_delay(sim, len);
+
+	if (sim->cmd != NAND_CMD_SEQIN && sim->cmd != NAND_CMD_RNDIN)
+		return;
+
+	if (sim->pos >= sim->rawsize)
+		return;
+
+	n = min_t(int, len, sim->rawsize - sim->pos);
+	memcpy(sim->reg + sim->pos, buf, n);
+	sim->pos += n;
+}
+
+static int sandbox_nand_verify_buf(struct mtd_info *mtd, const uint8_t *buf,
+		int len)
+{
+	struct sandbox_nand *sim = mtd_to_sim(mtd);
+	int ret = 0;
+
+	if (!sim->out || sim->pos + len > sim->outlen)
+		return -EFAULT;
+
+	if (memcmp(buf, sim->out + sim->pos, len))
+		ret = -EFAULT;
+
+	sim->pos += len;
+
+	return ret;
+}
+
+static void sim_init_param(struct sandbox_nand *sim)
+{
+	struct nand_onfi_params *p;
+	u16 crc = ONFI_CRC_BASE;
+	int i, j;
+
+	sim->param = xzalloc(3 * sizeof(*p));
+	p = (struct nand_onfi_params *)sim->param;
+
+	memcpy(p->sig, "ONFI", 4);
+	p->revision = cpu_to_le16(1 << 1);
+	p->opt_cmd = cpu_to_le16(ONFI_OPT_CMD_READ_CACHE);
+	memcpy(p->manufacturer, "BAREBOX     ", sizeof(p->manufacturer));
+	memcpy(p->model, "SANDBOX NAND        ", sizeof(p->model));
+	p->byte_per_page = cpu_to_le32(sim->pagesize);
+	p->spare_bytes_per_page = cpu_to_le16(sim->oobsize);
+	p->pages_per_block = cpu_to_le32(sim->pages);
+	p->blocks_per_lun = cpu_to_le32(sim->blocks);
+	p->lun_count = 1;
+	p->addr_cycles = sim->row_cycles | 2 << 4;
+	p->bits_per_cell = 1;
+	p->programs_per_page = 4;
+	p->ecc_bits = 1;
+	p->t_prog = cpu_to_le16(min_t(unsigned long, sim->tprog, 0xffff));
+	p->t_bers = cpu_to_le16(min_t(unsigned long, sim->tbers, 0xffff));
+	p->t_r = cpu_to_le16(min_t(unsigned long, sim->tr, 0xffff));
+
+	for (i = 0; i < 254; i++) {
+		crc ^= sim->param[i] << 8;
+		for (j = 0; j < 8; j++)
+			crc = (crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0);
+	}
+	p->crc = cpu_to_le16(crc);
+
+	memcpy(p + 1, p, sizeof(*p));
+	memcpy(p + 2, p, sizeof(*p));
+}
+
+/*
+ * Software ECC with 3 bytes per 256 bytes at the end of the OOB, the rest
+ * after the bad block marker is free.
+ */
+static int sim_init_layout(struct sandbox_nand *sim)
+{
+	struct nand_ecclayout *l = &sim->layout;
+	int i, eccbytes = sim->pagesize / 256 * 3;
+
+	if (eccbytes + 2 > sim->oobsize ||
+	    eccbytes > ARRAY_SIZE(l->eccpos))
+		return -EINVAL;
+
+	l->eccbytes = eccbytes;
+	for (i = 0; i < eccbytes; i++)
+		l->eccpos[i] = sim->oobsize - eccbytes + i;
+
+	l->oobfree[0].offset = 2;
+	l->oobfree[0].length = sim->oobsize - eccbytes - 2;
+
+	return 0;
+}
+
+static void sim_mark_blocks(struct sandbox_nand *sim, char *list, u8 state)
+{
+	char *s;
+	unsigned long block;
+
+	while ((s = strsep(&list, ":"))) {
+		if (!*s)
+			continue;
+		block = simple_strtoul(s, NULL, 0);
+		if (block < sim->blocks)
+			sim->blkstate[block] |= state;
+		else
+			dev_warn(sim->dev, "block %lu out of range\n", block);
+	}
+}
+
+static int sim_parse_args(struct sandbox_nand *sim, char **bad, char **fail)
+{
+	char *args, *opt, *val;
+	unsigned long v;
+
+	if (!sim->hf->args)
+		return 0;
+
+	/* @bad and @fail point into the copy */
+	sim->args = args = xstrdup(sim->hf->args);
+
+	while ((opt = strsep(&args, ","))) {
+		val = strchr(opt, '=');
+		if (!val) {
+			dev_err(sim->dev, "invalid option '%s'\n", opt);
+			return -EINVAL;
+		}
+		*val++ = 0;
+		v = strtoull_suffix(val, NULL, 0);
+
+		if (!strcmp(opt, "pagesize"))
+			sim->pagesize = v;
+		else if (!strcmp(opt, "oobsize"))
+			sim->oobsize = v;
+		else if (!strcmp(opt, "pages"))
+			sim->pages = v;
+		else if (!strcmp(opt, "blocks"))
+			sim->blocks = v;
+		else if (!strcmp(opt, "bad"))
+			*bad = val;
+		else if (!strcmp(opt, "fail"))
+			*fail = val;
+		else if (!strcmp(opt, "tr"))
+			sim->tr = v;
+		else if (!strcmp(opt, "tprog"))
+			sim->tprog = v;
+		else if (!strcmp(opt, "tbers"))
+			sim->tbers = v;
+		else if (!strcmp(opt, "tc"))
+			sim->tc = v;
+		else {
+			dev_err(sim->dev, "unknown option '%s'\n", opt);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Grow the file to the size of the chip, erased */
+static int sim_extend_file(struct sandbox_nand *sim)
+{
+	loff_t size = (loff_t)sim->blocks * sim->pages * sim->rawsize;
+	loff_t ofs;
+
+	if (sim->hf->size >= size)
+		return 0;
+
+	memset(sim->tmp, 0xff, sim->rawsize);
+
+	for (ofs = sim->hf->size; ofs < size; ofs += sim->rawsize) {
+		size_t len = min_t(loff_t, sim->rawsize, size - ofs);
+
+		if (linux_pwrite(sim->hf->fd, sim->tmp, len, ofs) != len)
+			return -EIO;
+	}
+
+	sim->hf->size = size;
+
+	return 0;
+}
+
+static void sandbox_nand_info(struct device_d *dev)
+{
+	struct sandbox_nand *sim = dev->priv;
+	int i;
+
+	printf("file: %s\n", sim->hf->filename);
+	printf("geometry: %u blocks of %u pages, %u + %u bytes\n",
+			sim->blocks, sim->pages, sim->pagesize, sim->oobsize);
+	printf("timing: tR %luus, tPROG %luus, tBERS %luus, tC %luns\n",
+			sim->tr, sim->tprog, sim->tbers, sim->tc);
+
+	printf("bad blocks:");
+	for (i = 0; i < sim->blocks; i++)
+		if (sim->blkstate[i] & SIM_BLK_BAD)
+			printf(" %d", i);
+	printf("\nfailing blocks:");
+	for (i = 0; i < sim->blocks; i++)
+		if (sim->blkstate[i] & SIM_BLK_FAIL)
+			printf(" %d", i);
+	printf("\n");
+}
+
+static int sandbox_nand_probe(struct device_d *dev)
+{
+	struct hf_platform_data *hf = dev->platform_data;
+	struct sandbox_nand *sim;
+	struct nand_chip *nand;
+	struct mtd_info *mtd;
+	char *bad = NULL, *fail = NULL;
+	int ret;
+
+	sim = xzalloc(sizeof(*sim));
+	sim->dev = dev;
+	sim->hf = hf;
+
+	/* A typical SLC chip */
+	sim->pagesize = 2048;
+	sim->oobsize = 64;
+	sim->pages = 64;
+	sim->tr = 25;
+	sim->tprog = 200;
+	sim->tbers = 1500;
+	sim->tc = 25;
+
+	ret = sim_parse_args(sim, &bad, &fail);
+	if (ret)
+		goto err;
+
+	sim->rawsize = sim->pagesize + sim->oobsize;
+
+	if (!sim->blocks)
+		sim->blocks = hf->size ?
+			hf->size / ((loff_t)sim->pages * sim->rawsize) : 256;
+
+	if (!is_power_of_2(sim->pagesize) || sim->pagesize < 1024 ||
+	    !is_power_of_2(sim->pages) || !is_power_of_2(sim->blocks)) {
+		dev_err(dev, "page size, pages and blocks must be powers of 2\n");
+		ret = -EINVAL;
+		goto err;
+	}
+
+	ret = sim_init_layout(sim);
+	if (ret) {
+		dev_err(dev, "oob size %u too small\n", sim->oobsize);
+		goto err;
+	}
+
+	/* Two row address cycles address up to 128MiB */
+	sim->row_cycles = (u64)sim->blocks * sim->pages * sim->pagesize >
+		(128 << 20) ? 3 : 2;
+
+	sim->reg = xmalloc(sim->rawsize);
+	sim->cache = xmalloc(sim->rawsize);
+	sim->tmp = xmalloc(sim->rawsize);
+	sim->blkstate = xzalloc(sim->blocks);
+
+	ret = sim_extend_file(sim);
+	if (ret) {
+		dev_err(dev, "cannot extend %s\n", hf->filename);
+		goto err;
+	}
+
+	sim_mark_blocks(sim, bad, SIM_BLK_BAD);
+	sim_mark_blocks(sim, fail, SIM_BLK_FAIL);
+
+	/* An unknown device id makes the NAND layer use the ONFI parameters */
+	sim->id[0] = 0x00;
+	sim->id[1] = 0xf0;
+	sim_init_param(sim);
+
+	mtd = &sim->mtd;
+	nand = &sim->nand;
+	mtd->priv = nand;
+	mtd->parent = dev;
+
+	nand->cmd_ctrl = sandbox_nand_cmd_ctrl;
+	nand->dev_ready = sandbox_nand_dev_ready;
+	nand->read_byte = sandbox_nand_read_byte;
+	nand->read_buf = sandbox_nand_read_buf;
+	nand->write_buf = sandbox_nand_write_buf;
+	nand->verify_buf = sandbox_nand_verify_buf;
+	nand->ecc.mode = NAND_ECC_SOFT;
+	nand->ecc.layout = &sim->layout;
+	nand->chip_delay = 0;
+
+	dev->priv = sim;
+
+	ret = nand_scan(mtd, 1);
+	if (ret)
+		goto err;
+
+	return add_mtd_nand_device(mtd, "nand");
+
+err:
+	free(sim->blkstate);
+	free(sim->tmp);
+	free(sim->cache);
+	free(sim->reg);
+	free(sim->param);
+	free(sim->args);
+	free(sim);
+
+	return ret;
+}
+
+static struct driver_d sandbox_nand_driver = {
+	.name  = "sandbox-nand",
+	.probe = sandbox_nand_probe,
+	.info  = sandbox_nand_info,
+};
+device_platform_driver(sandbox_nand_driver);
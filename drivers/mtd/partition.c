@@ -31,6 +31,15 @@ static int mtd_part_read(struct mtd_info *mtd, loff_t from, size_t len,
 	return res;
 }
 
+static int mtd_part_point(struct mtd_info *mtd, loff_t from, size_t len,
+		size_t *retlen, void **virt)
+{
+	struct mtd_part *part = PART(mtd);
+
+	return part->master->point(part->master, from + part->offset, len,
+			retlen, virt);
+}
+
 static int mtd_part_write(struct mtd_info *mtd, loff_t to, size_t len,
                 size_t *retlen, const u_char *buf)
 {
@@ -123,6 +132,7 @@ struct mtd_info *mtd_add_partition(struct mtd_info *mtd, off_t offset, size_t si
 	slave_mtd->read = mtd_part_read;
 	slave_mtd->write = mtd_part_write;
 	slave_mtd->erase = mtd_part_erase;
+	slave_mtd->point = mtd->point ? mtd_part_point : NULL;
 	slave_mtd->block_isbad = mtd->block_isbad ? mtd_part_block_isbad : NULL;
 	slave_mtd->block_markbad = mtd->block_markbad ? mtd_part_block_markbad : NULL;
 	slave_mtd->size = size;
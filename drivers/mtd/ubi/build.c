@@ -443,30 +443,45 @@ static void uif_close(struct ubi_device *ubi)
 /**
  * attach_by_scanning - attach an MTD device using scanning method.
  * @ubi: UBI device descriptor
+ * @force_scan: do not use the fastmap
  *
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * The fastmap is used if there is one, otherwise all PEBs are scanned. Full
+ * scanning is also the fall-back if the volume table found by the fastmap
+ * is broken.
  */
-static int attach_by_scanning(struct ubi_device *ubi)
+static int attach_by_scanning(struct ubi_device *ubi, int force_scan)
 {
 	int err;
-	struct ubi_scan_info *si;
+	struct ubi_scan_info *si = ERR_PTR(-ENOENT);
 
-	si = ubi_scan(ubi);
+	if (!force_scan && !ubi->fm_disabled)
+		si = ubi_scan_fastmap(ubi);
+	if (IS_ERR(si))
+		si = ubi_scan(ubi);
 	if (IS_ERR(si))
 		return PTR_ERR(si);
 
+	/* Only convert images to fastmap if asked to */
+	if (!ubi->fm && !force_scan &&
+	    !IS_ENABLED(CONFIG_MTD_UBI_FASTMAP_AUTOCONVERT))
+		ubi->fm_disabled = 1;
+
 	ubi->bad_peb_count = si->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
 	ubi->max_ec = si->max_ec;
 	ubi->mean_ec = si->mean_ec;
 
 	err = ubi_read_volume_table(ubi, si);
+	if (err && ubi->fm) {
+		ubi_warn("bad volume table in fastmap, scanning");
+		ubi_fastmap_close(ubi);
+		ubi_scan_destroy_si(si);
+		ubi->vol_count = 0;
+		return attach_by_scanning(ubi, 1);
+	}
 	if (err)
 		goto out_si;
 
@@ -486,6 +501,7 @@ out_wl:
 out_vtbl:
 	vfree(ubi->vtbl);
 out_si:
+	ubi_fastmap_close(ubi);
 	ubi_scan_destroy_si(si);
 	return err;
 }
@@ -782,6 +798,12 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	if (err)
 		goto out_free;
 
+	ubi->fm_size = ubi_calc_fm_size(ubi);
+	if (!IS_ENABLED(CONFIG_MTD_UBI_FASTMAP) ||
+	    ubi->peb_count <= UBI_FM_MAX_START ||
+	    ubi->fm_size / ubi->leb_size > UBI_FM_MAX_BLOCKS || ubi->ro_mode)
+		ubi->fm_disabled = 1;
+
 	err = -ENOMEM;
 	ubi->peb_buf1 = vmalloc(ubi->peb_size);
 	if (!ubi->peb_buf1)
@@ -798,7 +820,7 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 		goto out_free;
 #endif
 
-	err = attach_by_scanning(ubi);
+	err = attach_by_scanning(ubi, 0);
 	if (err) {
 		dbg_err("failed to attach by scanning, error %d", err);
 		goto out_free;
@@ -810,6 +832,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 			goto out_detach;
 	}
 
+	/* Errors are not fatal, the next attach just has to scan */
+	ubi_update_fastmap(ubi);
+
 	err = uif_init(ubi);
 	if (err)
 		goto out_detach;
@@ -918,6 +943,8 @@ int ubi_detach_mtd_dev(struct mtd_info *mtd, int anyway)
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
 
+	ubi_update_fastmap(ubi);
+
 	uif_close(ubi);
 	ubi_eba_close(ubi);
 	ubi_wl_close(ubi);
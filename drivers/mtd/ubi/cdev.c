@@ -23,8 +23,6 @@ static ssize_t ubi_volume_cdev_read(struct cdev *cdev, void *buf, size_t size,
 	loff_t offp = offset;
 	int usable_leb_size = vol->usable_leb_size;
 
-	printf("%s: %zd @ 0x%08llx\n", __func__, size, offset);
-
 	len = size > usable_leb_size ? usable_leb_size : size;
 
 	tmp = offp;
@@ -37,7 +35,7 @@ static ssize_t ubi_volume_cdev_read(struct cdev *cdev, void *buf, size_t size,
 		err = ubi_eba_read_leb(ubi, vol, lnum, buf, off, len, 0);
 		if (err) {
 			printf("read err %x\n", err);
-			break;
+			return err;
 		}
 		off += len;
 		if (off == usable_leb_size) {
@@ -135,6 +133,7 @@ static int ubi_volume_cdev_close(struct cdev *cdev)
 
 		vol->checked = 1;
 		ubi_gluebi_updated(vol);
+		ubi_update_fastmap(ubi);
 	}
 
 	return 0;
@@ -199,6 +198,7 @@ static int ubi_cdev_ioctl(struct cdev *cdev, int cmd, void *buf)
 	struct ubi_volume_desc *desc;
 	struct ubi_device *ubi = cdev->priv;
 	struct ubi_mkvol_req *req = buf;
+	int err;
 
 	switch (cmd) {
 	case UBI_IOCRMVOL:
@@ -206,15 +206,21 @@ static int ubi_cdev_ioctl(struct cdev *cdev, int cmd, void *buf)
                                            UBI_EXCLUSIVE);
 		if (IS_ERR(desc))
 			return PTR_ERR(desc);
-		ubi_remove_volume(desc);
+		err = ubi_remove_volume(desc);
 		break;
 	case UBI_IOCMKVOL:
 		if (!req->bytes)
 			req->bytes = ubi->avail_pebs * ubi->leb_size;
-		return ubi_create_volume(ubi, req);
+		err = ubi_create_volume(ubi, req);
+		break;
+	default:
+		return -EINVAL;
 	};
 
-	return 0;
+	if (!err)
+		ubi_update_fastmap(ubi);
+
+	return err;
 }
 
 
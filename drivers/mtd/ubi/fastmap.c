@@ -0,0 +1,901 @@
+/*
+ * fastmap.c - attach UBI devices without scanning all PEBs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ */
+
+/*
+ * The fastmap stores the state of all physical eraseblocks and the EBA tables
+ * of all volumes on the flash, so that attaching only has to read the
+ * fastmap instead of the headers of every PEB. The on-flash format is the one
+ * of the Linux UBI fastmap, so a fastmap written by barebox is used by Linux
+ * and vice versa.
+ *
+ * The fastmap starts with the super block in the anchor PEB, which is one of
+ * the first %UBI_FM_MAX_START PEBs and found by scanning these. It is
+ * followed by the pools, the lists of free, used, to be scrubbed and to be
+ * erased PEBs and the EBA table of each volume.
+ *
+ * Linux keeps the fastmap valid while writing by taking new PEBs only from
+ * the pools, which are scanned when attaching. We do not fill the pools
+ * but invalidate the fastmap before the first change to the flash, that is
+ * before a PEB is taken from or given back to the WL unit, and write a new
+ * one when the device is detached, after a volume has been changed and,
+ * with CONFIG_MTD_UBI_FASTMAP_AUTOCONVERT, after attaching by scanning.
+ */
+
+#include "ubi-barebox.h"
+#include "ubi.h"
+
+/* What a PEB is used for according to the fastmap being read */
+enum {
+	FM_PEB_UNKNOWN,
+	FM_PEB_FREE,
+	FM_PEB_USED,
+	FM_PEB_SCRUB,
+	FM_PEB_ERASE,
+	FM_PEB_POOL,
+	FM_PEB_FASTMAP,
+	FM_PEB_MAPPED,
+};
+
+struct fm_peb {
+	int ec;
+	int state;
+};
+
+/**
+ * ubi_calc_fm_size - calculate the fastmap size.
+ * @ubi: UBI device description object
+ *
+ * The size is chosen so that the fastmap can describe every PEB, it is
+ * rounded up to whole logical eraseblocks.
+ */
+int ubi_calc_fm_size(struct ubi_device *ubi)
+{
+	size_t size;
+
+	size = sizeof(struct ubi_fm_sb) +
+		sizeof(struct ubi_fm_hdr) +
+		sizeof(struct ubi_fm_scan_pool) * 2 +
+		ubi->peb_count * sizeof(struct ubi_fm_ec) +
+		sizeof(struct ubi_fm_eba) + ubi->peb_count * sizeof(__be32) +
+		sizeof(struct ubi_fm_volhdr) * UBI_MAX_VOLUMES;
+
+	return roundup(size, ubi->leb_size);
+}
+
+/* Return the next @len bytes of the fastmap or %NULL if it is too short */
+static void *fm_next(void *buf, int fm_size, int *pos, size_t len)
+{
+	void *p = buf + *pos;
+
+	if (len > fm_size - *pos)
+		return NULL;
+
+	*pos += len;
+
+	return p;
+}
+
+static int fm_add_to_list(struct list_head *list, int pnum, int ec)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+
+	return 0;
+}
+
+static int fm_mark_peb(struct ubi_device *ubi, struct fm_peb *pebs, int pnum,
+		       int ec, int state)
+{
+	if (pnum < 0 || pnum >= ubi->peb_count ||
+	    pebs[pnum].state != FM_PEB_UNKNOWN) {
+		ubi_err("bad PEB %d in fastmap", pnum);
+		return -EINVAL;
+	}
+
+	if (ec > UBI_MAX_ERASECOUNTER) {
+		ubi_err("bad erase counter %d of PEB %d in fastmap", ec, pnum);
+		return -EINVAL;
+	}
+
+	pebs[pnum].state = state;
+	pebs[pnum].ec = ec;
+
+	return 0;
+}
+
+/* Read a list of PEBs with their erase counters */
+static int fm_read_ec_list(struct ubi_device *ubi, struct fm_peb *pebs,
+			   void *buf, int fm_size, int *pos, __be32 count,
+			   int state)
+{
+	struct ubi_fm_ec *fmec;
+	int i, n = be32_to_cpu(count), err;
+
+	if (n < 0 || n > ubi->peb_count)
+		return -EINVAL;
+
+	fmec = fm_next(buf, fm_size, pos, n * sizeof(*fmec));
+	if (!fmec)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		err = fm_mark_peb(ubi, pebs, be32_to_cpu(fmec[i].pnum),
+				  be32_to_cpu(fmec[i].ec), state);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* Add the mapped LEBs of a volume to the scanning information */
+static int fm_read_volume(struct ubi_device *ubi, struct ubi_scan_info *si,
+			  struct fm_peb *pebs, void *buf, int fm_size,
+			  int *pos)
+{
+	struct ubi_fm_volhdr *fmvh;
+	struct ubi_fm_eba *fmeba;
+	struct ubi_vid_hdr vh;
+	int vol_id, reserved_pebs, lnum, pnum, err;
+
+	fmvh = fm_next(buf, fm_size, pos, sizeof(*fmvh));
+	if (!fmvh || be32_to_cpu(fmvh->magic) != UBI_FM_VHDR_MAGIC)
+		return -EINVAL;
+
+	fmeba = fm_next(buf, fm_size, pos, sizeof(*fmeba));
+	if (!fmeba || be32_to_cpu(fmeba->magic) != UBI_FM_EBA_MAGIC)
+		return -EINVAL;
+
+	reserved_pebs = be32_to_cpu(fmeba->reserved_pebs);
+	if (reserved_pebs < 0 || reserved_pebs > ubi->peb_count)
+		return -EINVAL;
+
+	if (!fm_next(buf, fm_size, pos, reserved_pebs * sizeof(__be32)))
+		return -EINVAL;
+
+	vol_id = be32_to_cpu(fmvh->vol_id);
+	if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+	    vol_id != UBI_LAYOUT_VOLUME_ID) {
+		ubi_err("bad volume ID %d in fastmap", vol_id);
+		return -EINVAL;
+	}
+
+	if (fmvh->vol_type != UBI_DYNAMIC_VOLUME &&
+	    fmvh->vol_type != UBI_STATIC_VOLUME) {
+		ubi_err("bad type of volume %d in fastmap", vol_id);
+		return -EINVAL;
+	}
+
+	/*
+	 * The scanning unit takes the volume information from the VID
+	 * headers, so we make up one for the LEBs of this volume.
+	 */
+	memset(&vh, 0, sizeof(vh));
+	vh.vol_type = fmvh->vol_type == UBI_STATIC_VOLUME ? UBI_VID_STATIC :
+							     UBI_VID_DYNAMIC;
+	if (vol_id == UBI_LAYOUT_VOLUME_ID)
+		vh.compat = UBI_LAYOUT_VOLUME_COMPAT;
+	vh.vol_id = fmvh->vol_id;
+	vh.used_ebs = fmvh->used_ebs;
+	vh.data_pad = fmvh->data_pad;
+	vh.data_size = fmvh->last_eb_bytes;
+
+	for (lnum = 0; lnum < reserved_pebs; lnum++) {
+		pnum = be32_to_cpu(fmeba->pnum[lnum]);
+		if (pnum < 0)
+			continue;
+
+		if (pnum >= ubi->peb_count) {
+			ubi_err("bad PEB %d in fastmap", pnum);
+			return -EINVAL;
+		}
+
+		/* PEBs from the pools are scanned, they may be newer */
+		if (pebs[pnum].state == FM_PEB_POOL)
+			continue;
+
+		if (pebs[pnum].state != FM_PEB_USED &&
+		    pebs[pnum].state != FM_PEB_SCRUB) {
+			ubi_err("LEB %d:%d mapped to unused PEB %d in fastmap",
+				vol_id, lnum, pnum);
+			return -EINVAL;
+		}
+
+		vh.lnum = cpu_to_be32(lnum);
+		err = ubi_scan_add_used(ubi, si, pnum, pebs[pnum].ec, &vh,
+					pebs[pnum].state == FM_PEB_SCRUB);
+		if (err)
+			return err;
+
+		pebs[pnum].state = FM_PEB_MAPPED;
+	}
+
+	return 0;
+}
+
+/*
+ * Build the scanning information from the fastmap data in @buf. The PEBs of
+ * the pools are scanned.
+ */
+static int fm_attach(struct ubi_device *ubi, struct ubi_scan_info *si,
+		     struct ubi_fastmap_layout *fm, void *buf, int fm_size)
+{
+	struct ubi_fm_hdr *fmh;
+	struct ubi_fm_scan_pool *fmpl;
+	struct fm_peb *pebs;
+	int *pool, pool_count = 0;
+	int pos = sizeof(struct ubi_fm_sb);
+	int i, j, size, vol_count, bad_count = 0, err = -EINVAL;
+
+	pebs = kzalloc(ubi->peb_count * sizeof(*pebs), GFP_KERNEL);
+	pool = kmalloc(2 * UBI_FM_MAX_POOL_SIZE * sizeof(int), GFP_KERNEL);
+	if (!pebs || !pool) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		err = fm_mark_peb(ubi, pebs, fm->e[i]->pnum, fm->e[i]->ec,
+				  FM_PEB_FASTMAP);
+		if (err)
+			goto out;
+	}
+
+	err = -EINVAL;
+
+	fmh = fm_next(buf, fm_size, &pos, sizeof(*fmh));
+	if (!fmh || be32_to_cpu(fmh->magic) != UBI_FM_HDR_MAGIC)
+		goto out;
+
+	for (i = 0; i < 2; i++) {
+		fmpl = fm_next(buf, fm_size, &pos, sizeof(*fmpl));
+		if (!fmpl || be32_to_cpu(fmpl->magic) != UBI_FM_POOL_MAGIC)
+			goto out;
+
+		size = be16_to_cpu(fmpl->size);
+		if (size > UBI_FM_MAX_POOL_SIZE)
+			goto out;
+
+		for (j = 0; j < size; j++) {
+			pool[pool_count] = be32_to_cpu(fmpl->pebs[j]);
+			err = fm_mark_peb(ubi, pebs, pool[pool_count],
+					  UBI_SCAN_UNKNOWN_EC, FM_PEB_POOL);
+			if (err)
+				goto out;
+			pool_count++;
+		}
+	}
+
+	err = fm_read_ec_list(ubi, pebs, buf, fm_size, &pos,
+			      fmh->free_peb_count, FM_PEB_FREE);
+	if (!err)
+		err = fm_read_ec_list(ubi, pebs, buf, fm_size, &pos,
+				      fmh->used_peb_count, FM_PEB_USED);
+	if (!err)
+		err = fm_read_ec_list(ubi, pebs, buf, fm_size, &pos,
+				      fmh->scrub_peb_count, FM_PEB_SCRUB);
+	if (!err)
+		err = fm_read_ec_list(ubi, pebs, buf, fm_size, &pos,
+				      fmh->erase_peb_count, FM_PEB_ERASE);
+	if (err)
+		goto out;
+
+	vol_count = be32_to_cpu(fmh->vol_count);
+	if (vol_count < 0 || vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < vol_count; i++) {
+		err = fm_read_volume(ubi, si, pebs, buf, fm_size, &pos);
+		if (err)
+			goto out;
+	}
+
+	for (i = 0; i < ubi->peb_count; i++) {
+		struct fm_peb *peb = &pebs[i];
+
+		switch (peb->state) {
+		case FM_PEB_UNKNOWN:
+			bad_count++;
+			continue;
+		case FM_PEB_POOL:
+		case FM_PEB_FASTMAP:
+			continue;
+		case FM_PEB_MAPPED:
+			break;
+		case FM_PEB_FREE:
+			err = fm_add_to_list(&si->free, i, peb->ec);
+			break;
+		case FM_PEB_USED:
+		case FM_PEB_SCRUB:
+			/* Not mapped by any volume, it is garbage */
+		case FM_PEB_ERASE:
+			err = fm_add_to_list(&si->erase, i, peb->ec);
+			break;
+		}
+
+		if (err)
+			goto out;
+
+		si->ec_sum += peb->ec;
+		si->ec_count += 1;
+		if (peb->ec > si->max_ec)
+			si->max_ec = peb->ec;
+		if (peb->ec < si->min_ec)
+			si->min_ec = peb->ec;
+	}
+
+	/* All PEBs not mentioned in the fastmap have to be bad ones */
+	if (bad_count != be32_to_cpu(fmh->bad_peb_count)) {
+		ubi_err("fastmap knows %d bad PEBs, but %d PEBs are missing",
+			be32_to_cpu(fmh->bad_peb_count), bad_count);
+		err = -EINVAL;
+		goto out;
+	}
+
+	si->bad_peb_count = bad_count;
+	si->is_empty = 0;
+
+	err = ubi_scan_pebs(ubi, si, pool, pool_count);
+out:
+	kfree(pool);
+	kfree(pebs);
+
+	return err;
+}
+
+/*
+ * Find the anchor PEB, the one with the fastmap super block. If there are
+ * several, the newest one is taken.
+ */
+static int fm_find_anchor(struct ubi_device *ubi, struct ubi_ec_hdr *ech,
+			  struct ubi_vid_hdr *vh)
+{
+	int pnum, err, anchor = -ENOENT;
+	unsigned long long sqnum, max_sqnum = 0;
+
+	for (pnum = 0; pnum < UBI_FM_MAX_START && pnum < ubi->peb_count;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		if (err)
+			continue;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vh->vol_id) != UBI_FM_SB_VOLUME_ID)
+			continue;
+
+		sqnum = be64_to_cpu(vh->sqnum);
+		if (anchor < 0 || sqnum > max_sqnum) {
+			anchor = pnum;
+			max_sqnum = sqnum;
+		}
+	}
+
+	return anchor;
+}
+
+/* Read the fastmap PEBs with the super block at PEB @anchor into @fm */
+static void *fm_read(struct ubi_device *ubi, int anchor,
+		     struct ubi_fastmap_layout *fm, struct ubi_ec_hdr *ech,
+		     struct ubi_vid_hdr *vh, unsigned long long *max_sqnum)
+{
+	struct ubi_fm_sb *fmsb;
+	struct ubi_wl_entry *e;
+	void *buf;
+	int i, pnum, vol_id, used_blocks, err;
+	uint32_t crc;
+
+	fmsb = kmalloc(sizeof(*fmsb), GFP_KERNEL);
+	if (!fmsb)
+		return ERR_PTR(-ENOMEM);
+
+	err = ubi_io_read(ubi, fmsb, anchor, ubi->leb_start, sizeof(*fmsb));
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_sb;
+
+	err = -EINVAL;
+
+	if (be32_to_cpu(fmsb->magic) != UBI_FM_SB_MAGIC) {
+		ubi_err("bad fastmap super block magic in PEB %d", anchor);
+		goto out_sb;
+	}
+
+	if (fmsb->version != UBI_FM_FMT_VERSION) {
+		ubi_err("fastmap version is %d, supported is %d",
+			fmsb->version, UBI_FM_FMT_VERSION);
+		goto out_sb;
+	}
+
+	used_blocks = be32_to_cpu(fmsb->used_blocks);
+	if (used_blocks < 1 || used_blocks > UBI_FM_MAX_BLOCKS ||
+	    be32_to_cpu(fmsb->block_loc[0]) != anchor) {
+		ubi_err("bad fastmap super block in PEB %d", anchor);
+		goto out_sb;
+	}
+
+	buf = vmalloc(used_blocks * ubi->leb_size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto out_sb;
+	}
+
+	for (i = 0; i < used_blocks; i++) {
+		err = -EINVAL;
+
+		pnum = be32_to_cpu(fmsb->block_loc[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count)
+			goto out_buf;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+		if (err && err != UBI_IO_BITFLIPS) {
+			ubi_err("cannot read EC header of fastmap PEB %d",
+				pnum);
+			err = -EINVAL;
+			goto out_buf;
+		}
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS) {
+			ubi_err("cannot read VID header of fastmap PEB %d",
+				pnum);
+			err = -EINVAL;
+			goto out_buf;
+		}
+
+		vol_id = be32_to_cpu(vh->vol_id);
+		if (vol_id != (i ? UBI_FM_DATA_VOLUME_ID : UBI_FM_SB_VOLUME_ID) ||
+		    be32_to_cpu(vh->lnum) != i) {
+			ubi_err("PEB %d is not part of the fastmap", pnum);
+			err = -EINVAL;
+			goto out_buf;
+		}
+
+		if (be64_to_cpu(vh->sqnum) > *max_sqnum)
+			*max_sqnum = be64_to_cpu(vh->sqnum);
+
+		err = ubi_io_read(ubi, buf + i * ubi->leb_size, pnum,
+				  ubi->leb_start, ubi->leb_size);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_buf;
+
+		e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!e) {
+			err = -ENOMEM;
+			goto out_buf;
+		}
+
+		e->pnum = pnum;
+		e->ec = be64_to_cpu(ech->ec);
+		fm->e[i] = e;
+		fm->used_blocks = i + 1;
+	}
+
+	kfree(fmsb);
+
+	fmsb = buf;
+	crc = be32_to_cpu(fmsb->data_crc);
+	fmsb->data_crc = 0;
+	if (crc32(UBI_CRC32_INIT, buf, used_blocks * ubi->leb_size) != crc) {
+		ubi_err("fastmap data CRC is invalid");
+		vfree(buf);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return buf;
+
+out_buf:
+	vfree(buf);
+out_sb:
+	kfree(fmsb);
+
+	return ERR_PTR(err < 0 ? err : -EIO);
+}
+
+/**
+ * ubi_scan_fastmap - attach using the fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function reads the fastmap and scans the PEBs of the pools. It returns
+ * the scanning information in case of success and an error code if there is
+ * no valid fastmap, in this case the device has to be scanned. On success
+ * @ubi->fm describes the fastmap.
+ */
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm;
+	struct ubi_scan_info *si = NULL;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vh;
+	unsigned long long max_sqnum = 0;
+	void *buf;
+	int anchor = -ENOENT, err = -ENOMEM;
+
+	if (ubi->peb_count <= UBI_FM_MAX_START)
+		return ERR_PTR(-ENOENT);
+
+	fm = kzalloc(sizeof(*fm), GFP_KERNEL);
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!fm || !ech || !vh)
+		goto out;
+
+	anchor = fm_find_anchor(ubi, ech, vh);
+	if (anchor < 0) {
+		dbg_bld("no fastmap found");
+		err = anchor;
+		goto out;
+	}
+
+	buf = fm_read(ubi, anchor, fm, ech, vh, &max_sqnum);
+	if (IS_ERR(buf)) {
+		err = PTR_ERR(buf);
+		goto out;
+	}
+
+	si = ubi_scan_alloc_si();
+	if (!si) {
+		err = -ENOMEM;
+		goto out_buf;
+	}
+
+	err = fm_attach(ubi, si, fm, buf, fm->used_blocks * ubi->leb_size);
+	if (err)
+		goto out_buf;
+
+	if (si->max_sqnum < max_sqnum)
+		si->max_sqnum = max_sqnum;
+
+	err = ubi_scan_finish(ubi, si);
+	if (err)
+		goto out_buf;
+
+	vfree(buf);
+	ubi_free_vid_hdr(ubi, vh);
+	kfree(ech);
+
+	ubi->fm = fm;
+	ubi_msg("attaching by fastmap in PEB %d", anchor);
+
+	return si;
+
+out_buf:
+	vfree(buf);
+out:
+	if (si)
+		ubi_scan_destroy_si(si);
+	if (anchor >= 0)
+		ubi_warn("cannot attach by fastmap, error %d", err);
+	ubi->fm = fm;
+	ubi_fastmap_close(ubi);
+	ubi_free_vid_hdr(ubi, vh);
+	kfree(ech);
+
+	return ERR_PTR(err);
+}
+
+static void fm_put_ec(void *buf, int *pos, struct ubi_wl_entry *e)
+{
+	struct ubi_fm_ec *fmec = buf + *pos;
+
+	fmec->pnum = cpu_to_be32(e->pnum);
+	fmec->ec = cpu_to_be32(e->ec);
+	*pos += sizeof(*fmec);
+}
+
+/* Write the state of the WL unit and the EBA tables to the PEBs in @fm */
+static int fm_write(struct ubi_device *ubi, struct ubi_fastmap_layout *fm)
+{
+	struct ubi_fm_sb *fmsb;
+	struct ubi_fm_hdr *fmh;
+	struct ubi_fm_scan_pool *fmpl;
+	struct ubi_fm_volhdr *fmvh;
+	struct ubi_fm_eba *fmeba;
+	struct ubi_wl_prot_entry *pe;
+	struct ubi_wl_entry *e;
+	struct ubi_volume *vol;
+	struct ubi_vid_hdr *vh;
+	struct rb_node *rb;
+	void *buf;
+	int pos = 0, i, j, count, total = 0, vol_count = 0, err = -ENOMEM;
+
+	buf = vmalloc(ubi->fm_size);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!buf || !vh)
+		goto out;
+
+	memset(buf, 0, ubi->fm_size);
+
+	fmsb = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmsb));
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->used_blocks = cpu_to_be32(fm->used_blocks);
+	/* The sequence number is taken from the VID headers when reading */
+	fmsb->sqnum = 0;
+
+	fmh = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmh));
+	fmh->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+
+	/* Empty pools, with the sizes Linux uses */
+	fmpl = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmpl));
+	fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+	fmpl->max_size = cpu_to_be16(clamp(ubi->peb_count / 100 * 5,
+			UBI_FM_MIN_POOL_SIZE, UBI_FM_MAX_POOL_SIZE));
+
+	fmpl = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmpl));
+	fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+	fmpl->max_size = cpu_to_be16(UBI_FM_WL_POOL_SIZE);
+
+	count = 0;
+	ubi_rb_for_each_entry(rb, e, &ubi->free, rb) {
+		fm_put_ec(buf, &pos, e);
+		count++;
+	}
+	fmh->free_peb_count = cpu_to_be32(count);
+	total += count;
+
+	count = 0;
+	ubi_rb_for_each_entry(rb, e, &ubi->used, rb) {
+		fm_put_ec(buf, &pos, e);
+		count++;
+	}
+	ubi_rb_for_each_entry(rb, pe, &ubi->prot.pnum, rb_pnum) {
+		fm_put_ec(buf, &pos, pe->e);
+		count++;
+	}
+	fmh->used_peb_count = cpu_to_be32(count);
+	total += count;
+
+	count = 0;
+	ubi_rb_for_each_entry(rb, e, &ubi->scrub, rb) {
+		fm_put_ec(buf, &pos, e);
+		count++;
+	}
+	fmh->scrub_peb_count = cpu_to_be32(count);
+	total += count;
+
+	/* There are no pending erasures, the works have been flushed */
+	fmh->erase_peb_count = 0;
+
+	if (total + fm->used_blocks != ubi->good_peb_count) {
+		ubi_err("fastmap knows %d of %d PEBs", total + fm->used_blocks,
+			ubi->good_peb_count);
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		fmvh = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmvh));
+		fmeba = fm_next(buf, ubi->fm_size, &pos, sizeof(*fmeba));
+		if (!fmvh || !fmeba ||
+		    !fm_next(buf, ubi->fm_size, &pos,
+			     vol->reserved_pebs * sizeof(__be32))) {
+			ubi_err("too many volumes for the fastmap");
+			err = -ENOSPC;
+			goto out;
+		}
+
+		fmvh->magic = cpu_to_be32(UBI_FM_VHDR_MAGIC);
+		fmvh->vol_id = cpu_to_be32(vol->vol_id);
+		fmvh->vol_type = vol->vol_type;
+		fmvh->used_ebs = cpu_to_be32(vol->used_ebs);
+		fmvh->data_pad = cpu_to_be32(vol->data_pad);
+		fmvh->last_eb_bytes = cpu_to_be32(vol->last_eb_bytes);
+
+		fmeba->magic = cpu_to_be32(UBI_FM_EBA_MAGIC);
+		fmeba->reserved_pebs = cpu_to_be32(vol->reserved_pebs);
+		for (j = 0; j < vol->reserved_pebs; j++)
+			fmeba->pnum[j] = cpu_to_be32(vol->eba_tbl[j]);
+
+		vol_count++;
+	}
+
+	fmh->vol_count = cpu_to_be32(vol_count);
+	fmh->bad_peb_count = cpu_to_be32(ubi->bad_peb_count);
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		fmsb->block_loc[i] = cpu_to_be32(fm->e[i]->pnum);
+		fmsb->block_ec[i] = cpu_to_be32(fm->e[i]->ec);
+	}
+
+	fmsb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, buf, ubi->fm_size));
+
+	/* UBI implementations without fastmap support delete the fastmap */
+	vh->vol_type = UBI_VID_DYNAMIC;
+	vh->compat = UBI_COMPAT_DELETE;
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		vh->vol_id = cpu_to_be32(i ? UBI_FM_DATA_VOLUME_ID :
+					     UBI_FM_SB_VOLUME_ID);
+		vh->lnum = cpu_to_be32(i);
+		vh->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+
+		err = ubi_io_write_vid_hdr(ubi, fm->e[i]->pnum, vh);
+		if (err)
+			goto out;
+
+		err = ubi_io_write(ubi, buf + i * ubi->leb_size,
+				   fm->e[i]->pnum, ubi->leb_start,
+				   ubi->leb_size);
+		if (err)
+			goto out;
+	}
+
+	dbg_bld("fastmap written to PEB %d", fm->e[0]->pnum);
+out:
+	ubi_free_vid_hdr(ubi, vh);
+	vfree(buf);
+
+	return err;
+}
+
+/**
+ * ubi_update_fastmap - write a new fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function writes a fastmap describing the current state of the device
+ * unless the fastmap on the flash is still valid. It returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubi_update_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm;
+	int i, err;
+
+	if (ubi->fm_disabled || ubi->ro_mode || ubi->fm)
+		return 0;
+
+	err = ubi_wl_flush(ubi);
+	if (err)
+		goto out_warn;
+
+	fm = kzalloc(sizeof(*fm), GFP_KERNEL);
+	if (!fm) {
+		err = -ENOMEM;
+		goto out_warn;
+	}
+
+	for (i = 0; i < ubi->fm_size / ubi->leb_size; i++) {
+		fm->e[i] = ubi_wl_get_fm_peb(ubi, i == 0);
+		if (!fm->e[i]) {
+			ubi_err("no free PEB for the fastmap");
+			err = -ENOSPC;
+			goto out_put;
+		}
+		fm->used_blocks = i + 1;
+	}
+
+	err = fm_write(ubi, fm);
+	if (err)
+		goto out_put;
+
+	ubi->fm = fm;
+
+	return 0;
+
+out_put:
+	for (i = 0; i < fm->used_blocks; i++)
+		ubi_wl_put_fm_peb(ubi, fm->e[i]);
+	kfree(fm);
+out_warn:
+	ubi_warn("cannot write fastmap, error %d", err);
+
+	return err;
+}
+
+/**
+ * ubi_fastmap_invalidate - invalidate the fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before the flash is changed in a way the
+ * fastmap does not know about. The fastmap PEBs are erased, the anchor first,
+ * and given back to the WL unit. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+int ubi_fastmap_invalidate(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm = ubi->fm;
+	int i, err;
+
+	if (!fm)
+		return 0;
+
+	/* Erasing may start wear-leveling, which invalidates again */
+	ubi->fm = NULL;
+
+	err = ubi_wl_put_fm_peb(ubi, fm->e[0]);
+	if (err) {
+		ubi->fm = fm;
+		return err;
+	}
+
+	for (i = 1; i < fm->used_blocks; i++)
+		ubi_wl_put_fm_peb(ubi, fm->e[i]);
+
+	kfree(fm);
+
+	return ubi->ro_mode ? -EROFS : 0;
+}
+
+/**
+ * ubi_fastmap_invalidate_scan - invalidate the fastmap while attaching.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * Like ubi_fastmap_invalidate(), but for the time before the WL unit is
+ * initialized. The anchor is erased right away and put to the free list, the
+ * other fastmap PEBs go to the erase list.
+ */
+int ubi_fastmap_invalidate_scan(struct ubi_device *ubi,
+				struct ubi_scan_info *si)
+{
+	struct ubi_fastmap_layout *fm = ubi->fm;
+	struct ubi_wl_entry *e;
+	int i, err;
+
+	if (!fm)
+		return 0;
+
+	e = fm->e[0];
+	err = ubi_scan_erase_peb(ubi, si, e->pnum, e->ec + 1);
+	if (err)
+		return err;
+
+	err = fm_add_to_list(&si->free, e->pnum, e->ec + 1);
+	for (i = 1; i < fm->used_blocks && !err; i++)
+		err = fm_add_to_list(&si->erase, fm->e[i]->pnum,
+				     fm->e[i]->ec);
+
+	ubi_fastmap_close(ubi);
+
+	return err;
+}
+
+/**
+ * ubi_fastmap_close - free the in-memory fastmap.
+ * @ubi: UBI device description object
+ */
+void ubi_fastmap_close(struct ubi_device *ubi)
+{
+	int i;
+
+	if (!ubi->fm)
+		return;
+
+	for (i = 0; i < ubi->fm->used_blocks; i++)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->fm->e[i]);
+
+	kfree(ubi->fm);
+	ubi->fm = NULL;
+}
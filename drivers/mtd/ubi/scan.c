@@ -701,6 +701,11 @@ struct ubi_scan_leb *ubi_scan_get_free_peb(struct ubi_device *ubi,
 	int err = 0, i;
 	struct ubi_scan_leb *seb;
 
+	/* The fastmap does not know about the PEB we are going to write */
+	err = ubi_fastmap_invalidate_scan(ubi, si);
+	if (err)
+		return ERR_PTR(err);
+
 	if (!list_empty(&si->free)) {
 		seb = list_entry(si->free.next, struct ubi_scan_leb, u.list);
 		list_del(&seb->u.list);
@@ -894,23 +899,18 @@ adjust_mean_ec:
 }
 
 /**
- * ubi_scan - scan an MTD device.
- * @ubi: UBI device description object
+ * ubi_scan_alloc_si - allocate empty scanning information.
  *
- * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * This function returns the new scanning information or %NULL if there is no
+ * memory.
  */
-struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+struct ubi_scan_info *ubi_scan_alloc_si(void)
 {
-	int err, pnum;
-	struct rb_node *rb1, *rb2;
-	struct ubi_scan_volume *sv;
-	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
 
 	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
 	if (!si)
-		return ERR_PTR(-ENOMEM);
+		return NULL;
 
 	INIT_LIST_HEAD(&si->corr);
 	INIT_LIST_HEAD(&si->free);
@@ -919,27 +919,64 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	si->volumes = RB_ROOT;
 	si->is_empty = 1;
 
-	err = -ENOMEM;
+	return si;
+}
+
+/**
+ * ubi_scan_pebs - scan physical eraseblocks.
+ * @ubi: UBI device description object
+ * @si: scanning information to add the results to
+ * @pebs: the physical eraseblocks to scan, %NULL to scan PEBs 0 to @count - 1
+ * @count: number of physical eraseblocks to scan
+ *
+ * This function returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+int ubi_scan_pebs(struct ubi_device *ubi, struct ubi_scan_info *si,
+		  const int *pebs, int count)
+{
+	int err = -ENOMEM, i;
+
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
 	if (!ech)
-		goto out_si;
+		return err;
 
 	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vidh)
 		goto out_ech;
 
-	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+	err = 0;
+	for (i = 0; i < count; i++) {
 		cond_resched();
 
-//		dbg_msg("process PEB %d", pnum);
-		err = process_eb(ubi, si, pnum);
+		err = process_eb(ubi, si, pebs ? pebs[i] : i);
 		if(err < 0)
 			printf("err: %d\n", err);
 		if (err < 0)
-			goto out_vidh;
+			break;
 	}
 
-	dbg_msg("scanning is finished");
+	ubi_free_vid_hdr(ubi, vidh);
+out_ech:
+	kfree(ech);
+	return err;
+}
+
+/**
+ * ubi_scan_finish - finish scanning information.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * This function calculates the mean erase counter and assigns it to the
+ * physical eraseblocks whose erase counter is unknown. It returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+int ubi_scan_finish(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err;
+	struct rb_node *rb1, *rb2;
+	struct ubi_scan_volume *sv;
+	struct ubi_scan_leb *seb;
 
 	/* Calculate mean erase counter */
 	if (si->ec_count) {
@@ -974,21 +1011,40 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 			seb->ec = si->mean_ec;
 
 	err = paranoid_check_si(ubi, si);
-	if (err) {
-		if (err > 0)
-			err = -EINVAL;
-		goto out_vidh;
-	}
+	if (err > 0)
+		err = -EINVAL;
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+	return err;
+}
+
+/**
+ * ubi_scan - scan an MTD device.
+ * @ubi: UBI device description object
+ *
+ * This function does full scanning of an MTD device and returns complete
+ * information about it. In case of failure, an error code is returned.
+ */
+struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+{
+	int err;
+	struct ubi_scan_info *si;
+
+	si = ubi_scan_alloc_si();
+	if (!si)
+		return ERR_PTR(-ENOMEM);
+
+	err = ubi_scan_pebs(ubi, si, NULL, ubi->peb_count);
+	if (err)
+		goto out_si;
+
+	dbg_msg("scanning is finished");
+
+	err = ubi_scan_finish(ubi, si);
+	if (err)
+		goto out_si;
 
 	return si;
 
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
 out_si:
 	ubi_scan_destroy_si(si);
 	return ERR_PTR(err);
@@ -116,6 +116,36 @@ struct ubi_wl_entry {
 	int pnum;
 };
 
+/**
+ * struct ubi_wl_prot_entry - PEB protection entry.
+ * @rb_pnum: link in the @wl->prot.pnum RB-tree
+ * @rb_aec: link in the @wl->prot.aec RB-tree
+ * @abs_ec: the absolute erase counter value when the protection ends
+ * @e: the wear-leveling entry of the physical eraseblock under protection
+ *
+ * See WL unit for details.
+ */
+struct ubi_wl_prot_entry {
+	struct rb_node rb_pnum;
+	struct rb_node rb_aec;
+	unsigned long long abs_ec;
+	struct ubi_wl_entry *e;
+};
+
+/**
+ * struct ubi_fastmap_layout - in-memory fastmap data structure.
+ * @e: the wear-leveling entries of the PEBs used by the fastmap, the anchor
+ *     PEB with the super block first
+ * @used_blocks: number of PEBs used by the fastmap
+ *
+ * The PEBs of the fastmap are not in any of the WL RB-trees, they are only
+ * known by the lookup table.
+ */
+struct ubi_fastmap_layout {
+	struct ubi_wl_entry *e[UBI_FM_MAX_BLOCKS];
+	int used_blocks;
+};
+
 /**
  * struct ubi_ltree_entry - an entry in the lock tree.
  * @rb: links RB-tree nodes
@@ -340,6 +370,11 @@ struct ubi_wl_entry;
  * @buf_mutex: proptects @peb_buf1 and @peb_buf2
  * @dbg_peb_buf: buffer of PEB size used for debugging
  * @dbg_buf_mutex: proptects @dbg_peb_buf
+ *
+ * @fm: in-memory copy of the fastmap on the flash, %NULL if there is no
+ *      fastmap or it has been invalidated
+ * @fm_size: size of a fastmap in bytes, a multiple of @leb_size
+ * @fm_disabled: if no fastmap is written for this device
  */
 struct ubi_device {
 	struct cdev cdev;
@@ -422,6 +457,10 @@ struct ubi_device {
 	void *dbg_peb_buf;
 	struct mutex dbg_buf_mutex;
 #endif
+
+	struct ubi_fastmap_layout *fm;
+	int fm_size;
+	int fm_disabled;
 };
 
 extern struct kmem_cache *ubi_wl_entry_slab;
@@ -486,6 +525,7 @@ int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_eba_close(const struct ubi_device *ubi);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -495,6 +535,26 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor);
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e);
+
+/* fastmap.c */
+#ifdef CONFIG_MTD_UBI_FASTMAP
+int ubi_calc_fm_size(struct ubi_device *ubi);
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi);
+int ubi_update_fastmap(struct ubi_device *ubi);
+int ubi_fastmap_invalidate(struct ubi_device *ubi);
+int ubi_fastmap_invalidate_scan(struct ubi_device *ubi,
+				struct ubi_scan_info *si);
+void ubi_fastmap_close(struct ubi_device *ubi);
+#else
+#define ubi_calc_fm_size(ubi) 0
+#define ubi_scan_fastmap(ubi) ERR_PTR(-ENOSYS)
+#define ubi_update_fastmap(ubi) 0
+#define ubi_fastmap_invalidate(ubi) 0
+#define ubi_fastmap_invalidate_scan(ubi, si) 0
+#define ubi_fastmap_close(ubi)
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -117,12 +117,8 @@
  */
 #define WL_MAX_FAILURES 32
 
-/**
- * struct ubi_wl_prot_entry - PEB protection entry.
- * @rb_pnum: link in the @wl->prot.pnum RB-tree
- * @rb_aec: link in the @wl->prot.aec RB-tree
- * @abs_ec: the absolute erase counter value when the protection ends
- * @e: the wear-leveling entry of the physical eraseblock under protection
+/*
+ * Protection of physical eraseblocks, see &struct ubi_wl_prot_entry.
  *
  * When the WL unit returns a physical eraseblock, the physical eraseblock is
  * protected from being moved for some "time". For this reason, the physical
@@ -164,12 +160,6 @@
  * Depending on the sub-state, wear-leveling entries of the used physical
  * eraseblocks may be kept in one of those trees.
  */
-struct ubi_wl_prot_entry {
-	struct rb_node rb_pnum;
-	struct rb_node rb_aec;
-	unsigned long long abs_ec;
-	struct ubi_wl_entry *e;
-};
 
 /**
  * struct ubi_work - UBI work description data structure.
@@ -449,6 +439,10 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 	ubi_assert(dtype == UBI_LONGTERM || dtype == UBI_SHORTTERM ||
 		   dtype == UBI_UNKNOWN);
 
+	err = ubi_fastmap_invalidate(ubi);
+	if (err)
+		return err;
+
 	pe = kmalloc(sizeof(struct ubi_wl_prot_entry), GFP_NOFS);
 	if (!pe)
 		return -ENOMEM;
@@ -758,6 +752,10 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	if (cancel)
 		return 0;
 
+	err = ubi_fastmap_invalidate(ubi);
+	if (err)
+		return err;
+
 	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_NOFS);
 	if (!vid_hdr)
 		return -ENOMEM;
@@ -1161,6 +1159,10 @@ int ubi_wl_put_peb(struct ubi_device *ubi, int pnum, int torture)
 	ubi_assert(pnum >= 0);
 	ubi_assert(pnum < ubi->peb_count);
 
+	err = ubi_fastmap_invalidate(ubi);
+	if (err)
+		return err;
+
 retry:
 	spin_lock(&ubi->wl_lock);
 	e = ubi->lookuptbl[pnum];
@@ -1234,9 +1236,14 @@ retry:
 int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum)
 {
 	struct ubi_wl_entry *e;
+	int err;
 
 	ubi_msg("schedule PEB %d for scrubbing", pnum);
 
+	err = ubi_fastmap_invalidate(ubi);
+	if (err)
+		return err;
+
 retry:
 	spin_lock(&ubi->wl_lock);
 	e = ubi->lookuptbl[pnum];
@@ -1262,8 +1269,6 @@ retry:
 		paranoid_check_in_wl_tree(e, &ubi->used);
 		rb_erase(&e->rb, &ubi->used);
 	} else {
-		int err;
-
 		err = prot_tree_del(ubi, e->pnum);
 		if (err) {
 			ubi_err("PEB %d not found", pnum);
@@ -1283,6 +1288,49 @@ retry:
 	return ensure_wear_leveling(ubi);
 }
 
+/**
+ * ubi_wl_get_fm_peb - get a physical eraseblock for the fastmap.
+ * @ubi: UBI device description object
+ * @anchor: if the physical eraseblock is for the fastmap super block
+ *
+ * This function takes the free physical eraseblock with the lowest erase
+ * counter out of the free tree. The anchor PEB has to be one of the first
+ * %UBI_FM_MAX_START PEBs. Returns %NULL if there is no suitable physical
+ * eraseblock.
+ */
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, rb) {
+		if (anchor && e->pnum >= UBI_FM_MAX_START)
+			continue;
+
+		rb_erase(&e->rb, &ubi->free);
+		spin_unlock(&ubi->wl_lock);
+		return e;
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	return NULL;
+}
+
+/**
+ * ubi_wl_put_fm_peb - return a fastmap physical eraseblock.
+ * @ubi: UBI device description object
+ * @e: the wear-leveling entry of the physical eraseblock
+ *
+ * The physical eraseblock is erased and goes back to the free tree. This
+ * function returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	return schedule_erase(ubi, e, 0);
+}
+
 /**
  * ubi_wl_flush - flush all pending works.
  * @ubi: UBI device description object
@@ -1441,7 +1489,7 @@ static void cancel_pending(struct ubi_device *ubi)
  */
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 {
-	int err;
+	int err, i;
 	struct rb_node *rb1, *rb2;
 	struct ubi_scan_volume *sv;
 	struct ubi_scan_leb *seb, *tmp;
@@ -1532,6 +1580,14 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		}
 	}
 
+	/* The PEBs of the fastmap we attached from are not in any tree */
+	if (ubi->fm) {
+		for (i = 0; i < ubi->fm->used_blocks; i++) {
+			e = ubi->fm->e[i];
+			ubi->lookuptbl[e->pnum] = e;
+		}
+	}
+
 	if (ubi->avail_pebs < WL_RESERVED_PEBS) {
 		ubi_err("no enough physical eraseblocks (%d, need %d)",
 			ubi->avail_pebs, WL_RESERVED_PEBS);
@@ -1540,6 +1596,20 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	ubi->avail_pebs -= WL_RESERVED_PEBS;
 	ubi->rsvd_pebs += WL_RESERVED_PEBS;
 
+	if (!ubi->fm_disabled) {
+		int fm_pebs = ubi->fm_size / ubi->leb_size;
+
+		if (ubi->avail_pebs < fm_pebs) {
+			ubi_warn("no enough physical eraseblocks for fastmap "
+				 "(%d, need %d), disable it",
+				 ubi->avail_pebs, fm_pebs);
+			ubi->fm_disabled = 1;
+		} else {
+			ubi->avail_pebs -= fm_pebs;
+			ubi->rsvd_pebs += fm_pebs;
+		}
+	}
+
 	/* Schedule wear-leveling if needed */
 	err = ensure_wear_leveling(ubi);
 	if (err)
@@ -1601,6 +1671,7 @@ void ubi_wl_close(struct ubi_device *ubi)
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
+	ubi_fastmap_close(ubi);
 	kfree(ubi->lookuptbl);
 }
 
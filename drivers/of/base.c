@@ -49,7 +49,19 @@ struct alias_prop {
 
 static LIST_HEAD(aliases_lookup);
 
-static LIST_HEAD(phandle_list);
+/*
+ * Nodes of the live tree indexed by their phandle. Phandles are usually
+ * allocated sequentially by dtc, so the low bits make a good hash.
+ */
+#define OF_PHANDLE_HASH_BITS	8
+#define OF_PHANDLE_HASH_SIZE	(1 << OF_PHANDLE_HASH_BITS)
+
+static struct hlist_head phandle_hash[OF_PHANDLE_HASH_SIZE];
+
+static inline struct hlist_head *of_phandle_bucket(phandle phandle)
+{
+	return &phandle_hash[phandle & (OF_PHANDLE_HASH_SIZE - 1)];
+}
 
 struct device_node *root_node;
 
@@ -162,7 +174,7 @@ static void of_alias_scan(void)
 		    !strcmp(pp->name, "linux,phandle"))
 			continue;
 
-		np = of_find_node_by_path(root_node, pp->value);
+		np = of_find_node_by_path(root_node, of_property_get_value(pp));
 		if (!np)
 			continue;
 
@@ -237,17 +249,77 @@ u64 of_translate_address(struct device_node *node, const __be32 *in_addr)
 }
 EXPORT_SYMBOL(of_translate_address);
 
+/*
+ * A property referring to an external blob is about to get a value of
+ * its own. Copy the name so that it no longer depends on the blob.
+ */
+static void of_property_make_private(struct property *pp)
+{
+	if (!pp->value_const)
+		return;
+
+	pp->name = xstrdup(pp->name);
+	pp->value_const = NULL;
+}
+
+static void of_phandle_hash_add(struct device_node *node)
+{
+	hlist_del_init(&node->phandle_hash);
+
+	if (node->phandle)
+		hlist_add_head(&node->phandle_hash,
+				of_phandle_bucket(node->phandle));
+}
+
+/*
+ * Update the cached phandle of a node whenever its phandle property
+ * is created or changed.
+ */
+static void of_property_update_phandle(struct device_node *node,
+		struct property *pp)
+{
+	if (strcmp(pp->name, "phandle") && strcmp(pp->name, "linux,phandle"))
+		return;
+
+	if (pp->length != sizeof(__be32))
+		return;
+
+	node->phandle = be32_to_cpup(of_property_get_value(pp));
+
+	if (!hlist_unhashed(&node->phandle_hash))
+		of_phandle_hash_add(node);
+}
+
 /*
  * of_find_node_by_phandle - Find a node given a phandle
  * @handle:    phandle of the node to find
+ *
+ * The phandle hash is filled when a tree is set as root node. Nodes
+ * merged into the live tree later are picked up by walking the tree
+ * once and are hashed from then on.
  */
 struct device_node *of_find_node_by_phandle(phandle phandle)
 {
 	struct device_node *node;
+	struct hlist_node *h;
 
-	list_for_each_entry(node, &phandle_list, phandles)
+	if (!phandle)
+		return NULL;
+
+	hlist_for_each_entry(node, h, of_phandle_bucket(phandle), phandle_hash)
 		if (node->phandle == phandle)
 			return node;
+
+	if (!root_node)
+		return NULL;
+
+	of_tree_for_each_node(node, root_node) {
+		if (node->phandle == phandle) {
+			of_phandle_hash_add(node);
+			return node;
+		}
+	}
+
 	return NULL;
 }
 EXPORT_SYMBOL(of_find_node_by_phandle);
@@ -267,7 +339,7 @@ const void *of_get_property(const struct device_node *np, const char *name,
 	if (lenp)
 		*lenp = pp->length;
 
-	return pp ? pp->value : NULL;
+	return of_property_get_value(pp);
 }
 EXPORT_SYMBOL(of_get_property);
 
@@ -337,12 +409,12 @@ int of_property_read_u32_array(const struct device_node *np,
 
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	val = of_property_get_value(prop);
+	if (!val)
 		return -ENODATA;
 	if ((sz * sizeof(*out_values)) > prop->length)
 		return -EOVERFLOW;
 
-	val = prop->value;
 	while (sz--)
 		*out_values++ = be32_to_cpup(val++);
 	return 0;
@@ -361,12 +433,16 @@ int of_property_write_u32_array(struct device_node *np,
 	if (!prop)
 		return -ENOMEM;
 
+	of_property_make_private(prop);
+
 	free(prop->value);
 
 	prop->value = malloc(sizeof(__be32) * sz);
 	if (!prop->value)
 		return -ENOMEM;
 
+	prop->length = sizeof(__be32) * sz;
+
 	val = prop->value;
 
 	while (sz--)
@@ -505,45 +581,65 @@ int of_machine_is_compatible(const char *compat)
 }
 EXPORT_SYMBOL(of_machine_is_compatible);
 
+static struct device_node *of_find_child_by_namen(struct device_node *node,
+		const char *name, int len)
+{
+	struct device_node *_n;
+
+	device_node_for_nach_child(node, _n)
+		if (!strncmp(_n->name, name, len) && !_n->name[len])
+			return _n;
+
+	return NULL;
+}
+
+static struct device_node *of_find_node_by_alias(const char *alias)
+{
+	struct alias_prop *app;
+
+	list_for_each_entry(app, &aliases_lookup, link)
+		if (!strcmp(app->alias, alias))
+			return app->np;
+
+	return NULL;
+}
+
 /**
  *	of_find_node_by_path - Find a node matching a full OF path
  *	@root:	The root node of this tree
  *	@path:	The full path to match
  *
+ *	For the live tree @path may also be an alias name. It is
+ *	resolved through the table built by of_alias_scan().
+ *
  *	Returns a node pointer with refcount incremented, use
  *	of_node_put() on it when done.
  */
 struct device_node *of_find_node_by_path(struct device_node *root, const char *path)
 {
-	char *slash, *p, *freep;
+	const char *slash;
 	struct device_node *dn = root;
+	int len;
 
-	if (*path != '/')
+	if (*path != '/') {
+		if (root && root == root_node)
+			return of_find_node_by_alias(path);
 		return NULL;
+	}
 
 	path++;
 
-	freep = p = xstrdup(path);
+	while (dn && *path) {
+		slash = strchr(path, '/');
+		len = slash ? slash - path : strlen(path);
 
-	while (1) {
-		if (!*p)
-			goto out;
-
-		slash = strchr(p, '/');
-		if (slash)
-			*slash = 0;
-
-		dn = of_find_child_by_name(dn, p);
-		if (!dn)
-			goto out;
+		dn = of_find_child_by_namen(dn, path, len);
 
 		if (!slash)
-			goto out;
+			break;
 
-		p = slash + 1;
+		path = slash + 1;
 	}
-out:
-	free(freep);
 
 	return dn;
 }
@@ -568,13 +664,16 @@ int of_property_read_string(struct device_node *np, const char *propname,
 				const char **out_string)
 {
 	struct property *prop = of_find_property(np, propname);
+	const char *value;
+
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	value = of_property_get_value(prop);
+	if (!value)
 		return -ENODATA;
-	if (strnlen(prop->value, prop->length) >= prop->length)
+	if (strnlen(value, prop->length) >= prop->length)
 		return -EILSEQ;
-	*out_string = prop->value;
+	*out_string = value;
 	return 0;
 }
 EXPORT_SYMBOL_GPL(of_property_read_string);
@@ -586,11 +685,19 @@ struct device_node *of_get_root_node(void)
 
 int of_set_root_node(struct device_node *node)
 {
+	struct device_node *n;
+
 	if (node && root_node)
 		return -EBUSY;
 
 	root_node = node;
 
+	if (node) {
+		of_phandle_hash_add(node);
+		of_tree_for_each_node(n, node)
+			of_phandle_hash_add(n);
+	}
+
 	of_alias_scan();
 
 	return 0;
@@ -602,7 +709,7 @@ static int of_node_disabled(struct device_node *node)
 
 	p = of_find_property(node, "status");
 	if (p) {
-		if (!strcmp("disabled", p->value))
+		if (!strcmp("disabled", of_property_get_value(p)))
 			return 1;
 	}
 	return 0;
@@ -629,7 +736,7 @@ void of_print_nodes(struct device_node *node, int indent)
 		for (i = 0; i < indent + 1; i++)
 			printf("\t");
 		printf("%s: ", p->name);
-		of_print_property(p->value, p->length);
+		of_print_property(of_property_get_value(p), p->length);
 		printf("\n");
 	}
 
@@ -683,18 +790,55 @@ struct property *of_new_property(struct device_node *node, const char *name,
 
 	list_add_tail(&prop->list, &node->properties);
 
+	of_property_update_phandle(node, prop);
+
 	return prop;
 }
 
-void of_delete_property(struct property *pp)
+/**
+ * of_new_property_const - create a property without copying its contents
+ * @node - the node to add the property to
+ * @name - the name of the property
+ * @data - the value of the property
+ * @len - the length of the value
+ *
+ * @name and @data are referenced, not copied, so they must stay valid
+ * for the lifetime of the property. This is used to unflatten a blob
+ * which is not freed afterwards.
+ */
+struct property *of_new_property_const(struct device_node *node,
+		const char *name, const void *data, int len)
 {
-	list_del(&pp->list);
+	struct property *prop;
+
+	prop = xzalloc(sizeof(*prop));
+
+	prop->name = (char *)name;
+	prop->length = len;
+	prop->value_const = data;
+
+	list_add_tail(&prop->list, &node->properties);
+
+	of_property_update_phandle(node, prop);
+
+	return prop;
+}
 
-	free(pp->name);
+static void of_property_free(struct property *pp)
+{
+	if (!pp->value_const)
+		free(pp->name);
 	free(pp->value);
 	free(pp);
 }
 
+void of_delete_property(struct property *pp)
+{
+	list_del(&pp->list);
+
+	of_property_free(pp);
+}
+
 /**
  * of_set_property - create a property for a given node
  * @node - the node
@@ -715,11 +859,15 @@ int of_set_property(struct device_node *np, const char *name, const void *val, i
 	if (pp) {
 		void *data;
 
+		of_property_make_private(pp);
+
 		free(pp->value);
 		data = xzalloc(len);
 		memcpy(data, val, len);
 		pp->value = data;
 		pp->length = len;
+
+		of_property_update_phandle(np, pp);
 	} else {
 		if (!create)
 			return -ENOENT;
@@ -873,15 +1021,8 @@ static int add_of_device_resource(struct device_node *node)
 	u64 address, size;
 	struct resource *res;
 	struct device_d *dev;
-	phandle phandle;
 	int ret;
 
-	ret = of_property_read_u32(node, "phandle", &phandle);
-	if (!ret) {
-		node->phandle = phandle;
-		list_add_tail(&node->phandles, &phandle_list);
-	}
-
 	ret = of_add_memory(node, false);
 	if (ret != -ENXIO)
 		return ret;
@@ -890,11 +1031,11 @@ static int add_of_device_resource(struct device_node *node)
 	if (!reg)
 		return -ENODEV;
 
-	address = of_translate_address(node, reg->value);
+	address = of_translate_address(node, of_property_get_value(reg));
 	if (address == OF_BAD_ADDR)
 		return -EINVAL;
 
-	size = be32_to_cpu(((u32 *)reg->value)[1]);
+	size = be32_to_cpu(((const u32 *)of_property_get_value(reg))[1]);
 
 	/*
 	 * A device may already be registered as platform_device.
@@ -933,12 +1074,8 @@ void of_free(struct device_node *node)
 	if (!node)
 		return;
 
-	list_for_each_entry_safe(p, pt, &node->properties, list) {
-		list_del(&p->list);
-		free(p->name);
-		free(p->value);
-		free(p);
-	}
+	list_for_each_entry_safe(p, pt, &node->properties, list)
+		of_delete_property(p);
 
 	list_for_each_entry_safe(n, nt, &node->children, parent_list) {
 		of_free(n);
@@ -949,6 +1086,8 @@ void of_free(struct device_node *node)
 		list_del(&node->list);
 	}
 
+	hlist_del_init(&node->phandle_hash);
+
 	if (node->device)
 		node->device->device_node = NULL;
 	else
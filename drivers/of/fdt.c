@@ -46,15 +46,8 @@ static inline char *dt_string(struct fdt_header *f, char *strstart, uint32_t ofs
 		return strstart + ofs;
 }
 
-/**
- * of_unflatten_dtb - unflatten a dtb binary blob
- * @root - node in which the fdt blob should be merged into or NULL
- * @infdt - the fdt blob to unflatten
- *
- * Parse a flat device tree binary blob and return a pointer to the
- * unflattened tree.
- */
-struct device_node *of_unflatten_dtb(struct device_node *root, void *infdt)
+static struct device_node *__of_unflatten_dtb(struct device_node *root,
+		void *infdt, int constprops)
 {
 	const void *nodep;	/* property node pointer */
 	uint32_t tag;		/* tag */
@@ -178,10 +171,12 @@ struct device_node *of_unflatten_dtb(struct device_node *root, void *infdt)
 				goto err;
 			}
 
-			if (merge && (p = of_find_property(node, name))) {
-				free(p->value);
-				p->value = xzalloc(len);
-				memcpy(p->value, nodep, len);
+			if (constprops) {
+				if (merge && (p = of_find_property(node, name)))
+					of_delete_property(p);
+				of_new_property_const(node, name, nodep, len);
+			} else if (merge) {
+				of_set_property(node, name, nodep, len, 1);
 			} else {
 				of_new_property(node, name, nodep, len);
 			}
@@ -212,13 +207,52 @@ err:
 	return ERR_PTR(ret);
 }
 
+/**
+ * of_unflatten_dtb - unflatten a dtb binary blob
+ * @root - node in which the fdt blob should be merged into or NULL
+ * @infdt - the fdt blob to unflatten
+ *
+ * Parse a flat device tree binary blob and return a pointer to the
+ * unflattened tree.
+ */
+struct device_node *of_unflatten_dtb(struct device_node *root, void *infdt)
+{
+	return __of_unflatten_dtb(root, infdt, 0);
+}
+
+/**
+ * of_unflatten_dtb_const - unflatten a dtb binary blob without copying
+ * @root - node in which the fdt blob should be merged into or NULL
+ * @infdt - the fdt blob to unflatten
+ *
+ * Like of_unflatten_dtb(), but property names and values are not copied.
+ * They point into @infdt which must stay valid as long as the tree is
+ * in use.
+ */
+struct device_node *of_unflatten_dtb_const(struct device_node *root,
+		void *infdt)
+{
+	return __of_unflatten_dtb(root, infdt, 1);
+}
+
+/*
+ * Property names are stored only once in the strings block. During the
+ * sizing pass every distinct name gets its offset in this hash.
+ */
+#define FDT_STRING_HASH_SIZE	256
+
+struct fdt_string {
+	struct hlist_node hash;
+	const char *str;
+	uint32_t ofs;
+};
+
 struct fdt {
 	void *dt;
 	uint32_t dt_nextofs;
 	uint32_t dt_size;
-	char *strings;
-	uint32_t str_nextofs;
 	uint32_t str_size;
+	struct hlist_head *strings;
 };
 
 static inline uint32_t dt_next_ofs(uint32_t curofs, uint32_t len)
@@ -226,210 +260,170 @@ static inline uint32_t dt_next_ofs(uint32_t curofs, uint32_t len)
 	return ALIGN(curofs + len, 4);
 }
 
-static int lstrcpy(char *dest, const char *src)
+static struct hlist_head *dt_string_bucket(struct fdt *fdt, const char *str)
 {
-	int len = 0;
-	int maxlen = 1023;
-
-	while (*src) {
-		*dest++ = *src++;
-		len++;
-		if (!maxlen)
-			return -ENOSPC;
-		maxlen--;
-	}
+	unsigned int hash = 0;
+
+	while (*str)
+		hash = hash * 31 + *str++;
 
-	return len;
+	return &fdt->strings[hash % FDT_STRING_HASH_SIZE];
 }
 
-static void *memalign_realloc(void *orig, size_t oldsize, size_t newsize)
+static struct fdt_string *dt_find_string(struct fdt *fdt, const char *str)
 {
-	int align;
-	void *newbuf;
+	struct fdt_string *s;
+	struct hlist_node *h;
 
-	/*
-	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
-	 * for mapping the devicetree, so we are not allowed to cross
-	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
-	 */
-	align = 1 << fls(newsize - 1);
-
-	if (!orig)
-		return memalign(align, newsize);
-
-	newbuf = memalign(align, newsize);
-	if (!newbuf) {
-		free(orig);
-		return NULL;
-	}
-
-	memcpy(newbuf, orig, oldsize);
-	free(orig);
-	memset(newbuf + oldsize, 0, newsize - oldsize);
+	hlist_for_each_entry(s, h, dt_string_bucket(fdt, str), hash)
+		if (!strcmp(s->str, str))
+			return s;
 
-	return newbuf;
+	return NULL;
 }
 
-static int fdt_ensure_space(struct fdt *fdt, int dtsize)
+static void dt_add_string(struct fdt *fdt, const char *str)
 {
-	/*
-	 * We assume strings and names have a maximum length of 1024
-	 * whereas properties can be longer. We allocate new memory
-	 * if we have less than 1024 bytes (+ the property size left.
-	 */
-	if (fdt->str_size - fdt->str_nextofs < 1024) {
-		fdt->strings = realloc(fdt->strings, fdt->str_size * 2);
-		if (!fdt->strings)
-			return -ENOMEM;
-		fdt->str_size *= 2;
-	}
+	struct fdt_string *s;
 
-	if (fdt->dt_size - fdt->dt_nextofs < 1024 + dtsize) {
-		fdt->dt = memalign_realloc(fdt->dt, fdt->dt_size,
-				fdt->dt_size * 2);
-		if (!fdt->dt)
-			return -ENOMEM;
-		fdt->dt_size *= 2;
-	}
+	if (dt_find_string(fdt, str))
+		return;
 
-	return 0;
+	s = xzalloc(sizeof(*s));
+	s->str = str;
+	s->ofs = fdt->str_size;
+	hlist_add_head(&s->hash, dt_string_bucket(fdt, str));
+
+	fdt->str_size += strlen(str) + 1;
 }
 
-static inline int dt_add_string(struct fdt *fdt, const char *str)
+/*
+ * First pass: calculate the size of the structure block and collect
+ * the strings block.
+ */
+static void __of_flatten_dtb_size(struct fdt *fdt, struct device_node *node)
 {
-	uint32_t ret;
-	int len;
-
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
+	struct property *p;
+	struct device_node *n;
 
-	len = lstrcpy(fdt->strings + fdt->str_nextofs, str);
-	if (len < 0)
-		return -ENOSPC;
+	fdt->dt_size = dt_next_ofs(fdt->dt_size,
+			sizeof(struct fdt_node_header) + strlen(node->name) + 1);
 
-	ret = fdt->str_nextofs;
+	list_for_each_entry(p, &node->properties, list) {
+		dt_add_string(fdt, p->name);
+		fdt->dt_size = dt_next_ofs(fdt->dt_size,
+				sizeof(struct fdt_property) + p->length);
+	}
 
-	fdt->str_nextofs += len + 1;
+	list_for_each_entry(n, &node->children, parent_list)
+		__of_flatten_dtb_size(fdt, n);
 
-	return ret;
+	fdt->dt_size += FDT_TAGSIZE;
 }
 
-static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
+/*
+ * Second pass: write the structure block into the preallocated blob.
+ */
+static void __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 {
 	struct property *p;
 	struct device_node *n;
-	int ret;
-	unsigned int len;
 	struct fdt_node_header *nh;
-
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
+	int len;
 
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_BEGIN_NODE);
-	len = lstrcpy(nh->name, node->name);
-	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs, 4 + len + 1);
+	len = strlen(node->name);
+	memcpy(nh->name, node->name, len + 1);
+	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
+			sizeof(struct fdt_node_header) + len + 1);
 
 	list_for_each_entry(p, &node->properties, list) {
 		struct fdt_property *fp;
 
-		if (fdt_ensure_space(fdt, p->length) < 0)
-			return -ENOMEM;
-
 		fp = fdt->dt + fdt->dt_nextofs;
 
 		fp->tag = cpu_to_fdt32(FDT_PROP);
 		fp->len = cpu_to_fdt32(p->length);
-		fp->nameoff = cpu_to_fdt32(dt_add_string(fdt, p->name));
-		memcpy(fp->data, p->value, p->length);
+		fp->nameoff = cpu_to_fdt32(dt_find_string(fdt, p->name)->ofs);
+		memcpy(fp->data, of_property_get_value(p), p->length);
 		fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
 				sizeof(struct fdt_property) + p->length);
 	}
 
-	list_for_each_entry(n, &node->children, parent_list) {
-		ret = __of_flatten_dtb(fdt, n);
-		if (ret)
-			return ret;
-	}
+	list_for_each_entry(n, &node->children, parent_list)
+		__of_flatten_dtb(fdt, n);
 
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_END_NODE);
-	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
-			sizeof(struct fdt_node_header));
-
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
-
-	return 0;
+	fdt->dt_nextofs += FDT_TAGSIZE;
 }
 
 /**
  * of_flatten_dtb - flatten a barebox internal devicetree to a dtb
  * @node - the root node of the tree to be unflattened
+ *
+ * The size of the resulting blob is calculated first, so the blob is
+ * allocated once with its final size and written in a single pass.
  */
 void *of_flatten_dtb(struct device_node *node)
 {
-	int ret;
-	struct fdt_header header = {};
+	struct fdt_header *header;
 	struct fdt fdt = {};
-	uint32_t ofs;
-	struct fdt_node_header *nh;
-
-	header.magic = cpu_to_fdt32(FDT_MAGIC);
-	header.version = cpu_to_fdt32(0x11);
-	header.last_comp_version = cpu_to_fdt32(0x10);
-
-	fdt.dt = xmemalign(SZ_64K, SZ_64K);
-	fdt.dt_size = SZ_64K;
-
-	fdt.strings = xzalloc(SZ_64K);
-	fdt.str_size = SZ_64K;
-
-	memset(fdt.dt, 0, SZ_64K);
-
-	ofs = sizeof(struct fdt_header);
-
-	header.off_mem_rsvmap = cpu_to_fdt32(ofs);
-	ofs += sizeof(struct fdt_reserve_entry) * OF_MAX_RESERVE_MAP;
-
-	fdt.dt_nextofs = ofs;
-
-	ret = __of_flatten_dtb(&fdt, node);
-	if (ret)
-		goto out_free;
-	nh = fdt.dt + fdt.dt_nextofs;
-	nh->tag = cpu_to_fdt32(FDT_END);
-	fdt.dt_nextofs = dt_next_ofs(fdt.dt_nextofs, sizeof(struct fdt_node_header));
-
-	header.size_dt_strings = cpu_to_fdt32(fdt.str_nextofs);
-	header.size_dt_struct = cpu_to_fdt32(fdt.dt_nextofs);
+	struct fdt_string *s;
+	struct hlist_node *h, *tmp;
+	uint32_t off_dt_struct, off_dt_strings, totalsize;
+	int i, align;
 
-	header.off_dt_struct = cpu_to_fdt32(ofs);
+	fdt.strings = xzalloc(sizeof(*fdt.strings) * FDT_STRING_HASH_SIZE);
 
-	header.off_dt_strings = cpu_to_fdt32(fdt.dt_nextofs);
+	__of_flatten_dtb_size(&fdt, node);
+	fdt.dt_size += FDT_TAGSIZE;
 
-	if (fdt.dt_size - fdt.dt_nextofs < fdt.str_nextofs) {
-		fdt.dt = memalign_realloc(fdt.dt, fdt.dt_size,
-				fdt.dt_nextofs + fdt.str_nextofs);
-		if (!fdt.dt)
-			goto out_free;
-	}
-
-	memcpy(fdt.dt + fdt.dt_nextofs, fdt.strings, fdt.str_nextofs);
-
-	header.totalsize = cpu_to_fdt32(fdt.dt_nextofs + fdt.str_nextofs);
+	off_dt_struct = sizeof(struct fdt_header) +
+		sizeof(struct fdt_reserve_entry) * OF_MAX_RESERVE_MAP;
+	off_dt_strings = off_dt_struct + fdt.dt_size;
+	totalsize = off_dt_strings + fdt.str_size;
 
-	memcpy(fdt.dt, &header, sizeof(header));
+	/*
+	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
+	 * for mapping the devicetree, so we are not allowed to cross
+	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
+	 */
+	align = 1 << fls(totalsize - 1);
+
+	fdt.dt = memalign(align, totalsize);
+	if (!fdt.dt)
+		goto out;
+
+	memset(fdt.dt, 0, off_dt_struct);
+
+	header = fdt.dt;
+	header->magic = cpu_to_fdt32(FDT_MAGIC);
+	header->totalsize = cpu_to_fdt32(totalsize);
+	header->off_dt_struct = cpu_to_fdt32(off_dt_struct);
+	header->off_dt_strings = cpu_to_fdt32(off_dt_strings);
+	header->off_mem_rsvmap = cpu_to_fdt32(sizeof(struct fdt_header));
+	header->version = cpu_to_fdt32(0x11);
+	header->last_comp_version = cpu_to_fdt32(0x10);
+	header->size_dt_strings = cpu_to_fdt32(fdt.str_size);
+	header->size_dt_struct = cpu_to_fdt32(fdt.dt_size);
+
+	fdt.dt_nextofs = off_dt_struct;
+	__of_flatten_dtb(&fdt, node);
+	*(uint32_t *)(fdt.dt + fdt.dt_nextofs) = cpu_to_fdt32(FDT_END);
+
+	for (i = 0; i < FDT_STRING_HASH_SIZE; i++)
+		hlist_for_each_entry(s, h, &fdt.strings[i], hash)
+			strcpy(fdt.dt + off_dt_strings + s->ofs, s->str);
+out:
+	for (i = 0; i < FDT_STRING_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(s, h, tmp, &fdt.strings[i], hash)
+			free(s);
 
 	free(fdt.strings);
 
 	return fdt.dt;
-
-out_free:
-	free(fdt.strings);
-	free(fdt.dt);
-
-	return NULL;
 }
 
 /*
@@ -77,16 +77,16 @@ const void *of_get_mac_address(struct device_node *np)
 	struct property *pp;
 
 	pp = of_find_property(np, "mac-address");
-	if (pp && (pp->length == 6) && is_valid_ether_addr(pp->value))
-		return pp->value;
+	if (pp && (pp->length == 6) && is_valid_ether_addr(of_property_get_value(pp)))
+		return of_property_get_value(pp);
 
 	pp = of_find_property(np, "local-mac-address");
-	if (pp && (pp->length == 6) && is_valid_ether_addr(pp->value))
-		return pp->value;
+	if (pp && (pp->length == 6) && is_valid_ether_addr(of_property_get_value(pp)))
+		return of_property_get_value(pp);
 
 	pp = of_find_property(np, "address");
-	if (pp && (pp->length == 6) && is_valid_ether_addr(pp->value))
-		return pp->value;
+	if (pp && (pp->length == 6) && is_valid_ether_addr(of_property_get_value(pp)))
+		return of_property_get_value(pp);
 
 	return NULL;
 }
@@ -0,0 +1,415 @@
+/*
+ * overlay.c - devicetree overlay support
+ *
+ * based on Linux devicetree overlay support
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <of.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/err.h>
+
+struct of_overlay {
+	struct device_node *root;
+	struct device_node *overlay;
+	/* offset added to all phandles defined in the overlay */
+	phandle delta;
+	/* next free phandle in the base tree after renumbering */
+	phandle next;
+};
+
+static phandle of_overlay_max_phandle(struct device_node *root)
+{
+	struct device_node *n;
+	phandle max = root->phandle;
+
+	of_tree_for_each_node(n, root)
+		if (n->phandle > max)
+			max = n->phandle;
+
+	return max;
+}
+
+static struct device_node *of_overlay_find_phandle(struct device_node *root,
+		phandle phandle)
+{
+	struct device_node *n;
+
+	/* The live tree has a phandle hash, use it */
+	if (root == of_get_root_node())
+		return of_find_node_by_phandle(phandle);
+
+	of_tree_for_each_node(n, root)
+		if (n->phandle == phandle)
+			return n;
+
+	return NULL;
+}
+
+/*
+ * Write a phandle value into the cell at @offset of a property. If @add
+ * is true @value is added to the current value instead.
+ */
+static int of_overlay_write_cell(struct device_node *node, const char *name,
+		uint32_t offset, phandle value, int add)
+{
+	struct property *pp;
+	__be32 *cell;
+	void *buf;
+	int ret;
+
+	pp = of_find_property(node, name);
+	if (!pp || offset + sizeof(__be32) > pp->length) {
+		pr_err("overlay: bad fixup %s:%s:%d\n", node->full_name,
+				name, offset);
+		return -EINVAL;
+	}
+
+	buf = xmalloc(pp->length);
+	memcpy(buf, of_property_get_value(pp), pp->length);
+
+	cell = buf + offset;
+	if (add)
+		value += be32_to_cpup(cell);
+	*cell = cpu_to_be32(value);
+
+	ret = of_set_property(node, name, buf, pp->length, 0);
+
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Move the phandles defined in the overlay above the ones of the base
+ * tree, so that they can be merged without conflicts.
+ */
+static int of_overlay_renumber(struct of_overlay *ovl)
+{
+	struct device_node *n;
+	phandle max = 0;
+	int ret;
+
+	of_tree_for_each_node(n, ovl->overlay) {
+		if (!n->phandle)
+			continue;
+
+		if (n->phandle > max)
+			max = n->phandle;
+
+		if (of_find_property(n, "phandle")) {
+			ret = of_overlay_write_cell(n, "phandle", 0,
+					ovl->delta, 1);
+			if (ret)
+				return ret;
+		}
+
+		if (of_find_property(n, "linux,phandle")) {
+			ret = of_overlay_write_cell(n, "linux,phandle", 0,
+					ovl->delta, 1);
+			if (ret)
+				return ret;
+		}
+	}
+
+	ovl->next = ovl->delta + max + 1;
+
+	return 0;
+}
+
+/*
+ * __local_fixups__ mirrors the structure of the overlay. Each property
+ * holds the offsets of the cells in the property of the same name which
+ * reference a phandle defined in the overlay itself.
+ */
+static int of_overlay_local_fixups(struct of_overlay *ovl,
+		struct device_node *fixups, struct device_node *node)
+{
+	struct device_node *f, *n;
+	struct property *pp;
+	int ret, i;
+
+	list_for_each_entry(pp, &fixups->properties, list) {
+		const __be32 *offsets = of_property_get_value(pp);
+
+		if (!strcmp(pp->name, "name"))
+			continue;
+
+		for (i = 0; i < pp->length / sizeof(__be32); i++) {
+			ret = of_overlay_write_cell(node, pp->name,
+					be32_to_cpu(offsets[i]), ovl->delta, 1);
+			if (ret)
+				return ret;
+		}
+	}
+
+	device_node_for_nach_child(fixups, f) {
+		n = of_find_child_by_name(node, f->name);
+		if (!n) {
+			pr_err("overlay: local fixup for missing node %s\n",
+					f->full_name);
+			return -EINVAL;
+		}
+
+		ret = of_overlay_local_fixups(ovl, f, n);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static phandle of_overlay_resolve_label(struct of_overlay *ovl,
+		const char *label)
+{
+	struct device_node *symbols, *target;
+	const char *path;
+	int ret;
+
+	symbols = of_find_node_by_path(ovl->root, "/__symbols__");
+	if (!symbols)
+		return 0;
+
+	ret = of_property_read_string(symbols, label, &path);
+	if (ret)
+		return 0;
+
+	target = of_find_node_by_path(ovl->root, path);
+	if (!target)
+		return 0;
+
+	if (!target->phandle) {
+		ret = of_property_write_u32(target, "phandle", ovl->next);
+		if (ret)
+			return 0;
+		target->phandle = ovl->next++;
+	}
+
+	return target->phandle;
+}
+
+/*
+ * __fixups__ contains one property per label of the base tree used in
+ * the overlay. Its value is a list of "path:property:offset" strings
+ * describing where the phandle of the label has to be filled in.
+ */
+static int of_overlay_fixups(struct of_overlay *ovl)
+{
+	struct device_node *fixups, *node;
+	struct property *pp;
+	int ret;
+
+	fixups = of_find_child_by_name(ovl->overlay, "__fixups__");
+	if (!fixups)
+		return 0;
+
+	list_for_each_entry(pp, &fixups->properties, list) {
+		const char *fixup = of_property_get_value(pp);
+		const char *end = fixup + pp->length;
+		phandle phandle;
+
+		if (!strcmp(pp->name, "name"))
+			continue;
+
+		phandle = of_overlay_resolve_label(ovl, pp->name);
+		if (!phandle) {
+			pr_err("overlay: cannot resolve label %s\n", pp->name);
+			return -ENOENT;
+		}
+
+		while (fixup < end) {
+			char *path, *prop, *sep;
+			uint32_t offset;
+
+			path = xstrdup(fixup);
+			fixup += strlen(fixup) + 1;
+
+			sep = strchr(path, ':');
+			if (!sep)
+				goto bad_fixup;
+			*sep = 0;
+			prop = sep + 1;
+
+			sep = strchr(prop, ':');
+			if (!sep)
+				goto bad_fixup;
+			*sep = 0;
+			offset = simple_strtoul(sep + 1, NULL, 0);
+
+			node = of_find_node_by_path(ovl->overlay, path);
+			if (!node)
+				goto bad_fixup;
+
+			ret = of_overlay_write_cell(node, prop, offset,
+					phandle, 0);
+			free(path);
+			if (ret)
+				return ret;
+
+			continue;
+bad_fixup:
+			pr_err("overlay: bad fixup for label %s\n", pp->name);
+			free(path);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int of_overlay_merge(struct device_node *target,
+		struct device_node *overlay)
+{
+	struct device_node *n, *child;
+	struct property *pp;
+	int ret;
+
+	list_for_each_entry(pp, &overlay->properties, list) {
+		if (!strcmp(pp->name, "name"))
+			continue;
+
+		ret = of_set_property(target, pp->name,
+				of_property_get_value(pp), pp->length, 1);
+		if (ret)
+			return ret;
+	}
+
+	device_node_for_nach_child(overlay, n) {
+		child = of_find_child_by_name(target, n->name);
+		if (!child)
+			child = of_new_node(target, n->name);
+
+		ret = of_overlay_merge(child, n);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static struct device_node *of_overlay_find_target(struct of_overlay *ovl,
+		struct device_node *fragment)
+{
+	const char *path;
+	u32 phandle;
+
+	if (!of_property_read_u32(fragment, "target", &phandle))
+		return of_overlay_find_phandle(ovl->root, phandle);
+
+	if (!of_property_read_string(fragment, "target-path", &path))
+		return of_find_node_by_path(ovl->root, path);
+
+	return NULL;
+}
+
+/**
+ * of_overlay_is_overlay - check whether a tree is an overlay
+ * @overlay - the root node of the tree
+ *
+ * Returns true if the tree contains at least one fragment with an
+ * __overlay__ node.
+ */
+int of_overlay_is_overlay(struct device_node *overlay)
+{
+	struct device_node *fragment;
+
+	device_node_for_nach_child(overlay, fragment)
+		if (of_find_child_by_name(fragment, "__overlay__"))
+			return 1;
+
+	return 0;
+}
+
+/**
+ * of_overlay_apply_tree - apply an overlay to a tree
+ * @root - the root node of the tree to modify
+ * @overlay - the root node of the unflattened overlay
+ *
+ * The phandles of the overlay are renumbered and its references to
+ * labels of @root are resolved through the __symbols__ node of @root.
+ * Then the __overlay__ node of each fragment is merged into the node
+ * given by its target or target-path property. @overlay is modified
+ * in the process and should be freed afterwards.
+ */
+int of_overlay_apply_tree(struct device_node *root,
+		struct device_node *overlay)
+{
+	struct of_overlay ovl = {
+		.root = root,
+		.overlay = overlay,
+	};
+	struct device_node *fragment, *fixups, *target, *n;
+	int ret;
+
+	ovl.delta = of_overlay_max_phandle(root);
+
+	ret = of_overlay_renumber(&ovl);
+	if (ret)
+		return ret;
+
+	fixups = of_find_child_by_name(overlay, "__local_fixups__");
+	if (fixups) {
+		ret = of_overlay_local_fixups(&ovl, fixups, overlay);
+		if (ret)
+			return ret;
+	}
+
+	ret = of_overlay_fixups(&ovl);
+	if (ret)
+		return ret;
+
+	device_node_for_nach_child(overlay, fragment) {
+		n = of_find_child_by_name(fragment, "__overlay__");
+		if (!n)
+			continue;
+
+		target = of_overlay_find_target(&ovl, fragment);
+		if (!target) {
+			pr_err("overlay: cannot find target for %s\n",
+					fragment->full_name);
+			return -EINVAL;
+		}
+
+		ret = of_overlay_merge(target, n);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * of_overlay_apply_dtb - apply an overlay blob to a tree
+ * @root - the root node of the tree to modify
+ * @fdt - the overlay blob (dtbo)
+ */
+int of_overlay_apply_dtb(struct device_node *root, void *fdt)
+{
+	struct device_node *overlay;
+	int ret;
+
+	overlay = of_unflatten_dtb_const(NULL, fdt);
+	if (IS_ERR(overlay))
+		return PTR_ERR(overlay);
+
+	if (of_overlay_is_overlay(overlay))
+		ret = of_overlay_apply_tree(root, overlay);
+	else
+		ret = -EINVAL;
+
+	of_free(overlay);
+
+	return ret;
+}
@@ -105,6 +105,8 @@
 #define CSPI_2_3_STAT		0x18
 #define CSPI_2_3_STAT_RR		(1 <<  3)
 
+#define CSPI_2_3_FIFO_SIZE	64
+
 enum imx_spi_devtype {
 #ifdef CONFIG_DRIVER_SPI_IMX1
 	SPI_IMX_VER_IMX1,
@@ -133,12 +135,16 @@ struct imx_spi {
 	struct clk		*clk;
 
 	unsigned int		(*xchg_single)(struct imx_spi *imx, u32 data);
+	void			(*xchg_fifo)(struct imx_spi *imx, const u8 *tx_buf,
+					u8 *rx_buf, unsigned len);
 	void			(*chipselect)(struct spi_device *spi, int active);
 	void			(*init)(struct imx_spi *imx);
 };
 
 struct spi_imx_devtype_data {
 	unsigned int		(*xchg_single)(struct imx_spi *imx, u32 data);
+	void			(*xchg_fifo)(struct imx_spi *imx, const u8 *tx_buf,
+					u8 *rx_buf, unsigned len);
 	void			(*chipselect)(struct spi_device *spi, int active);
 	void			(*init)(struct imx_spi *imx);
 };
@@ -328,6 +334,42 @@ static unsigned int cspi_2_3_xchg_single(struct imx_spi *imx, unsigned int data)
 	return readl(base + CSPI_2_3_RXDATA);
 }
 
+/*
+ * Exchange 8 bit words a FIFO full at a time instead of waiting for
+ * each word.
+ */
+static void cspi_2_3_xchg_fifo(struct imx_spi *imx, const u8 *tx_buf,
+		u8 *rx_buf, unsigned len)
+{
+	void __iomem *base = imx->regs;
+	unsigned i, now;
+	u32 val;
+
+	while (len) {
+		now = min(len, (unsigned)CSPI_2_3_FIFO_SIZE);
+
+		for (i = 0; i < now; i++)
+			writel(tx_buf ? tx_buf[i] : 0, base + CSPI_2_3_TXDATA);
+
+		val = readl(base + CSPI_2_3_CTRL);
+		writel(val | CSPI_2_3_CTRL_XCH, base + CSPI_2_3_CTRL);
+
+		for (i = 0; i < now; i++) {
+			while (!(readl(base + CSPI_2_3_STAT) & CSPI_2_3_STAT_RR));
+
+			val = readl(base + CSPI_2_3_RXDATA);
+			if (rx_buf)
+				rx_buf[i] = val;
+		}
+
+		if (tx_buf)
+			tx_buf += now;
+		if (rx_buf)
+			rx_buf += now;
+		len -= now;
+	}
+}
+
 static unsigned int cspi_2_3_clkdiv(unsigned int fin, unsigned int fspi)
 {
 	/*
@@ -419,7 +461,9 @@ static void imx_spi_do_transfer(struct spi_device *spi, struct spi_transfer *t)
 	struct imx_spi *imx = container_of(spi->master, struct imx_spi, master);
 	unsigned i;
 
-	if (spi->bits_per_word <= 8) {
+	if (spi->bits_per_word <= 8 && imx->xchg_fifo) {
+		imx->xchg_fifo(imx, t->tx_buf, t->rx_buf, t->len);
+	} else if (spi->bits_per_word <= 8) {
 		const u8	*tx_buf = t->tx_buf;
 		u8		*rx_buf = t->rx_buf;
 		u8		rx_val;
@@ -490,6 +534,7 @@ static struct spi_imx_devtype_data spi_imx_devtype_data[] = {
 	[SPI_IMX_VER_2_3] = {
 		.chipselect = cspi_2_3_chipselect,
 		.xchg_single = cspi_2_3_xchg_single,
+		.xchg_fifo = cspi_2_3_xchg_fifo,
 		.init = cspi_2_3_init,
 	},
 #endif
@@ -566,6 +611,7 @@ static int imx_spi_probe(struct device_d *dev)
 #endif
 	imx->chipselect = spi_imx_devtype_data[version].chipselect;
 	imx->xchg_single = spi_imx_devtype_data[version].xchg_single;
+	imx->xchg_fifo = spi_imx_devtype_data[version].xchg_fifo;
 	imx->init = spi_imx_devtype_data[version].init;
 	imx->regs = dev_request_mem_region(dev, 0);
 
@@ -27,18 +27,49 @@
 #include <mach/mxs.h>
 #include <mach/clock.h>
 #include <mach/ssp.h>
+#include <mach/dma.h>
 
 #define	MXS_SPI_MAX_TIMEOUT		(10 * MSECOND)
 
 #define	SPI_XFER_BEGIN	0x01 /* Assert CS before transfer */
 #define	SPI_XFER_END	0x02 /* Deassert CS after transfer */
 
+#define	MXS_SPI_DMA_DESC_COUNT		8
+#define	MXS_SPI_DMA_BUF_SIZE		(32 * 1024)
+/* Shorter transfers are faster by PIO than by setting up the DMA */
+#define	MXS_SPI_DMA_MIN_LEN		32
+
+#ifdef CONFIG_ARCH_IMX23
+# define MXS_SPI_DMA_PIO_WORDS		1	/* CTRL0 */
+#else
+# define MXS_SPI_DMA_PIO_WORDS		4	/* CTRL0 to XFER_COUNT */
+#endif
+
+struct mxs_spi_dma_rx {
+	void			*buf;
+	unsigned int		offset;
+	unsigned int		len;
+};
+
 struct mxs_spi {
 	struct spi_master	master;
 	uint32_t		max_khz;
 	uint32_t		mode;
 	struct clk		*clk;
 	void __iomem		*regs;
+
+	/*
+	 * The DMA chain being built: the descriptors, the bounce buffer
+	 * they transfer from and to and where received data goes.
+	 */
+	struct mxs_dma_desc	*desc[MXS_SPI_DMA_DESC_COUNT];
+	int			desc_num;
+	struct mxs_spi_dma_rx	rx[MXS_SPI_DMA_DESC_COUNT];
+	int			rx_num;
+	void			*dma_buf;
+	unsigned int		dma_used;
+	uint32_t		dma_speed_hz;
+	char			dummy;
 };
 
 static inline struct mxs_spi *to_mxs(struct spi_master *master)
@@ -195,12 +226,155 @@ static int mxs_spi_xfer_pio(struct spi_device *spi,
 	return 0;
 }
 
-static int mxs_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
+/*
+ * Drop the DMA chain, the descriptors are ready for the next one.
+ */
+static void mxs_spi_dma_reset(struct mxs_spi *mxs)
+{
+	struct mxs_dma_desc *d;
+	int i;
+
+	for (i = 0; i < mxs->desc_num; i++) {
+		d = mxs->desc[i];
+		memset(d, 0, sizeof(*d));
+		d->address = (dma_addr_t)d;
+	}
+
+	mxs->desc_num = 0;
+	mxs->rx_num = 0;
+	mxs->dma_used = 0;
+}
+
+/*
+ * Run the DMA chain built so far and copy the received data to where it
+ * belongs.
+ */
+static int mxs_spi_dma_run(struct mxs_spi *mxs)
+{
+	struct spi_master *master = &mxs->master;
+	int channel = MXS_DMA_CHANNEL_AHB_APBH_SSP0 + master->bus_num;
+	uint32_t timeout;
+	int i, ret;
+
+	if (!mxs->desc_num)
+		return 0;
+
+	/* The channel stops waiting at the first completion irq */
+	mxs->desc[mxs->desc_num - 1]->cmd.data |= MXS_DMA_DESC_IRQ;
+
+	for (i = 0; i < mxs->desc_num; i++)
+		mxs_dma_desc_append(channel, mxs->desc[i]);
+
+	/* twice the time on the bus, in us, plus the usual 10ms */
+	timeout = 10000 + mxs->dma_used * 16000 /
+		max(mxs->dma_speed_hz / 1000, 1U);
+
+	writel(SSP_CTRL1_DMA_ENABLE, mxs->regs + HW_SSP_CTRL1 + BIT_SET);
+	ret = mxs_dma_go_timeout(channel, timeout);
+	writel(SSP_CTRL1_DMA_ENABLE, mxs->regs + HW_SSP_CTRL1 + BIT_CLR);
+
+	if (ret)
+		dev_err(master->dev, "MXS SPI: DMA timeout\n");
+	else
+		for (i = 0; i < mxs->rx_num; i++)
+			memcpy(mxs->rx[i].buf, mxs->dma_buf + mxs->rx[i].offset,
+					mxs->rx[i].len);
+
+	mxs_spi_dma_reset(mxs);
+
+	return ret;
+}
+
+/*
+ * Add a transfer to the DMA chain. The chain is run when it is full,
+ * otherwise the caller has to run it.
+ */
+static int mxs_spi_xfer_dma(struct spi_device *spi,
+			char *data, int length, int write, unsigned long flags)
+{
+	struct mxs_spi *mxs = to_mxs(spi->master);
+	struct mxs_dma_desc *d;
+	uint32_t ctrl0, base;
+	void *buf;
+	int now, ret;
+
+	mxs_spi_set_cs(spi);
+
+	base = readl(mxs->regs + HW_SSP_CTRL0);
+	base &= ~(SSP_CTRL0_RUN | SSP_CTRL0_READ | SSP_CTRL0_IGNORE_CRC |
+			SSP_CTRL0_LOCK_CS | SSP_CTRL0_DATA_XFER);
+#ifdef CONFIG_ARCH_IMX23
+	base &= ~SSP_CTRL0_XFER_COUNT(~0);
+#endif
+	base |= SSP_CTRL0_DATA_XFER | SSP_CTRL0_LOCK_CS;
+	if (!write)
+		base |= SSP_CTRL0_READ;
+
+	mxs->dma_speed_hz = spi->max_speed_hz;
+
+	while (length) {
+		now = min(length, MXS_SPI_DMA_BUF_SIZE);
+
+		if (mxs->desc_num == MXS_SPI_DMA_DESC_COUNT ||
+		    mxs->dma_used + now > MXS_SPI_DMA_BUF_SIZE) {
+			ret = mxs_spi_dma_run(mxs);
+			if (ret)
+				return ret;
+		}
+
+		d = mxs->desc[mxs->desc_num++];
+		buf = mxs->dma_buf + mxs->dma_used;
+
+		ctrl0 = base;
+		if ((flags & SPI_XFER_END) && now == length) {
+			ctrl0 &= ~SSP_CTRL0_LOCK_CS;
+			ctrl0 |= SSP_CTRL0_IGNORE_CRC;
+		}
+
+		if (write) {
+			memcpy(buf, data, now);
+		} else {
+			mxs->rx[mxs->rx_num].buf = data;
+			mxs->rx[mxs->rx_num].offset = mxs->dma_used;
+			mxs->rx[mxs->rx_num].len = now;
+			mxs->rx_num++;
+		}
+
+		d->cmd.data = (write ? MXS_DMA_DESC_COMMAND_DMA_READ :
+				MXS_DMA_DESC_COMMAND_DMA_WRITE) |
+			MXS_DMA_DESC_DEC_SEM | MXS_DMA_DESC_WAIT4END |
+			MXS_DMA_DESC_HALT_ON_TERMINATE |
+			(MXS_SPI_DMA_PIO_WORDS << MXS_DMA_DESC_PIO_WORDS_OFFSET) |
+			(now << MXS_DMA_DESC_BYTES_OFFSET);
+		d->cmd.address = (dma_addr_t)buf;
+#ifdef CONFIG_ARCH_IMX23
+		d->cmd.pio_words[0] = ctrl0 | SSP_CTRL0_XFER_COUNT(now);
+#else
+		d->cmd.pio_words[0] = ctrl0;
+		d->cmd.pio_words[1] = 0;	/* CMD0 */
+		d->cmd.pio_words[2] = 0;	/* CMD1 */
+		d->cmd.pio_words[3] = now;	/* XFER_COUNT */
+#endif
+
+		mxs->dma_used += ALIGN(now, MXS_DMA_ALIGNMENT);
+		data += now;
+		length -= now;
+	}
+
+	return 0;
+}
+
+/*
+ * Transfer a message. With @chain set all transfers are added to the DMA
+ * chain, which the caller runs, otherwise long transfers are done by DMA
+ * right away and short ones by PIO.
+ */
+static int mxs_spi_message(struct spi_device *spi, struct spi_message *mesg,
+		int chain)
 {
 	struct mxs_spi *mxs = to_mxs(spi->master);
 	struct spi_master *master = spi->master;
 	struct spi_transfer *t = NULL;
-	char dummy;
 	unsigned long flags = 0;
 	int write = 0;
 	char *data = NULL;
@@ -210,20 +384,6 @@ static int mxs_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
 	list_for_each_entry(t, &mesg->transfers, transfer_list) {
 		flags = 0;
 
-		if (t->tx_buf) {
-			data = (char *) t->tx_buf;
-			write = 1;
-		} else if (t->rx_buf) {
-			data = (char *) t->rx_buf;
-			write = 0;
-		} else if (t->rx_buf && t->tx_buf) {
-			dev_err(master->dev, "Cannot send and receive simultaneously\n");
-			return -EIO;
-		} else if (!t->rx_buf && !t->tx_buf) {
-			dev_err(master->dev, "No Data\n");
-			return -EIO;
-		}
-
 		if (&t->transfer_list == mesg->transfers.next)
 			flags |= SPI_XFER_BEGIN;
 
@@ -233,14 +393,32 @@ static int mxs_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
 		if (t->len == 0) {
 			if (flags == SPI_XFER_END) {
 				t->len = 1;
-				t->rx_buf = (void *) &dummy;
+				t->rx_buf = &mxs->dummy;
 			} else {
 				return 0;
 			}
 		}
 
-		writel(SSP_CTRL1_DMA_ENABLE, mxs->regs + HW_SSP_CTRL1 + BIT_CLR);
-		ret = mxs_spi_xfer_pio(spi, data, t->len, write, flags);
+		if (t->tx_buf) {
+			data = (char *) t->tx_buf;
+			write = 1;
+		} else if (t->rx_buf) {
+			data = (char *) t->rx_buf;
+			write = 0;
+		} else {
+			dev_err(master->dev, "No Data\n");
+			return -EIO;
+		}
+
+		if (IS_ENABLED(CONFIG_MXS_APBH_DMA) &&
+		    (chain || spi_transfer_use_dma(master, t))) {
+			ret = mxs_spi_xfer_dma(spi, data, t->len, write, flags);
+			if (!ret && !chain)
+				ret = mxs_spi_dma_run(mxs);
+		} else {
+			writel(SSP_CTRL1_DMA_ENABLE, mxs->regs + HW_SSP_CTRL1 + BIT_CLR);
+			ret = mxs_spi_xfer_pio(spi, data, t->len, write, flags);
+		}
 		if (ret < 0)
 			return ret;
 		mesg->actual_length += t->len;
@@ -249,6 +427,72 @@ static int mxs_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
 	return 0;
 }
 
+static int mxs_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
+{
+	return mxs_spi_message(spi, mesg, 0);
+}
+
+/*
+ * All messages of a batch go into one DMA chain, chip select is
+ * deasserted at the end of each message by the chain itself.
+ */
+static int mxs_spi_transfer_batch(struct spi_device *spi,
+		struct list_head *batch)
+{
+	struct mxs_spi *mxs = to_mxs(spi->master);
+	struct spi_message *m;
+	int ret;
+
+	list_for_each_entry(m, batch, queue) {
+		ret = mxs_spi_message(spi, m, 1);
+		m->status = ret;
+		if (ret) {
+			mxs_spi_dma_reset(mxs);
+			return ret;
+		}
+	}
+
+	return mxs_spi_dma_run(mxs);
+}
+
+static void mxs_spi_dma_init(struct mxs_spi *mxs)
+{
+	struct spi_master *master = &mxs->master;
+	int i;
+
+	mxs->dma_buf = dma_alloc_coherent(MXS_SPI_DMA_BUF_SIZE);
+	if (!mxs->dma_buf)
+		return;
+
+	for (i = 0; i < MXS_SPI_DMA_DESC_COUNT; i++) {
+		mxs->desc[i] = mxs_dma_desc_alloc();
+		if (!mxs->desc[i])
+			goto err_free;
+	}
+
+	if (mxs_dma_init())
+		goto err_free;
+
+	if (mxs_dma_request_chan(MXS_DMA_CHANNEL_AHB_APBH_SSP0 +
+				master->bus_num))
+		goto err_free;
+
+	master->dma_min_len = MXS_SPI_DMA_MIN_LEN;
+	master->transfer_batch = mxs_spi_transfer_batch;
+
+	return;
+
+err_free:
+	/* fall back to PIO */
+	for (i = 0; i < MXS_SPI_DMA_DESC_COUNT; i++) {
+		mxs_dma_desc_free(mxs->desc[i]);
+		mxs->desc[i] = NULL;
+	}
+
+	dma_free_coherent(mxs->dma_buf, MXS_SPI_DMA_BUF_SIZE);
+	mxs->dma_buf = NULL;
+}
+
 static int mxs_spi_probe(struct device_d *dev)
 {
 	struct spi_master *master;
@@ -267,6 +511,9 @@ static int mxs_spi_probe(struct device_d *dev)
 
 	mxs->regs = dev_request_mem_region(dev, 0);
 
+	if (IS_ENABLED(CONFIG_MXS_APBH_DMA))
+		mxs_spi_dma_init(mxs);
+
 	spi_register_master(master);
 
 	return 0;
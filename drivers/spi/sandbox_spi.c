@@ -0,0 +1,585 @@
+/*
+ * sandbox_spi.c - SPI master with a simulated NOR flash for the sandbox
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The flash sits on chip select 0 and is driven by the m25p80 driver. It
+ * has no entry in the m25p80 id table, the geometry is described by its
+ * SFDP parameters. The contents are kept in a file on the host.
+ *
+ * Each byte on the bus takes 8 clocks at the configured frequency. Page
+ * program and erase set the WIP bit in the status register for tPP or
+ * tSE, during that time other commands are ignored.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <malloc.h>
+#include <init.h>
+#include <errno.h>
+#include <clock.h>
+#include <xfuncs.h>
+#include <linux/log2.h>
+#include <sizes.h>
+#include <spi/spi.h>
+#include <spi/flash.h>
+#include <mach/linux.h>
+#include <mach/hostfile.h>
+
+#define CMD_WRSR	0x01
+#define CMD_PP		0x02
+#define CMD_READ	0x03
+#define CMD_WRDI	0x04
+#define CMD_RDSR	0x05
+#define CMD_WREN	0x06
+#define CMD_FAST_READ	0x0b
+#define CMD_BE_4K	0x20
+#define CMD_RDCR	0x35
+#define CMD_RDSFDP	0x5a
+#define CMD_RDID	0x9f
+#define CMD_EN4B	0xb7
+#define CMD_CHIP_ERASE	0xc7
+#define CMD_SE		0xd8
+#define CMD_EX4B	0xe9
+
+#define SR_WIP		(1 << 0)
+#define SR_WEL		(1 << 1)
+
+#define SFDP_BFPT	0x10
+#define SFDP_DWORDS	16
+
+enum sim_phase {
+	PH_CMD,
+	PH_ADDR,
+	PH_DUMMY,
+	PH_DATA,
+	PH_IGNORE,
+};
+
+struct sandbox_spinor {
+	struct spi_master	master;
+	struct device_d		*dev;
+	struct hf_platform_data	*hf;
+	struct flash_platform_data pdata;
+
+	/* geometry */
+	u64			size;
+	unsigned int		sectorsize;
+	unsigned int		pagesize;
+
+	/* timing, tpp and tse in us */
+	unsigned long		hz;
+	unsigned long		tbyte;		/* ns */
+	unsigned long		tpp, tse4k, tse;
+
+	int			map;
+	void			*mem;
+
+	u8			id[5];
+	u8			sfdp[SFDP_BFPT + SFDP_DWORDS * 4];
+
+	/* interface state */
+	enum sim_phase		phase;
+	u8			cmd;
+	int			addr_width;
+	int			naddr;
+	int			ndummy;
+	u32			addr;
+	u8			sr;
+	uint64_t		busy_until;
+	u8			*page;
+	int			programmed;
+};
+
+static inline struct sandbox_spinor *to_sim(struct spi_master *master)
+{
+	return container_of(master, struct sandbox_spinor, master);
+}
+
+static u8 sim_status(struct sandbox_spinor *sim)
+{
+	if (get_time_ns() < sim->busy_until)
+		return sim->sr | SR_WIP;
+
+	return sim->sr;
+}
+
+static void sim_busy(struct sandbox_spinor *sim, unsigned long us)
+{
+	sim->busy_until = get_time_ns() + us * USECOND;
+	sim->sr &= ~SR_WEL;
+}
+
+static void sim_start(struct sandbox_spinor *sim, u8 cmd)
+{
+	sim->cmd = cmd;
+	sim->addr = 0;
+	sim->naddr = 0;
+	sim->ndummy = 0;
+	sim->phase = PH_DATA;
+
+	/* Only the status can be read while a program or erase is running */
+	if ((sim_status(sim) & SR_WIP) && cmd != CMD_RDSR) {
+		sim->phase = PH_IGNORE;
+		return;
+	}
+
+	switch (cmd) {
+	case CMD_RDSR:
+	case CMD_RDCR:
+	case CMD_RDID:
+	case CMD_WRSR:
+		break;
+	case CMD_WREN:
+		sim->sr |= SR_WEL;
+		break;
+	case CMD_WRDI:
+		sim->sr &= ~SR_WEL;
+		break;
+	case CMD_EN4B:
+		sim->addr_width = 4;
+		break;
+	case CMD_EX4B:
+		sim->addr_width = 3;
+		break;
+	case CMD_FAST_READ:
+		sim->ndummy = 1;
+		/* fall through */
+	case CMD_READ:
+	case CMD_PP:
+	case CMD_BE_4K:
+	case CMD_SE:
+		sim->naddr = sim->addr_width;
+		sim->phase = PH_ADDR;
+		break;
+	case CMD_RDSFDP:
+		sim->naddr = 3;
+		sim->ndummy = 1;
+		sim->phase = PH_ADDR;
+		break;
+	case CMD_CHIP_ERASE:
+		break;
+	default:
+		dev_dbg(sim->dev, "unsupported command 0x%02x\n", cmd);
+		sim->phase = PH_IGNORE;
+		break;
+	}
+
+	if (cmd == CMD_PP) {
+		memset(sim->page, 0xff, sim->pagesize);
+		sim->programmed = 0;
+	}
+}
+
+static void sim_data(struct sandbox_spinor *sim, const u8 *tx, u8 *rx,
+		unsigned int len)
+{
+	unsigned int i, n;
+
+	switch (sim->cmd) {
+	case CMD_READ:
+	case CMD_FAST_READ:
+		while (rx && len) {
+			sim->addr &= sim->size - 1;
+			n = min_t(u64, len, sim->size - sim->addr);
+			if (linux_pread(sim->hf->fd, rx, n, sim->addr) != n)
+				memset(rx, 0xff, n);
+			sim->addr += n;
+			rx += n;
+			len -= n;
+		}
+		return;
+	case CMD_PP:
+		if (!tx)
+			return;
+		for (i = 0; i < len; i++)
+			sim->page[(sim->addr + i) & (sim->pagesize - 1)] &= tx[i];
+		sim->addr = (sim->addr & ~(sim->pagesize - 1)) |
+			((sim->addr + len) & (sim->pagesize - 1));
+		sim->programmed = 1;
+		return;
+	}
+
+	for (i = 0; rx && i < len; i++, sim->addr++) {
+		switch (sim->cmd) {
+		case CMD_RDSR:
+			rx[i] = sim_status(sim);
+			break;
+		case CMD_RDCR:
+			rx[i] = 0;
+			break;
+		case CMD_RDID:
+			rx[i] = sim->id[sim->addr % sizeof(sim->id)];
+			break;
+		case CMD_RDSFDP:
+			rx[i] = sim->addr < sizeof(sim->sfdp) ?
+				sim->sfdp[sim->addr] : 0xff;
+			break;
+		default:
+			rx[i] = 0xff;
+			break;
+		}
+	}
+}
+
+static void sim_xfer(struct sandbox_spinor *sim, const u8 *tx, u8 *rx,
+		unsigned int len)
+{
+	u8 byte;
+
+	while (len) {
+		if (sim->phase == PH_DATA) {
+			sim_data(sim, tx, rx, len);
+			return;
+		}
+
+		byte = tx ? *tx++ : 0xff;
+		if (rx)
+			*rx++ = 0xff;
+		len--;
+
+		switch (sim->phase) {
+		case PH_CMD:
+			sim_start(sim, byte);
+			break;
+		case PH_ADDR:
+			sim->addr = sim->addr << 8 | byte;
+			if (--sim->naddr)
+				break;
+			sim->phase = sim->ndummy ? PH_DUMMY : PH_DATA;
+			break;
+		case PH_DUMMY:
+			if (!--sim->ndummy)
+				sim->phase = PH_DATA;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void sim_erase(struct sandbox_spinor *sim, u32 addr, u64 len,
+		unsigned long us)
+{
+	u64 ofs;
+
+	addr &= ~(len - 1);
+	memset(sim->page, 0xff, sim->pagesize);
+
+	for (ofs = 0; ofs < len; ofs += sim->pagesize)
+		linux_pwrite(sim->hf->fd, sim->page, sim->pagesize, addr + ofs);
+
+	sim_busy(sim, us);
+}
+
+static void sim_program(struct sandbox_spinor *sim)
+{
+	u32 addr = sim->addr & ~(sim->pagesize - 1) & (sim->size - 1);
+	u8 *buf = xmalloc(sim->pagesize);
+	int i;
+
+	if (linux_pread(sim->hf->fd, buf, sim->pagesize, addr) == sim->pagesize) {
+		/* Programming can only clear bits */
+		for (i = 0; i < sim->pagesize; i++)
+			buf[i] &= sim->page[i];
+		linux_pwrite(sim->hf->fd, buf, sim->pagesize, addr);
+	}
+
+	free(buf);
+	sim_busy(sim, sim->tpp);
+}
+
+/* Deasserting chip select starts a program or erase */
+static void sim_end(struct sandbox_spinor *sim)
+{
+	int complete = sim->phase == PH_DATA;
+
+	sim->phase = PH_CMD;
+
+	if (!complete || !(sim->sr & SR_WEL))
+		return;
+
+	switch (sim->cmd) {
+	case CMD_PP:
+		if (sim->programmed)
+			sim_program(sim);
+		break;
+	case CMD_BE_4K:
+		sim_erase(sim, sim->addr & (sim->size - 1), 4096, sim->tse4k);
+		break;
+	case CMD_SE:
+		sim_erase(sim, sim->addr & (sim->size - 1), sim->sectorsize,
+				sim->tse);
+		break;
+	case CMD_CHIP_ERASE:
+		sim_erase(sim, 0, sim->size,
+				sim->tse * (sim->size / sim->sectorsize));
+		break;
+	}
+}
+
+static int sandbox_spi_setup(struct spi_device *spi)
+{
+	if (spi->chip_select)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int sandbox_spi_transfer(struct spi_device *spi, struct spi_message *mesg)
+{
+	struct sandbox_spinor *sim = to_sim(spi->master);
+	struct spi_transfer *t;
+
+	mesg->actual_length = 0;
+
+	list_for_each_entry(t, &mesg->transfers, transfer_list) {
+		if (sim->tbyte)
+			ndelay(t->len * sim->tbyte);
+
+		sim_xfer(sim, t->tx_buf, t->rx_buf, t->len);
+		mesg->actual_length += t->len;
+
+		if (t->cs_change)
+			sim_end(sim);
+	}
+
+	sim_end(sim);
+
+	return 0;
+}
+
+static void __iomem *sandbox_spi_flash_map(struct spi_device *spi,
+		const struct spi_flash_map *map)
+{
+	struct sandbox_spinor *sim = to_sim(spi->master);
+
+	if (!sim->map || map->size > sim->size)
+		return NULL;
+
+	if (map->opcode != CMD_READ && map->opcode != CMD_FAST_READ)
+		return NULL;
+
+	if (!sim->mem)
+		sim->mem = linux_mmap(sim->hf->fd, sim->size);
+
+	return sim->mem;
+}
+
+static void sim_put_dword(struct sandbox_spinor *sim, int dw, u32 val)
+{
+	u8 *p = sim->sfdp + SFDP_BFPT + (dw - 1) * 4;
+
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+/* Basic flash parameter table as defined by JESD216A */
+static void sim_init_sfdp(struct sandbox_spinor *sim)
+{
+	u8 *hdr = sim->sfdp;
+
+	memset(sim->sfdp, 0, sizeof(sim->sfdp));
+
+	memcpy(hdr, "SFDP", 4);
+	hdr[5] = 1;			/* major revision */
+	hdr[6] = 0;			/* one parameter header */
+	hdr[7] = 0xff;
+
+	hdr[8] = 0;			/* basic table, id lsb */
+	hdr[10] = 1;			/* major revision */
+	hdr[11] = SFDP_DWORDS;
+	hdr[12] = SFDP_BFPT;
+	hdr[15] = 0xff;
+
+	/* 4K erase, only 4 address bytes above 16MiB */
+	sim_put_dword(sim, 1, 0x1 | CMD_BE_4K << 8 |
+			(sim->size > SZ_16M ? 2 : 0) << 17);
+	sim_put_dword(sim, 2, sim->size * 8 - 1);
+	sim_put_dword(sim, 8, 12 | CMD_BE_4K << 8 |
+			(ffs(sim->sectorsize) - 1) << 16 | CMD_SE << 24);
+	sim_put_dword(sim, 11, (ffs(sim->pagesize) - 1) << 4);
+}
+
+static int sim_parse_args(struct sandbox_spinor *sim)
+{
+	char *args, *opt, *val;
+	unsigned long v;
+	int ret = 0;
+
+	if (!sim->hf->args)
+		return 0;
+
+	args = xstrdup(sim->hf->args);
+
+	while ((opt = strsep(&args, ","))) {
+		if (!strcmp(opt, "map")) {
+			sim->map = 1;
+			continue;
+		}
+
+		val = strchr(opt, '=');
+		if (!val) {
+			dev_err(sim->dev, "invalid option '%s'\n", opt);
+			ret = -EINVAL;
+			break;
+		}
+		*val++ = 0;
+		v = strtoull_suffix(val, NULL, 0);
+
+		if (!strcmp(opt, "size"))
+			sim->size = v;
+		else if (!strcmp(opt, "sectorsize"))
+			sim->sectorsize = v;
+		else if (!strcmp(opt, "pagesize"))
+			sim->pagesize = v;
+		else if (!strcmp(opt, "hz"))
+			sim->hz = v;
+		else if (!strcmp(opt, "tpp"))
+			sim->tpp = v;
+		else if (!strcmp(opt, "tse4k"))
+			sim->tse4k = v;
+		else if (!strcmp(opt, "tse"))
+			sim->tse = v;
+		else {
+			dev_err(sim->dev, "unknown option '%s'\n", opt);
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	free(args);
+
+	return ret;
+}
+
+/* Grow the file to the size of the flash, erased */
+static int sim_extend_file(struct sandbox_spinor *sim)
+{
+	u64 ofs;
+
+	memset(sim->page, 0xff, sim->pagesize);
+
+	for (ofs = sim->hf->size & ~(sim->pagesize - 1); ofs < sim->size;
+			ofs += sim->pagesize) {
+		if (ofs < sim->hf->size)
+			continue;
+		if (linux_pwrite(sim->hf->fd, sim->page, sim->pagesize, ofs) !=
+				sim->pagesize)
+			return -EIO;
+	}
+
+	if (sim->hf->size < sim->size)
+		sim->hf->size = sim->size;
+
+	return 0;
+}
+
+static void sandbox_spi_info(struct device_d *dev)
+{
+	struct sandbox_spinor *sim = dev->priv;
+
+	printf("file: %s\n", sim->hf->filename);
+	printf("geometry: %llu bytes, %u byte sectors, %u byte pages\n",
+			sim->size, sim->sectorsize, sim->pagesize);
+	printf("timing: %luHz, tPP %luus, tSE 4K %luus, tSE %luus%s\n",
+			sim->hz, sim->tpp, sim->tse4k, sim->tse,
+			sim->map ? ", mapped reads" : "");
+}
+
+static int sandbox_spi_probe(struct device_d *dev)
+{
+	struct hf_platform_data *hf = dev->platform_data;
+	struct sandbox_spinor *sim;
+	struct spi_master *master;
+	struct spi_board_info info = {};
+	int ret;
+
+	sim = xzalloc(sizeof(*sim));
+	sim->dev = dev;
+	sim->hf = hf;
+
+	/* A typical 64Mbit flash */
+	sim->sectorsize = SZ_64K;
+	sim->pagesize = 256;
+	sim->hz = 50000000;
+	sim->tpp = 700;
+	sim->tse4k = 45000;
+	sim->tse = 150000;
+
+	ret = sim_parse_args(sim);
+	if (ret)
+		goto err;
+
+	if (!sim->size)
+		sim->size = hf->size ? hf->size : SZ_8M;
+
+	if (!is_power_of_2(sim->size) || !is_power_of_2(sim->sectorsize) ||
+	    !is_power_of_2(sim->pagesize) || sim->sectorsize < SZ_4K ||
+	    sim->size < sim->sectorsize || sim->pagesize > SZ_4K ||
+	    sim->size > SZ_256M || !sim->hz) {
+		dev_err(dev, "invalid geometry\n");
+		ret = -EINVAL;
+		goto err;
+	}
+
+	sim->tbyte = 8000000 / max(sim->hz / 1000, 1UL);
+	sim->page = xmalloc(sim->pagesize);
+	sim->addr_width = sim->size > SZ_16M ? 4 : 3;
+
+	ret = sim_extend_file(sim);
+	if (ret) {
+		dev_err(dev, "cannot extend %s\n", hf->filename);
+		goto err;
+	}
+
+	sim->id[0] = 0x00;
+	sim->id[1] = 0x40;
+	sim->id[2] = ffs(sim->size) - 1;
+	sim_init_sfdp(sim);
+
+	dev->priv = sim;
+
+	master = &sim->master;
+	master->dev = dev;
+	master->bus_num = dev->id;
+	master->num_chipselect = 1;
+	master->setup = sandbox_spi_setup;
+	master->transfer = sandbox_spi_transfer;
+	master->flash_map = sandbox_spi_flash_map;
+
+	sim->pdata.name = "spinor";
+
+	info.name = "m25p80";
+	info.max_speed_hz = sim->hz;
+	info.bus_num = master->bus_num;
+	info.platform_data = &sim->pdata;
+
+	spi_register_board_info(&info, 1);
+
+	return spi_register_master(master);
+
+err:
+	free(sim->page);
+	free(sim);
+
+	return ret;
+}
+
+static struct driver_d sandbox_spi_driver = {
+	.name  = "sandbox-spinor",
+	.probe = sandbox_spi_probe,
+	.info  = sandbox_spi_info,
+};
+device_platform_driver(sandbox_spi_driver);
@@ -73,6 +73,14 @@ struct spi_device *spi_new_device(struct spi_master *master,
 	proxy->chip_select = chip->chip_select;
 	proxy->max_speed_hz = chip->max_speed_hz;
 	proxy->mode = chip->mode;
+
+	/* multi wire transfers need the controller to support them */
+	if (proxy->mode & ~master->mode_bits & SPI_NBITS_MODE_MASK) {
+		debug("%s: master does not support mode 0x%x\n", chip->name,
+				proxy->mode & ~master->mode_bits &
+				SPI_NBITS_MODE_MASK);
+		proxy->mode &= ~SPI_NBITS_MODE_MASK | master->mode_bits;
+	}
 	proxy->bits_per_word = chip->bits_per_word ? chip->bits_per_word : 8;
 	proxy->dev.platform_data = chip->platform_data;
 	proxy->dev.bus = &spi_bus;
@@ -101,6 +109,28 @@ fail:
 EXPORT_SYMBOL(spi_new_device);
 
 #ifdef CONFIG_OFDEVICE
+static u16 spi_of_bus_width(struct device_node *n, const char *propname,
+		u16 dual, u16 quad)
+{
+	u32 width;
+
+	if (of_property_read_u32(n, propname, &width))
+		return 0;
+
+	switch (width) {
+	case 1:
+		return 0;
+	case 2:
+		return dual;
+	case 4:
+		return quad;
+	default:
+		pr_warning("%s: %s %d not supported\n", n->name, propname,
+				width);
+		return 0;
+	}
+}
+
 void spi_of_register_slaves(struct spi_master *master, struct device_node *node)
 {
 	struct device_node *n;
@@ -108,13 +138,18 @@ void spi_of_register_slaves(struct spi_master *master, struct device_node *node)
 	struct property *reg;
 
 	device_node_for_nach_child(node, n) {
+		memset(&chip, 0, sizeof(chip));
 		chip.name = n->name;
 		chip.bus_num = master->bus_num;
 		chip.max_speed_hz = 300000; /* FIXME */
 		reg = of_find_property(n, "reg");
 		if (!reg)
 			continue;
-		chip.chip_select = of_read_number(reg->value, 1);
+		chip.chip_select = of_read_number(of_property_get_value(reg), 1);
+		chip.mode |= spi_of_bus_width(n, "spi-tx-bus-width",
+				SPI_TX_DUAL, SPI_TX_QUAD);
+		chip.mode |= spi_of_bus_width(n, "spi-rx-bus-width",
+				SPI_RX_DUAL, SPI_RX_QUAD);
 		chip.device_node = n;
 		spi_register_board_info(&chip, 1);
 	}
@@ -231,11 +266,127 @@ struct spi_master *spi_get_master(int bus)
 	return NULL;
 }
 
+static int spi_check_nbits(struct spi_device *spi, u8 *nbits,
+		u16 dual, u16 quad)
+{
+	switch (*nbits) {
+	case 0:
+		*nbits = SPI_NBITS_SINGLE;
+		/* fall through */
+	case SPI_NBITS_SINGLE:
+		return 0;
+	case SPI_NBITS_DUAL:
+		return spi->mode & (dual | quad) ? 0 : -EINVAL;
+	case SPI_NBITS_QUAD:
+		return spi->mode & quad ? 0 : -EINVAL;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int spi_check_message(struct spi_device *spi,
+		struct spi_message *message)
+{
+	struct spi_transfer *t;
+	int ret;
+
+	list_for_each_entry(t, &message->transfers, transfer_list) {
+		ret = spi_check_nbits(spi, &t->tx_nbits, SPI_TX_DUAL,
+				SPI_TX_QUAD);
+		if (ret)
+			return ret;
+
+		ret = spi_check_nbits(spi, &t->rx_nbits, SPI_RX_DUAL,
+				SPI_RX_QUAD);
+		if (ret)
+			return ret;
+
+		/* multi wire transfers are half duplex */
+		if ((t->tx_nbits != SPI_NBITS_SINGLE ||
+		     t->rx_nbits != SPI_NBITS_SINGLE) &&
+		    t->tx_buf && t->rx_buf)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
 int spi_sync(struct spi_device *spi, struct spi_message *message)
 {
+	int ret;
+
+	ret = spi_check_message(spi, message);
+	if (ret)
+		return ret;
+
 	return spi->master->transfer(spi, message);
 }
 
+/**
+ * spi_sync_batch - transfer a sequence of messages
+ * @spi: device with which data will be exchanged
+ * @batch: the messages, added with spi_batch_add_tail()
+ *
+ * The messages are transferred in order, chip select is deasserted
+ * between them like for separate spi_sync() calls. Controllers which
+ * can chain messages do so without returning to the CPU in between,
+ * which saves the turnaround time for sequences like write enable
+ * followed by a page program on a serial flash.
+ *
+ * Returns zero on success, else the error of the first failing
+ * message, which is also stored in its @status. The remaining messages
+ * may not have been transferred then.
+ */
+int spi_sync_batch(struct spi_device *spi, struct list_head *batch)
+{
+	struct spi_message *m;
+	int ret;
+
+	list_for_each_entry(m, batch, queue) {
+		ret = spi_check_message(spi, m);
+		if (ret)
+			return ret;
+	}
+
+	if (spi->master->transfer_batch)
+		return spi->master->transfer_batch(spi, batch);
+
+	list_for_each_entry(m, batch, queue) {
+		ret = spi->master->transfer(spi, m);
+		m->status = ret;
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * spi_flash_map - map a serial flash into the CPU address space
+ * @spi: the flash
+ * @map: the read command the controller should use
+ *
+ * Returns the start of the window or NULL if the controller can't map
+ * flashes or doesn't support the command. Reads from the window behave
+ * like the read command issued with spi_sync(), so they are only valid
+ * while the flash is not busy writing or erasing.
+ */
+void __iomem *spi_flash_map(struct spi_device *spi,
+		const struct spi_flash_map *map)
+{
+	u8 addr_nbits = map->addr_nbits, data_nbits = map->data_nbits;
+
+	if (!spi->master->flash_map)
+		return NULL;
+
+	if (spi_check_nbits(spi, &addr_nbits, SPI_TX_DUAL, SPI_TX_QUAD) ||
+	    spi_check_nbits(spi, &data_nbits, SPI_RX_DUAL, SPI_RX_QUAD))
+		return NULL;
+
+	return spi->master->flash_map(spi, map);
+}
+EXPORT_SYMBOL(spi_flash_map);
+
 /**
  * spi_write_then_read - SPI synchronous write followed by read
  * @spi: device with which data will be exchanged
@@ -302,6 +453,7 @@ struct bus_type spi_bus = {
 	.match = spi_match,
 	.probe = spi_probe,
 	.remove = spi_remove,
+	.of_match_only = 1,
 };
 
 static int spi_bus_init(void)
@@ -21,6 +21,7 @@ struct atmel_lcdfb_info {
 
 	unsigned int		guard_time;
 	unsigned int		smem_len;
+	unsigned int		screen_len;	/* size of screen_base */
 	struct clk		*bus_clk;
 	struct clk		*lcdc_clk;
 
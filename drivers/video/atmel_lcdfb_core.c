@@ -198,7 +198,8 @@ static int atmel_lcdfb_alloc_video_memory(struct atmel_lcdfb_info *sinfo)
 	struct fb_videomode *mode = info->mode;
 	unsigned int smem_len;
 
-	free(info->screen_base);
+	if (info->screen_base)
+		dma_free_coherent(info->screen_base, sinfo->screen_len);
 
 	smem_len = (mode->xres * mode->yres
 		    * ((info->bits_per_pixel + 7) / 8));
@@ -209,6 +210,7 @@ static int atmel_lcdfb_alloc_video_memory(struct atmel_lcdfb_info *sinfo)
 	if (!info->screen_base)
 		return -ENOMEM;
 
+	sinfo->screen_len = smem_len;
 	memset(info->screen_base, 0, smem_len);
 
 	return 0;
@@ -303,7 +305,7 @@ int atmel_lcdc_register(struct device_d *dev, struct atmel_lcdfb_devdata *data)
 
 stop_clk:
 	if (sinfo->dma_desc)
-		free(sinfo->dma_desc);
+		dma_free_coherent(sinfo->dma_desc, data->dma_desc_size);
 	atmel_lcdfb_stop_clock(sinfo);
 	clk_put(sinfo->lcdc_clk);
 put_bus_clk:
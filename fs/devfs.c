@@ -108,12 +108,28 @@ static int devfs_memmap(struct device_d *_dev, FILE *f, void **map, int flags)
 	return ret;
 }
 
+/*
+ * A missing device file may belong to a device which has not been probed
+ * or detected yet, so give it a chance before giving up. open() looks
+ * up the file with stat() first, so this is done in both.
+ */
+static struct cdev *devfs_cdev_by_name(const char *name)
+{
+	struct cdev *cdev;
+
+	cdev = cdev_by_name(name);
+	if (!cdev && device_detect_file(name))
+		cdev = cdev_by_name(name);
+
+	return cdev;
+}
+
 static int devfs_open(struct device_d *_dev, FILE *f, const char *filename)
 {
 	struct cdev *cdev;
 	int ret;
 
-	cdev = cdev_by_name(filename + 1);
+	cdev = devfs_cdev_by_name(filename + 1);
 
 	if (!cdev)
 		return -ENOENT;
@@ -212,7 +228,7 @@ static int devfs_stat(struct device_d *_dev, const char *filename, struct stat *
 {
 	struct cdev *cdev;
 
-	cdev = cdev_by_name(filename + 1);
+	cdev = devfs_cdev_by_name(filename + 1);
 	if (!cdev)
 		return -ENOENT;
 
@@ -1578,37 +1578,117 @@ out:
 }
 EXPORT_SYMBOL(rmdir);
 
-static void memcpy_sz(void *_dst, const void *_src, ulong count, ulong rwsize)
-{
-	ulong dst = (ulong)_dst;
-	ulong src = (ulong)_src;
+/*
+ * Width preserving copy and compare kernels. The accesses go through
+ * volatile pointers so that the compiler can neither merge nor split
+ * them, the loops are unrolled to keep the loop overhead small compared
+ * to the accesses.
+ */
+#define MEM_SZ_KERNELS(bits)						\
+static void memcpy_##bits(volatile u##bits *dst,			\
+		const volatile u##bits *src, ulong count)		\
+{									\
+	while (count >= 4) {						\
+		dst[0] = src[0];					\
+		dst[1] = src[1];					\
+		dst[2] = src[2];					\
+		dst[3] = src[3];					\
+		dst += 4;						\
+		src += 4;						\
+		count -= 4;						\
+	}								\
+									\
+	while (count--)							\
+		*dst++ = *src++;					\
+}									\
+									\
+static ulong memcmp_##bits(const volatile u##bits *a,			\
+		const volatile u##bits *b, ulong count)			\
+{									\
+	ulong i = 0;							\
+									\
+	while (i + 4 <= count) {					\
+		if (a[i] != b[i] || a[i + 1] != b[i + 1] ||		\
+				a[i + 2] != b[i + 2] ||			\
+				a[i + 3] != b[i + 3])			\
+			break;						\
+		i += 4;							\
+	}								\
+									\
+	for (; i < count; i++)						\
+		if (a[i] != b[i])					\
+			break;						\
+									\
+	return i;							\
+}
 
-	/* no rwsize specification given. Do whatever memcpy likes best */
-	if (!rwsize) {
-		memcpy(_dst, _src, count);
-		return;
-	}
+MEM_SZ_KERNELS(8)
+MEM_SZ_KERNELS(16)
+MEM_SZ_KERNELS(32)
+MEM_SZ_KERNELS(64)
 
-	rwsize = rwsize >> O_RWSIZE_SHIFT;
+/*
+ * Copy @count bytes with the access width given by the O_RWSIZE_* flags in
+ * @rwsize. Without a width do whatever memcpy likes best. Trailing bytes
+ * which do not make a full access are not copied.
+ */
+void memcpy_sz(void *dst, const void *src, ulong count, ulong rwsize)
+{
+	switch (O_RWSIZE_BYTES(rwsize)) {
+	case 1:
+		memcpy_8(dst, src, count);
+		break;
+	case 2:
+		memcpy_16(dst, src, count / 2);
+		break;
+	case 4:
+		memcpy_32(dst, src, count / 4);
+		break;
+	case 8:
+		memcpy_64(dst, src, count / 8);
+		break;
+	default:
+		memcpy(dst, src, count);
+		break;
+	}
+}
+EXPORT_SYMBOL(memcpy_sz);
 
-	count /= rwsize;
+/*
+ * Compare @count bytes with the access width given by the O_RWSIZE_* flags
+ * in @rwsize. Returns the offset of the first access which differs, @count
+ * if the regions are equal. Like in memcpy_sz() trailing bytes which do
+ * not make a full access are ignored.
+ */
+ulong memcmp_sz(const void *a, const void *b, ulong count, ulong rwsize)
+{
+	const u8 *pa = a, *pb = b;
+	ulong ofs, now, n;
+
+	switch (O_RWSIZE_BYTES(rwsize)) {
+	case 1:
+		return memcmp_8(a, b, count);
+	case 2:
+		n = memcmp_16(a, b, count / 2);
+		return n == count / 2 ? count : n * 2;
+	case 4:
+		n = memcmp_32(a, b, count / 4);
+		return n == count / 4 ? count : n * 4;
+	case 8:
+		n = memcmp_64(a, b, count / 8);
+		return n == count / 8 ? count : n * 8;
+	}
 
-	while (count-- > 0) {
-		switch (rwsize) {
-		case 1:
-			*((u_char *)dst) = *((u_char *)src);
-			break;
-		case 2:
-			*((ushort *)dst) = *((ushort *)src);
-			break;
-		case 4:
-			*((ulong  *)dst) = *((ulong  *)src);
-			break;
-		}
-		dst += rwsize;
-		src += rwsize;
+	/* memcmp() in blocks, then find the byte in the block which differs */
+	for (ofs = 0; ofs < count; ofs += now) {
+		now = min(count - ofs, 4096UL);
+		if (memcmp(pa + ofs, pb + ofs, now))
+			return ofs + memcmp_8(pa + ofs, pb + ofs, now);
 	}
+
+	return count;
 }
+EXPORT_SYMBOL(memcmp_sz);
 
 ssize_t mem_read(struct cdev *cdev, void *buf, size_t count, loff_t offset, ulong flags)
 {
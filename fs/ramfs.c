@@ -26,13 +26,19 @@
 #include <errno.h>
 #include <linux/stat.h>
 #include <xfuncs.h>
+#include <fcntl.h>
 
-#define CHUNK_SIZE	(4096 * 2)
-
-struct ramfs_chunk {
-	char *data;
-	struct ramfs_chunk *next;
-};
+/*
+ * File data starts with a single extent which is grown with realloc()
+ * while the file grows, so files written sequentially usually stay in one
+ * piece and can be memmapped. The extent doubles in size to keep the
+ * copying done by realloc() low, and is trimmed to the file size again
+ * when the writer closes the file. When the extent cannot be grown
+ * anymore, the rest of the file goes to an array of RAMFS_CHUNK_SIZE
+ * chunks after it. Either way the memory for any offset is found by a
+ * division.
+ */
+#define RAMFS_CHUNK_SIZE	(4096 * 2)
 
 struct ramfs_inode {
 	char *name;
@@ -45,11 +51,11 @@ struct ramfs_inode {
 	struct handle_d *handle;
 
 	ulong size;
-	struct ramfs_chunk *data;
-
-	/* Points to recently used chunk */
-	int recent_chunk;
-	struct ramfs_chunk *recent_chunkp;
+	char *extent;
+	ulong extent_size;
+	char **chunks;		/* behind the extent */
+	int nr_chunks;
+	int max_chunks;		/* allocated entries in chunks */
 };
 
 struct ramfs_priv {
@@ -132,32 +138,6 @@ out:
 	return node;
 }
 
-static int chunks = 0;
-
-static struct ramfs_chunk *ramfs_get_chunk(void)
-{
-	struct ramfs_chunk *data = malloc(sizeof(struct ramfs_chunk));
-	if (!data)
-		return NULL;
-
-	data->data = malloc(CHUNK_SIZE);
-	if (!data->data) {
-		free(data);
-		return NULL;
-	}
-	data->next = NULL;
-	chunks++;
-
-	return data;
-}
-
-static void ramfs_put_chunk(struct ramfs_chunk *data)
-{
-	free(data->data);
-	free(data);
-	chunks--;
-}
-
 static struct ramfs_inode* ramfs_get_inode(void)
 {
 	struct ramfs_inode *node = xzalloc(sizeof(struct ramfs_inode));
@@ -166,13 +146,12 @@ static struct ramfs_inode* ramfs_get_inode(void)
 
 static void ramfs_put_inode(struct ramfs_inode *node)
 {
-	struct ramfs_chunk *data = node->data;
+	int i;
 
-	while (data) {
-		struct ramfs_chunk *tmp = data->next;
-		ramfs_put_chunk(data);
-		data = tmp;
-	}
+	for (i = 0; i < node->nr_chunks; i++)
+		free(node->chunks[i]);
+	free(node->chunks);
+	free(node->extent);
 
 	free(node->symlink);
 	free(node->name);
@@ -315,85 +294,73 @@ static int ramfs_open(struct device_d *dev, FILE *file, const char *filename)
 	return 0;
 }
 
-static int ramfs_close(struct device_d *dev, FILE *f)
+/* give back what the extent has beyond the end of the file */
+static void ramfs_trim_extent(struct ramfs_inode *node)
 {
-	return 0;
+	ulong newsize = ALIGN(node->size, RAMFS_CHUNK_SIZE);
+	char *data;
+
+	if (node->nr_chunks || !newsize || newsize >= node->extent_size)
+		return;
+
+	data = realloc(node->extent, newsize);
+	if (!data)
+		return;
+
+	node->extent = data;
+	node->extent_size = newsize;
 }
 
-static struct ramfs_chunk *ramfs_find_chunk(struct ramfs_inode *node, int chunk)
+static int ramfs_close(struct device_d *dev, FILE *f)
 {
-	struct ramfs_chunk *data;
-	int left = chunk;
+	struct ramfs_inode *node = (struct ramfs_inode *)f->inode;
 
-	if (chunk == 0)
-		return node->data;
+	if ((f->flags & O_ACCMODE) != O_RDONLY)
+		ramfs_trim_extent(node);
 
-	if (node->recent_chunk == chunk)
-		return node->recent_chunkp;
+	return 0;
+}
 
-	if (node->recent_chunk < chunk && node->recent_chunk != 0) {
-		/* Start at last known chunk */
-		data = node->recent_chunkp;
-		left -= node->recent_chunk;
-	} else {
-		/* Start at first chunk */
-		data = node->data;
-	}
+static void ramfs_copy(struct ramfs_inode *node, ulong pos, void *buf,
+		size_t size, int write)
+{
+	while (size) {
+		char *chunk;
+		ulong ofs, len;
+		size_t now;
+
+		if (pos < node->extent_size) {
+			chunk = node->extent;
+			ofs = pos;
+			len = node->extent_size;
+		} else {
+			ulong tail = pos - node->extent_size;
+
+			chunk = node->chunks[tail / RAMFS_CHUNK_SIZE];
+			ofs = tail % RAMFS_CHUNK_SIZE;
+			len = RAMFS_CHUNK_SIZE;
+		}
 
-	while (left--)
-		data = data->next;
+		now = min_t(size_t, size, len - ofs);
 
-	node->recent_chunkp = data;
-	node->recent_chunk = chunk;
+		if (write)
+			memcpy(chunk + ofs, buf, now);
+		else
+			memcpy(buf, chunk + ofs, now);
 
-	return data;
+		size -= now;
+		pos += now;
+		buf += now;
+	}
 }
 
 static int ramfs_read(struct device_d *_dev, FILE *f, void *buf, size_t insize)
 {
 	struct ramfs_inode *node = (struct ramfs_inode *)f->inode;
-	int chunk;
-	struct ramfs_chunk *data;
-	int ofs;
-	int now;
-	int pos = f->pos;
-	int size = insize;
-
-	chunk = f->pos / CHUNK_SIZE;
-	debug("%s: reading from chunk %d\n", __FUNCTION__, chunk);
-
-	/* Position ourself in stream */
-	data = ramfs_find_chunk(node, chunk);
-	ofs = f->pos % CHUNK_SIZE;
-
-	/* Read till end of current chunk */
-	if (ofs) {
-		now = min(size, CHUNK_SIZE - ofs);
-		debug("Reading till end of node. size: %d\n", size);
-		memcpy(buf, data->data + ofs, now);
-		size -= now;
-		pos += now;
-		buf += now;
-		if (pos > node->size)
-			node->size = now;
-		data = data->next;
-	}
 
-	/* Do full chunks */
-	while (size >= CHUNK_SIZE) {
-		debug("do full chunk. size: %d\n", size);
-		memcpy(buf, data->data, CHUNK_SIZE);
-		data = data->next;
-		size -= CHUNK_SIZE;
-		pos += CHUNK_SIZE;
-		buf += CHUNK_SIZE;
-	}
+	debug("%s: reading %zu bytes at %lld\n", __func__, insize, f->pos);
 
-	/* And the rest */
-	if (size) {
-		debug("do rest. size: %d\n", size);
-		memcpy(buf, data->data, size);
-	}
+	ramfs_copy(node, f->pos, buf, insize, 0);
 
 	return insize;
 }
@@ -401,48 +368,10 @@ static int ramfs_read(struct device_d *_dev, FILE *f, void *buf, size_t insize)
 static int ramfs_write(struct device_d *_dev, FILE *f, const void *buf, size_t insize)
 {
 	struct ramfs_inode *node = (struct ramfs_inode *)f->inode;
-	int chunk;
-	struct ramfs_chunk *data;
-	int ofs;
-	int now;
-	int pos = f->pos;
-	int size = insize;
-
-	chunk = f->pos / CHUNK_SIZE;
-	debug("%s: writing to chunk %d\n", __FUNCTION__, chunk);
-
-	/* Position ourself in stream */
-	data = ramfs_find_chunk(node, chunk);
-	ofs = f->pos % CHUNK_SIZE;
-
-	/* Write till end of current chunk */
-	if (ofs) {
-		now = min(size, CHUNK_SIZE - ofs);
-		debug("writing till end of node. size: %d\n", size);
-		memcpy(data->data + ofs, buf, now);
-		size -= now;
-		pos += now;
-		buf += now;
-		if (pos > node->size)
-			node->size = now;
-		data = data->next;
-	}
 
-	/* Do full chunks */
-	while (size >= CHUNK_SIZE) {
-		debug("do full chunk. size: %d\n", size);
-		memcpy(data->data, buf, CHUNK_SIZE);
-		data = data->next;
-		size -= CHUNK_SIZE;
-		pos += CHUNK_SIZE;
-		buf += CHUNK_SIZE;
-	}
+	debug("%s: writing %zu bytes at %lld\n", __func__, insize, f->pos);
 
-	/* And the rest */
-	if (size) {
-		debug("do rest. size: %d\n", size);
-		memcpy(data->data, buf, size);
-	}
+	ramfs_copy(node, f->pos, (void *)buf, insize, 1);
 
 	return insize;
 }
@@ -453,52 +382,102 @@ static loff_t ramfs_lseek(struct device_d *dev, FILE *f, loff_t pos)
 	return f->pos;
 }
 
+/* grow the extent to hold at least @size bytes, in one piece */
+static int ramfs_grow_extent(struct ramfs_inode *node, ulong size)
+{
+	ulong newsize;
+	char *data;
+
+	newsize = ALIGN(max(size, node->extent_size * 2), RAMFS_CHUNK_SIZE);
+
+	data = realloc(node->extent, newsize);
+	if (!data && newsize > size) {
+		newsize = ALIGN(size, RAMFS_CHUNK_SIZE);
+		data = realloc(node->extent, newsize);
+	}
+	if (!data)
+		return -ENOMEM;
+
+	node->extent = data;
+	node->extent_size = newsize;
+
+	return 0;
+}
+
+static int ramfs_add_chunks(struct ramfs_inode *node, int nr)
+{
+	if (nr > node->max_chunks) {
+		int n = max(nr, node->max_chunks * 2);
+		char **chunks = realloc(node->chunks, n * sizeof(char *));
+
+		if (!chunks)
+			return -ENOMEM;
+
+		node->chunks = chunks;
+		node->max_chunks = n;
+	}
+
+	while (node->nr_chunks < nr) {
+		char *data = malloc(RAMFS_CHUNK_SIZE);
+
+		if (!data)
+			return -ENOMEM;
+
+		node->chunks[node->nr_chunks++] = data;
+	}
+
+	return 0;
+}
+
 static int ramfs_truncate(struct device_d *dev, FILE *f, ulong size)
 {
 	struct ramfs_inode *node = (struct ramfs_inode *)f->inode;
-	int oldchunks, newchunks;
-	struct ramfs_chunk *data = node->data;
-
-	newchunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
-	oldchunks = (node->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
-
-	if (newchunks < oldchunks) {
-		if (!newchunks)
-			node->data = NULL;
-		while (newchunks--)
-			data = data->next;
-		while (data) {
-			struct ramfs_chunk *tmp;
-			tmp = data->next;
-			ramfs_put_chunk(data);
-			data = tmp;
-		}
-		if (node->recent_chunk > newchunks)
-			node->recent_chunk = 0;
+	int newchunks = 0, shrink, ret;
+
+	if (!size) {
+		free(node->extent);
+		node->extent = NULL;
+		node->extent_size = 0;
 	}
 
-	if (newchunks > oldchunks) {
-		if (!data) {
-			node->data = ramfs_get_chunk();
-			if (!node->data)
-				return -ENOMEM;
-			data = node->data;
-		}
+	/* once there are chunks behind it the extent stays as it is */
+	if (size > node->extent_size && !node->nr_chunks &&
+			!ramfs_grow_extent(node, size)) {
+		node->size = size;
+		return 0;
+	}
 
-		newchunks--;
-		while (data->next) {
-			newchunks--;
-			data = data->next;
-		}
+	if (size > node->extent_size)
+		newchunks = DIV_ROUND_UP(size - node->extent_size,
+				RAMFS_CHUNK_SIZE);
 
-		while (newchunks--) {
-			data->next = ramfs_get_chunk();
-			if (!data->next)
-				return -ENOMEM;
-		data = data->next;
-		}
-	}
+	/* unused chunks are freed, the extent is trimmed below */
+	while (node->nr_chunks > newchunks)
+		free(node->chunks[--node->nr_chunks]);
+
+	ret = ramfs_add_chunks(node, newchunks);
+	if (ret)
+		return ret;
+
+	shrink = size < node->size;
 	node->size = size;
+
+	if (shrink)
+		ramfs_trim_extent(node);
+
+	return 0;
+}
+
+/* files which are in one piece can be mapped directly */
+static int ramfs_memmap(struct device_d *dev, FILE *f, void **map, int flags)
+{
+	struct ramfs_inode *node = (struct ramfs_inode *)f->inode;
+
+	if (!node->extent || node->nr_chunks)
+		return -EINVAL;
+
+	*map = node->extent;
+
 	return 0;
 }
 
@@ -630,6 +609,7 @@ static struct fs_driver_d ramfs_driver = {
 	.stat      = ramfs_stat,
 	.symlink   = ramfs_symlink,
 	.readlink  = ramfs_readlink,
+	.memmap    = ramfs_memmap,
 	.flags     = FS_DRIVER_NO_DEV,
 	.drv = {
 		.probe  = ramfs_probe,
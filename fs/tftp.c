@@ -351,6 +351,13 @@ static void tftp_handler(void *ctx, char *packet, unsigned len)
 			tftp_send(priv);
 			priv->err = 0;
 			priv->state = STATE_DONE;
+		} else if (TFTP_FIFO_SIZE - kfifo_len(priv->fifo) >=
+				priv->blocksize) {
+			/*
+			 * Request the next block right away, so that it is on
+			 * its way while the reader works on this one.
+			 */
+			tftp_send(priv);
 		}
 
 		break;
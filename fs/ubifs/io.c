@@ -0,0 +1,230 @@
+/*
+ * io.c - read UBIFS nodes
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Nodes are not read one by one. Whole LEBs are read into a small cache
+ * instead, so that reading a file results in one large read per LEB, like
+ * reading a raw UBI volume does. The nodes are used right from the cache,
+ * a pointer to a node is valid until the next LEB is read.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <malloc.h>
+#include <errno.h>
+#include <linux/err.h>
+#include <lzo.h>
+#include <linux/zlib.h>
+#include "ubifs.h"
+
+const void *ubifs_read_leb(struct ubifs_info *c, int lnum)
+{
+	struct ubifs_leb_cache *lc, *victim = &c->lebs[0];
+	ssize_t ret;
+	int i;
+
+	if (lnum < 0 || lnum >= c->leb_cnt)
+		return ERR_PTR(-EINVAL);
+
+	for (i = 0; i < UBIFS_LEB_CACHE_SIZE; i++) {
+		lc = &c->lebs[i];
+
+		if (lc->buf && lc->lnum == lnum) {
+			lc->used = ++c->lebs_used;
+			return lc->buf;
+		}
+
+		if (lc->used < victim->used)
+			victim = lc;
+	}
+
+	if (!victim->buf)
+		victim->buf = xmalloc(c->leb_size);
+
+	victim->lnum = -1;
+	victim->used = 0;
+	ret = cdev_read(c->cdev, victim->buf, c->leb_size,
+			(loff_t)lnum * c->leb_size, 0);
+	if (ret < 0) {
+		dev_err(c->dev, "cannot read LEB %d: %s\n", lnum,
+				strerror(-ret));
+		return ERR_PTR(ret);
+	}
+
+	victim->lnum = lnum;
+	victim->used = ++c->lebs_used;
+
+	return victim->buf;
+}
+
+/**
+ * ubifs_check_node - check a node
+ * @c: the file system
+ * @buf: the node
+ * @lnum: LEB number of the node, for messages
+ * @offs: offset of the node, for messages
+ * @avail: number of bytes available at @buf
+ *
+ * Checks the magic, the length and the CRC of a node. Returns the node
+ * length or a negative error code.
+ */
+int ubifs_check_node(struct ubifs_info *c, const void *buf, int lnum,
+		int offs, int avail)
+{
+	const struct ubifs_ch *ch = buf;
+	uint32_t crc;
+	int len;
+
+	if (avail < UBIFS_CH_SZ || le32_to_cpu(ch->magic) != UBIFS_NODE_MAGIC)
+		return -EUCLEAN;
+
+	len = le32_to_cpu(ch->len);
+	if (len < UBIFS_CH_SZ || len > avail || ch->node_type >= UBIFS_NODE_TYPES_CNT) {
+		dev_dbg(c->dev, "bad node at LEB %d:%d\n", lnum, offs);
+		return -EUCLEAN;
+	}
+
+	crc = crc32_no_comp(UBIFS_CRC32_INIT, buf + 8, len - 8);
+	if (crc != le32_to_cpu(ch->crc)) {
+		dev_dbg(c->dev, "bad node CRC at LEB %d:%d\n", lnum, offs);
+		return -EUCLEAN;
+	}
+
+	return len;
+}
+
+/**
+ * ubifs_read_node - read a node
+ * @c: the file system
+ * @type: the expected node type
+ * @lnum: LEB number of the node
+ * @offs: offset of the node
+ * @len: length of the node
+ * @check_crc: also check the CRC. Data nodes are not checked by
+ *              default, UBI takes care of their integrity.
+ *
+ * Returns a pointer to the node which is valid until the next node is read.
+ */
+const void *ubifs_read_node(struct ubifs_info *c, int type, int lnum,
+		int offs, int len, int check_crc)
+{
+	const struct ubifs_ch *ch;
+	const void *leb;
+	int ret;
+
+	if (offs < 0 || len < UBIFS_CH_SZ || offs > c->leb_size - len)
+		return ERR_PTR(-EINVAL);
+
+	leb = ubifs_read_leb(c, lnum);
+	if (IS_ERR(leb))
+		return leb;
+
+	ch = leb + offs;
+
+	if (check_crc) {
+		ret = ubifs_check_node(c, ch, lnum, offs, len);
+		if (ret < 0)
+			goto bad;
+	} else if (le32_to_cpu(ch->magic) != UBIFS_NODE_MAGIC) {
+		goto bad;
+	}
+
+	if (ch->node_type != type || le32_to_cpu(ch->len) != len)
+		goto bad;
+
+	return ch;
+bad:
+	dev_err(c->dev, "bad node at LEB %d:%d\n", lnum, offs);
+
+	return ERR_PTR(-EUCLEAN);
+}
+
+#ifdef CONFIG_FS_UBIFS_COMPRESSION_ZLIB
+static z_stream ubifs_zstream;
+
+static int ubifs_inflate(const void *in, int in_len, void *out, int out_len)
+{
+	z_stream *s = &ubifs_zstream;
+	int ret;
+
+	if (!s->workspace) {
+		s->workspace = xmalloc(zlib_inflate_workspacesize());
+		/* UBIFS uses raw deflate without zlib header */
+		zlib_inflateInit2(s, -MAX_WBITS);
+	} else {
+		zlib_inflateReset(s);
+	}
+
+	s->next_in = in;
+	s->avail_in = in_len;
+	s->next_out = out;
+	s->avail_out = out_len;
+
+	ret = zlib_inflate(s, Z_FINISH);
+	if (ret != Z_STREAM_END && (ret != Z_OK || s->total_out != out_len))
+		return -EUCLEAN;
+
+	return s->total_out;
+}
+#endif
+
+/**
+ * ubifs_decompress - decompress a data block
+ * @in: the compressed data
+ * @in_len: length of the compressed data
+ * @out: where the data goes
+ * @out_len: the uncompressed size
+ * @compr_type: compression type of the data node
+ *
+ * Returns 0 or a negative error code.
+ */
+int ubifs_decompress(const void *in, int in_len, void *out, int out_len,
+		int compr_type)
+{
+	switch (compr_type) {
+	case UBIFS_COMPR_NONE:
+		if (in_len != out_len)
+			return -EUCLEAN;
+		memcpy(out, in, in_len);
+		return 0;
+#ifdef CONFIG_FS_UBIFS_COMPRESSION_LZO
+	case UBIFS_COMPR_LZO: {
+		size_t len = out_len;
+
+		if (lzo1x_decompress_safe(in, in_len, out, &len) != LZO_E_OK ||
+				len != out_len)
+			return -EUCLEAN;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_FS_UBIFS_COMPRESSION_ZLIB
+	case UBIFS_COMPR_ZLIB:
+		if (ubifs_inflate(in, in_len, out, out_len) != out_len)
+			return -EUCLEAN;
+		return 0;
+#endif
+	default:
+		return -ENOSYS;
+	}
+}
+
+void ubifs_io_close(struct ubifs_info *c)
+{
+	int i;
+
+	for (i = 0; i < UBIFS_LEB_CACHE_SIZE; i++) {
+		free(c->lebs[i].buf);
+		c->lebs[i].buf = NULL;
+	}
+}
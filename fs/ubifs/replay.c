@@ -0,0 +1,452 @@
+/*
+ * replay.c - apply the UBIFS journal
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Linux does not commit the journal when unmounting, so the index alone
+ * does not describe the file system. The log references the buds, the
+ * LEBs the journal has written to since the last commit. All nodes in
+ * the buds are applied in the order of their sequence numbers. We do not
+ * change the index for that but keep the nodes in the journal tree, which
+ * is consulted before the index.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <malloc.h>
+#include <errno.h>
+#include <linux/err.h>
+#include <qsort.h>
+#include "ubifs.h"
+
+struct replay_entry {
+	unsigned long long sqnum;
+	int type;
+	struct ubifs_key key;
+	int lnum;
+	int offs;
+	int len;
+	unsigned long inum;
+	unsigned long long size;
+	char *name;
+	int nlen;
+};
+
+struct replay_bud {
+	int lnum;
+	int offs;
+};
+
+struct replay_info {
+	unsigned long long cs_sqnum;
+	int nodes;
+	int end;
+
+	struct replay_bud *buds;
+	int num_buds;
+
+	struct replay_entry *entries;
+	int num_entries;
+	int max_entries;
+};
+
+/*
+ * Call @fn for all nodes in LEB @lnum starting at @offs until the end of
+ * the written data. @fn must not read other LEBs, the node is only valid
+ * while the LEB is in the cache. A nonzero return value of @fn stops the
+ * scan and is returned.
+ */
+static int scan_leb(struct ubifs_info *c, int lnum, int offs,
+		int (*fn)(struct ubifs_info *c, const struct ubifs_ch *ch,
+			int lnum, int offs, struct replay_info *r),
+		struct replay_info *r)
+{
+	const struct ubifs_pad_node *pad;
+	const unsigned char *leb;
+	int len, ret;
+
+	leb = ubifs_read_leb(c, lnum);
+	if (IS_ERR(leb))
+		return PTR_ERR(leb);
+
+	while (offs + UBIFS_CH_SZ <= c->leb_size) {
+		len = ubifs_check_node(c, leb + offs, lnum, offs,
+				c->leb_size - offs);
+		if (len < 0) {
+			/* padding too short for a padding node */
+			if (leb[offs] == UBIFS_PADDING_BYTE) {
+				offs = ALIGN(offs + 1, c->min_io_size);
+				continue;
+			}
+			break;
+		}
+
+		pad = (const void *)(leb + offs);
+		if (pad->ch.node_type == UBIFS_PAD_NODE) {
+			if (len != UBIFS_PAD_NODE_SZ)
+				break;
+			offs += len + le32_to_cpu(pad->pad_len);
+			continue;
+		}
+
+		ret = fn(c, &pad->ch, lnum, offs, r);
+		if (ret)
+			return ret;
+
+		offs += ALIGN(len, 8);
+	}
+
+	return 0;
+}
+
+static int replay_log_node(struct ubifs_info *c, const struct ubifs_ch *ch,
+		int lnum, int offs, struct replay_info *r)
+{
+	const struct ubifs_cs_node *cs = (const void *)ch;
+	const struct ubifs_ref_node *ref = (const void *)ch;
+	unsigned long long sqnum = le64_to_cpu(ch->sqnum);
+
+	if (!r->nodes++) {
+		/* The log starts with the commit start node */
+		if (ch->node_type != UBIFS_CS_NODE ||
+		    le32_to_cpu(ch->len) != UBIFS_CS_NODE_SZ ||
+		    le64_to_cpu(cs->cmt_no) != c->cmt_no) {
+			dev_err(c->dev, "no commit start node at LEB %d:%d\n",
+					lnum, offs);
+			return -EUCLEAN;
+		}
+
+		r->cs_sqnum = sqnum;
+
+		return 0;
+	}
+
+	/* Older nodes are left over from before the last commit */
+	if (sqnum < r->cs_sqnum || ch->node_type != UBIFS_REF_NODE ||
+	    le32_to_cpu(ch->len) != UBIFS_REF_NODE_SZ) {
+		r->end = 1;
+		return 1;
+	}
+
+	r->buds = xrealloc(r->buds, (r->num_buds + 1) * sizeof(*r->buds));
+	r->buds[r->num_buds].lnum = le32_to_cpu(ref->lnum);
+	r->buds[r->num_buds].offs = le32_to_cpu(ref->offs);
+	r->num_buds++;
+
+	return 0;
+}
+
+static int replay_bud_node(struct ubifs_info *c, const struct ubifs_ch *ch,
+		int lnum, int offs, struct replay_info *r)
+{
+	const struct ubifs_ino_node *ino = (const void *)ch;
+	const struct ubifs_dent_node *dent = (const void *)ch;
+	const struct ubifs_trun_node *trun = (const void *)ch;
+	struct replay_entry *e;
+	int len = le32_to_cpu(ch->len);
+
+	switch (ch->node_type) {
+	case UBIFS_INO_NODE:
+	case UBIFS_DATA_NODE:
+	case UBIFS_DENT_NODE:
+	case UBIFS_XENT_NODE:
+	case UBIFS_TRUN_NODE:
+		break;
+	default:
+		return 0;
+	}
+
+	if (r->num_entries == r->max_entries) {
+		r->max_entries = r->max_entries * 2 + 64;
+		r->entries = xrealloc(r->entries,
+				r->max_entries * sizeof(*r->entries));
+	}
+
+	e = &r->entries[r->num_entries];
+	memset(e, 0, sizeof(*e));
+	e->sqnum = le64_to_cpu(ch->sqnum);
+	e->type = ch->node_type;
+	e->lnum = lnum;
+	e->offs = offs;
+	e->len = len;
+
+	switch (ch->node_type) {
+	case UBIFS_INO_NODE:
+		if (len < UBIFS_INO_NODE_SZ)
+			return -EUCLEAN;
+		key_read(&e->key, ino->key);
+		e->size = le32_to_cpu(ino->nlink);
+		break;
+	case UBIFS_DATA_NODE:
+		if (len < UBIFS_DATA_NODE_SZ)
+			return -EUCLEAN;
+		key_read(&e->key, ((const struct ubifs_data_node *)ch)->key);
+		break;
+	case UBIFS_DENT_NODE:
+	case UBIFS_XENT_NODE:
+		e->nlen = le16_to_cpu(dent->nlen);
+		if (len < UBIFS_DENT_NODE_SZ + e->nlen ||
+		    e->nlen > UBIFS_MAX_NLEN)
+			return -EUCLEAN;
+		key_read(&e->key, dent->key);
+		e->inum = le64_to_cpu(dent->inum);
+		e->name = arena_strndup(&c->journal_mem, dent->name, e->nlen);
+		break;
+	case UBIFS_TRUN_NODE:
+		if (len != UBIFS_TRUN_NODE_SZ)
+			return -EUCLEAN;
+		e->inum = le32_to_cpu(trun->inum);
+		e->size = le64_to_cpu(trun->new_size);
+		break;
+	}
+
+	r->num_entries++;
+
+	return 0;
+}
+
+static int jnode_cmp(const struct ubifs_key *key, const char *name, int nlen,
+		const struct ubifs_jnode *j)
+{
+	int ret;
+
+	ret = keys_cmp(key, &j->key);
+	if (ret || (!name && !j->name))
+		return ret;
+
+	if (!name || !j->name)
+		return name ? 1 : -1;
+
+	if (nlen != j->nlen)
+		return nlen < j->nlen ? -1 : 1;
+
+	return memcmp(name, j->name, nlen);
+}
+
+/**
+ * ubifs_journal_find - find a node from the journal
+ * @c: the file system
+ * @key: the key of the node
+ * @name: the name for directory entries, NULL otherwise
+ * @nlen: length of @name
+ */
+struct ubifs_jnode *ubifs_journal_find(struct ubifs_info *c,
+		const struct ubifs_key *key, const char *name, int nlen)
+{
+	struct rb_node *rb = c->journal.rb_node;
+	struct ubifs_jnode *j;
+	int ret;
+
+	while (rb) {
+		j = rb_entry(rb, struct ubifs_jnode, rb);
+
+		ret = jnode_cmp(key, name, nlen, j);
+		if (!ret)
+			return j;
+
+		rb = ret < 0 ? rb->rb_left : rb->rb_right;
+	}
+
+	return NULL;
+}
+
+static void journal_add(struct ubifs_info *c, struct replay_entry *e,
+		int deleted)
+{
+	struct rb_node **p = &c->journal.rb_node, *parent = NULL;
+	struct ubifs_jnode *j;
+	int ret;
+
+	while (*p) {
+		parent = *p;
+		j = rb_entry(parent, struct ubifs_jnode, rb);
+
+		ret = jnode_cmp(&e->key, e->name, e->nlen, j);
+		if (!ret)
+			goto found;
+
+		p = ret < 0 ? &parent->rb_left : &parent->rb_right;
+	}
+
+	j = arena_zalloc(&c->journal_mem, sizeof(*j));
+	j->key = e->key;
+	j->name = e->name;
+	j->nlen = e->nlen;
+
+	rb_link_node(&j->rb, parent, p);
+	rb_insert_color(&j->rb, &c->journal);
+found:
+	j->inum = e->inum;
+	j->lnum = e->lnum;
+	j->offs = e->offs;
+	j->len = e->len;
+	j->deleted = deleted;
+}
+
+static struct ubifs_purge *purge_get(struct ubifs_info *c, unsigned long inum)
+{
+	struct ubifs_purge *p;
+
+	list_for_each_entry(p, &c->purged, list)
+		if (p->inum == inum)
+			return p;
+
+	return NULL;
+}
+
+/* Hide nodes of inode @inum, all of them or the data blocks from @block */
+static void journal_purge(struct ubifs_info *c, unsigned long inum,
+		unsigned int block, int all)
+{
+	struct ubifs_purge *p;
+	struct ubifs_jnode *j;
+	struct rb_node *rb;
+
+	p = purge_get(c, inum);
+	if (!p) {
+		p = arena_zalloc(&c->journal_mem, sizeof(*p));
+		p->inum = inum;
+		p->block = block;
+		list_add_tail(&p->list, &c->purged);
+	}
+
+	p->all |= all;
+	p->block = min(p->block, block);
+
+	for (rb = rb_first(&c->journal); rb; rb = rb_next(rb)) {
+		j = rb_entry(rb, struct ubifs_jnode, rb);
+
+		if (key_inum(&j->key) != inum)
+			continue;
+
+		if (all || (key_type(&j->key) == UBIFS_DATA_KEY &&
+			    key_block(&j->key) >= block))
+			j->deleted = 1;
+	}
+}
+
+/**
+ * ubifs_journal_hides - check if the journal removed a node of the index
+ * @c: the file system
+ * @key: the key of the node in the index
+ *
+ * This covers deleted inodes and truncated files. Deleted directory
+ * entries are found with ubifs_journal_find().
+ */
+int ubifs_journal_hides(struct ubifs_info *c, const struct ubifs_key *key)
+{
+	struct ubifs_purge *p;
+
+	if (list_empty(&c->purged))
+		return 0;
+
+	p = purge_get(c, key_inum(key));
+	if (!p)
+		return 0;
+
+	return p->all || (key_type(key) == UBIFS_DATA_KEY &&
+			key_block(key) >= p->block);
+}
+
+static void replay_apply(struct ubifs_info *c, struct replay_entry *e)
+{
+	switch (e->type) {
+	case UBIFS_INO_NODE:
+		if (e->size)
+			journal_add(c, e, 0);
+		else
+			journal_purge(c, key_inum(&e->key), 0, 1);
+		break;
+	case UBIFS_DATA_NODE:
+		journal_add(c, e, 0);
+		break;
+	case UBIFS_DENT_NODE:
+	case UBIFS_XENT_NODE:
+		journal_add(c, e, !e->inum);
+		break;
+	case UBIFS_TRUN_NODE:
+		journal_purge(c, e->inum,
+			(e->size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT, 0);
+		break;
+	}
+}
+
+static int replay_entry_cmp(const void *a, const void *b)
+{
+	const struct replay_entry *ea = a, *eb = b;
+
+	if (ea->sqnum == eb->sqnum)
+		return 0;
+
+	return ea->sqnum < eb->sqnum ? -1 : 1;
+}
+
+/**
+ * ubifs_replay_journal - read the journal
+ * @c: the file system
+ * @log_lnum: the start of the log from the master node
+ */
+int ubifs_replay_journal(struct ubifs_info *c, int log_lnum)
+{
+	struct replay_info r = {};
+	int lnum = log_lnum, ret, i;
+
+	do {
+		int nodes = r.nodes;
+
+		ret = scan_leb(c, lnum, 0, replay_log_node, &r);
+		if (ret < 0)
+			goto out;
+
+		if (r.end || r.nodes == nodes)
+			break;
+
+		if (++lnum >= UBIFS_LOG_LNUM + c->log_lebs)
+			lnum = UBIFS_LOG_LNUM;
+	} while (lnum != log_lnum);
+
+	if (!r.nodes) {
+		dev_err(c->dev, "empty log\n");
+		ret = -EUCLEAN;
+		goto out;
+	}
+
+	for (i = 0; i < r.num_buds; i++) {
+		ret = scan_leb(c, r.buds[i].lnum, r.buds[i].offs,
+				replay_bud_node, &r);
+		if (ret < 0)
+			goto out;
+	}
+
+	qsort(r.entries, r.num_entries, sizeof(*r.entries), replay_entry_cmp);
+
+	for (i = 0; i < r.num_entries; i++)
+		replay_apply(c, &r.entries[i]);
+
+	dev_dbg(c->dev, "replayed %d nodes from %d buds\n", r.num_entries,
+			r.num_buds);
+	ret = 0;
+out:
+	free(r.entries);
+	free(r.buds);
+
+	return ret;
+}
+
+void ubifs_journal_close(struct ubifs_info *c)
+{
+	/* jnodes, their names and the purge entries all live in the arena */
+	arena_free_all(&c->journal_mem);
+	c->journal = RB_ROOT;
+	INIT_LIST_HEAD(&c->purged);
+}
@@ -0,0 +1,274 @@
+/*
+ * tnc.c - walk the UBIFS index
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The index is a B+ tree of index nodes, its leaves are the inode, data
+ * and directory entry nodes. It is walked starting at the root from the
+ * master node, the LEB properties tree is never needed for reading. Index
+ * nodes are kept in memory once they have been read, so lookups of
+ * neighbouring keys, like the blocks of a file, only read the leaf nodes.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <malloc.h>
+#include <errno.h>
+#include <linux/err.h>
+#include "ubifs.h"
+
+static struct ubifs_znode *tnc_read_znode(struct ubifs_info *c,
+		struct ubifs_zbranch *zbr, int parent_level)
+{
+	const struct ubifs_idx_node *idx;
+	const struct ubifs_branch *br;
+	struct ubifs_znode *znode;
+	int i, child_cnt, level;
+
+	idx = ubifs_read_node(c, UBIFS_IDX_NODE, zbr->lnum, zbr->offs,
+			zbr->len, 1);
+	if (IS_ERR(idx))
+		return ERR_CAST(idx);
+
+	child_cnt = le16_to_cpu(idx->child_cnt);
+	level = le16_to_cpu(idx->level);
+
+	if (child_cnt < 1 || child_cnt > c->fanout ||
+	    (parent_level >= 0 && level != parent_level - 1) ||
+	    UBIFS_IDX_NODE_SZ + child_cnt * (UBIFS_BRANCH_SZ + UBIFS_SK_LEN) >
+	    zbr->len) {
+		dev_err(c->dev, "bad index node at LEB %d:%d\n", zbr->lnum,
+				zbr->offs);
+		return ERR_PTR(-EUCLEAN);
+	}
+
+	znode = xzalloc(sizeof(*znode) +
+			child_cnt * sizeof(struct ubifs_zbranch));
+	znode->level = level;
+	znode->child_cnt = child_cnt;
+
+	for (i = 0; i < child_cnt; i++) {
+		struct ubifs_zbranch *z = &znode->zbranch[i];
+
+		br = (void *)idx->branches +
+			i * (UBIFS_BRANCH_SZ + UBIFS_SK_LEN);
+		key_read(&z->key, br->key);
+		z->lnum = le32_to_cpu(br->lnum);
+		z->offs = le32_to_cpu(br->offs);
+		z->len = le32_to_cpu(br->len);
+	}
+
+	return znode;
+}
+
+/* Get the index node @zbr points to, @parent_level is -1 for the root */
+static struct ubifs_znode *tnc_get_znode(struct ubifs_info *c,
+		struct ubifs_zbranch *zbr, int parent_level)
+{
+	struct ubifs_znode *znode;
+
+	if (zbr->znode)
+		return zbr->znode;
+
+	znode = tnc_read_znode(c, zbr, parent_level);
+	if (!IS_ERR(znode))
+		zbr->znode = znode;
+
+	return znode;
+}
+
+/* Returns the last branch whose key is not greater than @key or -1 */
+static int tnc_search(struct ubifs_znode *znode, const struct ubifs_key *key)
+{
+	int beg = 0, end = znode->child_cnt, mid;
+
+	while (end > beg) {
+		mid = (beg + end) / 2;
+		if (keys_cmp(key, &znode->zbranch[mid].key) < 0)
+			end = mid;
+		else
+			beg = mid + 1;
+	}
+
+	return beg - 1;
+}
+
+static int tnc_lookup_index(struct ubifs_info *c, const struct ubifs_key *key,
+		struct ubifs_zbranch *zbr)
+{
+	struct ubifs_znode *znode;
+	int n;
+
+	znode = tnc_get_znode(c, &c->zroot, -1);
+
+	while (1) {
+		if (IS_ERR(znode))
+			return PTR_ERR(znode);
+
+		n = tnc_search(znode, key);
+		if (n < 0)
+			return -ENOENT;
+
+		if (!znode->level)
+			break;
+
+		znode = tnc_get_znode(c, &znode->zbranch[n], znode->level);
+	}
+
+	if (keys_cmp(key, &znode->zbranch[n].key))
+		return -ENOENT;
+
+	*zbr = znode->zbranch[n];
+
+	return 0;
+}
+
+/**
+ * ubifs_tnc_lookup - find a leaf node
+ * @c: the file system
+ * @key: the key to look for, not a directory entry key
+ * @zbr: where the location of the node is returned
+ *
+ * Nodes from the journal take precedence over the index. Returns 0 or
+ * -ENOENT if there is no such node.
+ */
+int ubifs_tnc_lookup(struct ubifs_info *c, const struct ubifs_key *key,
+		struct ubifs_zbranch *zbr)
+{
+	struct ubifs_jnode *j;
+
+	j = ubifs_journal_find(c, key, NULL, 0);
+	if (j) {
+		if (j->deleted)
+			return -ENOENT;
+
+		zbr->key = j->key;
+		zbr->lnum = j->lnum;
+		zbr->offs = j->offs;
+		zbr->len = j->len;
+		zbr->znode = NULL;
+
+		return 0;
+	}
+
+	if (ubifs_journal_hides(c, key))
+		return -ENOENT;
+
+	return tnc_lookup_index(c, key, zbr);
+}
+
+static int tnc_walk(struct ubifs_info *c, struct ubifs_znode *znode,
+		const struct ubifs_key *lo, const struct ubifs_key *hi,
+		int (*fn)(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+			void *priv), void *priv)
+{
+	struct ubifs_zbranch *zbr;
+	struct ubifs_znode *child;
+	int i, ret;
+
+	for (i = 0; i < znode->child_cnt; i++) {
+		zbr = &znode->zbranch[i];
+
+		if (keys_cmp(&zbr->key, hi) > 0)
+			break;
+
+		if (!znode->level) {
+			if (keys_cmp(&zbr->key, lo) < 0 ||
+			    ubifs_journal_hides(c, &zbr->key))
+				continue;
+
+			ret = fn(c, zbr, priv);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		/*
+		 * Colliding directory entry keys may continue in the next
+		 * child, so a child is only skipped if the next one starts
+		 * below @lo.
+		 */
+		if (i + 1 < znode->child_cnt &&
+		    keys_cmp(&znode->zbranch[i + 1].key, lo) < 0)
+			continue;
+
+		child = tnc_get_znode(c, zbr, znode->level);
+		if (IS_ERR(child))
+			return PTR_ERR(child);
+
+		ret = tnc_walk(c, child, lo, hi, fn, priv);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * ubifs_tnc_walk - call a function for the leaf nodes in a key range
+ * @c: the file system
+ * @lo: lowest key of the range, inclusive
+ * @hi: highest key of the range, inclusive
+ * @fn: the function, a nonzero return value stops the walk
+ * @priv: passed to @fn
+ *
+ * Only the index is walked, nodes from the journal are not included.
+ * Returns the first nonzero return value of @fn or 0.
+ */
+int ubifs_tnc_walk(struct ubifs_info *c, const struct ubifs_key *lo,
+		const struct ubifs_key *hi,
+		int (*fn)(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+			void *priv), void *priv)
+{
+	struct ubifs_znode *znode;
+
+	znode = tnc_get_znode(c, &c->zroot, -1);
+	if (IS_ERR(znode))
+		return PTR_ERR(znode);
+
+	return tnc_walk(c, znode, lo, hi, fn, priv);
+}
+
+int ubifs_tnc_init(struct ubifs_info *c, int lnum, int offs, int len)
+{
+	struct ubifs_znode *znode;
+
+	c->zroot.lnum = lnum;
+	c->zroot.offs = offs;
+	c->zroot.len = len;
+
+	znode = tnc_get_znode(c, &c->zroot, -1);
+	if (IS_ERR(znode))
+		return PTR_ERR(znode);
+
+	return 0;
+}
+
+static void tnc_free_znode(struct ubifs_znode *znode)
+{
+	int i;
+
+	if (znode->level)
+		for (i = 0; i < znode->child_cnt; i++)
+			if (znode->zbranch[i].znode)
+				tnc_free_znode(znode->zbranch[i].znode);
+
+	free(znode);
+}
+
+void ubifs_tnc_close(struct ubifs_info *c)
+{
+	if (c->zroot.znode)
+		tnc_free_znode(c->zroot.znode);
+	c->zroot.znode = NULL;
+}
@@ -0,0 +1,681 @@
+/*
+ * ubifs.c - read-only UBIFS
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <init.h>
+#include <malloc.h>
+#include <fs.h>
+#include <errno.h>
+#include <linux/err.h>
+#include <fcntl.h>
+#include <xfuncs.h>
+#include <linux/stat.h>
+#include "ubifs.h"
+
+struct ubifs_inode {
+	unsigned long inum;
+	loff_t size;
+	unsigned int mode;
+};
+
+static uint32_t key_r5_hash(const char *s, int len)
+{
+	const signed char *str = (const signed char *)s;
+	uint32_t a = 0;
+
+	while (len--) {
+		a += *str << 4;
+		a += *str >> 4;
+		a *= 11;
+		str++;
+	}
+
+	return a;
+}
+
+static uint32_t key_test_hash(const char *str, int len)
+{
+	uint32_t a = 0;
+
+	memcpy(&a, str, min(len, 4));
+
+	return a;
+}
+
+uint32_t ubifs_key_hash(struct ubifs_info *c, const char *name, int len)
+{
+	uint32_t a;
+
+	if (c->key_hash_type == UBIFS_KEY_HASH_R5)
+		a = key_r5_hash(name, len);
+	else
+		a = key_test_hash(name, len);
+
+	a &= UBIFS_S_KEY_HASH_MASK;
+
+	/* 0, 1 and 2 are reserved for ".", ".." and the end of readdir */
+	if (a <= 2)
+		a += 3;
+
+	return a;
+}
+
+static int ubifs_read_inode(struct ubifs_info *c, unsigned long inum,
+		struct ubifs_inode *ui, char *link, size_t linksize)
+{
+	const struct ubifs_ino_node *ino;
+	struct ubifs_zbranch zbr;
+	struct ubifs_key key;
+	int ret, data_len;
+
+	key_init(&key, inum, UBIFS_INO_KEY, 0);
+
+	ret = ubifs_tnc_lookup(c, &key, &zbr);
+	if (ret)
+		return ret;
+
+	ino = ubifs_read_node(c, UBIFS_INO_NODE, zbr.lnum, zbr.offs, zbr.len, 1);
+	if (IS_ERR(ino))
+		return PTR_ERR(ino);
+
+	data_len = le32_to_cpu(ino->data_len);
+	if (zbr.len < UBIFS_INO_NODE_SZ + data_len)
+		return -EUCLEAN;
+
+	ui->inum = inum;
+	ui->size = le64_to_cpu(ino->size);
+	ui->mode = le32_to_cpu(ino->mode);
+
+	if (link) {
+		if (!S_ISLNK(ui->mode))
+			return -EINVAL;
+
+		data_len = min_t(size_t, data_len, linksize - 1);
+		memcpy(link, ino->data, data_len);
+		link[data_len] = 0;
+	}
+
+	return 0;
+}
+
+struct ubifs_dent_lookup {
+	const char *name;
+	int nlen;
+	unsigned long inum;
+};
+
+static int ubifs_dent_match(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+		void *priv)
+{
+	const struct ubifs_dent_node *dent;
+	struct ubifs_dent_lookup *l = priv;
+
+	dent = ubifs_read_node(c, UBIFS_DENT_NODE, zbr->lnum, zbr->offs,
+			zbr->len, 1);
+	if (IS_ERR(dent))
+		return PTR_ERR(dent);
+
+	if (le16_to_cpu(dent->nlen) != l->nlen ||
+	    zbr->len < UBIFS_DENT_NODE_SZ + l->nlen ||
+	    memcmp(dent->name, l->name, l->nlen))
+		return 0;
+
+	l->inum = le64_to_cpu(dent->inum);
+
+	return 1;
+}
+
+/* Find the inode number of @name in directory @dir */
+static int ubifs_lookup_dent(struct ubifs_info *c, unsigned long dir,
+		const char *name, unsigned long *inum)
+{
+	struct ubifs_dent_lookup l = {
+		.name = name,
+		.nlen = strlen(name),
+	};
+	struct ubifs_jnode *j;
+	struct ubifs_key key;
+	int ret;
+
+	if (l.nlen > UBIFS_MAX_NLEN)
+		return -ENAMETOOLONG;
+
+	key_init(&key, dir, UBIFS_DENT_KEY, ubifs_key_hash(c, name, l.nlen));
+
+	j = ubifs_journal_find(c, &key, name, l.nlen);
+	if (j) {
+		if (j->deleted)
+			return -ENOENT;
+		*inum = j->inum;
+		return 0;
+	}
+
+	if (ubifs_journal_hides(c, &key))
+		return -ENOENT;
+
+	/* Names with the same hash have the same key */
+	ret = ubifs_tnc_walk(c, &key, &key, ubifs_dent_match, &l);
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		return -ENOENT;
+
+	*inum = l.inum;
+
+	return 0;
+}
+
+static int ubifs_lookup_path(struct ubifs_info *c, const char *path,
+		struct ubifs_inode *ui)
+{
+	char *p, *name, *freep;
+	unsigned long inum = UBIFS_ROOT_INO;
+	int ret = 0;
+
+	p = freep = xstrdup(path);
+
+	while ((name = strsep(&p, "/"))) {
+		if (!*name)
+			continue;
+
+		ret = ubifs_read_inode(c, inum, ui, NULL, 0);
+		if (ret)
+			break;
+
+		if (!S_ISDIR(ui->mode)) {
+			ret = -ENOTDIR;
+			break;
+		}
+
+		ret = ubifs_lookup_dent(c, inum, name, &inum);
+		if (ret)
+			break;
+	}
+
+	free(freep);
+
+	if (ret)
+		return ret;
+
+	return ubifs_read_inode(c, inum, ui, NULL, 0);
+}
+
+/*
+ * Read data block @block of inode @inum to @buf. Holes and the part of the
+ * block after the end of the data node read as zeroes.
+ */
+static int ubifs_read_block(struct ubifs_info *c, unsigned long inum,
+		unsigned int block, void *buf)
+{
+	const struct ubifs_data_node *dn;
+	struct ubifs_zbranch zbr;
+	struct ubifs_key key;
+	int ret, size;
+
+	key_init(&key, inum, UBIFS_DATA_KEY, block);
+
+	ret = ubifs_tnc_lookup(c, &key, &zbr);
+	if (ret == -ENOENT) {
+		memset(buf, 0, UBIFS_BLOCK_SIZE);
+		return 0;
+	}
+	if (ret)
+		return ret;
+
+	dn = ubifs_read_node(c, UBIFS_DATA_NODE, zbr.lnum, zbr.offs, zbr.len, 0);
+	if (IS_ERR(dn))
+		return PTR_ERR(dn);
+
+	size = le32_to_cpu(dn->size);
+	if (size > UBIFS_BLOCK_SIZE || zbr.len < UBIFS_DATA_NODE_SZ)
+		return -EUCLEAN;
+
+	ret = ubifs_decompress(dn->data, zbr.len - UBIFS_DATA_NODE_SZ, buf,
+			size, le16_to_cpu(dn->compr_type));
+	if (ret) {
+		dev_err(c->dev, "cannot decompress block %u of inode %lu: %s\n",
+				block, inum, strerror(-ret));
+		return ret;
+	}
+
+	memset(buf + size, 0, UBIFS_BLOCK_SIZE - size);
+
+	return 0;
+}
+
+static int ubifs_open(struct device_d *dev, FILE *file, const char *filename)
+{
+	struct ubifs_info *c = dev->priv;
+	struct ubifs_inode *ui;
+	int ret;
+
+	ui = xzalloc(sizeof(*ui));
+
+	ret = ubifs_lookup_path(c, filename, ui);
+	if (ret) {
+		free(ui);
+		return ret;
+	}
+
+	file->inode = ui;
+	file->size = ui->size;
+
+	return 0;
+}
+
+static int ubifs_close(struct device_d *dev, FILE *file)
+{
+	free(file->inode);
+
+	return 0;
+}
+
+static int ubifs_read(struct device_d *dev, FILE *file, void *buf,
+		size_t insize)
+{
+	struct ubifs_info *c = dev->priv;
+	struct ubifs_inode *ui = file->inode;
+	loff_t pos = file->pos;
+	size_t size, done = 0, now;
+	unsigned int block, ofs;
+	int ret;
+
+	if (pos >= file->size)
+		return 0;
+
+	size = min_t(loff_t, insize, file->size - pos);
+
+	while (done < size) {
+		block = pos >> UBIFS_BLOCK_SHIFT;
+		ofs = pos & (UBIFS_BLOCK_SIZE - 1);
+		now = min_t(size_t, size - done, UBIFS_BLOCK_SIZE - ofs);
+
+		if (now == UBIFS_BLOCK_SIZE) {
+			/* Whole blocks are decompressed right to the buffer */
+			ret = ubifs_read_block(c, ui->inum, block, buf);
+			if (ret)
+				return ret;
+		} else {
+			if (c->block_inum != ui->inum || c->block_num != block) {
+				c->block_inum = 0;
+				ret = ubifs_read_block(c, ui->inum, block,
+						c->block_buf);
+				if (ret)
+					return ret;
+				c->block_inum = ui->inum;
+				c->block_num = block;
+			}
+
+			memcpy(buf, c->block_buf + ofs, now);
+		}
+
+		buf += now;
+		pos += now;
+		done += now;
+	}
+
+	return done;
+}
+
+static loff_t ubifs_lseek(struct device_d *dev, FILE *file, loff_t pos)
+{
+	file->pos = pos;
+
+	return pos;
+}
+
+struct ubifs_dir {
+	char **names;
+	int num;
+	int pos;
+	DIR dir;
+};
+
+static void ubifs_dir_add(struct ubifs_dir *udir, const char *name, int nlen)
+{
+	udir->names = xrealloc(udir->names, (udir->num + 1) * sizeof(char *));
+	udir->names[udir->num] = xmalloc(nlen + 1);
+	memcpy(udir->names[udir->num], name, nlen);
+	udir->names[udir->num][nlen] = 0;
+	udir->num++;
+}
+
+static int ubifs_dir_fill(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+		void *priv)
+{
+	const struct ubifs_dent_node *dent;
+	struct ubifs_dir *udir = priv;
+	struct ubifs_jnode *j;
+	int nlen;
+
+	dent = ubifs_read_node(c, UBIFS_DENT_NODE, zbr->lnum, zbr->offs,
+			zbr->len, 1);
+	if (IS_ERR(dent))
+		return PTR_ERR(dent);
+
+	nlen = le16_to_cpu(dent->nlen);
+	if (nlen > UBIFS_MAX_NLEN || zbr->len < UBIFS_DENT_NODE_SZ + nlen)
+		return -EUCLEAN;
+
+	/* entries in the journal are added separately */
+	j = ubifs_journal_find(c, &zbr->key, (const char *)dent->name, nlen);
+	if (!j)
+		ubifs_dir_add(udir, (const char *)dent->name, nlen);
+
+	return 0;
+}
+
+static void ubifs_free_dir(struct ubifs_dir *udir)
+{
+	int i;
+
+	for (i = 0; i < udir->num; i++)
+		free(udir->names[i]);
+	free(udir->names);
+	free(udir);
+}
+
+static DIR *ubifs_opendir(struct device_d *dev, const char *pathname)
+{
+	struct ubifs_info *c = dev->priv;
+	struct ubifs_dir *udir;
+	struct ubifs_inode ui;
+	struct ubifs_key lo, hi;
+	struct ubifs_jnode *j;
+	struct rb_node *rb;
+	int ret;
+
+	ret = ubifs_lookup_path(c, pathname, &ui);
+	if (ret || !S_ISDIR(ui.mode))
+		return NULL;
+
+	udir = xzalloc(sizeof(*udir));
+	udir->dir.priv = udir;
+
+	key_init(&lo, ui.inum, UBIFS_DENT_KEY, 0);
+	key_init(&hi, ui.inum, UBIFS_DENT_KEY, UBIFS_S_KEY_HASH_MASK);
+
+	ret = ubifs_tnc_walk(c, &lo, &hi, ubifs_dir_fill, udir);
+	if (ret) {
+		ubifs_free_dir(udir);
+		return NULL;
+	}
+
+	for (rb = rb_first(&c->journal); rb; rb = rb_next(rb)) {
+		j = rb_entry(rb, struct ubifs_jnode, rb);
+
+		if (key_inum(&j->key) == ui.inum && !j->deleted &&
+		    key_type(&j->key) == UBIFS_DENT_KEY)
+			ubifs_dir_add(udir, j->name, j->nlen);
+	}
+
+	return &udir->dir;
+}
+
+static struct dirent *ubifs_readdir(struct device_d *dev, DIR *dir)
+{
+	struct ubifs_dir *udir = dir->priv;
+
+	if (udir->pos >= udir->num)
+		return NULL;
+
+	strcpy(dir->d.d_name, udir->names[udir->pos++]);
+
+	return &dir->d;
+}
+
+static int ubifs_closedir(struct device_d *dev, DIR *dir)
+{
+	ubifs_free_dir(dir->priv);
+
+	return 0;
+}
+
+static int ubifs_stat(struct device_d *dev, const char *filename,
+		struct stat *s)
+{
+	struct ubifs_info *c = dev->priv;
+	struct ubifs_inode ui;
+	int ret;
+
+	ret = ubifs_lookup_path(c, filename, &ui);
+	if (ret)
+		return ret;
+
+	s->st_size = ui.size;
+	s->st_mode = ui.mode;
+
+	return 0;
+}
+
+static int ubifs_readlink(struct device_d *dev, const char *pathname,
+		char *buf, size_t bufsiz)
+{
+	struct ubifs_info *c = dev->priv;
+	struct ubifs_inode ui;
+	int ret;
+
+	ret = ubifs_lookup_path(c, pathname, &ui);
+	if (ret)
+		return ret;
+
+	return ubifs_read_inode(c, ui.inum, &ui, buf, bufsiz);
+}
+
+static int ubifs_read_sb(struct ubifs_info *c)
+{
+	const struct ubifs_sb_node *sb;
+	int ret, flags, fmt_version;
+
+	/* The LEB size is not known yet, read the superblock only */
+	sb = xmalloc(UBIFS_SB_NODE_SZ);
+
+	ret = cdev_read(c->cdev, (void *)sb, UBIFS_SB_NODE_SZ, 0, 0);
+	if (ret < 0)
+		goto out;
+
+	ret = ubifs_check_node(c, sb, UBIFS_SB_LNUM, 0, UBIFS_SB_NODE_SZ);
+	if (ret < 0 || sb->ch.node_type != UBIFS_SB_NODE) {
+		dev_dbg(c->dev, "no UBIFS superblock\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = -EINVAL;
+
+	fmt_version = le32_to_cpu(sb->fmt_version);
+	flags = le32_to_cpu(sb->flags);
+
+	if (fmt_version > UBIFS_FORMAT_VERSION) {
+		dev_err(c->dev, "unsupported format version %d\n", fmt_version);
+		goto out;
+	}
+
+	if (flags & (UBIFS_FLG_ENCRYPTION | UBIFS_FLG_AUTHENTICATION)) {
+		dev_err(c->dev, "encrypted and authenticated UBIFS not supported\n");
+		goto out;
+	}
+
+	if (sb->key_fmt != UBIFS_SIMPLE_KEY_FMT ||
+	    sb->key_hash > UBIFS_KEY_HASH_TEST) {
+		dev_err(c->dev, "unsupported key format\n");
+		goto out;
+	}
+
+	c->key_hash_type = sb->key_hash;
+	c->min_io_size = le32_to_cpu(sb->min_io_size);
+	c->leb_size = le32_to_cpu(sb->leb_size);
+	c->leb_cnt = le32_to_cpu(sb->leb_cnt);
+	c->log_lebs = le32_to_cpu(sb->log_lebs);
+	c->fanout = le32_to_cpu(sb->fanout);
+
+	if (c->min_io_size < 1 || c->leb_size < UBIFS_SB_NODE_SZ ||
+	    c->leb_size % c->min_io_size ||
+	    (loff_t)c->leb_cnt * c->leb_size > c->cdev->size ||
+	    c->log_lebs < 1 || c->fanout < 3) {
+		dev_err(c->dev, "bad superblock\n");
+		goto out;
+	}
+
+	ret = 0;
+out:
+	free((void *)sb);
+
+	return ret;
+}
+
+static int ubifs_find_master(struct ubifs_info *c, int lnum,
+		struct ubifs_mst_node *mst)
+{
+	const unsigned char *leb;
+	int offs = 0, len, found = 0;
+
+	leb = ubifs_read_leb(c, lnum);
+	if (IS_ERR(leb))
+		return PTR_ERR(leb);
+
+	/* The last master node written is the valid one */
+	while (offs + UBIFS_MST_NODE_SZ <= c->leb_size) {
+		len = ubifs_check_node(c, leb + offs, lnum, offs,
+				c->leb_size - offs);
+		if (len != UBIFS_MST_NODE_SZ ||
+		    ((struct ubifs_ch *)(leb + offs))->node_type != UBIFS_MST_NODE)
+			break;
+
+		memcpy(mst, leb + offs, UBIFS_MST_NODE_SZ);
+		found = 1;
+		offs += ALIGN(UBIFS_MST_NODE_SZ, c->min_io_size);
+	}
+
+	return found ? 0 : -EUCLEAN;
+}
+
+static int ubifs_mount(struct ubifs_info *c)
+{
+	struct ubifs_mst_node *mst;
+	int ret;
+
+	ret = ubifs_read_sb(c);
+	if (ret)
+		return ret;
+
+	mst = xmalloc(UBIFS_MST_NODE_SZ);
+
+	ret = ubifs_find_master(c, UBIFS_MST_LNUM, mst);
+	if (ret)
+		ret = ubifs_find_master(c, UBIFS_MST_LNUM + 1, mst);
+	if (ret) {
+		dev_err(c->dev, "no valid master node\n");
+		goto out;
+	}
+
+	c->cmt_no = le64_to_cpu(mst->cmt_no);
+
+	ret = ubifs_tnc_init(c, le32_to_cpu(mst->root_lnum),
+			le32_to_cpu(mst->root_offs),
+			le32_to_cpu(mst->root_len));
+	if (ret)
+		goto out;
+
+	ret = ubifs_replay_journal(c, le32_to_cpu(mst->log_lnum));
+out:
+	free(mst);
+
+	return ret;
+}
+
+static void ubifs_umount(struct ubifs_info *c)
+{
+	ubifs_journal_close(c);
+	ubifs_tnc_close(c);
+	ubifs_io_close(c);
+	free(c->block_buf);
+}
+
+static int ubifs_probe(struct device_d *dev)
+{
+	struct fs_device_d *fsdev = dev_to_fs_device(dev);
+	char *backingstore = fsdev->backingstore;
+	struct ubifs_info *c;
+	int ret;
+
+	c = xzalloc(sizeof(*c));
+
+	dev->priv = c;
+	c->dev = dev;
+	c->journal = RB_ROOT;
+	INIT_LIST_HEAD(&c->purged);
+	arena_init(&c->journal_mem, 4096);
+
+	if (!strncmp(backingstore, "/dev/", 5))
+		backingstore += 5;
+
+	c->cdev = cdev_open(backingstore, O_RDONLY);
+	if (!c->cdev) {
+		ret = -ENOENT;
+		goto err_open;
+	}
+
+	c->block_buf = xmalloc(UBIFS_BLOCK_SIZE);
+
+	ret = ubifs_mount(c);
+	if (ret)
+		goto err_mount;
+
+	return 0;
+
+err_mount:
+	ubifs_umount(c);
+	cdev_close(c->cdev);
+err_open:
+	free(c);
+
+	return ret;
+}
+
+static void ubifs_remove(struct device_d *dev)
+{
+	struct ubifs_info *c = dev->priv;
+
+	ubifs_umount(c);
+	cdev_close(c->cdev);
+	free(c);
+}
+
+static struct fs_driver_d ubifs_driver = {
+	.open      = ubifs_open,
+	.close     = ubifs_close,
+	.read      = ubifs_read,
+	.lseek     = ubifs_lseek,
+	.opendir   = ubifs_opendir,
+	.readdir   = ubifs_readdir,
+	.closedir  = ubifs_closedir,
+	.stat      = ubifs_stat,
+	.readlink  = ubifs_readlink,
+	.type      = filetype_ubifs,
+	.flags     = 0,
+	.drv = {
+		.probe  = ubifs_probe,
+		.remove = ubifs_remove,
+		.name = "ubifs",
+	}
+};
+
+static int ubifs_init(void)
+{
+	return register_fs_driver(&ubifs_driver);
+}
+
+coredevice_initcall(ubifs_init);
@@ -0,0 +1,225 @@
+/*
+ * ubifs.h - read-only UBIFS for barebox
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __UBIFS_H__
+#define __UBIFS_H__
+
+#include <linux/types.h>
+#include <linux/rbtree.h>
+#include <linux/list.h>
+#include <arena.h>
+#include "ubifs-media.h"
+
+/* Number of whole LEBs kept in memory */
+#define UBIFS_LEB_CACHE_SIZE	4
+
+/* The key in CPU byte order: inode number, type and block or name hash */
+struct ubifs_key {
+	uint32_t u32[2];
+};
+
+/**
+ * struct ubifs_zbranch - a branch of an index node.
+ * @key: the lowest key of the child
+ * @lnum: LEB number of the child node
+ * @offs: offset of the child node within @lnum
+ * @len: length of the child node
+ * @znode: the child index node once it has been read, level > 0 only
+ */
+struct ubifs_zbranch {
+	struct ubifs_key key;
+	int lnum;
+	int offs;
+	int len;
+	struct ubifs_znode *znode;
+};
+
+/**
+ * struct ubifs_znode - an index node in memory.
+ * @level: level in the tree, 0 for nodes pointing to leaf nodes
+ * @child_cnt: number of branches
+ * @zbranch: the branches
+ *
+ * Index nodes are read when a lookup passes them first and then stay in
+ * memory until unmount.
+ */
+struct ubifs_znode {
+	int level;
+	int child_cnt;
+	struct ubifs_zbranch zbranch[];
+};
+
+/**
+ * struct ubifs_jnode - a leaf node found in the journal.
+ * @rb: link in the @journal tree of &struct ubifs_info
+ * @key: key of the node
+ * @name: name of directory entries, %NULL for other nodes
+ * @nlen: length of @name
+ * @inum: target inode of directory entries
+ * @lnum: LEB number of the node
+ * @offs: offset of the node within @lnum
+ * @len: length of the node
+ * @deleted: the node and its counterpart in the index are gone
+ *
+ * The journal has not been committed to the index, so the index does not
+ * know about these nodes yet. They take precedence over the index.
+ */
+struct ubifs_jnode {
+	struct rb_node rb;
+	struct ubifs_key key;
+	char *name;
+	int nlen;
+	unsigned long inum;
+	int lnum;
+	int offs;
+	int len;
+	int deleted;
+};
+
+/**
+ * struct ubifs_purge - index nodes of an inode hidden by the journal.
+ * @list: link in the @purged list of &struct ubifs_info
+ * @inum: the inode number
+ * @block: data blocks from this one on are truncated
+ * @all: the inode is deleted, all its nodes are hidden
+ */
+struct ubifs_purge {
+	struct list_head list;
+	unsigned long inum;
+	unsigned int block;
+	int all;
+};
+
+struct ubifs_leb_cache {
+	int lnum;
+	unsigned long used;
+	void *buf;
+};
+
+/**
+ * struct ubifs_info - a mounted UBIFS.
+ * @dev: the file system device
+ * @cdev: the UBI volume
+ * @leb_size: logical eraseblock size
+ * @leb_cnt: number of LEBs used by the file system
+ * @min_io_size: minimal I/O unit size
+ * @log_lebs: number of log LEBs
+ * @fanout: maximum number of branches of index nodes
+ * @key_hash_type: %UBIFS_KEY_HASH_R5 or %UBIFS_KEY_HASH_TEST
+ * @cmt_no: number of the last commit
+ * @zroot: the root of the index
+ * @journal: leaf nodes from the journal, see &struct ubifs_jnode
+ * @purged: inodes truncated or deleted in the journal
+ * @journal_mem: memory for @journal and @purged, freed all at once
+ * @lebs: cache of whole LEBs, nodes are read from here
+ * @lebs_used: counter for the LRU replacement of @lebs
+ * @block_buf: buffer for blocks not read completely
+ * @block_inum: inode the block in @block_buf belongs to, 0 for none
+ * @block_num: number of the block in @block_buf
+ */
+struct ubifs_info {
+	struct device_d *dev;
+	struct cdev *cdev;
+
+	int leb_size;
+	int leb_cnt;
+	int min_io_size;
+	int log_lebs;
+	int fanout;
+	int key_hash_type;
+	unsigned long long cmt_no;
+
+	struct ubifs_zbranch zroot;
+	struct rb_root journal;
+	struct list_head purged;
+	struct arena journal_mem;
+
+	struct ubifs_leb_cache lebs[UBIFS_LEB_CACHE_SIZE];
+	unsigned long lebs_used;
+
+	void *block_buf;
+	unsigned long block_inum;
+	unsigned int block_num;
+};
+
+/* key helpers */
+static inline unsigned long key_inum(const struct ubifs_key *key)
+{
+	return key->u32[0];
+}
+
+static inline int key_type(const struct ubifs_key *key)
+{
+	return key->u32[1] >> UBIFS_S_KEY_BLOCK_BITS;
+}
+
+static inline unsigned int key_block(const struct ubifs_key *key)
+{
+	return key->u32[1] & UBIFS_S_KEY_BLOCK_MASK;
+}
+
+static inline void key_init(struct ubifs_key *key, unsigned long inum,
+		int type, uint32_t block_or_hash)
+{
+	key->u32[0] = inum;
+	key->u32[1] = block_or_hash | (type << UBIFS_S_KEY_BLOCK_BITS);
+}
+
+static inline void key_read(struct ubifs_key *key, const void *from)
+{
+	const __le32 *f = from;
+
+	key->u32[0] = le32_to_cpu(f[0]);
+	key->u32[1] = le32_to_cpu(f[1]);
+}
+
+static inline int keys_cmp(const struct ubifs_key *a, const struct ubifs_key *b)
+{
+	if (a->u32[0] != b->u32[0])
+		return a->u32[0] < b->u32[0] ? -1 : 1;
+	if (a->u32[1] != b->u32[1])
+		return a->u32[1] < b->u32[1] ? -1 : 1;
+	return 0;
+}
+
+uint32_t ubifs_key_hash(struct ubifs_info *c, const char *name, int len);
+
+/* io.c */
+const void *ubifs_read_leb(struct ubifs_info *c, int lnum);
+const void *ubifs_read_node(struct ubifs_info *c, int type, int lnum,
+		int offs, int len, int check_crc);
+int ubifs_check_node(struct ubifs_info *c, const void *buf, int lnum,
+		int offs, int avail);
+int ubifs_decompress(const void *in, int in_len, void *out, int out_len,
+		int compr_type);
+void ubifs_io_close(struct ubifs_info *c);
+
+/* replay.c */
+int ubifs_replay_journal(struct ubifs_info *c, int log_lnum);
+void ubifs_journal_close(struct ubifs_info *c);
+struct ubifs_jnode *ubifs_journal_find(struct ubifs_info *c,
+		const struct ubifs_key *key, const char *name, int nlen);
+int ubifs_journal_hides(struct ubifs_info *c, const struct ubifs_key *key);
+
+/* tnc.c */
+int ubifs_tnc_init(struct ubifs_info *c, int lnum, int offs, int len);
+void ubifs_tnc_close(struct ubifs_info *c);
+int ubifs_tnc_lookup(struct ubifs_info *c, const struct ubifs_key *key,
+		struct ubifs_zbranch *zbr);
+int ubifs_tnc_walk(struct ubifs_info *c, const struct ubifs_key *lo,
+		const struct ubifs_key *hi,
+		int (*fn)(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+			void *priv), void *priv);
+
+#endif /* __UBIFS_H__ */
@@ -0,0 +1,28 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <types.h>
+
+struct arena_chunk;
+
+/*
+ * An arena hands out memory from larger chunks and frees all of it at
+ * once. Use it for lots of small short-lived objects which all die
+ * together, like the nodes of a parse tree.
+ */
+struct arena {
+	struct arena_chunk *chunks;
+	char *cur;
+	size_t left;
+	size_t chunk_size;
+};
+
+#define ARENA_INIT(size)	{ .chunk_size = (size) }
+
+void arena_init(struct arena *arena, size_t chunk_size);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_zalloc(struct arena *arena, size_t size);
+char *arena_strndup(struct arena *arena, const char *s, size_t len);
+void arena_free_all(struct arena *arena);
+
+#endif /* __ARENA_H */
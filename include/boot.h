@@ -42,6 +42,8 @@ struct image_data {
 	unsigned long initrd_address;
 
 	struct device_node *of_root_node;
+	/* the blob of_root_node was unflattened from and still refers to */
+	void *of_root_blob;
 	struct fdt_header *oftree;
 
 	int verify;
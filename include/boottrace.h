@@ -0,0 +1,62 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __INCLUDE_BOOTTRACE_H
+#define __INCLUDE_BOOTTRACE_H
+
+#include <linux/types.h>
+
+enum boottrace_type {
+	BOOTTRACE_INITCALL,
+	BOOTTRACE_ENV,
+	BOOTTRACE_SCRIPT,
+	BOOTTRACE_COMMAND,
+	BOOTTRACE_PROBE,
+};
+
+#define BOOTTRACE_NAME_LEN	32
+
+struct boottrace_event {
+	unsigned int seq;	/* handle of the event, 0 for unused slots */
+	unsigned char type;
+	unsigned char depth;	/* number of enclosing events */
+	const void *fn;		/* initcall function, name is empty then */
+	uint64_t start;
+	uint64_t end;		/* 0 while the event is in progress */
+	char name[BOOTTRACE_NAME_LEN];
+};
+
+#ifdef CONFIG_BOOTTRACE
+unsigned int boottrace_begin(enum boottrace_type type, const char *name,
+		const void *fn);
+void boottrace_end(unsigned int handle);
+
+struct boottrace_event *boottrace_get(unsigned int i);
+unsigned int boottrace_num_events(void);
+unsigned int boottrace_num_lost(void);
+void boottrace_clear(void);
+const char *boottrace_type_name(struct boottrace_event *ev);
+void boottrace_event_name(struct boottrace_event *ev, char *buf, size_t len);
+int boottrace_export_oftree(void);
+#else
+static inline unsigned int boottrace_begin(enum boottrace_type type,
+		const char *name, const void *fn)
+{
+	return 0;
+}
+
+static inline void boottrace_end(unsigned int handle)
+{
+}
+#endif
+
+#endif /* __INCLUDE_BOOTTRACE_H */
@@ -0,0 +1,134 @@
+/*
+ * dmaengine.h - generic DMA engine API
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef __DMAENGINE_H
+#define __DMAENGINE_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <string.h>
+
+/*
+ * A much reduced version of the Linux dmaengine API. There are no
+ * interrupts, a transfer is started with dmaengine_submit() and its
+ * completion is found by polling, either with dma_sync_wait() or in the
+ * background by the poller which runs the descriptor callbacks.
+ */
+
+enum dma_transaction_type {
+	DMA_MEMCPY,
+	DMA_SLAVE,
+};
+
+enum dma_transfer_direction {
+	DMA_MEM_TO_MEM,
+	DMA_MEM_TO_DEV,
+	DMA_DEV_TO_MEM,
+};
+
+enum dma_status {
+	DMA_COMPLETE,
+	DMA_IN_PROGRESS,
+	DMA_ERROR,
+};
+
+typedef int dma_cookie_t;
+
+struct dma_sg {
+	dma_addr_t addr;
+	size_t len;
+};
+
+struct dma_chan;
+
+struct dma_async_tx_descriptor {
+	struct dma_chan *chan;
+	dma_cookie_t cookie;
+	struct list_head node;
+	void (*callback)(void *param, enum dma_status status);
+	void *callback_param;
+};
+
+struct dma_chan {
+	struct dma_device *device;
+	int chan_id;
+	int in_use;
+	dma_cookie_t cookie;		/* last submitted */
+	dma_cookie_t completed_cookie;	/* last completed, set by the driver */
+	enum dma_status status;		/* of completed_cookie */
+	struct list_head active;	/* submitted descriptors */
+	void *private;
+};
+
+struct dma_device {
+	const char *name;
+	struct device_d *dev;
+	struct list_head list;
+
+	struct dma_chan *chans;
+	int num_chans;
+
+	unsigned long caps;		/* 1 << enum dma_transaction_type */
+	size_t copy_align;		/* DMA_MEMCPY src, dst and len alignment */
+
+	struct dma_async_tx_descriptor *(*prep_memcpy)(struct dma_chan *chan,
+			dma_addr_t dst, dma_addr_t src, size_t len);
+	struct dma_async_tx_descriptor *(*prep_slave_sg)(struct dma_chan *chan,
+			struct dma_sg *sg, int sg_len,
+			enum dma_transfer_direction dir);
+	/* start or queue the transfer */
+	int (*submit)(struct dma_async_tx_descriptor *tx);
+	/* check the hardware, update completed_cookie and status */
+	void (*poll)(struct dma_chan *chan);
+	void (*terminate_all)(struct dma_chan *chan);
+	void (*free_desc)(struct dma_async_tx_descriptor *tx);
+};
+
+#ifdef CONFIG_DMA_ENGINE
+int dma_device_register(struct dma_device *dma);
+void dma_device_unregister(struct dma_device *dma);
+
+typedef int (*dma_filter_fn)(struct dma_chan *chan, void *param);
+
+struct dma_chan *dma_request_channel(enum dma_transaction_type cap,
+		dma_filter_fn filter, void *param);
+void dma_release_channel(struct dma_chan *chan);
+
+struct dma_async_tx_descriptor *dmaengine_prep_dma_memcpy(
+		struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		size_t len);
+struct dma_async_tx_descriptor *dmaengine_prep_slave_sg(
+		struct dma_chan *chan, struct dma_sg *sg, int sg_len,
+		enum dma_transfer_direction dir);
+dma_cookie_t dmaengine_submit(struct dma_async_tx_descriptor *tx);
+enum dma_status dma_async_is_tx_complete(struct dma_chan *chan,
+		dma_cookie_t cookie);
+int dma_sync_wait(struct dma_chan *chan, dma_cookie_t cookie, u64 timeout);
+void dmaengine_terminate_all(struct dma_chan *chan);
+
+void *dma_memcpy(void *dst, const void *src, size_t len);
+#else
+static inline void *dma_memcpy(void *dst, const void *src, size_t len)
+{
+	return memcpy(dst, src, len);
+}
+#endif
+
+/* for drivers */
+static inline void dma_cookie_complete(struct dma_chan *chan,
+		dma_cookie_t cookie, enum dma_status status)
+{
+	chan->completed_cookie = cookie;
+	chan->status = status;
+}
+
+#endif /* __DMAENGINE_H */
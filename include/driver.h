@@ -107,6 +107,19 @@ struct device_d {
 	struct device_node *device_node;
 
 	struct of_device_id *of_id_entry;
+
+	/*! Entries of this device in the compatible index, see driver.c */
+	struct list_head of_compatibles;
+
+	uint64_t probe_time; /*! time spent in probe, in ns */
+
+	/*! Called by device_detect() to look for what is behind this device,
+	 * like a card in a slot. A callback waiting for the hardware may
+	 * return -EAGAIN instead of busy waiting, it is called again then. */
+	int (*detect)(struct device_d *);
+	int detected;		/* detect has completed */
+	int probe_deferred;	/* bound to a lazy driver, but not probed yet */
+	struct list_head detect_list;	/* pending background detection */
 };
 
 /** @brief Describes a driver present in the system */
@@ -131,6 +144,14 @@ struct driver_d {
 
 	struct platform_device_id *id_table;
 	struct of_device_id *of_compatible;
+
+	uint64_t probe_time;	/* total time spent in probe, in ns */
+	unsigned int probe_count;
+
+	/*! Set if probing takes long and is not needed for every boot.
+	 * Devices are bound to this driver as usual, but probed only when
+	 * needed, see device_detect(). */
+	int lazy;
 };
 
 /*@}*/	/* do not delete, doxygen relevant */
@@ -153,6 +174,19 @@ int register_device(struct device_d *);
  */
 int device_probe(struct device_d *dev);
 
+/* Probe a device bound to a lazy driver, if not done yet.
+ */
+int device_probe_deferred(struct device_d *dev);
+
+/* Probe a device if deferred and run its detect callback. The
+ * async variant does the same from the poller.
+ */
+int device_detect(struct device_d *dev);
+int device_detect_by_name(const char *devname);
+int device_detect_async(struct device_d *dev);
+void device_detect_all(void);
+int device_detect_file(const char *name);
+
 /* Unregister a device. This function can fail, e.g. when the device
  * has children.
  */
@@ -334,6 +368,8 @@ int     dev_protect(struct device_d *dev, size_t count, unsigned long offset, in
 /* These are used by drivers which work with direct memory accesses */
 ssize_t mem_read(struct cdev *cdev, void *buf, size_t count, loff_t offset, ulong flags);
 ssize_t mem_write(struct cdev *cdev, const void *buf, size_t count, loff_t offset, ulong flags);
+void memcpy_sz(void *dst, const void *src, ulong count, ulong rwsize);
+ulong memcmp_sz(const void *a, const void *b, ulong count, ulong rwsize);
 int mem_memmap(struct cdev *cdev, void **map, int flags);
 
 /* Use this if you have nothing to do in your drivers probe function */
@@ -368,6 +404,14 @@ struct bus_type {
 	int (*probe)(struct device_d *dev);
 	void (*remove)(struct device_d *dev);
 
+	/*
+	 * Set if match() binds devices with a device node to drivers with an
+	 * of_compatible table only through of_match(). Devices and drivers
+	 * on such a bus are paired through the compatible index instead of
+	 * trying every combination.
+	 */
+	int of_match_only;
+
 	struct device_d *dev;
 
 	struct list_head list;
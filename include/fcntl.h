@@ -22,6 +22,12 @@
 #define O_RWSIZE_1      00000010
 #define O_RWSIZE_2      00000020
 #define O_RWSIZE_4      00000040
+#define O_RWSIZE_8      00000030	/* no room for another bit */
+
+/* access width in bytes, 0 if none is given */
+#define O_RWSIZE_BYTES(flags)						\
+	(((flags) & O_RWSIZE_MASK) == O_RWSIZE_8 ? 8 :			\
+	 ((flags) & O_RWSIZE_MASK) >> O_RWSIZE_SHIFT)
 
 #define F_DUPFD		0	/* dup */
 #define F_GETFD		1	/* get close_on_exec */
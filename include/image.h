@@ -245,6 +245,7 @@ struct uimage_handle {
 	int nb_data_entries;
 	size_t data_offset;
 	int fd;
+	loff_t size;	/* size of the file */
 };
 
 #define UIMAGE_INVALID_ADDRESS	(~0)
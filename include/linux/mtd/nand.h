@@ -89,6 +89,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
 #define NAND_CMD_READSTART	0x30
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 
 /* Extended commands for AG-AND device */
 /*
@@ -171,6 +173,8 @@ typedef enum {
 #define NAND_NO_READRDY		0x00000100
 /* Chip does not allow subpage writes */
 #define NAND_NO_SUBPAGE_WRITE	0x00000200
+/* Chip has cache read function */
+#define NAND_CACHERD		0x00000400
 /* Buswitdh shal be autodetected */
 #define NAND_BUSWIDTH_AUTO	0x00080000
 
@@ -184,6 +188,7 @@ typedef enum {
 #define NAND_MUST_PAD(chip) (!(chip->options & NAND_NO_PADDING))
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_COPYBACK(chip) ((chip->options & NAND_COPYBACK))
+#define NAND_HAS_CACHERD(chip) ((chip->options & NAND_CACHERD))
 
 /* Mask to zero out the chip options, which come from the id table */
 #define NAND_CHIPOPTIONS_MSK	(0x0000ffff & ~NAND_NO_AUTOINCR)
@@ -283,6 +288,9 @@ struct nand_onfi_params {
 
 #define ONFI_CRC_BASE	0x4F4E
 
+/* ONFI optional commands */
+#define ONFI_OPT_CMD_READ_CACHE	(1 << 1)
+
 /**
  * struct nand_hw_control - Control structure for hardware controller (e.g ECC generator) shared among independent devices
  * @lock:               protection lock
@@ -431,6 +439,8 @@ struct nand_buffers {
  * @errstat:		[OPTIONAL] hardware specific function to perform additional error status checks
  *			(determine if errors are correctable)
  * @write_page:		[REPLACEABLE] High-level page write function
+ * @read_pages:		[REPLACEABLE] read consecutive whole pages within one
+ *			block with ECC, e.g. using cache read or DMA
  */
 struct nand_chip {
 
@@ -456,6 +466,8 @@ struct nand_chip {
 	int		(*write_page)(struct mtd_info *mtd, struct nand_chip *chip,
 				      const uint8_t *buf, int page, int cached, int raw);
 	int		(*set_buswidth)(struct mtd_info *mtd, struct nand_chip *this, int buswidth);
+	int		(*read_pages)(struct mtd_info *mtd, struct nand_chip *chip,
+				      uint8_t *buf, int page, int numpages);
 
 	int		chip_delay;
 	unsigned int	options;
@@ -20,5 +20,23 @@ int mallopt(int, int);
 struct mallinfo mallinfo(void);
 void *sbrk(ptrdiff_t increment);
 
+#ifdef CONFIG_MALLOC_TRACE
+extern void *malloc_trace_caller;
+
+/*
+ * Account the next allocation to the caller of the current function.
+ * For wrappers like xmalloc(), an outer wrapper takes precedence.
+ */
+#define malloc_trace_set_caller()					\
+	do {								\
+		if (!malloc_trace_caller)				\
+			malloc_trace_caller = __builtin_return_address(0); \
+	} while (0)
+#else
+#define malloc_trace_set_caller()	do { } while (0)
+#endif
+
+void malloc_trace_stats(void);
+
 #endif
 
@@ -13,6 +13,7 @@ struct property {
 	char *name;
 	int length;
 	void *value;
+	const void *value_const;
 	struct list_head list;
 };
 
@@ -27,7 +28,7 @@ struct device_node {
 	struct list_head list;
 	struct resource *resource;
 	struct device_d *device;
-	struct list_head phandles;
+	struct hlist_node phandle_hash;
 	phandle phandle;
 };
 
@@ -43,6 +44,15 @@ struct of_reserve_map {
 	int num_entries;
 };
 
+/*
+ * Properties created with of_new_property_const() refer to the name and
+ * value in the blob they were unflattened from instead of owning a copy.
+ */
+static inline const void *of_property_get_value(const struct property *pp)
+{
+	return pp->value ? pp->value : pp->value_const;
+}
+
 int of_add_reserve_entry(resource_size_t start, resource_size_t end);
 struct of_reserve_map *of_get_reserve_map(void);
 void of_clean_reserve_map(void);
@@ -153,9 +163,12 @@ int of_probe(void);
 int of_parse_dtb(struct fdt_header *fdt);
 void of_free(struct device_node *node);
 struct device_node *of_unflatten_dtb(struct device_node *root, void *fdt);
+struct device_node *of_unflatten_dtb_const(struct device_node *root, void *fdt);
 struct device_node *of_new_node(struct device_node *parent, const char *name);
 struct property *of_new_property(struct device_node *node, const char *name,
 		const void *data, int len);
+struct property *of_new_property_const(struct device_node *node,
+		const char *name, const void *data, int len);
 void of_delete_property(struct property *pp);
 
 int of_property_read_string(struct device_node *np, const char *propname,
@@ -209,4 +222,27 @@ static inline int of_add_memory(struct device_node *node, bool dump)
 }
 #endif
 
+#ifdef CONFIG_OF_OVERLAY
+int of_overlay_is_overlay(struct device_node *overlay);
+int of_overlay_apply_tree(struct device_node *root,
+		struct device_node *overlay);
+int of_overlay_apply_dtb(struct device_node *root, void *fdt);
+#else
+static inline int of_overlay_is_overlay(struct device_node *overlay)
+{
+	return 0;
+}
+
+static inline int of_overlay_apply_tree(struct device_node *root,
+		struct device_node *overlay)
+{
+	return -ENOSYS;
+}
+
+static inline int of_overlay_apply_dtb(struct device_node *root, void *fdt)
+{
+	return -ENOSYS;
+}
+#endif
+
 #endif /* __OF_H */
@@ -0,0 +1,46 @@
+#ifndef __SLAB_H
+#define __SLAB_H
+
+#include <types.h>
+
+/* allocations up to this size are served from the slab allocator */
+#define SLAB_MAX_SIZE	256
+
+#ifdef CONFIG_MALLOC_SLAB
+void *slab_alloc(size_t size);
+void slab_free(void *mem);
+void *slab_realloc(void *mem, size_t size);
+int slab_owns(void *mem);
+size_t slab_usable_size(void *mem);
+void slab_stats(void);
+#else
+static inline void *slab_alloc(size_t size)
+{
+	return NULL;
+}
+
+static inline int slab_owns(void *mem)
+{
+	return 0;
+}
+
+static inline void slab_free(void *mem)
+{
+}
+
+static inline void *slab_realloc(void *mem, size_t size)
+{
+	return NULL;
+}
+
+static inline size_t slab_usable_size(void *mem)
+{
+	return 0;
+}
+
+static inline void slab_stats(void)
+{
+}
+#endif
+
+#endif /* __SLAB_H */
@@ -14,7 +14,7 @@ struct spi_board_info {
 	/* mode becomes spi_device.mode, and is essential for chips
 	 * where the default of SPI_CS_HIGH = 0 is wrong.
 	 */
-	u8	mode;
+	u16	mode;
 	u8	bits_per_word;
 	void	*platform_data;
 	struct device_node *device_node;
@@ -33,6 +33,8 @@ struct spi_board_info {
  *	The "active low" default for chipselect mode can be overridden
  *	(by specifying SPI_CS_HIGH) as can the "MSB first" default for
  *	each word in a transfer (by specifying SPI_LSB_FIRST).
+ *	SPI_{TX,RX}_{DUAL,QUAD} tell which multi wire transfers the board
+ *	wiring allows, see spi_transfer.tx_nbits and rx_nbits.
  * @bits_per_word: Data transfers involve one or more words; word sizes
  *	like eight or 12 bits are common.  In-memory wordsizes are
  *	powers of two bytes (e.g. 20 bit samples use 32 bits).
@@ -63,7 +65,7 @@ struct spi_device {
 	struct spi_master	*master;
 	u32			max_speed_hz;
 	u8			chip_select;
-	u8			mode;
+	u16			mode;
 #define	SPI_CPHA	0x01			/* clock phase */
 #define	SPI_CPOL	0x02			/* clock polarity */
 #define	SPI_MODE_0	(0|0)			/* (original MicroWire) */
@@ -74,6 +76,12 @@ struct spi_device {
 #define	SPI_LSB_FIRST	0x08			/* per-word bits-on-wire */
 #define	SPI_3WIRE	0x10			/* SI/SO signals shared */
 #define	SPI_LOOP	0x20			/* loopback mode */
+#define	SPI_TX_DUAL	0x100			/* transmit with 2 wires */
+#define	SPI_TX_QUAD	0x200			/* transmit with 4 wires */
+#define	SPI_RX_DUAL	0x400			/* receive with 2 wires */
+#define	SPI_RX_QUAD	0x800			/* receive with 4 wires */
+#define	SPI_NBITS_MODE_MASK	(SPI_TX_DUAL | SPI_TX_QUAD | SPI_RX_DUAL | \
+				 SPI_RX_QUAD)
 	u8			bits_per_word;
 	int			irq;
 	void			*controller_state;
@@ -93,6 +101,25 @@ struct spi_device {
 
 struct spi_message;
 
+/**
+ * struct spi_flash_map - read command for a mapped serial flash
+ * @opcode: read opcode sent for each access
+ * @addr_width: number of address bytes following the opcode
+ * @dummy: number of dummy bytes following the address
+ * @addr_nbits: wires used for the address and dummy bytes, the opcode
+ *	always uses a single wire
+ * @data_nbits: wires used for the data
+ * @size: size of the flash in bytes
+ */
+struct spi_flash_map {
+	u8			opcode;
+	u8			addr_width;
+	u8			dummy;
+	u8			addr_nbits;
+	u8			data_nbits;
+	u64			size;
+};
+
 /**
  * struct spi_master - interface to SPI master controller
  * @dev: device interface to this driver
@@ -102,6 +129,8 @@ struct spi_message;
  *	SPI slaves, and are numbered from zero to num_chipselects.
  *	each slave has a chipselect signal, but it's common that not
  *	every chipselect is connected to a slave.
+ * @mode_bits: SPI_{TX,RX}_{DUAL,QUAD} flags understood by this controller
+ *	driver. Devices never get more of these than the master supports.
  * @setup: updates the device mode and clocking records used by a
  *	device's SPI controller; protocol code may call this.  This
  *	must fail if an unrecognized or unsupported mode is requested.
@@ -109,6 +138,20 @@ struct spi_message;
  *	the device whose settings are being modified.
  * @transfer: adds a message to the controller's transfer queue.
  * @cleanup: frees controller-specific state
+ * @flash_map: optional, sets up the controller to read the serial flash
+ *	@spi with the command described by @map whenever the CPU reads
+ *	from the window returned, byte 0 of the window being byte 0 of the
+ *	flash. Returns NULL if the flash can't be mapped. The window stays
+ *	valid while other messages are transferred to the device, the
+ *	controller has to switch back to mapped reads after each message
+ *	and drop anything it prefetched from the flash.
+ *
+ * @transfer_batch: optional, transfers a list of messages linked through
+ *	their @queue member like consecutive calls to @transfer, but without
+ *	returning to the CPU between them.
+ * @dma_min_len: transfers of at least this many bytes are done by DMA,
+ *	shorter ones by PIO, whose setup is cheaper. Zero for controllers
+ *	without DMA.
  *
  * Each SPI master controller can communicate with one or more @spi_device
  * children.  These make a small bus, sharing MOSI, MISO and SCK signals
@@ -137,6 +180,9 @@ struct spi_master {
 	 */
 	u16			num_chipselect;
 
+	/* multi wire transfers supported by the controller */
+	u16			mode_bits;
+
 	/* setup mode and clock, etc (spi driver may call many times) */
 	int			(*setup)(struct spi_device *spi);
 
@@ -165,6 +211,17 @@ struct spi_master {
 	/* called on release() to free memory provided by spi_master */
 	void			(*cleanup)(struct spi_device *spi);
 
+	/* map a serial flash into the CPU address space */
+	void __iomem		*(*flash_map)(struct spi_device *spi,
+					const struct spi_flash_map *map);
+
+	/* transfer several messages in one go */
+	int			(*transfer_batch)(struct spi_device *spi,
+						struct list_head *batch);
+
+	/* minimum transfer length worth setting up DMA for */
+	unsigned		dma_min_len;
+
 	struct list_head list;
 };
 
@@ -196,6 +253,9 @@ struct spi_master {
  *      transfer. If 0 the default (from @spi_device) is used.
  * @bits_per_word: select a bits_per_word other then the device default
  *      for this transfer. If 0 the default (from @spi_device) is used.
+ * @tx_nbits: number of wires used for writing, SPI_NBITS_SINGLE (the
+ *	default when 0), SPI_NBITS_DUAL or SPI_NBITS_QUAD
+ * @rx_nbits: number of wires used for reading, like @tx_nbits
  * @cs_change: affects chipselect after this transfer completes
  * @delay_usecs: microseconds to delay after this transfer before
  *	(optionally) changing the chipselect status, then starting
@@ -222,6 +282,10 @@ struct spi_master {
  * words are always seen by protocol drivers as right-justified, so the
  * undefined (rx) or unused (tx) bits are always the most significant bits.
  *
+ * Transfers with @tx_nbits or @rx_nbits other than single are half duplex,
+ * only one of the buffers may be given. They are only allowed if the mode
+ * of the device has the corresponding SPI_TX_* or SPI_RX_* flag.
+ *
  * All SPI transfers start with the relevant chipselect active.  Normally
  * it stays selected until after the last transfer in a message.  Drivers
  * can affect the chipselect signal using cs_change.
@@ -259,6 +323,11 @@ struct spi_transfer {
 	unsigned	len;
 
 	unsigned	cs_change:1;
+	u8		tx_nbits;
+	u8		rx_nbits;
+#define	SPI_NBITS_SINGLE	0x01	/* 1bit transfer */
+#define	SPI_NBITS_DUAL		0x02	/* 2bits transfer */
+#define	SPI_NBITS_QUAD		0x04	/* 4bits transfer */
 	u8		bits_per_word;
 	u16		delay_usecs;
 	u32		speed_hz;
@@ -329,6 +398,19 @@ spi_message_add_tail(struct spi_transfer *t, struct spi_message *m)
 	list_add_tail(&t->transfer_list, &m->transfers);
 }
 
+static inline void
+spi_batch_add_tail(struct spi_message *m, struct list_head *batch)
+{
+	list_add_tail(&m->queue, batch);
+}
+
+/* Whether a controller driver should use DMA for @t */
+static inline int
+spi_transfer_use_dma(struct spi_master *master, struct spi_transfer *t)
+{
+	return master->dma_min_len && t->len >= master->dma_min_len;
+}
+
 static inline void
 spi_transfer_del(struct spi_transfer *t)
 {
@@ -341,6 +423,9 @@ spi_transfer_del(struct spi_transfer *t)
  */
 
 int spi_sync(struct spi_device *spi, struct spi_message *message);
+int spi_sync_batch(struct spi_device *spi, struct list_head *batch);
+void __iomem *spi_flash_map(struct spi_device *spi,
+		const struct spi_flash_map *map);
 
 struct spi_device *spi_new_device(struct spi_master *master,
 				  struct spi_board_info *chip);
@@ -32,11 +32,16 @@ struct param_d *get_param_by_name(struct device_d *dev, const char *name)
 {
 	struct param_d *p;
 
+again:
 	list_for_each_entry(p, &dev->parameters, list) {
 		if (!strcmp(p->name, name))
 			return p;
 	}
 
+	/* parameters of lazy drivers appear when the device is probed */
+	if (dev->probe_deferred && !device_probe_deferred(dev))
+		goto again;
+
 	return NULL;
 }
 
@@ -19,9 +19,32 @@
 #include <linux/string.h>
 #include <linux/ctype.h>
 #include <malloc.h>
+#include <asm/byteorder.h>
 
 char * ___strtok;
 
+/*
+ * Helpers for the word-at-a-time implementations below. The inner loops
+ * only ever do naturally aligned accesses of unsigned long size, so they
+ * are safe on architectures without unaligned access support. A word
+ * containing a zero byte is detected with the usual
+ * (x - 0x01..01) & ~x & 0x80..80 trick.
+ */
+#define WORD_SIZE		sizeof(unsigned long)
+#define WORD_MASK		(WORD_SIZE - 1)
+#define WORD_ONES		(~0UL / 0xff)
+#define WORD_HIGHS		(WORD_ONES * 0x80)
+#define word_has_zero(x)	(((x) - WORD_ONES) & ~(x) & WORD_HIGHS)
+#define word_aligned(p)		(!((unsigned long)(p) & WORD_MASK))
+
+#ifdef __BIG_ENDIAN
+#define word_merge(w0, w1, shift) \
+	(((w0) << (shift)) | ((w1) >> (WORD_SIZE * 8 - (shift))))
+#else
+#define word_merge(w0, w1, shift) \
+	(((w0) >> (shift)) | ((w1) << (WORD_SIZE * 8 - (shift))))
+#endif
+
 #ifndef __HAVE_ARCH_STRCPY
 /**
  * strcpy - Copy a %NUL terminated string
@@ -188,7 +211,21 @@ EXPORT_SYMBOL(strncmp);
  */
 char * _strchr(const char * s, int c)
 {
-	for(; *s != (char) c; ++s)
+	const unsigned long *w;
+	unsigned long pattern = WORD_ONES * (unsigned char)c;
+
+	for (; !word_aligned(s); ++s) {
+		if (*s == (char) c)
+			return (char *) s;
+		if (*s == '\0')
+			return NULL;
+	}
+
+	for (w = (const unsigned long *)s;
+			!word_has_zero(*w) && !word_has_zero(*w ^ pattern); w++)
+		/* nothing */;
+
+	for (s = (const char *)w; *s != (char) c; ++s)
 		if (*s == '\0')
 			return NULL;
 	return (char *) s;
@@ -222,8 +259,16 @@ EXPORT_SYMBOL(_strrchr);
 size_t strlen(const char * s)
 {
 	const char *sc;
+	const unsigned long *w;
 
-	for (sc = s; *sc != '\0'; ++sc)
+	for (sc = s; !word_aligned(sc); ++sc)
+		if (*sc == '\0')
+			return sc - s;
+
+	for (w = (const unsigned long *)sc; !word_has_zero(*w); w++)
+		/* nothing */;
+
+	for (sc = (const char *)w; *sc != '\0'; ++sc)
 		/* nothing */;
 	return sc - s;
 }
@@ -252,10 +297,14 @@ char * strdup(const char *s)
 {
 	char *new;
 
-	if ((s == NULL)	||
-	    ((new = malloc (strlen(s) + 1)) == NULL) ) {
+	if (s == NULL)
+		return NULL;
+
+	malloc_trace_set_caller();
+
+	new = malloc(strlen(s) + 1);
+	if (new == NULL)
 		return NULL;
-	}
 
 	strcpy (new, s);
 	return new;
@@ -411,6 +460,27 @@ char *strswab(const char *s)
 void * memset(void * s,int c,size_t count)
 {
 	char *xs = (char *) s;
+	unsigned long *ws, pattern;
+
+	if (count >= 4 * WORD_SIZE) {
+		for (; !word_aligned(xs); count--)
+			*xs++ = c;
+
+		pattern = WORD_ONES * (unsigned char)c;
+		ws = (unsigned long *)xs;
+
+		for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+			ws[0] = pattern;
+			ws[1] = pattern;
+			ws[2] = pattern;
+			ws[3] = pattern;
+			ws += 4;
+		}
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*ws++ = pattern;
+
+		xs = (char *)ws;
+	}
 
 	while (count--)
 		*xs++ = c;
@@ -433,6 +503,51 @@ EXPORT_SYMBOL(memset);
 void * memcpy(void * dest,const void *src,size_t count)
 {
 	char *tmp = (char *) dest, *s = (char *) src;
+	unsigned long *d, *sw, w0, w1;
+	int shift;
+
+	if (count >= 4 * WORD_SIZE) {
+		for (; !word_aligned(tmp); count--)
+			*tmp++ = *s++;
+
+		d = (unsigned long *)tmp;
+
+		if (word_aligned(s)) {
+			sw = (unsigned long *)s;
+
+			for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+				d[0] = sw[0];
+				d[1] = sw[1];
+				d[2] = sw[2];
+				d[3] = sw[3];
+				d += 4;
+				sw += 4;
+			}
+			for (; count >= WORD_SIZE; count -= WORD_SIZE)
+				*d++ = *sw++;
+
+			s = (char *)sw;
+		} else {
+			/*
+			 * Source and destination are differently aligned:
+			 * read aligned source words and shift them into
+			 * place. Only bytes from words which contain at
+			 * least one byte of the source area are accessed.
+			 */
+			shift = ((unsigned long)s & WORD_MASK) * 8;
+			sw = (unsigned long *)((unsigned long)s & ~WORD_MASK);
+			w0 = *sw++;
+
+			for (; count >= WORD_SIZE; count -= WORD_SIZE) {
+				w1 = *sw++;
+				*d++ = word_merge(w0, w1, shift);
+				w0 = w1;
+				s += WORD_SIZE;
+			}
+		}
+
+		tmp = (char *)d;
+	}
 
 	while (count--)
 		*tmp++ = *s++;
@@ -482,10 +597,37 @@ EXPORT_SYMBOL(memmove);
  */
 int memcmp(const void * cs,const void * ct,size_t count)
 {
-	const unsigned char *su1, *su2;
+	const unsigned char *su1 = cs, *su2 = ct;
+	const unsigned long *w1, *w2;
 	int res = 0;
 
-	for( su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+	/* Skip equal words, the byte loop below finds the difference */
+	if (count >= WORD_SIZE &&
+			!(((unsigned long)su1 ^ (unsigned long)su2) & WORD_MASK)) {
+		for (; !word_aligned(su1); ++su1, ++su2, count--)
+			if ((res = *su1 - *su2) != 0)
+				return res;
+
+		w1 = (const unsigned long *)su1;
+		w2 = (const unsigned long *)su2;
+
+		for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+			if (w1[0] != w2[0] || w1[1] != w2[1] ||
+					w1[2] != w2[2] || w1[3] != w2[3])
+				break;
+			w1 += 4;
+			w2 += 4;
+		}
+		for (; count >= WORD_SIZE && *w1 == *w2; count -= WORD_SIZE) {
+			w1++;
+			w2++;
+		}
+
+		su1 = (const unsigned char *)w1;
+		su2 = (const unsigned char *)w2;
+	}
+
+	for(; 0 < count; ++su1, ++su2, count--)
 		if ((res = *su1 - *su2) != 0)
 			break;
 	return res;
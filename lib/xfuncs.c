@@ -27,6 +27,8 @@ void *xmalloc(size_t size)
 {
 	void *p = NULL;
 
+	malloc_trace_set_caller();
+
 	if (!(p = malloc(size)))
 		panic("ERROR: out of memory\n");
 
@@ -40,6 +42,8 @@ void *xrealloc(void *ptr, size_t size)
 {
 	void *p = NULL;
 
+	malloc_trace_set_caller();
+
 	if (!(p = realloc(ptr, size)))
 		panic("ERROR: out of memory\n");
 
@@ -51,7 +55,11 @@ EXPORT_SYMBOL(xrealloc);
 
 void *xzalloc(size_t size)
 {
-	void *ptr = xmalloc(size);
+	void *ptr;
+
+	malloc_trace_set_caller();
+
+	ptr = xmalloc(size);
 	memset(ptr, 0, size);
 	return ptr;
 }
@@ -59,7 +67,11 @@ EXPORT_SYMBOL(xzalloc);
 
 char *xstrdup(const char *s)
 {
-	char *p = strdup(s);
+	char *p;
+
+	malloc_trace_set_caller();
+
+	p = strdup(s);
 
 	if (!p)
 		panic("ERROR: out of memory\n");
@@ -69,7 +81,11 @@ EXPORT_SYMBOL(xstrdup);
 
 void* xmemalign(size_t alignment, size_t bytes)
 {
-	void *p = memalign(alignment, bytes);
+	void *p;
+
+	malloc_trace_set_caller();
+
+	p = memalign(alignment, bytes);
 	if (!p)
 		panic("ERROR: out of memory\n");
 	return p;